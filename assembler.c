@@ -0,0 +1,870 @@
+#include "assembler.h"
+
+#include <string.h>
+
+#define H8_ASM_FIXUP_REL8  0
+#define H8_ASM_FIXUP_REL16 1
+#define H8_ASM_FIXUP_ABS16 2
+#define H8_ASM_FIXUP_ABS24 3
+
+/** The address stored for labels which have not been bound yet */
+#define H8_ASM_UNBOUND 0xFFFFFFFF
+
+static void h8_asm_fail(h8_asm_t *a, h8_asm_error error)
+{
+  /* Only the first error is kept, as later ones are usually caused by it */
+  if (a->error == H8_ASM_ERROR_NONE)
+    a->error = error;
+}
+
+static void h8_asm_put(h8_asm_t *a, unsigned address, unsigned value)
+{
+  if (address >= a->size)
+    h8_asm_fail(a, H8_ASM_ERROR_OVERFLOW);
+  else
+    a->image[address] = (h8_u8)value;
+}
+
+static void emit8(h8_asm_t *a, unsigned value)
+{
+  h8_asm_put(a, a->pc, value);
+  a->pc++;
+  if (a->pc > a->end)
+    a->end = a->pc;
+}
+
+static void emit16(h8_asm_t *a, unsigned value)
+{
+  emit8(a, (value >> 8) & 0xFF);
+  emit8(a, value & 0xFF);
+}
+
+static void emit32(h8_asm_t *a, h8_u32 value)
+{
+  emit16(a, (value >> 16) & 0xFFFF);
+  emit16(a, value & 0xFFFF);
+}
+
+/** Emits a two-byte instruction with a pair of 4-bit operands */
+static void emit_op(h8_asm_t *a, unsigned op, unsigned h, unsigned l)
+{
+  if (h > 0xF || l > 0xF)
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+  emit8(a, op);
+  emit8(a, ((h & 0xF) << 4) | (l & 0xF));
+}
+
+static void h8_asm_reference(h8_asm_t *a, h8_asm_label label, unsigned kind,
+                             unsigned size)
+{
+  h8_asm_fixup_t *fixup;
+
+  if (label >= a->label_count || a->fixup_count >= H8_ASM_FIXUPS_MAX)
+  {
+    h8_asm_fail(a, H8_ASM_ERROR_LABELS);
+    return;
+  }
+  fixup = &a->fixups[a->fixup_count++];
+  fixup->address = a->pc;
+  fixup->base = a->pc + size;
+  fixup->label = label;
+  fixup->kind = (h8_u8)kind;
+
+  /* Reserve space, filled in by h8_asm_finish */
+  while (size--)
+    emit8(a, 0);
+}
+
+void h8_asm_init(h8_asm_t *a, void *image, unsigned size)
+{
+  memset(a, 0, sizeof(*a));
+  a->image = image;
+  a->size = size;
+  a->pc = sizeof(h8_ivat_t);
+  a->end = a->pc;
+}
+
+void h8_asm_org(h8_asm_t *a, unsigned address)
+{
+  a->pc = address;
+}
+
+void h8_asm_align(h8_asm_t *a, unsigned alignment)
+{
+  while (alignment && a->pc % alignment)
+    emit8(a, 0);
+}
+
+unsigned h8_asm_finish(h8_asm_t *a)
+{
+  unsigned i;
+
+  for (i = 0; i < a->fixup_count; i++)
+  {
+    const h8_asm_fixup_t *fixup = &a->fixups[i];
+    h8_u32 target = a->labels[fixup->label];
+    long disp = (long)target - (long)fixup->base;
+
+    if (target == H8_ASM_UNBOUND)
+    {
+      h8_asm_fail(a, H8_ASM_ERROR_UNBOUND);
+      break;
+    }
+    switch (fixup->kind)
+    {
+    case H8_ASM_FIXUP_REL8:
+      if (disp < -128 || disp > 127)
+        h8_asm_fail(a, H8_ASM_ERROR_RANGE);
+      h8_asm_put(a, fixup->address, disp & 0xFF);
+      break;
+    case H8_ASM_FIXUP_REL16:
+      if (disp < -32768 || disp > 32767)
+        h8_asm_fail(a, H8_ASM_ERROR_RANGE);
+      h8_asm_put(a, fixup->address, (disp >> 8) & 0xFF);
+      h8_asm_put(a, fixup->address + 1, disp & 0xFF);
+      break;
+    case H8_ASM_FIXUP_ABS16:
+      if (target > 0xFFFF)
+        h8_asm_fail(a, H8_ASM_ERROR_RANGE);
+      h8_asm_put(a, fixup->address, (target >> 8) & 0xFF);
+      h8_asm_put(a, fixup->address + 1, target & 0xFF);
+      break;
+    case H8_ASM_FIXUP_ABS24:
+      h8_asm_put(a, fixup->address, (target >> 16) & 0xFF);
+      h8_asm_put(a, fixup->address + 1, (target >> 8) & 0xFF);
+      h8_asm_put(a, fixup->address + 2, target & 0xFF);
+      break;
+    }
+  }
+
+  return a->error == H8_ASM_ERROR_NONE ? a->end : 0;
+}
+
+h8_asm_label h8_asm_new_label(h8_asm_t *a)
+{
+  if (a->label_count >= H8_ASM_LABELS_MAX)
+  {
+    h8_asm_fail(a, H8_ASM_ERROR_LABELS);
+    return H8_ASM_LABELS_MAX;
+  }
+  a->labels[a->label_count] = H8_ASM_UNBOUND;
+
+  return a->label_count++;
+}
+
+void h8_asm_bind(h8_asm_t *a, h8_asm_label label)
+{
+  if (label >= a->label_count)
+    h8_asm_fail(a, H8_ASM_ERROR_LABELS);
+  else
+    a->labels[label] = a->pc;
+}
+
+h8_asm_label h8_asm_here(h8_asm_t *a)
+{
+  h8_asm_label label = h8_asm_new_label(a);
+
+  h8_asm_bind(a, label);
+
+  return label;
+}
+
+unsigned h8_asm_address(const h8_asm_t *a, h8_asm_label label)
+{
+  if (label >= a->label_count || a->labels[label] == H8_ASM_UNBOUND)
+    return 0;
+  else
+    return a->labels[label];
+}
+
+void h8_asm_vector(h8_asm_t *a, h8_vector vector, h8_asm_label label)
+{
+  unsigned pc = a->pc;
+
+  if ((unsigned)vector >= H8_VECTOR_SIZE)
+  {
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+    return;
+  }
+  a->pc = vector * sizeof(h8_word_be_t);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_ABS16, 2);
+  a->pc = pc;
+}
+
+void h8_asm_ivat_set(h8_ivat_t *ivat, h8_vector vector, unsigned address)
+{
+  h8_word_be_t *entry = &((h8_word_be_t*)ivat)[vector];
+
+  entry->h.u = (address >> 8) & 0xFF;
+  entry->l.u = address & 0xFF;
+}
+
+void h8_asm_byte(h8_asm_t *a, unsigned value)
+{
+  emit8(a, value);
+}
+
+void h8_asm_word(h8_asm_t *a, unsigned value)
+{
+  emit16(a, value);
+}
+
+void h8_asm_data(h8_asm_t *a, const void *data, unsigned size)
+{
+  const h8_u8 *bytes = data;
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    emit8(a, bytes[i]);
+}
+
+/**
+ * Instructions with a single opcode byte followed by a source and destination
+ * register nibble.
+ */
+#define H8_ASM_RR(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, unsigned rd) \
+{ \
+  emit_op(a, op, rs, rd); \
+}
+
+/** As above, but for 32-bit registers where the source has its high bit set */
+#define H8_ASM_RR_L(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned ers, unsigned erd) \
+{ \
+  emit_op(a, op, ers | 8, erd); \
+}
+
+/** Instructions with a single register operand and a sub-opcode nibble */
+#define H8_ASM_R(name, op, sub) \
+void h8_asm_##name(h8_asm_t *a, unsigned rd) \
+{ \
+  emit_op(a, op, sub, rd); \
+}
+
+/** Instructions with an 8-bit immediate encoded alongside the register */
+#define H8_ASM_IMM8(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned imm, unsigned rd) \
+{ \
+  if (rd > 0xF) \
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND); \
+  emit8(a, (op) | (rd & 0xF)); \
+  emit8(a, imm & 0xFF); \
+}
+
+/** Instructions with a 16-bit immediate following the opcode (0x79) */
+#define H8_ASM_IMM16(name, sub) \
+void h8_asm_##name(h8_asm_t *a, unsigned imm, unsigned rd) \
+{ \
+  emit_op(a, 0x79, sub, rd); \
+  emit16(a, imm & 0xFFFF); \
+}
+
+/** Instructions with a 32-bit immediate following the opcode (0x7A) */
+#define H8_ASM_IMM32(name, sub) \
+void h8_asm_##name(h8_asm_t *a, h8_u32 imm, unsigned erd) \
+{ \
+  emit_op(a, 0x7A, sub, erd); \
+  emit32(a, imm); \
+}
+
+/** Register indirect loads and stores, with the store flag in bit 7 */
+#define H8_ASM_LD(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned ers, unsigned rd) \
+{ \
+  emit_op(a, op, ers, rd); \
+}
+#define H8_ASM_ST(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, unsigned erd) \
+{ \
+  emit_op(a, op, erd | 8, rs); \
+}
+
+/** Longword variants of the above, using the 0x0100 prefix */
+#define H8_ASM_LD_L(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned ers, unsigned erd) \
+{ \
+  emit16(a, 0x0100); \
+  emit_op(a, op, ers, erd); \
+}
+#define H8_ASM_ST_L(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned ers, unsigned erd) \
+{ \
+  emit16(a, 0x0100); \
+  emit_op(a, op, erd | 8, ers); \
+}
+
+/** Register indirect with 16-bit displacement */
+#define H8_ASM_LD_D16(name, prefix, op) \
+void h8_asm_##name(h8_asm_t *a, int disp, unsigned ers, unsigned rd) \
+{ \
+  if (prefix) \
+    emit16(a, prefix); \
+  emit_op(a, op, ers, rd); \
+  emit16(a, disp & 0xFFFF); \
+}
+#define H8_ASM_ST_D16(name, prefix, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, int disp, unsigned erd) \
+{ \
+  if (prefix) \
+    emit16(a, prefix); \
+  emit_op(a, op, erd | 8, rs); \
+  emit16(a, disp & 0xFFFF); \
+}
+
+/** Register indirect with 24-bit displacement (0x78 prefix) */
+#define H8_ASM_LD_D24(name, op) \
+void h8_asm_##name(h8_asm_t *a, long disp, unsigned ers, unsigned rd) \
+{ \
+  emit_op(a, 0x78, ers, 0); \
+  emit_op(a, op, 0x2, rd); \
+  emit32(a, disp & 0xFFFFFF); \
+}
+#define H8_ASM_ST_D24(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, long disp, unsigned erd) \
+{ \
+  emit_op(a, 0x78, erd, 0); \
+  emit_op(a, op, 0xA, rs); \
+  emit32(a, disp & 0xFFFFFF); \
+}
+
+/** Absolute 16-bit and 24-bit addresses (0x6A / 0x6B) */
+#define H8_ASM_LD_ABS16(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned address, unsigned rd) \
+{ \
+  emit_op(a, op, 0x0, rd); \
+  emit16(a, address & 0xFFFF); \
+}
+#define H8_ASM_ST_ABS16(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, unsigned address) \
+{ \
+  emit_op(a, op, 0x8, rs); \
+  emit16(a, address & 0xFFFF); \
+}
+#define H8_ASM_LD_ABS24(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned address, unsigned rd) \
+{ \
+  emit_op(a, op, 0x2, rd); \
+  emit32(a, address & 0xFFFFFF); \
+}
+#define H8_ASM_ST_ABS24(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, unsigned address) \
+{ \
+  emit_op(a, op, 0xA, rs); \
+  emit32(a, address & 0xFFFFFF); \
+}
+
+/** Bit manipulation with a 3-bit immediate (or inverted) and a register */
+#define H8_ASM_BIT(name, op, invert) \
+void h8_asm_##name(h8_asm_t *a, unsigned bit, unsigned rd) \
+{ \
+  if (bit > 7) \
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND); \
+  emit_op(a, op, (bit & 7) | (invert), rd); \
+}
+
+/**
+ * Bit manipulation on memory: a 0x7C / 0x7D (@ERd) or 0x7E / 0x7F (@aa:8)
+ * prefix word, depending on whether the operand is written back.
+ */
+#define H8_ASM_BIT_IND(name, prefix, op, invert) \
+void h8_asm_##name(h8_asm_t *a, unsigned bit, unsigned erd) \
+{ \
+  if (bit > 7) \
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND); \
+  emit_op(a, prefix, erd, 0); \
+  emit_op(a, op, (bit & 7) | (invert), 0); \
+}
+#define H8_ASM_BIT_R_IND(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rn, unsigned erd) \
+{ \
+  emit_op(a, 0x7D, erd, 0); \
+  emit_op(a, op, rn, 0); \
+}
+#define H8_ASM_BIT_ABS8(name, prefix, op, invert) \
+void h8_asm_##name(h8_asm_t *a, unsigned bit, unsigned address) \
+{ \
+  if (bit > 7) \
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND); \
+  emit8(a, prefix); \
+  emit8(a, address & 0xFF); \
+  emit_op(a, op, (bit & 7) | (invert), 0); \
+}
+#define H8_ASM_BIT_R_ABS8(name, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rn, unsigned address) \
+{ \
+  emit8(a, 0x7F); \
+  emit8(a, address & 0xFF); \
+  emit_op(a, op, rn, 0); \
+}
+
+/** Instructions operating on a 16/32-bit register with an immediate of 1/2 */
+#define H8_ASM_INCDEC(name, op, sub1, sub2) \
+void h8_asm_##name(h8_asm_t *a, unsigned imm, unsigned rd) \
+{ \
+  if (imm == 1) \
+    emit_op(a, op, sub1, rd); \
+  else if (imm == 2) \
+    emit_op(a, op, sub2, rd); \
+  else \
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND); \
+}
+
+/** Instructions using the 0x01C0 / 0x01D0 prefixes */
+#define H8_ASM_RR_PREFIX(name, prefix, op) \
+void h8_asm_##name(h8_asm_t *a, unsigned rs, unsigned rd) \
+{ \
+  emit16(a, prefix); \
+  emit_op(a, op, rs, rd); \
+}
+
+/**
+ * Data transfer
+ */
+H8_ASM_RR(mov_b, 0x0C)
+H8_ASM_RR(mov_w, 0x0D)
+H8_ASM_RR_L(mov_l, 0x0F)
+H8_ASM_IMM8(mov_b_imm, 0xF0)
+H8_ASM_IMM16(mov_w_imm, 0x0)
+H8_ASM_IMM32(mov_l_imm, 0x0)
+
+void h8_asm_mov_w_label(h8_asm_t *a, h8_asm_label label, unsigned rd)
+{
+  emit_op(a, 0x79, 0x0, rd);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_ABS16, 2);
+}
+
+H8_ASM_LD(mov_b_ld_ind, 0x68)
+H8_ASM_ST(mov_b_st_ind, 0x68)
+H8_ASM_LD(mov_w_ld_ind, 0x69)
+H8_ASM_ST(mov_w_st_ind, 0x69)
+H8_ASM_LD_L(mov_l_ld_ind, 0x69)
+H8_ASM_ST_L(mov_l_st_ind, 0x69)
+
+H8_ASM_LD(mov_b_ld_inc, 0x6C)
+H8_ASM_ST(mov_b_st_dec, 0x6C)
+H8_ASM_LD(mov_w_ld_inc, 0x6D)
+H8_ASM_ST(mov_w_st_dec, 0x6D)
+H8_ASM_LD_L(mov_l_ld_inc, 0x6D)
+H8_ASM_ST_L(mov_l_st_dec, 0x6D)
+
+H8_ASM_LD_D16(mov_b_ld_d16, 0, 0x6E)
+H8_ASM_ST_D16(mov_b_st_d16, 0, 0x6E)
+H8_ASM_LD_D16(mov_w_ld_d16, 0, 0x6F)
+H8_ASM_ST_D16(mov_w_st_d16, 0, 0x6F)
+H8_ASM_LD_D16(mov_l_ld_d16, 0x0100, 0x6F)
+H8_ASM_ST_D16(mov_l_st_d16, 0x0100, 0x6F)
+
+H8_ASM_LD_D24(mov_b_ld_d24, 0x6A)
+H8_ASM_ST_D24(mov_b_st_d24, 0x6A)
+H8_ASM_LD_D24(mov_w_ld_d24, 0x6B)
+H8_ASM_ST_D24(mov_w_st_d24, 0x6B)
+
+void h8_asm_mov_b_ld_abs8(h8_asm_t *a, unsigned address, unsigned rd)
+{
+  if (rd > 0xF)
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+  emit8(a, 0x20 | (rd & 0xF));
+  emit8(a, address & 0xFF);
+}
+
+void h8_asm_mov_b_st_abs8(h8_asm_t *a, unsigned rs, unsigned address)
+{
+  if (rs > 0xF)
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+  emit8(a, 0x30 | (rs & 0xF));
+  emit8(a, address & 0xFF);
+}
+
+H8_ASM_LD_ABS16(mov_b_ld_abs16, 0x6A)
+H8_ASM_ST_ABS16(mov_b_st_abs16, 0x6A)
+H8_ASM_LD_ABS16(mov_w_ld_abs16, 0x6B)
+H8_ASM_ST_ABS16(mov_w_st_abs16, 0x6B)
+
+void h8_asm_mov_l_ld_abs16(h8_asm_t *a, unsigned address, unsigned erd)
+{
+  emit16(a, 0x0100);
+  emit_op(a, 0x6B, 0x0, erd);
+  emit16(a, address & 0xFFFF);
+}
+
+void h8_asm_mov_l_st_abs16(h8_asm_t *a, unsigned ers, unsigned address)
+{
+  emit16(a, 0x0100);
+  emit_op(a, 0x6B, 0x8, ers);
+  emit16(a, address & 0xFFFF);
+}
+
+H8_ASM_LD_ABS24(mov_b_ld_abs24, 0x6A)
+H8_ASM_ST_ABS24(mov_b_st_abs24, 0x6A)
+H8_ASM_LD_ABS24(mov_w_ld_abs24, 0x6B)
+H8_ASM_ST_ABS24(mov_w_st_abs24, 0x6B)
+
+void h8_asm_push_w(h8_asm_t *a, unsigned rs)
+{
+  h8_asm_mov_w_st_dec(a, rs, H8_ASM_SP);
+}
+
+void h8_asm_pop_w(h8_asm_t *a, unsigned rd)
+{
+  h8_asm_mov_w_ld_inc(a, H8_ASM_SP, rd);
+}
+
+void h8_asm_push_l(h8_asm_t *a, unsigned ers)
+{
+  h8_asm_mov_l_st_dec(a, ers, H8_ASM_SP);
+}
+
+void h8_asm_pop_l(h8_asm_t *a, unsigned erd)
+{
+  h8_asm_mov_l_ld_inc(a, H8_ASM_SP, erd);
+}
+
+/**
+ * Arithmetic
+ */
+H8_ASM_RR(add_b, 0x08)
+H8_ASM_RR(add_w, 0x09)
+H8_ASM_RR_L(add_l, 0x0A)
+H8_ASM_IMM8(add_b_imm, 0x80)
+H8_ASM_IMM16(add_w_imm, 0x1)
+H8_ASM_IMM32(add_l_imm, 0x1)
+H8_ASM_RR(addx, 0x0E)
+H8_ASM_IMM8(addx_imm, 0x90)
+H8_ASM_R(inc_b, 0x0A, 0x0)
+H8_ASM_INCDEC(inc_w, 0x0B, 0x5, 0xD)
+H8_ASM_INCDEC(inc_l, 0x0B, 0x7, 0xF)
+H8_ASM_R(daa, 0x0F, 0x0)
+
+void h8_asm_adds(h8_asm_t *a, unsigned imm, unsigned erd)
+{
+  switch (imm)
+  {
+  case 1:
+    emit_op(a, 0x0B, 0x0, erd);
+    break;
+  case 2:
+    emit_op(a, 0x0B, 0x8, erd);
+    break;
+  case 4:
+    emit_op(a, 0x0B, 0x9, erd);
+    break;
+  default:
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+  }
+}
+
+H8_ASM_RR(sub_b, 0x18)
+H8_ASM_RR(sub_w, 0x19)
+H8_ASM_RR_L(sub_l, 0x1A)
+H8_ASM_IMM16(sub_w_imm, 0x3)
+H8_ASM_IMM32(sub_l_imm, 0x3)
+H8_ASM_RR(subx, 0x1E)
+H8_ASM_IMM8(subx_imm, 0xB0)
+H8_ASM_R(dec_b, 0x1A, 0x0)
+H8_ASM_INCDEC(dec_w, 0x1B, 0x5, 0xD)
+H8_ASM_INCDEC(dec_l, 0x1B, 0x7, 0xF)
+
+void h8_asm_subs(h8_asm_t *a, unsigned imm, unsigned erd)
+{
+  switch (imm)
+  {
+  case 1:
+    emit_op(a, 0x1B, 0x0, erd);
+    break;
+  case 2:
+    emit_op(a, 0x1B, 0x8, erd);
+    break;
+  case 4:
+    emit_op(a, 0x1B, 0x9, erd);
+    break;
+  default:
+    h8_asm_fail(a, H8_ASM_ERROR_OPERAND);
+  }
+}
+
+H8_ASM_RR(cmp_b, 0x1C)
+H8_ASM_RR(cmp_w, 0x1D)
+H8_ASM_RR_L(cmp_l, 0x1F)
+H8_ASM_IMM8(cmp_b_imm, 0xA0)
+H8_ASM_IMM16(cmp_w_imm, 0x2)
+H8_ASM_IMM32(cmp_l_imm, 0x2)
+
+H8_ASM_R(neg_b, 0x17, 0x8)
+H8_ASM_R(neg_w, 0x17, 0x9)
+H8_ASM_R(neg_l, 0x17, 0xB)
+H8_ASM_R(extu_w, 0x17, 0x5)
+H8_ASM_R(extu_l, 0x17, 0x7)
+H8_ASM_R(exts_w, 0x17, 0xD)
+H8_ASM_R(exts_l, 0x17, 0xF)
+
+H8_ASM_RR(mulxu_b, 0x50)
+H8_ASM_RR(divxu_b, 0x51)
+H8_ASM_RR(mulxu_w, 0x52)
+H8_ASM_RR(divxu_w, 0x53)
+H8_ASM_RR_PREFIX(mulxs_b, 0x01C0, 0x50)
+H8_ASM_RR_PREFIX(mulxs_w, 0x01C0, 0x52)
+H8_ASM_RR_PREFIX(divxs_b, 0x01D0, 0x51)
+H8_ASM_RR_PREFIX(divxs_w, 0x01D0, 0x53)
+
+/**
+ * Logic operations
+ */
+H8_ASM_RR(and_b, 0x16)
+H8_ASM_RR(and_w, 0x66)
+H8_ASM_IMM8(and_b_imm, 0xE0)
+H8_ASM_IMM16(and_w_imm, 0x6)
+H8_ASM_IMM32(and_l_imm, 0x6)
+H8_ASM_RR_PREFIX(and_l, 0x01F0, 0x66)
+H8_ASM_RR(or_b, 0x14)
+H8_ASM_RR(or_w, 0x64)
+H8_ASM_IMM8(or_b_imm, 0xC0)
+H8_ASM_IMM16(or_w_imm, 0x4)
+H8_ASM_IMM32(or_l_imm, 0x4)
+H8_ASM_RR_PREFIX(or_l, 0x01F0, 0x64)
+H8_ASM_RR(xor_b, 0x15)
+H8_ASM_RR(xor_w, 0x65)
+H8_ASM_IMM8(xor_b_imm, 0xD0)
+H8_ASM_IMM16(xor_w_imm, 0x5)
+H8_ASM_IMM32(xor_l_imm, 0x5)
+H8_ASM_RR_PREFIX(xor_l, 0x01F0, 0x65)
+H8_ASM_R(not_b, 0x17, 0x0)
+H8_ASM_R(not_w, 0x17, 0x1)
+H8_ASM_R(not_l, 0x17, 0x3)
+
+/**
+ * Shift operations
+ */
+H8_ASM_R(shll_b, 0x10, 0x0)
+H8_ASM_R(shll_w, 0x10, 0x1)
+H8_ASM_R(shll_l, 0x10, 0x3)
+H8_ASM_R(shal_b, 0x10, 0x8)
+H8_ASM_R(shal_w, 0x10, 0x9)
+H8_ASM_R(shal_l, 0x10, 0xB)
+H8_ASM_R(shlr_b, 0x11, 0x0)
+H8_ASM_R(shlr_w, 0x11, 0x1)
+H8_ASM_R(shlr_l, 0x11, 0x3)
+H8_ASM_R(shar_b, 0x11, 0x8)
+H8_ASM_R(shar_w, 0x11, 0x9)
+H8_ASM_R(shar_l, 0x11, 0xB)
+H8_ASM_R(rotxl_b, 0x12, 0x0)
+H8_ASM_R(rotxl_w, 0x12, 0x1)
+H8_ASM_R(rotxl_l, 0x12, 0x3)
+H8_ASM_R(rotl_b, 0x12, 0x8)
+H8_ASM_R(rotl_w, 0x12, 0x9)
+H8_ASM_R(rotl_l, 0x12, 0xB)
+H8_ASM_R(rotxr_b, 0x13, 0x0)
+H8_ASM_R(rotxr_w, 0x13, 0x1)
+H8_ASM_R(rotxr_l, 0x13, 0x3)
+H8_ASM_R(rotr_b, 0x13, 0x8)
+H8_ASM_R(rotr_w, 0x13, 0x9)
+H8_ASM_R(rotr_l, 0x13, 0xB)
+
+/**
+ * Bit manipulation
+ */
+H8_ASM_BIT(bset, 0x70, 0)
+H8_ASM_BIT(bnot, 0x71, 0)
+H8_ASM_BIT(bclr, 0x72, 0)
+H8_ASM_BIT(btst, 0x73, 0)
+H8_ASM_BIT(bst, 0x67, 0)
+H8_ASM_BIT(bist, 0x67, 8)
+H8_ASM_BIT(bld, 0x77, 0)
+H8_ASM_BIT(bild, 0x77, 8)
+
+H8_ASM_RR(bset_r, 0x60)
+H8_ASM_RR(bnot_r, 0x61)
+H8_ASM_RR(bclr_r, 0x62)
+H8_ASM_RR(btst_r, 0x63)
+
+H8_ASM_BIT_IND(bset_ind, 0x7D, 0x70, 0)
+H8_ASM_BIT_IND(bnot_ind, 0x7D, 0x71, 0)
+H8_ASM_BIT_IND(bclr_ind, 0x7D, 0x72, 0)
+H8_ASM_BIT_IND(bst_ind, 0x7D, 0x67, 0)
+H8_ASM_BIT_IND(bist_ind, 0x7D, 0x67, 8)
+H8_ASM_BIT_IND(btst_ind, 0x7C, 0x73, 0)
+H8_ASM_BIT_IND(bld_ind, 0x7C, 0x77, 0)
+H8_ASM_BIT_IND(bild_ind, 0x7C, 0x77, 8)
+
+H8_ASM_BIT_R_IND(bset_r_ind, 0x60)
+H8_ASM_BIT_R_IND(bnot_r_ind, 0x61)
+H8_ASM_BIT_R_IND(bclr_r_ind, 0x62)
+
+H8_ASM_BIT_ABS8(bset_abs8, 0x7F, 0x70, 0)
+H8_ASM_BIT_ABS8(bnot_abs8, 0x7F, 0x71, 0)
+H8_ASM_BIT_ABS8(bclr_abs8, 0x7F, 0x72, 0)
+H8_ASM_BIT_ABS8(bst_abs8, 0x7F, 0x67, 0)
+H8_ASM_BIT_ABS8(bist_abs8, 0x7F, 0x67, 8)
+H8_ASM_BIT_ABS8(bld_abs8, 0x7E, 0x77, 0)
+H8_ASM_BIT_ABS8(bild_abs8, 0x7E, 0x77, 8)
+
+H8_ASM_BIT_R_ABS8(bset_r_abs8, 0x60)
+H8_ASM_BIT_R_ABS8(bnot_r_abs8, 0x61)
+H8_ASM_BIT_R_ABS8(bclr_r_abs8, 0x62)
+
+/**
+ * Branching
+ */
+void h8_asm_bcc_8(h8_asm_t *a, h8_asm_cond cond, h8_asm_label label)
+{
+  emit8(a, 0x40 | (cond & 0xF));
+  h8_asm_reference(a, label, H8_ASM_FIXUP_REL8, 1);
+}
+
+void h8_asm_bcc_16(h8_asm_t *a, h8_asm_cond cond, h8_asm_label label)
+{
+  emit_op(a, 0x58, cond & 0xF, 0);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_REL16, 2);
+}
+
+void h8_asm_bsr_8(h8_asm_t *a, h8_asm_label label)
+{
+  emit8(a, 0x55);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_REL8, 1);
+}
+
+void h8_asm_bsr_16(h8_asm_t *a, h8_asm_label label)
+{
+  emit16(a, 0x5C00);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_REL16, 2);
+}
+
+void h8_asm_jmp_ind(h8_asm_t *a, unsigned ern)
+{
+  emit_op(a, 0x59, ern, 0);
+}
+
+void h8_asm_jmp(h8_asm_t *a, h8_asm_label label)
+{
+  emit8(a, 0x5A);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_ABS24, 3);
+}
+
+void h8_asm_jsr_ind(h8_asm_t *a, unsigned ern)
+{
+  emit_op(a, 0x5D, ern, 0);
+}
+
+void h8_asm_jsr(h8_asm_t *a, h8_asm_label label)
+{
+  emit8(a, 0x5E);
+  h8_asm_reference(a, label, H8_ASM_FIXUP_ABS24, 3);
+}
+
+void h8_asm_rts(h8_asm_t *a)
+{
+  emit16(a, 0x5470);
+}
+
+void h8_asm_rte(h8_asm_t *a)
+{
+  emit16(a, 0x5670);
+}
+
+/**
+ * System control
+ */
+void h8_asm_nop(h8_asm_t *a)
+{
+  emit16(a, 0x0000);
+}
+
+void h8_asm_sleep(h8_asm_t *a)
+{
+  emit16(a, 0x0180);
+}
+
+H8_ASM_R(stc, 0x02, 0x0)
+H8_ASM_R(ldc, 0x03, 0x0)
+
+void h8_asm_ldc_imm(h8_asm_t *a, unsigned imm)
+{
+  emit8(a, 0x07);
+  emit8(a, imm & 0xFF);
+}
+
+void h8_asm_andc(h8_asm_t *a, unsigned imm)
+{
+  emit8(a, 0x06);
+  emit8(a, imm & 0xFF);
+}
+
+void h8_asm_orc(h8_asm_t *a, unsigned imm)
+{
+  emit8(a, 0x04);
+  emit8(a, imm & 0xFF);
+}
+
+void h8_asm_xorc(h8_asm_t *a, unsigned imm)
+{
+  emit8(a, 0x05);
+  emit8(a, imm & 0xFF);
+}
+
+void h8_asm_ldc_w_ind(h8_asm_t *a, unsigned ers)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x69, ers, 0);
+}
+
+void h8_asm_stc_w_ind(h8_asm_t *a, unsigned erd)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x69, erd | 8, 0);
+}
+
+void h8_asm_ldc_w_inc(h8_asm_t *a, unsigned ers)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x6D, ers, 0);
+}
+
+void h8_asm_stc_w_dec(h8_asm_t *a, unsigned erd)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x6D, erd | 8, 0);
+}
+
+void h8_asm_ldc_w_d16(h8_asm_t *a, int disp, unsigned ers)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x6F, ers, 0);
+  emit16(a, disp & 0xFFFF);
+}
+
+void h8_asm_stc_w_d16(h8_asm_t *a, int disp, unsigned erd)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x6F, erd | 8, 0);
+  emit16(a, disp & 0xFFFF);
+}
+
+void h8_asm_ldc_w_d24(h8_asm_t *a, long disp, unsigned ers)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x78, ers, 0);
+  emit16(a, 0x6B20);
+  emit32(a, disp & 0xFFFFFF);
+}
+
+void h8_asm_stc_w_d24(h8_asm_t *a, long disp, unsigned erd)
+{
+  emit16(a, 0x0140);
+  emit_op(a, 0x78, erd, 0);
+  emit16(a, 0x6BA0);
+  emit32(a, disp & 0xFFFFFF);
+}
+
+void h8_asm_ldc_w_abs16(h8_asm_t *a, unsigned address)
+{
+  emit16(a, 0x0140);
+  emit16(a, 0x6B00);
+  emit16(a, address & 0xFFFF);
+}
+
+void h8_asm_stc_w_abs16(h8_asm_t *a, unsigned address)
+{
+  emit16(a, 0x0140);
+  emit16(a, 0x6B80);
+  emit16(a, address & 0xFFFF);
+}
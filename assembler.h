@@ -0,0 +1,479 @@
+#ifndef H8_ASSEMBLER_H
+#define H8_ASSEMBLER_H
+
+#include "system.h"
+#include "types.h"
+
+/**
+ * A minimal in-memory assembler emitting H8/300H machine code for the subset
+ * of instructions implemented by the emulator. It is meant for building
+ * synthetic ROMs for tests and benchmarks, so each instruction is a function
+ * call writing directly into a caller-provided ROM image.
+ *
+ * The image buffer is indexed by address, so byte 0 of the buffer is the
+ * first byte of the interrupt vector address table.
+ */
+
+/** An arbitrary maximum for how many labels a single image can contain */
+#define H8_ASM_LABELS_MAX 256
+
+/** An arbitrary maximum for how many unresolved label references can exist */
+#define H8_ASM_FIXUPS_MAX 512
+
+typedef enum
+{
+  H8_ASM_ERROR_NONE = 0,
+
+  /** An instruction was emitted past the end of the image buffer */
+  H8_ASM_ERROR_OVERFLOW,
+
+  /** Too many labels or label references were created */
+  H8_ASM_ERROR_LABELS,
+
+  /** A label was referenced but never bound to an address */
+  H8_ASM_ERROR_UNBOUND,
+
+  /** A branch target is too far away for the chosen displacement size */
+  H8_ASM_ERROR_RANGE,
+
+  /** An operand is outside of its valid range */
+  H8_ASM_ERROR_OPERAND,
+
+  H8_ASM_ERROR_SIZE
+} h8_asm_error;
+
+/** 8-bit general registers, as encoded in instructions */
+enum
+{
+  H8_ASM_R0H = 0,
+  H8_ASM_R1H,
+  H8_ASM_R2H,
+  H8_ASM_R3H,
+  H8_ASM_R4H,
+  H8_ASM_R5H,
+  H8_ASM_R6H,
+  H8_ASM_R7H,
+  H8_ASM_R0L,
+  H8_ASM_R1L,
+  H8_ASM_R2L,
+  H8_ASM_R3L,
+  H8_ASM_R4L,
+  H8_ASM_R5L,
+  H8_ASM_R6L,
+  H8_ASM_R7L
+};
+
+/** 16-bit general registers, as encoded in instructions */
+enum
+{
+  H8_ASM_R0 = 0,
+  H8_ASM_R1,
+  H8_ASM_R2,
+  H8_ASM_R3,
+  H8_ASM_R4,
+  H8_ASM_R5,
+  H8_ASM_R6,
+  H8_ASM_R7,
+  H8_ASM_E0,
+  H8_ASM_E1,
+  H8_ASM_E2,
+  H8_ASM_E3,
+  H8_ASM_E4,
+  H8_ASM_E5,
+  H8_ASM_E6,
+  H8_ASM_E7
+};
+
+/** 32-bit general registers, as encoded in instructions */
+enum
+{
+  H8_ASM_ER0 = 0,
+  H8_ASM_ER1,
+  H8_ASM_ER2,
+  H8_ASM_ER3,
+  H8_ASM_ER4,
+  H8_ASM_ER5,
+  H8_ASM_ER6,
+  H8_ASM_ER7,
+
+  H8_ASM_SP = H8_ASM_ER7
+};
+
+/** Branch conditions, as encoded in Bcc instructions */
+typedef enum
+{
+  H8_ASM_BRA = 0,
+  H8_ASM_BRN,
+  H8_ASM_BHI,
+  H8_ASM_BLS,
+  H8_ASM_BCC,
+  H8_ASM_BCS,
+  H8_ASM_BNE,
+  H8_ASM_BEQ,
+  H8_ASM_BVC,
+  H8_ASM_BVS,
+  H8_ASM_BPL,
+  H8_ASM_BMI,
+  H8_ASM_BGE,
+  H8_ASM_BLT,
+  H8_ASM_BGT,
+  H8_ASM_BLE
+} h8_asm_cond;
+
+typedef unsigned h8_asm_label;
+
+typedef struct
+{
+  /** The address of the first byte of the reference */
+  unsigned address;
+
+  /** The address displacements are relative to */
+  unsigned base;
+
+  h8_asm_label label;
+
+  /** One of the H8_ASM_FIXUP_* kinds */
+  h8_u8 kind;
+} h8_asm_fixup_t;
+
+typedef struct
+{
+  /** The ROM image being written, indexed by address */
+  h8_u8 *image;
+
+  /** The size of the ROM image buffer in bytes */
+  unsigned size;
+
+  /** The address the next instruction will be written to */
+  unsigned pc;
+
+  /** One past the highest address written to so far */
+  unsigned end;
+
+  /** The first error encountered, or H8_ASM_ERROR_NONE */
+  h8_asm_error error;
+
+  unsigned labels[H8_ASM_LABELS_MAX];
+  unsigned label_count;
+
+  h8_asm_fixup_t fixups[H8_ASM_FIXUPS_MAX];
+  unsigned fixup_count;
+} h8_asm_t;
+
+/**
+ * Begins assembling into an image buffer. The buffer is not cleared, and
+ * assembly begins at the first address after the vector table.
+ */
+void h8_asm_init(h8_asm_t *a, void *image, unsigned size);
+
+/** Sets the address the next instruction will be written to */
+void h8_asm_org(h8_asm_t *a, unsigned address);
+
+/** Pads with NOPs until the current address is a multiple of `alignment` */
+void h8_asm_align(h8_asm_t *a, unsigned alignment);
+
+/**
+ * Resolves all label references. Should be called once all code is emitted.
+ * @return The size of the resulting image, or 0 if an error occurred
+ */
+unsigned h8_asm_finish(h8_asm_t *a);
+
+/** Creates a new label which can be referenced before it is bound */
+h8_asm_label h8_asm_new_label(h8_asm_t *a);
+
+/** Binds a label to the current address */
+void h8_asm_bind(h8_asm_t *a, h8_asm_label label);
+
+/** Creates a new label bound to the current address */
+h8_asm_label h8_asm_here(h8_asm_t *a);
+
+/** Returns the address a label is bound to, or 0 if it is not yet bound */
+unsigned h8_asm_address(const h8_asm_t *a, h8_asm_label label);
+
+/** Points an entry of the image's vector table to a label */
+void h8_asm_vector(h8_asm_t *a, h8_vector vector, h8_asm_label label);
+
+/** Points an entry of an existing vector table to an address */
+void h8_asm_ivat_set(h8_ivat_t *ivat, h8_vector vector, unsigned address);
+
+/**
+ * Raw data
+ */
+void h8_asm_byte(h8_asm_t *a, unsigned value);
+void h8_asm_word(h8_asm_t *a, unsigned value);
+void h8_asm_data(h8_asm_t *a, const void *data, unsigned size);
+
+/**
+ * Data transfer
+ */
+void h8_asm_mov_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_mov_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_mov_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_mov_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_mov_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_mov_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+
+/** MOV.W #label, Rd */
+void h8_asm_mov_w_label(h8_asm_t *a, h8_asm_label label, unsigned rd);
+
+/** MOV @ERs, Rd / MOV Rs, @ERd */
+void h8_asm_mov_b_ld_ind(h8_asm_t *a, unsigned ers, unsigned rd);
+void h8_asm_mov_b_st_ind(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_mov_w_ld_ind(h8_asm_t *a, unsigned ers, unsigned rd);
+void h8_asm_mov_w_st_ind(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_mov_l_ld_ind(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_mov_l_st_ind(h8_asm_t *a, unsigned ers, unsigned erd);
+
+/** MOV @ERs+, Rd / MOV Rs, @-ERd */
+void h8_asm_mov_b_ld_inc(h8_asm_t *a, unsigned ers, unsigned rd);
+void h8_asm_mov_b_st_dec(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_mov_w_ld_inc(h8_asm_t *a, unsigned ers, unsigned rd);
+void h8_asm_mov_w_st_dec(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_mov_l_ld_inc(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_mov_l_st_dec(h8_asm_t *a, unsigned ers, unsigned erd);
+
+/** MOV @(d:16, ERs), Rd / MOV Rs, @(d:16, ERd) */
+void h8_asm_mov_b_ld_d16(h8_asm_t *a, int disp, unsigned ers, unsigned rd);
+void h8_asm_mov_b_st_d16(h8_asm_t *a, unsigned rs, int disp, unsigned erd);
+void h8_asm_mov_w_ld_d16(h8_asm_t *a, int disp, unsigned ers, unsigned rd);
+void h8_asm_mov_w_st_d16(h8_asm_t *a, unsigned rs, int disp, unsigned erd);
+void h8_asm_mov_l_ld_d16(h8_asm_t *a, int disp, unsigned ers, unsigned erd);
+void h8_asm_mov_l_st_d16(h8_asm_t *a, unsigned ers, int disp, unsigned erd);
+
+/** MOV @(d:24, ERs), Rd / MOV Rs, @(d:24, ERd) */
+void h8_asm_mov_b_ld_d24(h8_asm_t *a, long disp, unsigned ers, unsigned rd);
+void h8_asm_mov_b_st_d24(h8_asm_t *a, unsigned rs, long disp, unsigned erd);
+void h8_asm_mov_w_ld_d24(h8_asm_t *a, long disp, unsigned ers, unsigned rd);
+void h8_asm_mov_w_st_d24(h8_asm_t *a, unsigned rs, long disp, unsigned erd);
+
+/** MOV.B @aa:8, Rd / MOV.B Rs, @aa:8 */
+void h8_asm_mov_b_ld_abs8(h8_asm_t *a, unsigned address, unsigned rd);
+void h8_asm_mov_b_st_abs8(h8_asm_t *a, unsigned rs, unsigned address);
+
+/** MOV @aa:16, Rd / MOV Rs, @aa:16 */
+void h8_asm_mov_b_ld_abs16(h8_asm_t *a, unsigned address, unsigned rd);
+void h8_asm_mov_b_st_abs16(h8_asm_t *a, unsigned rs, unsigned address);
+void h8_asm_mov_w_ld_abs16(h8_asm_t *a, unsigned address, unsigned rd);
+void h8_asm_mov_w_st_abs16(h8_asm_t *a, unsigned rs, unsigned address);
+void h8_asm_mov_l_ld_abs16(h8_asm_t *a, unsigned address, unsigned erd);
+void h8_asm_mov_l_st_abs16(h8_asm_t *a, unsigned ers, unsigned address);
+
+/** MOV @aa:24, Rd / MOV Rs, @aa:24 */
+void h8_asm_mov_b_ld_abs24(h8_asm_t *a, unsigned address, unsigned rd);
+void h8_asm_mov_b_st_abs24(h8_asm_t *a, unsigned rs, unsigned address);
+void h8_asm_mov_w_ld_abs24(h8_asm_t *a, unsigned address, unsigned rd);
+void h8_asm_mov_w_st_abs24(h8_asm_t *a, unsigned rs, unsigned address);
+
+void h8_asm_push_w(h8_asm_t *a, unsigned rs);
+void h8_asm_pop_w(h8_asm_t *a, unsigned rd);
+void h8_asm_push_l(h8_asm_t *a, unsigned ers);
+void h8_asm_pop_l(h8_asm_t *a, unsigned erd);
+
+/**
+ * Arithmetic
+ */
+void h8_asm_add_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_add_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_add_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_add_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_add_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_add_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+void h8_asm_addx(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_addx_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+
+/** ADDS #1/#2/#4, ERd */
+void h8_asm_adds(h8_asm_t *a, unsigned imm, unsigned erd);
+void h8_asm_inc_b(h8_asm_t *a, unsigned rd);
+
+/** INC.W #1/#2, Rd */
+void h8_asm_inc_w(h8_asm_t *a, unsigned imm, unsigned rd);
+
+/** INC.L #1/#2, ERd */
+void h8_asm_inc_l(h8_asm_t *a, unsigned imm, unsigned erd);
+void h8_asm_daa(h8_asm_t *a, unsigned rd);
+
+void h8_asm_sub_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_sub_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_sub_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_sub_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_sub_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+void h8_asm_subx(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_subx_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+
+/** SUBS #1/#2/#4, ERd */
+void h8_asm_subs(h8_asm_t *a, unsigned imm, unsigned erd);
+void h8_asm_dec_b(h8_asm_t *a, unsigned rd);
+
+/** DEC.W #1/#2, Rd */
+void h8_asm_dec_w(h8_asm_t *a, unsigned imm, unsigned rd);
+
+/** DEC.L #1/#2, ERd */
+void h8_asm_dec_l(h8_asm_t *a, unsigned imm, unsigned erd);
+
+void h8_asm_cmp_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_cmp_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_cmp_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_cmp_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_cmp_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_cmp_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+
+void h8_asm_neg_b(h8_asm_t *a, unsigned rd);
+void h8_asm_neg_w(h8_asm_t *a, unsigned rd);
+void h8_asm_neg_l(h8_asm_t *a, unsigned erd);
+void h8_asm_extu_w(h8_asm_t *a, unsigned rd);
+void h8_asm_extu_l(h8_asm_t *a, unsigned erd);
+void h8_asm_exts_w(h8_asm_t *a, unsigned rd);
+void h8_asm_exts_l(h8_asm_t *a, unsigned erd);
+
+void h8_asm_mulxu_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_mulxu_w(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_divxu_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_divxu_w(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_mulxs_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_mulxs_w(h8_asm_t *a, unsigned rs, unsigned erd);
+void h8_asm_divxs_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_divxs_w(h8_asm_t *a, unsigned rs, unsigned erd);
+
+/**
+ * Logic operations
+ */
+void h8_asm_and_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_and_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_and_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_and_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_and_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+void h8_asm_and_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_or_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_or_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_or_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_or_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_or_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+void h8_asm_or_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_xor_b(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_xor_w(h8_asm_t *a, unsigned rs, unsigned rd);
+void h8_asm_xor_b_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_xor_w_imm(h8_asm_t *a, unsigned imm, unsigned rd);
+void h8_asm_xor_l_imm(h8_asm_t *a, h8_u32 imm, unsigned erd);
+void h8_asm_xor_l(h8_asm_t *a, unsigned ers, unsigned erd);
+void h8_asm_not_b(h8_asm_t *a, unsigned rd);
+void h8_asm_not_w(h8_asm_t *a, unsigned rd);
+void h8_asm_not_l(h8_asm_t *a, unsigned erd);
+
+/**
+ * Shift operations
+ */
+void h8_asm_shal_b(h8_asm_t *a, unsigned rd);
+void h8_asm_shal_w(h8_asm_t *a, unsigned rd);
+void h8_asm_shal_l(h8_asm_t *a, unsigned erd);
+void h8_asm_shar_b(h8_asm_t *a, unsigned rd);
+void h8_asm_shar_w(h8_asm_t *a, unsigned rd);
+void h8_asm_shar_l(h8_asm_t *a, unsigned erd);
+void h8_asm_shll_b(h8_asm_t *a, unsigned rd);
+void h8_asm_shll_w(h8_asm_t *a, unsigned rd);
+void h8_asm_shll_l(h8_asm_t *a, unsigned erd);
+void h8_asm_shlr_b(h8_asm_t *a, unsigned rd);
+void h8_asm_shlr_w(h8_asm_t *a, unsigned rd);
+void h8_asm_shlr_l(h8_asm_t *a, unsigned erd);
+void h8_asm_rotl_b(h8_asm_t *a, unsigned rd);
+void h8_asm_rotl_w(h8_asm_t *a, unsigned rd);
+void h8_asm_rotl_l(h8_asm_t *a, unsigned erd);
+void h8_asm_rotr_b(h8_asm_t *a, unsigned rd);
+void h8_asm_rotr_w(h8_asm_t *a, unsigned rd);
+void h8_asm_rotr_l(h8_asm_t *a, unsigned erd);
+void h8_asm_rotxl_b(h8_asm_t *a, unsigned rd);
+void h8_asm_rotxl_w(h8_asm_t *a, unsigned rd);
+void h8_asm_rotxl_l(h8_asm_t *a, unsigned erd);
+void h8_asm_rotxr_b(h8_asm_t *a, unsigned rd);
+void h8_asm_rotxr_w(h8_asm_t *a, unsigned rd);
+void h8_asm_rotxr_l(h8_asm_t *a, unsigned erd);
+
+/**
+ * Bit manipulation
+ */
+void h8_asm_bset(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bclr(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bnot(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_btst(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bld(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bild(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bst(h8_asm_t *a, unsigned bit, unsigned rd);
+void h8_asm_bist(h8_asm_t *a, unsigned bit, unsigned rd);
+
+/** Bit number taken from the low 3 bits of register Rn */
+void h8_asm_bset_r(h8_asm_t *a, unsigned rn, unsigned rd);
+void h8_asm_bclr_r(h8_asm_t *a, unsigned rn, unsigned rd);
+void h8_asm_bnot_r(h8_asm_t *a, unsigned rn, unsigned rd);
+void h8_asm_btst_r(h8_asm_t *a, unsigned rn, unsigned rd);
+
+/** Bit operations on @ERd */
+void h8_asm_bset_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bclr_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bnot_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bst_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bist_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_btst_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bld_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bild_ind(h8_asm_t *a, unsigned bit, unsigned erd);
+void h8_asm_bset_r_ind(h8_asm_t *a, unsigned rn, unsigned erd);
+void h8_asm_bclr_r_ind(h8_asm_t *a, unsigned rn, unsigned erd);
+void h8_asm_bnot_r_ind(h8_asm_t *a, unsigned rn, unsigned erd);
+
+/** Bit operations on @aa:8 */
+void h8_asm_bset_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bclr_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bnot_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bst_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bist_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bld_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bild_abs8(h8_asm_t *a, unsigned bit, unsigned address);
+void h8_asm_bset_r_abs8(h8_asm_t *a, unsigned rn, unsigned address);
+void h8_asm_bclr_r_abs8(h8_asm_t *a, unsigned rn, unsigned address);
+void h8_asm_bnot_r_abs8(h8_asm_t *a, unsigned rn, unsigned address);
+
+/**
+ * Branching
+ */
+void h8_asm_bcc_8(h8_asm_t *a, h8_asm_cond cond, h8_asm_label label);
+void h8_asm_bcc_16(h8_asm_t *a, h8_asm_cond cond, h8_asm_label label);
+void h8_asm_bsr_8(h8_asm_t *a, h8_asm_label label);
+void h8_asm_bsr_16(h8_asm_t *a, h8_asm_label label);
+void h8_asm_jmp_ind(h8_asm_t *a, unsigned ern);
+void h8_asm_jmp(h8_asm_t *a, h8_asm_label label);
+void h8_asm_jsr_ind(h8_asm_t *a, unsigned ern);
+void h8_asm_jsr(h8_asm_t *a, h8_asm_label label);
+void h8_asm_rts(h8_asm_t *a);
+void h8_asm_rte(h8_asm_t *a);
+
+/**
+ * System control
+ */
+void h8_asm_nop(h8_asm_t *a);
+void h8_asm_sleep(h8_asm_t *a);
+void h8_asm_stc(h8_asm_t *a, unsigned rd);
+void h8_asm_ldc(h8_asm_t *a, unsigned rs);
+void h8_asm_ldc_imm(h8_asm_t *a, unsigned imm);
+void h8_asm_andc(h8_asm_t *a, unsigned imm);
+void h8_asm_orc(h8_asm_t *a, unsigned imm);
+void h8_asm_xorc(h8_asm_t *a, unsigned imm);
+
+/** LDC.W @ERs, CCR / STC.W CCR, @ERd */
+void h8_asm_ldc_w_ind(h8_asm_t *a, unsigned ers);
+void h8_asm_stc_w_ind(h8_asm_t *a, unsigned erd);
+
+/** LDC.W @ERs+, CCR / STC.W CCR, @-ERd */
+void h8_asm_ldc_w_inc(h8_asm_t *a, unsigned ers);
+void h8_asm_stc_w_dec(h8_asm_t *a, unsigned erd);
+
+/** LDC.W @(d:16, ERs), CCR / STC.W CCR, @(d:16, ERd) */
+void h8_asm_ldc_w_d16(h8_asm_t *a, int disp, unsigned ers);
+void h8_asm_stc_w_d16(h8_asm_t *a, int disp, unsigned erd);
+
+/** LDC.W @(d:24, ERs), CCR / STC.W CCR, @(d:24, ERd) */
+void h8_asm_ldc_w_d24(h8_asm_t *a, long disp, unsigned ers);
+void h8_asm_stc_w_d24(h8_asm_t *a, long disp, unsigned erd);
+
+/** LDC.W @aa:16, CCR / STC.W CCR, @aa:16 */
+void h8_asm_ldc_w_abs16(h8_asm_t *a, unsigned address);
+void h8_asm_stc_w_abs16(h8_asm_t *a, unsigned address);
+
+#endif
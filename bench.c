@@ -0,0 +1,406 @@
+#include "assembler.h"
+#include "devices/eeprom.h"
+#include "devices/gait.h"
+#include "devices/lcd.h"
+#include "dma.h"
+#include "ir.h"
+#include "system.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Host-side throughput benchmarks running synthetic ROMs built with the
+ * assembler. Run with `make bench`.
+ */
+
+/** Large enough to not fit on some default stacks */
+static h8_system_t bench_system;
+
+/**
+ * Runs a system for a number of instructions, or until it errors or sleeps.
+ * @return The number of host seconds taken
+ */
+static double bench_run(h8_system_t *system, unsigned long instructions,
+                        unsigned long *executed)
+{
+  clock_t start = clock();
+  h8_u64 first = system->instructions;
+
+  while (system->instructions - first < instructions &&
+         !system->error_code && !system->sleep)
+    h8_step(system);
+  *executed = (unsigned long)(system->instructions - first);
+
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench_report(const char *name, const h8_system_t *system,
+                         unsigned long executed, double seconds)
+{
+  if (system->error_code)
+    printf("%-24s failed with error %u at line %u\n", name,
+           system->error_code, system->error_line);
+  else
+    printf("%-24s %10lu instructions in %6.3fs (%.2f MIPS)\n", name,
+           executed, seconds,
+           seconds > 0 ? (double)executed / seconds / 1000000.0 : 0.0);
+#if H8_PROFILE_SUBSYSTEMS
+  h8_profile_print(&system->profile);
+#endif
+}
+
+#if H8_LOGGER_DEFERRED
+/**
+ * The cost of recording a message shaped like the per-byte EEPROM log into a
+ * deferred ring, not counting formatting when the ring is drained.
+ */
+static void bench_logger(void)
+{
+  static h8_log_ring_t ring;
+  h8_log_record_t record;
+  unsigned long i, events = 10000000;
+  clock_t ticks = 0, start = clock();
+
+  h8_log_ring_init(&ring);
+  h8_log_set_ring(&ring);
+  for (i = 0; i < events; i++)
+  {
+    if ((i & (H8_LOGGER_RING_SIZE - 1)) == 0)
+    {
+      while (h8_log_ring_pop(&ring, &record));
+      start = clock();
+    }
+    h8_log(H8_LOG_ERROR, H8_LOG_EEP, "Read %02X from %04X",
+           (unsigned)(i & 0xFF), (unsigned)(i & 0xFFFF));
+    if ((i & (H8_LOGGER_RING_SIZE - 1)) == H8_LOGGER_RING_SIZE - 1)
+      ticks += clock() - start;
+  }
+  h8_log_set_ring(NULL);
+  printf("%-24s %10lu events in %6.3fs (%.1f ns/event, %u dropped)\n",
+         "Deferred log", events, (double)ticks / CLOCKS_PER_SEC,
+         (double)ticks / CLOCKS_PER_SEC * 1000000000.0 / events,
+         ring.dropped);
+}
+#endif
+
+/**
+ * Saving to and loading from a 64KB EEPROM byte by byte over the SSU, as a
+ * game does on every save, with EEPROM logging at its default level.
+ * @param path If set, the EEPROM is mapped to this file, synced on each save
+ */
+static void bench_eeprom(const char *path, const char *name)
+{
+  h8_device_t device;
+  h8_byte_t byte, value;
+  unsigned long bytes = 0;
+  unsigned pass, i;
+  clock_t start = clock();
+  double seconds;
+
+  memset(&device, 0, sizeof(device));
+  h8_eeprom_init_64k(&device);
+  if (path && !h8_eeprom_map(&device, path))
+  {
+    printf("%-24s could not map %s\n", name, path);
+    return;
+  }
+  for (pass = 0; pass < 256; pass++)
+  {
+    h8_eeprom_select_out(&device, FALSE);
+    value.u = 6; /* WREN */
+    h8_eeprom_write(&device, &byte, value);
+    h8_eeprom_select_out(&device, TRUE);
+
+    h8_eeprom_select_out(&device, FALSE);
+    value.u = 2; /* WRITE, address 0 */
+    h8_eeprom_write(&device, &byte, value);
+    value.u = 0;
+    h8_eeprom_write(&device, &byte, value);
+    h8_eeprom_write(&device, &byte, value);
+    for (i = 0; i < 0x10000; i++)
+    {
+      value.u = (h8_u8)(i + pass);
+      h8_eeprom_write(&device, &byte, value);
+    }
+    h8_eeprom_select_out(&device, TRUE);
+
+    h8_eeprom_select_out(&device, FALSE);
+    value.u = 3; /* READ, address 0 */
+    h8_eeprom_write(&device, &byte, value);
+    value.u = 0;
+    h8_eeprom_write(&device, &byte, value);
+    h8_eeprom_write(&device, &byte, value);
+    h8_eeprom_write(&device, &byte, value);
+    for (i = 0; i < 0x10000; i++)
+      h8_eeprom_read(&device, &byte);
+    h8_eeprom_select_out(&device, TRUE);
+    bytes += 0x20000;
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%-24s %10lu bytes in %6.3fs (%.1f ns/byte)\n", name,
+         bytes, seconds, seconds * 1000000000.0 / bytes);
+  h8_eeprom_free(&device);
+  h8_dma_free(device.device);
+  if (path)
+    remove(path);
+}
+
+/**
+ * Generating a day of 100Hz samples from a walking and running schedule, as
+ * a step counter experiment does, in blocks and one sample at a time.
+ * @param block The number of samples generated per call
+ */
+static void bench_gait(unsigned block, const char *name)
+{
+  static h8_s16 x[1000], y[1000], z[1000];
+  h8_gait_t gait;
+  unsigned long samples = 8640000, i;
+  clock_t start;
+  double seconds;
+
+  h8_gait_init(&gait, 1, 30);
+  h8_gait_add(&gait, H8_GAIT_WALK, 600000, 110, 300);
+  h8_gait_add(&gait, H8_GAIT_REST, 300000, 0, 0);
+  h8_gait_add(&gait, H8_GAIT_RUN, 300000, 170, 900);
+  gait.repeat = TRUE;
+
+  start = clock();
+  for (i = 0; i < samples; i += block)
+  {
+    h8_gait_block(&gait, (h8_u64)i * 10000, 10000, x, y, z, block);
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%-24s %10lu samples in %6.3fs (%.1f ns/sample)\n", name,
+         samples, seconds, seconds * 1000000000.0 / samples);
+}
+
+/**
+ * Paired IR sessions over an in-process link: each side sends a 128-byte
+ * packet that the other receives once it has been shifted out at 115200bps.
+ */
+static void bench_ir_link(void)
+{
+  static h8_ir_link_t link;
+  h8_ir_t a, b;
+  h8_byte_t value;
+  unsigned long sessions = 100000, session, bytes = 0;
+  h8_u64 time_us = 0;
+  unsigned i;
+  clock_t start;
+  double seconds;
+
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+  h8_ir_init(&a, 256, NULL);
+  h8_ir_init(&b, 256, NULL);
+  h8_ir_link_init(&link);
+  h8_ir_link_attach(&link, &a);
+  h8_ir_link_attach(&link, &b);
+
+  start = clock();
+  for (session = 0; session < sessions; session++)
+  {
+    for (i = 0; i < 128; i++)
+    {
+      value.u = (h8_u8)i;
+      h8_ir_link_send(&a, value, time_us, 87);
+    }
+    time_us += 128 * 87;
+    h8_ir_link_poll(&b, time_us);
+    while (h8_ir_in(&b, &value))
+    {
+      h8_ir_link_send(&b, value, time_us, 87);
+      bytes++;
+    }
+    time_us += 128 * 87;
+    h8_ir_link_poll(&a, time_us);
+    while (h8_ir_in(&a, &value))
+      bytes++;
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%-24s %10lu sessions in %6.3fs (%.0f sessions/s, %lu bytes)\n",
+         "IR link sessions", sessions, seconds,
+         seconds > 0 ? sessions / seconds : 0.0, bytes);
+  h8_ir_free(&a);
+  h8_ir_free(&b);
+}
+
+/**
+ * Converting a full frame of VRAM into an image, as a frontend or capture
+ * tool does for every frame of every instance.
+ */
+static void bench_lcd(h8_lcd_format format, const char *name)
+{
+  static h8_lcd_t lcd;
+  static h8_u8 image[H8_LCD_HEIGHT * H8_LCD_WIDTH * 4];
+  unsigned long frames = 200000, i;
+  unsigned size = format == H8_LCD_FORMAT_GRAY8 ? 1 : 4;
+  clock_t start;
+  double seconds;
+
+  for (i = 0; i < sizeof(lcd.vram); i++)
+    lcd.vram[i] = (h8_u8)(i * 37);
+  lcd.palette_modes[1] = 5;
+  lcd.palette_modes[2] = 10;
+  lcd.palette_modes[3] = 15;
+  lcd.contrast = 26;
+  lcd.display_on = TRUE;
+
+  start = clock();
+  for (i = 0; i < frames; i++)
+  {
+    lcd.start_line = (h8_u8)i;
+    h8_lcd_render(&lcd, image, H8_LCD_WIDTH * size, format);
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%-24s %10lu frames in %6.3fs (%.0f FPS, %s)\n", name, frames,
+         seconds, seconds > 0 ? frames / seconds : 0.0, h8_lcd_render_isa());
+}
+
+/**
+ * An NTR-032 program streaming bytes to the LCD and from the EEPROM through
+ * the SSU, as when drawing the screen or loading a save. Both are written as
+ * the transfer loops H8_SSU_BURSTS recognizes.
+ */
+static void bench_ssu(void)
+{
+  h8_system_t *system = &bench_system;
+  unsigned long executed;
+  h8_asm_label start, lcd, eeprom;
+  double seconds;
+  h8_asm_t a;
+
+  memset(system, 0, sizeof(*system));
+  h8_system_init(system, H8_SYSTEM_NTR_032);
+  h8_asm_init(&a, system->vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_IO2, H8_ASM_SP);
+
+  /* Turn the watchdog off so that it doesn't reset the loop */
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+
+  /* Select the LCD in data mode, then write 0x8000 bytes of ROM to VRAM */
+  h8_asm_mov_b_imm(&a, 0x06, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFD4);
+  h8_asm_mov_l_imm(&a, 0x1000, H8_ASM_ER2);
+  h8_asm_mov_w_imm(&a, 0x8000, H8_ASM_R1);
+  lcd = h8_asm_here(&a);
+  h8_asm_mov_b_ld_inc(&a, H8_ASM_ER2, H8_ASM_R3L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R3L, 0xF0EB);
+  h8_asm_dec_w(&a, 1, H8_ASM_R1);
+  h8_asm_bcc_8(&a, H8_ASM_BNE, lcd);
+
+  /* Select the EEPROM, send READ from address 0, then read 0x400 bytes */
+  h8_asm_mov_b_imm(&a, 0x03, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFD4);
+  h8_asm_mov_b_imm(&a, 0x03, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+  h8_asm_mov_b_imm(&a, 0x00, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+  h8_asm_mov_l_imm(&a, 0xF800, H8_ASM_ER4);
+  h8_asm_mov_w_imm(&a, 0x400, H8_ASM_R1);
+  eeprom = h8_asm_here(&a);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+  h8_asm_mov_b_ld_abs16(&a, 0xF0E9, H8_ASM_R5L);
+  h8_asm_mov_b_st_ind(&a, H8_ASM_R5L, H8_ASM_ER4);
+  h8_asm_adds(&a, 1, H8_ASM_ER4);
+  h8_asm_dec_w(&a, 1, H8_ASM_R1);
+  h8_asm_bcc_8(&a, H8_ASM_BNE, eeprom);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, start);
+  if (!h8_asm_finish(&a))
+  {
+    printf("ssu: assembly failed with error %u\n", a.error);
+    return;
+  }
+
+  /*
+   * Most of these instructions are skipped by bursts rather than emulated, so
+   * report how much faster than the hardware they ran instead of MIPS
+   */
+  h8_init(system);
+  seconds = bench_run(system, 20000000, &executed);
+  if (system->error_code)
+    bench_report("SSU LCD / EEPROM", system, executed, seconds);
+  else
+  {
+    printf("%-24s %10lu instructions in %6.3fs (%.0fx real time)\n",
+           "SSU LCD / EEPROM", executed, seconds, seconds > 0 ?
+           (double)executed / H8_INSTRUCTIONS_PER_SECOND / seconds : 0.0);
+#if H8_PROFILE_SUBSYSTEMS
+    h8_profile_print(&system->profile);
+#endif
+  }
+}
+
+/**
+ * A loop made up of instructions using the 0x01 prefix: longword moves in
+ * every addressing mode, and LDC/STC.W to and from memory.
+ */
+static void bench_prefix(void)
+{
+  h8_system_t *system = &bench_system;
+  unsigned long executed;
+  h8_asm_label start, loop;
+  double seconds;
+  h8_asm_t a;
+
+  memset(system, 0, sizeof(*system));
+  h8_asm_init(&a, system->vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_IO2, H8_ASM_SP);
+
+  /* Turn the watchdog off so that it doesn't reset the loop */
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_RAM_1K, H8_ASM_ER4);
+  h8_asm_mov_l_imm(&a, 0x12345678, H8_ASM_ER1);
+  loop = h8_asm_here(&a);
+  h8_asm_mov_l_st_ind(&a, H8_ASM_ER1, H8_ASM_ER4);
+  h8_asm_mov_l_ld_ind(&a, H8_ASM_ER4, H8_ASM_ER2);
+  h8_asm_mov_l_st_d16(&a, H8_ASM_ER2, 8, H8_ASM_ER4);
+  h8_asm_mov_l_ld_d16(&a, 8, H8_ASM_ER4, H8_ASM_ER3);
+  h8_asm_mov_l_st_abs16(&a, H8_ASM_ER3, H8_MEMORY_REGION_RAM_1K + 0x10);
+  h8_asm_mov_l_ld_abs16(&a, H8_MEMORY_REGION_RAM_1K + 0x10, H8_ASM_ER5);
+  h8_asm_push_l(&a, H8_ASM_ER5);
+  h8_asm_pop_l(&a, H8_ASM_ER6);
+  h8_asm_stc_w_dec(&a, H8_ASM_SP);
+  h8_asm_ldc_w_inc(&a, H8_ASM_SP);
+  h8_asm_stc_w_abs16(&a, H8_MEMORY_REGION_RAM_1K + 0x20);
+  h8_asm_ldc_w_abs16(&a, H8_MEMORY_REGION_RAM_1K + 0x20);
+  h8_asm_stc_w_d16(&a, 0x20, H8_ASM_ER4);
+  h8_asm_ldc_w_d16(&a, 0x20, H8_ASM_ER4);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, loop);
+  if (!h8_asm_finish(&a))
+  {
+    printf("prefix: assembly failed with error %u\n", a.error);
+    return;
+  }
+
+  h8_init(system);
+  seconds = bench_run(system, 20000000, &executed);
+  bench_report("MOV.L / LDC.W / STC.W", system, executed, seconds);
+}
+
+int main(void)
+{
+#if H8_LOGGER_DEFERRED
+  bench_logger();
+#endif
+  bench_eeprom(NULL, "EEPROM save/load");
+  bench_eeprom("libh8300h-bench.eep", "EEPROM save/load (mmap)");
+  bench_gait(1000, "Gait (blocks)");
+  bench_gait(1, "Gait (single)");
+  bench_ir_link();
+  bench_lcd(H8_LCD_FORMAT_GRAY8, "LCD render (gray)");
+  bench_lcd(H8_LCD_FORMAT_RGBA8888, "LCD render (RGBA)");
+  bench_prefix();
+  bench_ssu();
+
+  return 0;
+}
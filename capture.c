@@ -0,0 +1,276 @@
+#include "capture.h"
+
+#include <string.h>
+
+static const h8_u8 magic[5] = { 'H', '8', 'C', 'A', 'P' };
+
+#define H8_CAPTURE_KEYFRAME 'K'
+#define H8_CAPTURE_DELTA 'D'
+#define H8_CAPTURE_REPEAT 'R'
+
+/**
+ * Zero runs shorter than this are kept inside literal runs, as splitting a
+ * literal run costs two extra varints
+ */
+#define H8_CAPTURE_MIN_ZEROS 3
+
+/**
+ * Writes a varint into a buffer.
+ * @return The number of bytes written, or 0 if it did not fit
+ */
+static unsigned h8_capture_put_varint(h8_u8 *dst, unsigned space,
+                                      unsigned long value)
+{
+  unsigned size = 0;
+
+  do
+  {
+    if (size >= space)
+      return 0;
+    dst[size++] = (h8_u8)((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+    value >>= 7;
+  } while (value);
+
+  return size;
+}
+
+static h8_bool h8_capture_get_varint(FILE *file, unsigned long *value)
+{
+  unsigned shift = 0;
+  int byte;
+
+  *value = 0;
+  do
+  {
+    byte = fgetc(file);
+    if (byte == EOF || shift > 28)
+      return FALSE;
+    *value |= (unsigned long)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return TRUE;
+}
+
+/**
+ * Encodes the XOR of two frames as runs of unchanged bytes followed by runs
+ * of changed bytes.
+ * @return The encoded size, or 0 if it would not be smaller than a frame
+ */
+static unsigned h8_capture_encode_delta(h8_u8 *dst, const h8_u8 *prev,
+                                        const h8_u8 *next)
+{
+  unsigned pos = 0, size = 0;
+
+  while (pos < H8_CAPTURE_FRAME_SIZE)
+  {
+    unsigned zeros = 0, count = 0, written, i;
+
+    while (pos + zeros < H8_CAPTURE_FRAME_SIZE &&
+           prev[pos + zeros] == next[pos + zeros])
+      zeros++;
+    pos += zeros;
+
+    /* Extend the literal run until a long enough run of zeros or the end */
+    while (pos + count < H8_CAPTURE_FRAME_SIZE)
+    {
+      unsigned same = 0;
+
+      while (same < H8_CAPTURE_MIN_ZEROS &&
+             pos + count + same < H8_CAPTURE_FRAME_SIZE &&
+             prev[pos + count + same] == next[pos + count + same])
+        same++;
+      if (same == H8_CAPTURE_MIN_ZEROS ||
+          pos + count + same == H8_CAPTURE_FRAME_SIZE)
+        break;
+      count += same + 1;
+    }
+
+    written = h8_capture_put_varint(&dst[size], H8_CAPTURE_FRAME_SIZE - size,
+                                    zeros);
+    if (!written)
+      return 0;
+    size += written;
+    written = h8_capture_put_varint(&dst[size], H8_CAPTURE_FRAME_SIZE - size,
+                                    count);
+    if (!written || size + written + count >= H8_CAPTURE_FRAME_SIZE)
+      return 0;
+    size += written;
+    for (i = 0; i < count; i++)
+      dst[size++] = prev[pos + i] ^ next[pos + i];
+    pos += count;
+  }
+
+  return size;
+}
+
+h8_bool h8_capture_init(h8_capture_t *capture, FILE *file)
+{
+  h8_u8 header[8];
+
+  if (!capture || !file)
+    return FALSE;
+  memset(capture, 0, sizeof(*capture));
+  capture->file = file;
+  capture->keyframe_interval = H8_CAPTURE_KEYFRAME_INTERVAL;
+
+  memcpy(header, magic, sizeof(magic));
+  header[5] = H8_CAPTURE_VERSION;
+  header[6] = H8_CAPTURE_FRAME_SIZE & 0xFF;
+  header[7] = H8_CAPTURE_FRAME_SIZE >> 8;
+
+  return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+h8_bool h8_capture_flush(h8_capture_t *capture)
+{
+  if (capture->repeats)
+  {
+    h8_u8 record[8];
+    unsigned size;
+
+    record[0] = H8_CAPTURE_REPEAT;
+    size = h8_capture_put_varint(&record[1], sizeof(record) - 1,
+                                 capture->repeats);
+    capture->repeats = 0;
+    if (fwrite(record, size + 1, 1, capture->file) != 1)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+h8_bool h8_capture_frame(h8_capture_t *capture, const h8_lcd_t *lcd)
+{
+  h8_u8 next[H8_CAPTURE_FRAME_SIZE];
+  unsigned size = 0;
+
+  h8_lcd_display_state(lcd, next);
+  memcpy(&next[H8_LCD_DISPLAY_STATE_SIZE], lcd->vram, sizeof(lcd->vram));
+  capture->frames++;
+
+  if (capture->started && !memcmp(next, capture->frame, sizeof(next)))
+  {
+    if (!capture->changed_only)
+      capture->repeats++;
+    return TRUE;
+  }
+  else if (!h8_capture_flush(capture))
+    return FALSE;
+
+  if (capture->started && capture->deltas < capture->keyframe_interval)
+    size = h8_capture_encode_delta(capture->buffer, capture->frame, next);
+  memcpy(capture->frame, next, sizeof(next));
+  capture->started = TRUE;
+
+  if (size)
+  {
+    capture->deltas++;
+    return fputc(H8_CAPTURE_DELTA, capture->file) != EOF &&
+           fwrite(capture->buffer, size, 1, capture->file) == 1;
+  }
+  else
+  {
+    capture->deltas = 0;
+    return fputc(H8_CAPTURE_KEYFRAME, capture->file) != EOF &&
+           fwrite(next, sizeof(next), 1, capture->file) == 1;
+  }
+}
+
+h8_bool h8_capture_reader_init(h8_capture_reader_t *reader, FILE *file)
+{
+  h8_u8 header[8];
+
+  if (!reader || !file)
+    return FALSE;
+  memset(reader, 0, sizeof(*reader));
+  reader->file = file;
+
+  return fread(header, sizeof(header), 1, file) == 1 &&
+         !memcmp(header, magic, sizeof(magic)) &&
+         header[5] == H8_CAPTURE_VERSION &&
+         (header[6] | header[7] << 8) == H8_CAPTURE_FRAME_SIZE;
+}
+
+/** Reads the next record that produces a frame */
+static h8_bool h8_capture_next(h8_capture_reader_t *reader)
+{
+  for (;;)
+  {
+    unsigned long zeros, count, pos = 0;
+
+    switch (fgetc(reader->file))
+    {
+    case H8_CAPTURE_KEYFRAME:
+      return fread(reader->frame, sizeof(reader->frame), 1,
+                   reader->file) == 1;
+    case H8_CAPTURE_DELTA:
+      while (pos < H8_CAPTURE_FRAME_SIZE)
+      {
+        if (!h8_capture_get_varint(reader->file, &zeros) ||
+            !h8_capture_get_varint(reader->file, &count) ||
+            zeros + count > H8_CAPTURE_FRAME_SIZE - pos)
+          return FALSE;
+        for (pos += zeros; count; count--, pos++)
+        {
+          int byte = fgetc(reader->file);
+
+          if (byte == EOF)
+            return FALSE;
+          reader->frame[pos] ^= (h8_u8)byte;
+        }
+      }
+      return TRUE;
+    case H8_CAPTURE_REPEAT:
+      if (!h8_capture_get_varint(reader->file, &count))
+        return FALSE;
+      else if (count)
+      {
+        reader->repeats = count - 1;
+        return TRUE;
+      }
+      break;
+    default:
+      return FALSE;
+    }
+  }
+}
+
+h8_bool h8_capture_read(h8_capture_reader_t *reader, h8_lcd_t *lcd)
+{
+  if (reader->repeats)
+    reader->repeats--;
+  else if (!h8_capture_next(reader))
+    return FALSE;
+
+  h8_lcd_set_display_state(lcd, reader->frame);
+  memcpy(lcd->vram, &reader->frame[H8_LCD_DISPLAY_STATE_SIZE],
+         sizeof(lcd->vram));
+
+  return TRUE;
+}
+
+unsigned long h8_capture_export_y4m(FILE *in, FILE *out, unsigned fps)
+{
+  h8_capture_reader_t reader;
+  h8_lcd_t lcd;
+  h8_u8 image[H8_LCD_WIDTH * H8_LCD_HEIGHT];
+  unsigned long frames = 0;
+
+  if (!h8_capture_reader_init(&reader, in))
+    return 0;
+  memset(&lcd, 0, sizeof(lcd));
+  fprintf(out, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 Cmono\n",
+          (unsigned)H8_LCD_WIDTH, (unsigned)H8_LCD_HEIGHT, fps ? fps : 1);
+
+  while (h8_capture_read(&reader, &lcd))
+  {
+    h8_lcd_render(&lcd, image, H8_LCD_WIDTH, H8_LCD_FORMAT_GRAY8);
+    if (fputs("FRAME\n", out) == EOF ||
+        fwrite(image, sizeof(image), 1, out) != 1)
+      break;
+    frames++;
+  }
+
+  return frames;
+}
@@ -0,0 +1,110 @@
+#ifndef H8_CAPTURE_H
+#define H8_CAPTURE_H
+
+#include "devices/lcd.h"
+
+#include <stdio.h>
+
+/**
+ * A compact stream of LCD frames for headless runs, ie: regression tests and
+ * replays. Each frame is the display state plus the raw 2bpp VRAM. The first
+ * frame, and every keyframe_interval changed frames after it, is stored
+ * whole. Other changed frames are stored as run-length encoded XOR deltas
+ * against the previous frame. Runs of unchanged frames are stored as a single
+ * count, so hours of a static screen cost a few bytes.
+ *
+ * Stream layout, with counts stored as LEB128 varints:
+ *   "H8CAP", version, frame size (16-bit little-endian)
+ *   'K' frame                      keyframe
+ *   'D' { zeros, count, bytes }... delta, runs until the frame is covered
+ *   'R' count                      the previous frame repeated count times
+ */
+
+/** The number of bytes in one uncompressed frame */
+#define H8_CAPTURE_FRAME_SIZE (H8_LCD_DISPLAY_STATE_SIZE + 128 * 16 * 2)
+
+#define H8_CAPTURE_VERSION 1
+
+/** The default number of changed frames between keyframes */
+#define H8_CAPTURE_KEYFRAME_INTERVAL 600
+
+typedef struct
+{
+  FILE *file;
+
+  /** The last frame captured */
+  h8_u8 frame[H8_CAPTURE_FRAME_SIZE];
+
+  /** Space for encoding a delta, which is abandoned if it outgrows a frame */
+  h8_u8 buffer[H8_CAPTURE_FRAME_SIZE];
+
+  /** The number of frames passed to h8_capture_frame */
+  unsigned long frames;
+
+  /** Unchanged frames not yet written */
+  unsigned long repeats;
+
+  /** Changed frames written since the last keyframe */
+  unsigned deltas;
+
+  unsigned keyframe_interval;
+
+  /**
+   * If set, unchanged frames are not recorded at all. Saves a little space
+   * when only the sequence of images matters, not their timing.
+   */
+  h8_bool changed_only;
+
+  h8_bool started;
+} h8_capture_t;
+
+typedef struct
+{
+  FILE *file;
+  h8_u8 frame[H8_CAPTURE_FRAME_SIZE];
+
+  /** Repeats of the current frame still to be returned */
+  unsigned long repeats;
+} h8_capture_reader_t;
+
+/**
+ * Begins a capture stream, writing its header to an open binary file.
+ * @return FALSE if the header could not be written
+ */
+h8_bool h8_capture_init(h8_capture_t *capture, FILE *file);
+
+/**
+ * Appends the frame currently displayed by an LCD to a capture stream. Call
+ * once per displayed frame.
+ * @return FALSE if writing failed
+ */
+h8_bool h8_capture_frame(h8_capture_t *capture, const h8_lcd_t *lcd);
+
+/**
+ * Writes any pending repeated frames. Call before closing the file; the
+ * capture may continue afterwards.
+ */
+h8_bool h8_capture_flush(h8_capture_t *capture);
+
+/**
+ * Begins reading a capture stream from an open binary file.
+ * @return FALSE if the file is not a capture stream of this version
+ */
+h8_bool h8_capture_reader_init(h8_capture_reader_t *reader, FILE *file);
+
+/**
+ * Decodes the next frame of a capture stream into an LCD's VRAM and display
+ * state, ready for h8_lcd_render.
+ * @return FALSE at the end of the stream or if it is malformed
+ */
+h8_bool h8_capture_read(h8_capture_reader_t *reader, h8_lcd_t *lcd);
+
+/**
+ * Converts a whole capture stream into a YUV4MPEG2 (Y4M) video with a single
+ * luma plane, which tools like ffmpeg can encode further.
+ * @param fps The rate frames were captured at
+ * @return The number of frames exported
+ */
+unsigned long h8_capture_export_y4m(FILE *in, FILE *out, unsigned fps);
+
+#endif
@@ -11,15 +11,153 @@
 
 #ifndef H8_LOGGER_DEFAULT_LEVEL
 /**
- * The default severity level the logger will process
+ * The default severity level the logger will process for every source
  */
 #define H8_LOGGER_DEFAULT_LEVEL 3
 #endif
 
+#ifndef H8_LOGGER_MIN_LEVEL
+/**
+ * The lowest severity level compiled in at all. Messages logged through the
+ * H8_LOG macros below this level, and their arguments, are removed entirely.
+ */
+#define H8_LOGGER_MIN_LEVEL 1
+#endif
+
+#ifndef H8_INSTRUCTIONS_PER_SECOND
+/**
+ * Until instruction timings are emulated, the rate used to convert the
+ * number of instructions executed into emulated time
+ */
+#define H8_INSTRUCTIONS_PER_SECOND 1000000
+#endif
+
+#ifndef H8_IR_LINK_ENDPOINTS
+/**
+ * The number of IR interfaces an in-process IR link can connect
+ */
+#define H8_IR_LINK_ENDPOINTS 4
+#endif
+
+#ifndef H8_IR_LINK_QUEUE_SIZE
+/**
+ * The number of bytes each endpoint of an in-process IR link can have in
+ * flight; must be a power of two
+ */
+#define H8_IR_LINK_QUEUE_SIZE 1024
+#endif
+
+#ifndef H8_IR_QUEUE_SIZE
+/**
+ * The number of bytes each direction of the IR interface can queue, rounded
+ * up to a power of two
+ */
+#define H8_IR_QUEUE_SIZE 1024
+#endif
+
+#ifndef H8_SYSTEM_CLOCK_HZ
+/**
+ * The system clock (phi) that peripheral rates such as the SCI3 bit rate are
+ * derived from
+ * @todo Confirm against hardware
+ */
+#define H8_SYSTEM_CLOCK_HZ 3686400
+#endif
+
+#ifndef H8_WDT_OSCILLATOR_HZ
+/**
+ * The rate of the on-chip oscillator the watchdog timer counts when TMWD
+ * selects it, which overflows TCWD about every half second
+ * @todo Confirm against hardware
+ */
+#define H8_WDT_OSCILLATOR_HZ 512
+#endif
+
 #ifndef H8_NO_DMA
 #define H8_NO_DMA 0
 #endif
 
+#ifndef H8_IR_TRANSPORT
+/**
+ * Builds the event-driven IR network transport, see transport.h. Only
+ * implemented for Linux, where it needs linking with -pthread. Off by default
+ * with H8_NO_DMA, as targets without malloc have no network to carry it.
+ */
+#if defined(__linux__) && !H8_NO_DMA
+#define H8_IR_TRANSPORT 1
+#else
+#define H8_IR_TRANSPORT 0
+#endif
+#endif
+
+#ifndef H8_TRANSPORT_FRAME_MAX
+/**
+ * The largest IR transmission the network transport carries in one frame
+ */
+#define H8_TRANSPORT_FRAME_MAX 1024
+#endif
+
+#ifndef H8_TRANSPORT_QUEUE_FRAMES
+/**
+ * The number of frames the network transport queues in each direction; must
+ * be a power of two. Kept small with H8_NO_DMA, so that transports fit in
+ * the static heap alongside a system.
+ */
+#if H8_NO_DMA
+#define H8_TRANSPORT_QUEUE_FRAMES 8
+#else
+#define H8_TRANSPORT_QUEUE_FRAMES 64
+#endif
+#endif
+
+#ifndef H8_INPUT_QUEUE_EVENTS
+/**
+ * The number of input events a frontend can post ahead of the emulator; must
+ * be a power of two
+ */
+#define H8_INPUT_QUEUE_EVENTS 64
+#endif
+
+#ifndef H8_LOGGER_DEFERRED
+/**
+ * Allows attaching a ring buffer to a system (see h8_log_ring_t) so that log
+ * calls on its emulation thread only record their arguments, leaving the
+ * formatting and printing to whoever drains the ring
+ */
+#define H8_LOGGER_DEFERRED 1
+#endif
+
+#ifndef H8_LOGGER_RING_SIZE
+/**
+ * The number of records a deferred log ring holds; must be a power of two
+ */
+#define H8_LOGGER_RING_SIZE 1024
+#endif
+
+#ifndef H8_EEPROM_MMAP
+/**
+ * Allows EEPROM contents to be backed by memory-mapped files, see
+ * h8_eeprom_map. Only implemented for POSIX hosts.
+ */
+#define H8_EEPROM_MMAP 1
+#endif
+
+#ifndef H8_NO_DMA_SIZE
+/**
+ * The size, in bytes, of the static heap used in place of malloc when
+ * H8_NO_DMA is set
+ */
+#define H8_NO_DMA_SIZE (128 * 1024)
+#endif
+
+#ifndef H8_SYSTEM_ARENA_SIZE
+/**
+ * The size, in bytes, of the arena block a system allocates its device state
+ * from, which holds the largest preset in one block
+ */
+#define H8_SYSTEM_ARENA_SIZE (72 * 1024)
+#endif
+
 #ifndef H8_SAFETY
 /**
  * Enables some additional error handling and bounds checking for situations
@@ -32,6 +170,15 @@
 #define H8_PROFILING 1
 #endif
 
+#ifndef H8_PROFILE_SUBSYSTEMS
+/**
+ * Measures host time spent in each emulator layer (instruction decode, memory
+ * dispatch, IO registers, device callbacks and logging). Adds a timestamp read
+ * on every scope boundary, so leave disabled unless investigating throughput.
+ */
+#define H8_PROFILE_SUBSYSTEMS 0
+#endif
+
 #ifndef H8_REVERSE_BITFIELDS
 /**
  * Reverses bitfields for compilers where most significant bit is defined first
@@ -39,6 +186,23 @@
 #define H8_REVERSE_BITFIELDS 0
 #endif
 
+#ifndef H8_SIMD
+/**
+ * Uses SIMD instructions (SSE2, AVX2 or NEON) for host-side bulk conversions
+ * such as rendering the LCD, when the compiler and host support them
+ */
+#define H8_SIMD 1
+#endif
+
+#ifndef H8_SSU_BURSTS
+/**
+ * Recognizes simple SSU transfer loops (a byte to or from memory, a counter
+ * decremented to zero) and runs as many of their remaining iterations as fit
+ * before the next timed event at once, through the bulk device callbacks
+ */
+#define H8_SSU_BURSTS 1
+#endif
+
 #ifndef H8_TESTS
 #define H8_TESTS 1
 #endif
@@ -1,4 +1,5 @@
 #include "device.h"
+#include "dma.h"
 #include "devices/accelerometer.h"
 #include "devices/battery.h"
 #include "devices/bma150.h"
@@ -13,6 +14,8 @@
 #include "system.h"
 #include "types.h"
 
+#include <string.h>
+
 #define ADC_END H8_DEVICE_INVALID, H8_HOOKUP_PORT_INVALID, NULL
 #define PDR_END H8_DEVICE_INVALID, H8_HOOKUP_PORT_INVALID, { NULL }, { NULL }
 
@@ -23,8 +26,8 @@ static const h8_system_preset_t h8_systems[] =
     H8_SYSTEM_NTR_027,
     { 0x82341b9f, 0 },
     {
-      { H8_DEVICE_ACCELEROMETER_X, 0, h8_generic_adrr_get },
-      { H8_DEVICE_ACCELEROMETER_Y, 1, h8_generic_adrr_get },
+      { H8_DEVICE_ACCELEROMETER_X, 0, h8_accelerometer_adrr_get },
+      { H8_DEVICE_ACCELEROMETER_Y, 1, h8_accelerometer_adrr_get },
       { H8_DEVICE_BATTERY, 2, h8_generic_adrr_max },
       { ADC_END }
     },
@@ -195,6 +198,51 @@ h8_bool h8_device_init(h8_device_t *device, const h8_device_id type)
   return 0;
 }
 
+void *h8_device_alloc(h8_device_t *device, unsigned size, unsigned zero)
+{
+  return device->system ?
+         h8_dma_arena_alloc(&device->system->arena, size, zero) :
+         h8_dma_alloc(size, zero);
+}
+
+void h8_device_release(h8_device_t *device, void *value)
+{
+  if (!device->system || !h8_dma_arena_owns(&device->system->arena, value))
+    h8_dma_free(value);
+}
+
+void h8_device_ssu_select(h8_device_t *device, h8_bool selected)
+{
+  h8_system_t *system = device->system;
+
+  if (!system)
+    return;
+  else if (selected)
+    system->ssu_device = device;
+  else if (system->ssu_device == device)
+    system->ssu_device = NULL;
+}
+
+h8_bool h8_system_button(h8_system_t *system, unsigned button,
+                         h8_bool pressed)
+{
+  unsigned i;
+
+  for (i = 0; i < system->device_count; i++)
+  {
+    h8_device_t *device = &system->devices[i];
+
+    if (device->type == H8_DEVICE_1BUTTON ||
+        device->type == H8_DEVICE_3BUTTON)
+    {
+      h8_buttons_set(device, button, pressed);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
 {
   if (system)
@@ -217,9 +265,13 @@ h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
       return FALSE;
     }
 
+    /* Carve device state from one block, unless given a buffer to use */
+    if (!system->arena.base && !system->arena.block_size)
+      h8_dma_arena_init(&system->arena, NULL, H8_SYSTEM_ARENA_SIZE);
+
     if (preset->system != id)
     {
-      h8_log(H8_LOG_ERROR, H8_LOG_CPU, "ID does not match preset!");
+      H8_LOGE(H8_LOG_CPU, ("ID does not match preset!"));
       return FALSE;
     }
 
@@ -236,6 +288,7 @@ h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
         /* Create the device if it does not already exist */
         if (device->type == H8_DEVICE_INVALID)
         {
+          device->system = system;
           h8_device_init(device, hookup->type);
           j++;
         }
@@ -257,12 +310,14 @@ h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
       {
         h8_system_pin_in_t *pins_in;
         h8_system_pin_out_t *pins_out;
-        unsigned pin_count;
+        h8_system_port_t *port;
+        unsigned pin_count, shift = 0;
         unsigned k;
 
         /* Create the device if it does not already exist */
         if (device->type == H8_DEVICE_INVALID)
         {
+          device->system = system;
           h8_device_init(device, hookup->type);
           j++;
         }
@@ -276,26 +331,32 @@ h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
         case H8_HOOKUP_PORT_1:
           pins_in = system->pdr1_in;
           pins_out = system->pdr1_out;
+          port = &system->pdr1;
           pin_count = 3;
           break;
         case H8_HOOKUP_PORT_3:
           pins_in = system->pdr3_in;
           pins_out = system->pdr3_out;
+          port = &system->pdr3;
           pin_count = 3;
           break;
         case H8_HOOKUP_PORT_8:
           pins_in = system->pdr8_in;
           pins_out = system->pdr8_out;
+          port = &system->pdr8;
+          shift = 2;
           pin_count = 3;
           break;
         case H8_HOOKUP_PORT_9:
           pins_in = system->pdr9_in;
           pins_out = system->pdr9_out;
+          port = &system->pdr9;
           pin_count = 4;
           break;
         case H8_HOOKUP_PORT_B:
           pins_in = system->pdrb_in;
           pins_out = system->pdrb_out;
+          port = &system->pdrb;
           pin_count = 6;
           break;
         default:
@@ -309,18 +370,66 @@ h8_bool h8_system_init(h8_system_t *system, const h8_system_id id)
           {
             pins_in[k].device = device;
             pins_in[k].func = hookup->pdr_ins[k];
+            port->in_mask |= 1 << (k + shift);
           }
           if (hookup->pdr_outs[k])
           {
             pins_out[k].device = device;
             pins_out[k].func = hookup->pdr_outs[k];
+            port->out_mask |= 1 << (k + shift);
+            port->out_driven &= ~(1 << (k + shift));
           }
         }
       }
     }
 
     system->device_count = j;
+
+    if (!system->ir.rx.data)
+      h8_ir_init(&system->ir, H8_IR_QUEUE_SIZE, &system->arena);
   }
 
   return FALSE;
 }
+
+void h8_system_free(h8_system_t *system)
+{
+  unsigned i;
+
+  if (!system)
+    return;
+
+#if H8_PROFILE_SUBSYSTEMS
+  /* Report where host time went over the life of the system */
+  if (h8_profile_total(&system->profile))
+    h8_profile_print(&system->profile);
+#endif
+
+  for (i = 0; i < system->device_count; i++)
+    if (system->devices[i].free)
+      system->devices[i].free(&system->devices[i]);
+  h8_ir_free(&system->ir);
+  h8_dma_arena_free(&system->arena);
+
+  memset(system->devices, 0, sizeof(system->devices));
+  system->device_count = 0;
+  system->ssu_device = NULL;
+
+  /* Unhook the released devices from the IO ports and the A/DC */
+  memset(system->pdr1_in, 0, sizeof(system->pdr1_in));
+  memset(system->pdr1_out, 0, sizeof(system->pdr1_out));
+  memset(system->pdr3_in, 0, sizeof(system->pdr3_in));
+  memset(system->pdr3_out, 0, sizeof(system->pdr3_out));
+  memset(system->pdr8_in, 0, sizeof(system->pdr8_in));
+  memset(system->pdr8_out, 0, sizeof(system->pdr8_out));
+  memset(system->pdr9_in, 0, sizeof(system->pdr9_in));
+  memset(system->pdr9_out, 0, sizeof(system->pdr9_out));
+  memset(system->pdrb_in, 0, sizeof(system->pdrb_in));
+  memset(system->pdrb_out, 0, sizeof(system->pdrb_out));
+  memset(&system->pdr1, 0, sizeof(system->pdr1));
+  memset(&system->pdr3, 0, sizeof(system->pdr3));
+  memset(&system->pdr8, 0, sizeof(system->pdr8));
+  memset(&system->pdr9, 0, sizeof(system->pdr9));
+  memset(&system->pdrb, 0, sizeof(system->pdrb));
+  memset(system->adc, 0, sizeof(system->adc));
+}
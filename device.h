@@ -116,6 +116,10 @@ typedef h8_bool H8D_OP_PDR_IN_T(struct h8_device_t*);
 typedef void H8D_OP_PDR_OUT_T(struct h8_device_t*, const h8_bool);
 typedef void H8D_OP_SSU_IN_T(struct h8_device_t*, h8_byte_t*);
 typedef void H8D_OP_SSU_OUT_T(struct h8_device_t*, h8_byte_t*, h8_byte_t);
+typedef unsigned H8D_OP_SSU_IN_BULK_T(struct h8_device_t*, h8_byte_t*,
+                                      unsigned);
+typedef unsigned H8D_OP_SSU_OUT_BULK_T(struct h8_device_t*, const h8_byte_t*,
+                                       unsigned);
 typedef h8_word_t H8D_OP_ADRR_T(struct h8_device_t*);
 
 typedef struct h8_device_t
@@ -135,19 +139,41 @@ typedef struct h8_device_t
   H8D_OP_INIT_T *init;
 
   /**
-   * A function to be called when the SSU requests data from a device. This
-   * function is polled for every SSU-enabled device when data is to be read,
-   * and each implementation should handle its own chip select.
+   * Optional. Releases what the device holds outside of its allocations,
+   * such as mapped files. Called by h8_system_free.
+   */
+  H8D_OP_FREE_T *free;
+
+  /** The system this device is connected to, if any */
+  struct h8_system_t *system;
+
+  /**
+   * A function to be called when the SSU requests data from a device. Only
+   * called for the device most recently selected with h8_device_ssu_select.
    */
   H8D_OP_SSU_IN_T *ssu_in;
 
   /**
-   * A function to be called when the SSU writes data to a device. This
-   * function is polled for every SSU-enabled device when data is to be written,
-   * and each implementation should handle its own chip select.
+   * A function to be called when the SSU writes data to a device. Only called
+   * for the device most recently selected with h8_device_ssu_select.
    */
   H8D_OP_SSU_OUT_T *ssu_out;
 
+  /**
+   * Optional. Performs a number of full-duplex transfers in one call, where
+   * the bytes sent are "don't care" to the device, storing the bytes received.
+   * Returns how many transfers were handled; the emulator falls back to
+   * ssu_out and ssu_in for the rest, so a device may return 0 for any state
+   * it does not want to handle in bulk.
+   */
+  H8D_OP_SSU_IN_BULK_T *ssu_in_bulk;
+
+  /**
+   * Optional. Writes a span of bytes in one call, as if by that many calls to
+   * ssu_out. Returns how many bytes were handled, as with ssu_in_bulk.
+   */
+  H8D_OP_SSU_OUT_BULK_T *ssu_out_bulk;
+
   /**
    * PDR1: 3 pins - 0, 1, 2
    * PDR3: 3 pins - 0, 1, 2
@@ -201,6 +227,24 @@ typedef struct h8_pdr_hookup_t
   H8D_OP_PDR_OUT_T *pdr_outs[6];
 } h8_pdr_hookup_t;
 
+/**
+ * Allocates state for a device, from the arena of its system if it is on one
+ * and from h8_dma_alloc otherwise. Set `system` before initializing a device.
+ */
+void *h8_device_alloc(h8_device_t *device, unsigned size, unsigned zero);
+
+/**
+ * Frees state allocated with h8_device_alloc. State carved from the arena of
+ * a system is left for h8_system_free to release with the rest.
+ */
+void h8_device_release(h8_device_t *device, void *value);
+
+/**
+ * Called from a device's chip select output to make it the one device the
+ * system's SSU exchanges data with, or to release the SSU if it was.
+ */
+void h8_device_ssu_select(h8_device_t *device, h8_bool selected);
+
 typedef struct h8_system_preset_t
 {
   const char *title;
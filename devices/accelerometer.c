@@ -1,15 +1,37 @@
 #include "accelerometer.h"
 
+#include "../system.h"
 #include "generic_adc.h"
 
 static const char *name_x = "Analog accelerometer X";
 static const char *name_y = "Analog accelerometer Y";
 
+/** @todo The sensor's real zero-g level and sensitivity are not known */
+#define H8_ACCELEROMETER_ZERO 512
+#define H8_ACCELEROMETER_PER_G 256
+
+typedef struct
+{
+  /**
+   * The value last set, which comes first so the generic ADC functions can
+   * still be used on the device
+   */
+  h8_word_t value;
+
+  /** An optional synthetic waveform that drives the value */
+  const h8_gait_t *gait;
+} h8_accelerometer_t;
+
+static void h8_accelerometer_init(h8_device_t *device)
+{
+  device->device = h8_device_alloc(device, sizeof(h8_accelerometer_t), TRUE);
+}
+
 void h8_accelerometer_init_x(h8_device_t *device)
 {
   if (device)
   {
-    h8_generic_adc_init(device);
+    h8_accelerometer_init(device);
     device->name = name_x;
     device->type = H8_DEVICE_ACCELEROMETER_X;
   }
@@ -19,8 +41,45 @@ void h8_accelerometer_init_y(h8_device_t *device)
 {
   if (device)
   {
-    h8_generic_adc_init(device);
+    h8_accelerometer_init(device);
     device->name = name_y;
     device->type = H8_DEVICE_ACCELEROMETER_Y;
   }
 }
+
+h8_word_t h8_accelerometer_adrr_get(h8_device_t *device)
+{
+  h8_accelerometer_t *accel;
+  h8_s16 axes[3];
+  h8_word_t value;
+  long counts;
+
+#if H8_SAFETY
+  if (!device || !device->device)
+    return h8_generic_adrr_zero(device);
+#endif
+  accel = device->device;
+  if (!accel->gait || !device->system)
+    return accel->value;
+
+  h8_gait_block(accel->gait, h8_system_time_us(device->system), 0,
+                &axes[0], &axes[1], &axes[2], 1);
+  counts = H8_ACCELEROMETER_ZERO +
+           (long)axes[device->type == H8_DEVICE_ACCELEROMETER_Y] *
+           H8_ACCELEROMETER_PER_G / 1000;
+  if (counts < 0)
+    counts = 0;
+  else if (counts > 0x3FF)
+    counts = 0x3FF;
+  value.u = (h8_u16)(counts << 6);
+
+  return value;
+}
+
+void h8_accelerometer_set_gait(h8_device_t *device, const h8_gait_t *gait)
+{
+  if (device && device->device &&
+      (device->type == H8_DEVICE_ACCELEROMETER_X ||
+       device->type == H8_DEVICE_ACCELEROMETER_Y))
+    ((h8_accelerometer_t*)device->device)->gait = gait;
+}
@@ -2,9 +2,23 @@
 #define H8_ACCELEROMETER_H
 
 #include "../device.h"
+#include "gait.h"
 
 void h8_accelerometer_init_x(h8_device_t *device);
 
 void h8_accelerometer_init_y(h8_device_t *device);
 
+/**
+ * Returns the value last set with h8_generic_adrr_set, or the attached gait
+ * sampled at the current emulated time. The X sensor reads the vertical axis
+ * and the Y sensor the forward axis.
+ */
+h8_word_t h8_accelerometer_adrr_get(h8_device_t *device);
+
+/**
+ * Drives the sensor from a synthetic gait, which must outlive the
+ * attachment; pass NULL to detach it.
+ */
+void h8_accelerometer_set_gait(h8_device_t *device, const h8_gait_t *gait);
+
 #endif
@@ -1,7 +1,7 @@
 #include "bma150.h"
 
-#include "../dma.h"
 #include "../logger.h"
+#include "../system.h"
 
 static const char *name = "Bosch BMA150 Triaxial digital acceleration sensor";
 static const h8_device_id type = H8_DEVICE_BMA150;
@@ -46,16 +46,72 @@ typedef struct
   h8_u8 count;
 
   h8_u16 selected;
+
+  /** An optional recorded trace that drives the axis data */
+  h8_motion_t *motion;
+
+  /** An optional synthetic waveform that drives the axis data */
+  const h8_gait_t *gait;
+
+  /** The data update the axes were last sampled for, plus one */
+  h8_u64 update;
 } h8_bma150_t;
 
 #define H8_BMA150_WRITING 0
 #define H8_BMA150_READING 1
 
+/** 3.1.2 bandwidth - data is updated at twice the selected bandwidth */
+static const unsigned update_rates[8] = { 50, 100, 200, 380, 750, 1500,
+                                          3000, 3000 };
+
+/**
+ * Refreshes the axis data from a motion trace or gait if the sensor would
+ * have produced a new sample since it was last read.
+ */
+static void h8_bma150_update(h8_device_t *device, h8_bma150_t *bma)
+{
+  unsigned control = bma->data.raw[0x14].u;
+  unsigned rate = update_rates[control & B00000111];
+  h8_u64 time = h8_system_time_us(device->system);
+  h8_u64 update = time * rate / 1000000 + 1;
+  h8_s16 axes[3];
+  unsigned i;
+
+  if (update == bma->update)
+    return;
+  else if (bma->motion)
+  {
+    if (!h8_motion_sample(bma->motion, (update - 1) * 1000000 / rate,
+                          &axes[0], &axes[1], &axes[2]))
+      return;
+  }
+  else
+    h8_gait_block(bma->gait, (update - 1) * 1000000 / rate, 0,
+                  &axes[0], &axes[1], &axes[2], 1);
+  bma->update = update;
+
+  for (i = 0; i < 3; i++)
+  {
+    /* 3.1.1 range - 256 LSB/g at 2g, halved for each doubling of range */
+    long value = (long)axes[i] * 256 / 1000 /
+                 (1 << ((control >> 3) & B00000011));
+
+    if (value < -512)
+      value = -512;
+    else if (value > 511)
+      value = 511;
+    axes[i] = (h8_s16)value;
+  }
+  h8_bma150_set_axis(device, (h8_u16)(axes[0] & 0x3FF),
+                     (h8_u16)(axes[1] & 0x3FF), (h8_u16)(axes[2] & 0x3FF));
+}
+
 void h8_bma150_select_out(h8_device_t *device, h8_bool on)
 {
   h8_bma150_t *bma = device->device;
 
   bma->selected = !on;
+  h8_device_ssu_select(device, bma->selected);
   if (!bma->selected)
     bma->count = 0;
 }
@@ -71,6 +127,9 @@ void h8_bma150_read(h8_device_t *device, h8_byte_t *dst)
   {
     unsigned address = bma->state.parts.addr + bma->count - 2;
 
+    if ((bma->motion || bma->gait) && device->system &&
+        address >= 0x02 && address <= 0x07)
+      h8_bma150_update(device, bma);
     *dst = bma->data.raw[address];
 
     /* Clear "new_data" flags for accel axis */
@@ -81,8 +140,8 @@ void h8_bma150_read(h8_device_t *device, h8_byte_t *dst)
     else if (address == 0x06 || address == 0x07)
       bma->data.parts.z.flags.new = 0;
 
-    h8_log(H8_LOG_INFO, H8_LOG_SSU, "BMA150 read 0x%02X -> %02X",
-           address, dst->u);
+    H8_LOGI(H8_LOG_SSU, ("BMA150 read 0x%02X -> %02X",
+                         address, dst->u));
   }
 }
 
@@ -107,14 +166,14 @@ void h8_bma150_write(h8_device_t *device, h8_byte_t *dst, const h8_byte_t value)
     {
       if (bma->state.parts.addr >= 0x0A)
       {
-        h8_log(H8_LOG_INFO, H8_LOG_SSU, "BMA150 write 0x%02X -> %02X",
-               bma->state.parts.addr, value.u);
+        H8_LOGI(H8_LOG_SSU, ("BMA150 write 0x%02X -> %02X",
+                             bma->state.parts.addr, value.u));
         bma->data.raw[bma->state.parts.addr] = value;
       }
       else
-        h8_log(H8_LOG_INFO, H8_LOG_SSU, "BMA150 ERROR attempted write to "
-                                        "read-only address %02X",
-               bma->state.parts.addr);
+        H8_LOGI(H8_LOG_SSU, ("BMA150 ERROR attempted write to "
+                             "read-only address %02X",
+                             bma->state.parts.addr));
       bma->count = 0;
     }
   }
@@ -127,7 +186,7 @@ void h8_bma150_init(h8_device_t *device)
 {
   if (device)
   {
-    h8_bma150_t *bma = h8_dma_alloc(sizeof(h8_bma150_t), TRUE);
+    h8_bma150_t *bma = h8_device_alloc(device, sizeof(h8_bma150_t), TRUE);
 
     device->name = name;
     device->type = type;
@@ -179,3 +238,25 @@ void h8_bma150_set_axis(h8_device_t *device, h8_u16 x, h8_u16 y, h8_u16 z)
     bma->data.parts.z.flags.new = 1;
   }
 }
+
+void h8_bma150_set_motion(h8_device_t *device, h8_motion_t *motion)
+{
+  if (device && device->type == H8_DEVICE_BMA150 && device->device)
+  {
+    h8_bma150_t *bma = device->device;
+
+    bma->motion = motion;
+    bma->update = 0;
+  }
+}
+
+void h8_bma150_set_gait(h8_device_t *device, const h8_gait_t *gait)
+{
+  if (device && device->type == H8_DEVICE_BMA150 && device->device)
+  {
+    h8_bma150_t *bma = device->device;
+
+    bma->gait = gait;
+    bma->update = 0;
+  }
+}
@@ -2,6 +2,8 @@
 #define H8_BMA150_H
 
 #include "../device.h"
+#include "gait.h"
+#include "motion.h"
 
 void h8_bma150_init(h8_device_t *device);
 
@@ -9,4 +11,17 @@ void h8_bma150_select_out(h8_device_t *device, h8_bool on);
 
 void h8_bma150_set_axis(h8_device_t *device, h8_u16 x, h8_u16 y, h8_u16 z);
 
+/**
+ * Drives the axis data from a recorded trace, sampled at the sensor's update
+ * rate in emulated time whenever the firmware reads it. The trace must stay
+ * open while attached; pass NULL to detach it.
+ */
+void h8_bma150_set_motion(h8_device_t *device, h8_motion_t *motion);
+
+/**
+ * Drives the axis data from a synthetic gait in the same way. An attached
+ * motion trace takes precedence.
+ */
+void h8_bma150_set_gait(h8_device_t *device, const h8_gait_t *gait);
+
 #endif
@@ -1,5 +1,4 @@
 #include "buttons.h"
-#include "../dma.h"
 
 static const char *name_1 = "1-button input device";
 static const char *name_3 = "3-button input device";
@@ -8,7 +7,7 @@ static void h8_buttons_init(h8_device_t *device, h8_device_id type)
 {
   if (device)
   {
-    h8_buttons_t *buttons = h8_dma_alloc(sizeof(h8_buttons_t), TRUE);
+    h8_buttons_t *buttons = h8_device_alloc(device, sizeof(h8_buttons_t), TRUE);
 
     buttons->button_count = type == H8_DEVICE_1BUTTON ? 1 : 3;
 
@@ -30,6 +29,17 @@ void h8_buttons_init_3b(h8_device_t *device)
   h8_buttons_init(device, H8_DEVICE_3BUTTON);
 }
 
+void h8_buttons_set(h8_device_t *device, unsigned button, h8_bool pressed)
+{
+  if (device)
+  {
+    h8_buttons_t *m_buttons = device->device;
+
+    if (button < m_buttons->button_count)
+      m_buttons->buttons[button] = pressed;
+  }
+}
+
 static h8_bool h8_buttons_in(h8_device_t *device, unsigned index)
 {
   if (device)
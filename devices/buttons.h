@@ -27,6 +27,12 @@ void h8_buttons_init_1b(h8_device_t *device);
 
 void h8_buttons_init_3b(h8_device_t *device);
 
+/**
+ * Sets whether a button is held. Buttons the device does not have are
+ * ignored.
+ */
+void h8_buttons_set(h8_device_t *device, unsigned button, h8_bool pressed);
+
 h8_bool h8_buttons_in_0(h8_device_t *device);
 
 h8_bool h8_buttons_in_1(h8_device_t *device);
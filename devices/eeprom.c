@@ -1,9 +1,26 @@
-#include "../dma.h"
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "../config.h"
 #include "../logger.h"
+#include "../system.h"
 #include "eeprom.h"
 
 #include <string.h>
 
+#if H8_EEPROM_MMAP && !defined(_WIN32)
+#define H8_EEPROM_MMAP_IMPL 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define H8_EEPROM_MMAP_IMPL 0
+#endif
+
+static const h8_u8 journal_magic[4] = { 'H', '8', 'E', 'J' };
+
 static const char *name_8k = "8KB EEPROM device";
 static const char *name_64k = "64KB EEPROM device";
 
@@ -86,22 +103,165 @@ typedef struct
     ) flags;
     h8_byte_t raw;
   } status;
+
+  /** Whether `data` is mapped from the file open as `fd` */
+  h8_bool mapped;
+  int fd;
+
+  /** The range of `data` written since it was last synced to its file */
+  unsigned dirty_start, dirty_end;
+
+  /** A bit for each page written since the last h8_eeprom_checkpoint */
+  h8_u8 pages[H8_EEPROM_PAGES_MAX / 8];
+
+  /** If set, every write is appended here, see h8_eeprom_journal */
+  FILE *journal;
+
+  /** Contiguous written bytes not yet appended to the journal */
+  h8_u8 journal_data[H8_EEPROM_PAGE_SIZE];
+  unsigned journal_address, journal_length;
+  h8_u64 journal_time;
 } h8_eeprom_t;
 
+/** Records that a range of a mapped EEPROM must be synced to its file */
+static void h8_eeprom_dirty(h8_eeprom_t *eeprom, unsigned start, unsigned end)
+{
+  if (!eeprom->mapped)
+    return;
+  else if (eeprom->dirty_start >= eeprom->dirty_end)
+  {
+    eeprom->dirty_start = start;
+    eeprom->dirty_end = end;
+  }
+  else
+  {
+    if (start < eeprom->dirty_start)
+      eeprom->dirty_start = start;
+    if (end > eeprom->dirty_end)
+      eeprom->dirty_end = end;
+  }
+}
+
+/** Writes the dirty range of a mapped EEPROM through to its file */
+static void h8_eeprom_sync(h8_eeprom_t *eeprom)
+{
+#if H8_EEPROM_MMAP_IMPL
+  if (eeprom->mapped && eeprom->dirty_start < eeprom->dirty_end)
+  {
+    unsigned page = (unsigned)sysconf(_SC_PAGESIZE);
+    unsigned start = eeprom->dirty_start / page * page;
+
+    if (msync(eeprom->data + start, eeprom->dirty_end - start, MS_SYNC))
+      H8_LOGW(H8_LOG_EEP, ("Failed to sync 0x%04X-0x%04X",
+                           eeprom->dirty_start, eeprom->dirty_end - 1));
+  }
+#endif
+  eeprom->dirty_start = eeprom->dirty_end = 0;
+}
+
+static void h8_eeprom_put(h8_u8 *dst, h8_u64 value, unsigned size)
+{
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    dst[i] = (h8_u8)(value >> (i * 8));
+}
+
+static unsigned long h8_eeprom_get(const h8_u8 *src, unsigned size)
+{
+  unsigned long value = 0;
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    value |= (unsigned long)src[i] << (i * 8);
+
+  return value;
+}
+
+/** Appends the pending run of written bytes to the journal as one record */
+static void h8_eeprom_journal_flush(h8_eeprom_t *eeprom)
+{
+  if (eeprom->journal && eeprom->journal_length)
+  {
+    h8_u8 header[H8_EEPROM_JOURNAL_HEADER];
+
+    h8_eeprom_put(&header[0], eeprom->journal_address, 2);
+    h8_eeprom_put(&header[2], eeprom->journal_length, 2);
+    h8_eeprom_put(&header[4], eeprom->journal_time, 8);
+    if (fwrite(header, sizeof(header), 1, eeprom->journal) != 1 ||
+        fwrite(eeprom->journal_data, eeprom->journal_length, 1,
+               eeprom->journal) != 1)
+      H8_LOGW(H8_LOG_EEP, ("Failed to append to journal"));
+  }
+  eeprom->journal_length = 0;
+}
+
+/**
+ * Stores bytes written by a WRITE command with WEL set, noting the pages
+ * written and recording them in the journal.
+ */
+static void h8_eeprom_store(const h8_device_t *device, h8_eeprom_t *eeprom,
+                            unsigned address, const h8_byte_t *src,
+                            unsigned count)
+{
+  unsigned i;
+
+  for (i = address / H8_EEPROM_PAGE_SIZE;
+       i <= (address + count - 1) / H8_EEPROM_PAGE_SIZE; i++)
+    eeprom->pages[i >> 3] |= 1 << (i & 7);
+  memcpy(&eeprom->data[address], src, count);
+  h8_eeprom_dirty(eeprom, address, address + count);
+
+  while (eeprom->journal && count)
+  {
+    unsigned length = eeprom->journal_length, span;
+
+    if (length && (address != eeprom->journal_address + length ||
+                   length == sizeof(eeprom->journal_data)))
+    {
+      h8_eeprom_journal_flush(eeprom);
+      length = 0;
+    }
+    if (!length)
+    {
+      eeprom->journal_address = address;
+      eeprom->journal_time = device->system ?
+                             device->system->instructions : 0;
+    }
+    span = sizeof(eeprom->journal_data) - length;
+    if (span > count)
+      span = count;
+    memcpy(&eeprom->journal_data[length], src, span);
+    eeprom->journal_length += span;
+    address += span;
+    src += span;
+    count -= span;
+  }
+}
+
+/** Marks every page changed, ie: after the contents were replaced */
+static void h8_eeprom_touch(h8_eeprom_t *eeprom)
+{
+  memset(eeprom->pages, 0xFF, eeprom->length / H8_EEPROM_PAGE_SIZE / 8);
+}
+
 h8_bool h8_eeprom_serialize(const h8_device_t *device, h8_u8 **data,
                             unsigned *size)
 {
-  if (!device || !device->device || !data || !*data || !size || *size == 0)
+  if (!device || !device->device || !data || !*data || !size)
     return FALSE;
   else
   {
     const h8_eeprom_t *m_eeprom = (h8_eeprom_t*)device->device;
 
+    if (*size < m_eeprom->length + 1)
+      return FALSE;
     memcpy(*data, m_eeprom->data, m_eeprom->length);
-    *data += m_eeprom->length;
-    *size += m_eeprom->length;
+    (*data)[m_eeprom->length] = m_eeprom->status.raw.u;
+    *data += m_eeprom->length + 1;
+    *size -= m_eeprom->length + 1;
 
-    /** @todo */
+    /** @todo Save the state of a transfer in progress */
 
     return TRUE;
   }
@@ -110,26 +270,179 @@ h8_bool h8_eeprom_serialize(const h8_device_t *device, h8_u8 **data,
 h8_bool h8_eeprom_deserialize(h8_device_t *device, const h8_u8 **data,
                               unsigned *size)
 {
-  if (!device || !device->device || !data || !*data || !size || *size == 0)
+  if (!device || !device->device || !data || !*data || !size)
     return FALSE;
   else
   {
     h8_eeprom_t *m_eeprom = (h8_eeprom_t*)device->device;
 
+    if (*size < m_eeprom->length + 1)
+      return FALSE;
     memcpy(m_eeprom->data, *data, m_eeprom->length);
-    *data += m_eeprom->length;
-    *size += m_eeprom->length;
+    m_eeprom->status.raw.u = (*data)[m_eeprom->length];
+    h8_eeprom_dirty(m_eeprom, 0, m_eeprom->length);
+    h8_eeprom_sync(m_eeprom);
+    h8_eeprom_touch(m_eeprom);
+    *data += m_eeprom->length + 1;
+    *size -= m_eeprom->length + 1;
 
-    /** @todo */
+    /** @todo Load the state of a transfer in progress */
 
     return TRUE;
   }
 }
 
+/** Releases the memory holding an EEPROM's contents */
+static void h8_eeprom_release(h8_device_t *device, h8_eeprom_t *eeprom)
+{
+#if H8_EEPROM_MMAP_IMPL
+  if (eeprom->mapped)
+  {
+    h8_eeprom_sync(eeprom);
+    munmap(eeprom->data, eeprom->length);
+    close(eeprom->fd);
+    eeprom->mapped = FALSE;
+  }
+  else
+#endif
+    h8_device_release(device, eeprom->data);
+  eeprom->data = NULL;
+}
+
 void h8_eeprom_free(h8_device_t *device)
 {
   if (device && device->device)
-    h8_dma_free(((h8_eeprom_t*)device->device)->data);
+  {
+    h8_eeprom_journal(device, NULL);
+    h8_eeprom_release(device, (h8_eeprom_t*)device->device);
+  }
+}
+
+unsigned h8_eeprom_checkpoint(h8_device_t *device, h8_u16 *pages)
+{
+  h8_eeprom_t *eeprom = (h8_eeprom_t*)device->device;
+  unsigned page, count = 0;
+
+  for (page = 0; page < eeprom->length / H8_EEPROM_PAGE_SIZE; page++)
+    if (eeprom->pages[page >> 3] & (1 << (page & 7)))
+      pages[count++] = (h8_u16)page;
+  memset(eeprom->pages, 0, sizeof(eeprom->pages));
+
+  return count;
+}
+
+h8_bool h8_eeprom_journal(h8_device_t *device, FILE *file)
+{
+  h8_eeprom_t *eeprom = (h8_eeprom_t*)device->device;
+
+  h8_eeprom_journal_flush(eeprom);
+  eeprom->journal = file;
+  if (file)
+  {
+    h8_u8 header[9];
+
+    memcpy(header, journal_magic, sizeof(journal_magic));
+    header[4] = H8_EEPROM_JOURNAL_VERSION;
+    h8_eeprom_put(&header[5], eeprom->length, 4);
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+    {
+      eeprom->journal = NULL;
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+unsigned long h8_eeprom_journal_replay(FILE *file, h8_u8 *image,
+                                       unsigned length)
+{
+  h8_u8 header[9], record[H8_EEPROM_JOURNAL_HEADER];
+  unsigned long records = 0;
+
+  if (fread(header, sizeof(header), 1, file) != 1 ||
+      memcmp(header, journal_magic, sizeof(journal_magic)) ||
+      header[4] != H8_EEPROM_JOURNAL_VERSION ||
+      h8_eeprom_get(&header[5], 4) != length)
+    return 0;
+
+  while (fread(record, sizeof(record), 1, file) == 1)
+  {
+    unsigned address = (unsigned)h8_eeprom_get(&record[0], 2);
+    unsigned count = (unsigned)h8_eeprom_get(&record[2], 2);
+
+    if (address + count > length ||
+        fread(&image[address], count, 1, file) != 1)
+      break;
+    records++;
+  }
+
+  return records;
+}
+
+h8_bool h8_eeprom_map(h8_device_t *device, const char *path)
+{
+#if H8_EEPROM_MMAP_IMPL
+  h8_eeprom_t *eeprom;
+  struct stat st;
+  void *mapping;
+  int fd;
+
+  if (!device || !device->device || !path)
+    return FALSE;
+  eeprom = (h8_eeprom_t*)device->device;
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return FALSE;
+
+  /* Extend new or short files with erased bytes */
+  if (fstat(fd, &st) == 0 && st.st_size < (off_t)eeprom->length &&
+      lseek(fd, st.st_size, SEEK_SET) == st.st_size)
+  {
+    h8_u8 erased[256];
+    unsigned left = eeprom->length - (unsigned)st.st_size;
+
+    memset(erased, 0xFF, sizeof(erased));
+    while (left)
+    {
+      unsigned chunk = left < sizeof(erased) ? left : sizeof(erased);
+
+      if (write(fd, erased, chunk) != (ssize_t)chunk)
+        break;
+      left -= chunk;
+    }
+    if (left)
+    {
+      close(fd);
+      return FALSE;
+    }
+  }
+
+  mapping = mmap(NULL, eeprom->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                 0);
+  if (mapping == MAP_FAILED)
+  {
+    H8_LOGE(H8_LOG_EEP, ("Failed to map %s", path));
+    close(fd);
+    return FALSE;
+  }
+
+  h8_eeprom_release(device, eeprom);
+  eeprom->data = mapping;
+  eeprom->fd = fd;
+  eeprom->mapped = TRUE;
+  eeprom->dirty_start = eeprom->dirty_end = 0;
+  h8_eeprom_touch(eeprom);
+  device->data = eeprom->data;
+
+  return TRUE;
+#else
+  /** @todo Windows file mappings */
+  H8_UNUSED(device);
+  H8_UNUSED(path);
+
+  return FALSE;
+#endif
 }
 
 void h8_eeprom_read(h8_device_t *device, h8_byte_t *dst)
@@ -144,9 +457,9 @@ void h8_eeprom_read(h8_device_t *device, h8_byte_t *dst)
     if (eeprom->position > 3)
     {
       *dst = eeprom->data[eeprom->address.u];
-      h8_log(H8_LOG_INFO, H8_LOG_EEP, "read 0x%04X -> %02X %c",
-             eeprom->address.u, dst->u,
-             (dst->u >= 0x20 && dst->u <= 0x7E) ? dst->i : '\0');
+      H8_LOGI(H8_LOG_EEP, ("read 0x%04X -> %02X %c",
+                           eeprom->address.u, dst->u,
+                           (dst->u >= 0x20 && dst->u <= 0x7E) ? dst->i : '\0'));
       return;
     }
     break;
@@ -210,10 +523,20 @@ void h8_eeprom_write(h8_device_t *device, h8_byte_t *dst, h8_byte_t value)
     {
       if (eeprom->status.flags.wel)
       {
-        eeprom->data[eeprom->address.u] = value;
-        h8_log(H8_LOG_INFO, H8_LOG_EEP, "write 0x%04X -> %02X %c",
-             eeprom->address.u, value.u,
-             (value.u >= 0x20 && value.u <= 0x7E) ? value.u : '\0');
+        /* The common case of h8_eeprom_store, kept inline */
+        if (eeprom->mapped || eeprom->journal)
+          h8_eeprom_store(device, eeprom, eeprom->address.u, &value, 1);
+        else
+        {
+          unsigned page = eeprom->address.u / H8_EEPROM_PAGE_SIZE;
+
+          eeprom->pages[page >> 3] |= 1 << (page & 7);
+          eeprom->data[eeprom->address.u] = value;
+        }
+        H8_LOGI(H8_LOG_EEP, ("write 0x%04X -> %02X %c",
+                             eeprom->address.u, value.u,
+                             (value.u >= 0x20 && value.u <= 0x7E) ?
+                             value.u : '\0'));
       }
       eeprom->address.u++;
       goto end;
@@ -228,14 +551,62 @@ end:
   *dst = value;
 }
 
+unsigned h8_eeprom_read_bulk(h8_device_t *device, h8_byte_t *dst,
+                             unsigned count)
+{
+  h8_eeprom_t *eeprom = (h8_eeprom_t*)device->device;
+  unsigned start;
+
+  /* Only whole data phases of a READ are handled here */
+  if (!eeprom->selected || eeprom->command != H8_EEPROM_READ ||
+      eeprom->position < 3 || !count)
+    return 0;
+
+  /* The first "don't care" byte reads the address without incrementing it */
+  start = eeprom->address.u + (eeprom->position == 3 ? 0 : 1);
+  if (start + count > eeprom->length)
+    return 0;
+
+  memcpy(dst, &eeprom->data[start], count);
+  H8_LOGI(H8_LOG_EEP, ("read 0x%04X-0x%04X", start, start + count - 1));
+  eeprom->address.u = (h8_u16)(start + count - 1);
+  eeprom->position += count;
+
+  return count;
+}
+
+unsigned h8_eeprom_write_bulk(h8_device_t *device, const h8_byte_t *src,
+                              unsigned count)
+{
+  h8_eeprom_t *eeprom = (h8_eeprom_t*)device->device;
+
+  if (!eeprom->selected || eeprom->command != H8_EEPROM_WRITE ||
+      eeprom->position < 3 || !count ||
+      eeprom->address.u + count > eeprom->length)
+    return 0;
+
+  if (eeprom->status.flags.wel)
+  {
+    h8_eeprom_store(device, eeprom, eeprom->address.u, src, count);
+    H8_LOGI(H8_LOG_EEP, ("write 0x%04X-0x%04X",
+                         eeprom->address.u, eeprom->address.u + count - 1));
+  }
+  eeprom->address.u = (h8_u16)(eeprom->address.u + count);
+  eeprom->position += count;
+
+  return count;
+}
+
 void h8_eeprom_init(h8_device_t *device, unsigned type)
 {
   if (device)
   {
-    h8_eeprom_t *eeprom = h8_dma_alloc(sizeof(h8_eeprom_t), TRUE);
+    h8_eeprom_t *eeprom = h8_device_alloc(device, sizeof(h8_eeprom_t), TRUE);
     unsigned size = type == H8_DEVICE_EEPROM_8K ? 8 * 1024 : 64 * 1024;
 
-    eeprom->data = h8_dma_alloc(size, FALSE);
+    /* Unprogrammed EEPROM cells read as 1 */
+    eeprom->data = h8_device_alloc(device, size, FALSE);
+    memset(eeprom->data, 0xFF, size);
     eeprom->length = size;
 
     device->name = type == H8_DEVICE_EEPROM_8K ? name_8k : name_64k;
@@ -246,8 +617,11 @@ void h8_eeprom_init(h8_device_t *device, unsigned type)
 
     device->ssu_in = h8_eeprom_read;
     device->ssu_out = h8_eeprom_write;
+    device->ssu_in_bulk = h8_eeprom_read_bulk;
+    device->ssu_out_bulk = h8_eeprom_write_bulk;
     device->save = h8_eeprom_serialize;
     device->load = h8_eeprom_deserialize;
+    device->free = h8_eeprom_free;
   }
 }
 
@@ -256,8 +630,15 @@ void h8_eeprom_select_out(h8_device_t *device, const h8_bool on)
   h8_eeprom_t *m_eeprom = (h8_eeprom_t*)device->device;
 
   m_eeprom->selected = !on;
+  h8_device_ssu_select(device, m_eeprom->selected);
   if (!m_eeprom->selected)
   {
+    /* Raising chip select completes a write */
+    if (m_eeprom->command == H8_EEPROM_WRITE)
+    {
+      h8_eeprom_sync(m_eeprom);
+      h8_eeprom_journal_flush(m_eeprom);
+    }
     m_eeprom->position = 0;
     m_eeprom->address.u = 0;
   }
@@ -3,6 +3,19 @@
 
 #include "../device.h"
 
+#include <stdio.h>
+
+/** The granularity changes are tracked at for h8_eeprom_checkpoint */
+#define H8_EEPROM_PAGE_SIZE 128
+
+/** The number of pages in the largest (64KB) EEPROM */
+#define H8_EEPROM_PAGES_MAX (64 * 1024 / H8_EEPROM_PAGE_SIZE)
+
+#define H8_EEPROM_JOURNAL_VERSION 2
+
+/** The size of a journal record before its data */
+#define H8_EEPROM_JOURNAL_HEADER 12
+
 void h8_eeprom_init_8k(h8_device_t *device);
 
 void h8_eeprom_init_64k(h8_device_t *device);
@@ -11,6 +24,63 @@ void h8_eeprom_read(h8_device_t *device, h8_byte_t *dst);
 
 void h8_eeprom_write(h8_device_t *device, h8_byte_t *dst, h8_byte_t value);
 
+/**
+ * Continues a READ with a number of "don't care" transfers at once.
+ * @return The number of bytes read, or 0 outside of a READ's data phase
+ */
+unsigned h8_eeprom_read_bulk(h8_device_t *device, h8_byte_t *dst,
+                             unsigned count);
+
+/**
+ * Continues a WRITE with a span of bytes at once.
+ * @return The number of bytes written, or 0 outside of a WRITE's data phase
+ */
+unsigned h8_eeprom_write_bulk(h8_device_t *device, const h8_byte_t *src,
+                              unsigned count);
+
 void h8_eeprom_select_out(h8_device_t *device, const h8_bool on);
 
+/**
+ * Backs an EEPROM's contents with a file, which is memory-mapped so that
+ * writes go straight to it. A new or short file is extended with erased (0xFF)
+ * bytes, and the file's contents replace the current ones. Ranges written by
+ * a WRITE command are synced to disk when the chip is deselected, so saves
+ * survive the host process or machine going down.
+ * Requires H8_EEPROM_MMAP and a POSIX host.
+ * @return FALSE if the file could not be mapped, leaving the EEPROM as it was
+ */
+h8_bool h8_eeprom_map(h8_device_t *device, const char *path);
+
+void h8_eeprom_free(h8_device_t *device);
+
+/**
+ * Lists the pages written since the last call, ie: for an incremental
+ * backup, then resets tracking. Page n covers the H8_EEPROM_PAGE_SIZE bytes
+ * from n * H8_EEPROM_PAGE_SIZE in the device's data.
+ * @param pages Space for H8_EEPROM_PAGES_MAX page numbers
+ * @return The number of pages listed
+ */
+unsigned h8_eeprom_checkpoint(h8_device_t *device, h8_u16 *pages);
+
+/**
+ * Starts appending every byte stored by a WRITE command to an open binary
+ * file, or stops if it is NULL. Runs of contiguous bytes become one record:
+ *   "H8EJ", version, EEPROM size (32-bit)          once, at the start
+ *   address (16-bit), count (16-bit), time (64-bit), bytes...
+ * with all values little-endian. The time is the number of instructions the
+ * system had run when the run began. Records are written when chip select is
+ * raised after a WRITE, or when a run fills a page.
+ * @return FALSE if the header could not be written
+ */
+h8_bool h8_eeprom_journal(h8_device_t *device, FILE *file);
+
+/**
+ * Applies the records of a journal to an EEPROM image, ie: a backup taken
+ * when the journal was started.
+ * @return The number of records applied, or 0 if the journal is not for an
+ * image of this length
+ */
+unsigned long h8_eeprom_journal_replay(FILE *file, h8_u8 *image,
+                                       unsigned length);
+
 #endif
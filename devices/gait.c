@@ -0,0 +1,214 @@
+#include "gait.h"
+
+#include <string.h>
+
+/** Stride phase units per minute, as a stride is two steps */
+#define H8_GAIT_STRIDE_MINUTE 120000000UL
+
+/** Converts a position within a stride into a phase, in 2^-24 units */
+#define H8_GAIT_PHASE_SCALE (((h8_u64)1 << 56) / H8_GAIT_STRIDE_MINUTE)
+
+/** Gravity on the vertical axis, in milli-g */
+#define H8_GAIT_GRAVITY 1000
+
+/**
+ * Approximates the sine of a phase, where 2^32 is a full turn, in Q15. Uses
+ * a parabola with a correction term, which stays within 0.1% and is cheap
+ * enough to run per sample.
+ */
+static long h8_gait_sin(h8_u32 phase)
+{
+  unsigned long u = (phase >> 16) & 0x7FFF;
+  unsigned long y = u * (32768 - u) >> 13;
+
+  y -= 225 * (y - (y * y >> 15)) / 1000;
+
+  return phase & 0x80000000U ? -(long)y : (long)y;
+}
+
+static h8_u32 h8_gait_hash(h8_u32 value)
+{
+  value ^= value >> 16;
+  value *= 0x7FEB352DU;
+  value ^= value >> 15;
+  value *= 0x846CA68BU;
+  value ^= value >> 16;
+
+  return value;
+}
+
+/** A triangular-distributed deviation within +/-noise */
+static long h8_gait_noise(h8_u32 hash, unsigned noise)
+{
+  return ((long)(hash & 0xFFFF) - (long)(hash >> 16)) * (long)noise / 65535;
+}
+
+static h8_s16 h8_gait_clamp(long value)
+{
+  return (h8_s16)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+/**
+ * Finds the segment being walked at a time.
+ * @param offset_us Set to the time since the segment began
+ * @param left_us Set to the time until the segment ends
+ * @return NULL if resting after the end of the schedule
+ */
+static const h8_gait_segment_t *h8_gait_find(const h8_gait_t *gait,
+                                             h8_u64 time_us,
+                                             h8_u64 *offset_us,
+                                             h8_u64 *left_us)
+{
+  h8_u64 length_us = (h8_u64)gait->length_ms * 1000;
+  unsigned i;
+
+  *left_us = ~(h8_u64)0;
+  if (!length_us || (time_us >= length_us && !gait->repeat))
+    return NULL;
+  time_us %= length_us;
+
+  for (i = 0; i < gait->count; i++)
+  {
+    h8_u64 duration_us = (h8_u64)gait->segments[i].duration_ms * 1000;
+
+    if (time_us < duration_us)
+    {
+      *offset_us = time_us;
+      *left_us = duration_us - time_us;
+      return &gait->segments[i];
+    }
+    time_us -= duration_us;
+  }
+
+  return NULL;
+}
+
+void h8_gait_init(h8_gait_t *gait, h8_u32 seed, unsigned noise)
+{
+  memset(gait, 0, sizeof(*gait));
+  gait->seed = seed;
+  gait->noise = noise;
+}
+
+h8_bool h8_gait_add(h8_gait_t *gait, h8_gait_type type,
+                    unsigned long duration_ms, unsigned cadence,
+                    unsigned amplitude)
+{
+  h8_gait_segment_t *segment;
+
+  if (gait->count >= H8_GAIT_SEGMENTS_MAX)
+    return FALSE;
+  segment = &gait->segments[gait->count++];
+  segment->duration_ms = duration_ms;
+  segment->type = (h8_u8)type;
+  segment->cadence = cadence;
+  segment->amplitude = amplitude;
+  gait->length_ms += duration_ms;
+
+  return TRUE;
+}
+
+void h8_gait_block(const h8_gait_t *gait, h8_u64 start_us,
+                   unsigned long period_us, h8_s16 *x, h8_s16 *y, h8_s16 *z,
+                   unsigned count)
+{
+  unsigned done = 0;
+
+  while (done < count)
+  {
+    const h8_gait_segment_t *segment;
+    h8_u64 time_us = start_us + (h8_u64)done * period_us, offset_us, left_us;
+    h8_u64 stride = 0, step = 0;
+    long amplitude = 0;
+    h8_bool run = FALSE;
+    unsigned span = count - done, i;
+
+    segment = h8_gait_find(gait, time_us, &offset_us, &left_us);
+    if (period_us && (left_us - 1) / period_us + 1 < span)
+      span = (unsigned)((left_us - 1) / period_us + 1);
+    if (segment && segment->type != H8_GAIT_REST)
+    {
+      amplitude = (long)segment->amplitude;
+      run = segment->type == H8_GAIT_RUN;
+      stride = offset_us * segment->cadence % H8_GAIT_STRIDE_MINUTE;
+      step = (h8_u64)period_us * segment->cadence % H8_GAIT_STRIDE_MINUTE;
+    }
+
+    /*
+     * The whole span shares one segment, so this is a plain sweep. The
+     * position within the stride is kept exactly, so blocks match samples
+     * taken one at a time.
+     */
+    for (i = done; i < done + span; i++)
+    {
+      long vertical = H8_GAIT_GRAVITY, forward = 0, side = 0;
+
+      if (amplitude)
+      {
+        h8_u32 phase = (h8_u32)(stride * H8_GAIT_PHASE_SCALE >> 24);
+
+        stride += step;
+        if (stride >= H8_GAIT_STRIDE_MINUTE)
+          stride -= H8_GAIT_STRIDE_MINUTE;
+        vertical += amplitude * h8_gait_sin(phase * 2) / 32768;
+        if (run)
+          vertical += amplitude * h8_gait_sin(phase * 4) / 65536;
+        forward = amplitude * h8_gait_sin(phase * 2 + 0x40000000U) / 65536;
+        side = amplitude * h8_gait_sin(phase) / 131072;
+      }
+      if (gait->noise)
+      {
+        h8_u64 sample_us = start_us + (h8_u64)i * period_us;
+        h8_u32 hash = h8_gait_hash(gait->seed ^ (h8_u32)sample_us ^
+                                   h8_gait_hash((h8_u32)(sample_us >> 32)));
+
+        vertical += h8_gait_noise(hash = h8_gait_hash(hash + 1), gait->noise);
+        forward += h8_gait_noise(hash = h8_gait_hash(hash + 1), gait->noise);
+        side += h8_gait_noise(h8_gait_hash(hash + 1), gait->noise);
+      }
+      x[i] = h8_gait_clamp(vertical);
+      y[i] = h8_gait_clamp(forward);
+      z[i] = h8_gait_clamp(side);
+    }
+    done += span;
+  }
+}
+
+h8_u64 h8_gait_steps(const h8_gait_t *gait, h8_u64 time_us)
+{
+  h8_u64 length_us = (h8_u64)gait->length_ms * 1000, steps = 0;
+  unsigned i;
+
+  if (!length_us)
+    return 0;
+  else if (time_us >= length_us)
+  {
+    if (gait->repeat)
+    {
+      h8_u64 schedule = 0;
+
+      for (i = 0; i < gait->count; i++)
+        if (gait->segments[i].type != H8_GAIT_REST)
+          schedule += (h8_u64)gait->segments[i].duration_ms *
+                      gait->segments[i].cadence / 60000;
+      steps = time_us / length_us * schedule;
+      time_us %= length_us;
+    }
+    else
+      time_us = length_us;
+  }
+
+  for (i = 0; i < gait->count && time_us; i++)
+  {
+    const h8_gait_segment_t *segment = &gait->segments[i];
+    h8_u64 span = (h8_u64)segment->duration_ms * 1000;
+
+    if (span > time_us)
+      span = time_us;
+    if (segment->type != H8_GAIT_REST)
+      steps += span * segment->cadence / 60000000;
+    time_us -= span;
+  }
+
+  return steps;
+}
@@ -0,0 +1,86 @@
+#ifndef H8_GAIT_H
+#define H8_GAIT_H
+
+#include "../types.h"
+
+/**
+ * A synthetic source of body-worn acceleration, for driving the pedometer
+ * sensors through long schedules of walking, running and resting without
+ * recorded traces. Samples are computed on demand from emulated time, so the
+ * same schedule and seed always produce the same waveform, no matter how it
+ * is sampled.
+ *
+ * Axes are in milli-g as worn upright on a belt clip: X is vertical and
+ * includes gravity, Y points forward and Z to the side. Each step bounces X
+ * and rocks Y; Z sways once per stride of two steps. Running adds a harmonic
+ * for the sharper heel strike.
+ */
+
+/** The maximum number of segments in a schedule */
+#define H8_GAIT_SEGMENTS_MAX 32
+
+typedef enum
+{
+  H8_GAIT_REST = 0,
+  H8_GAIT_WALK,
+  H8_GAIT_RUN
+} h8_gait_type;
+
+typedef struct
+{
+  unsigned long duration_ms;
+  h8_u8 type;
+
+  /** Steps per minute */
+  unsigned cadence;
+
+  /** The peak vertical acceleration of a step, in milli-g */
+  unsigned amplitude;
+} h8_gait_segment_t;
+
+typedef struct
+{
+  h8_gait_segment_t segments[H8_GAIT_SEGMENTS_MAX];
+  unsigned count;
+
+  /** The total duration of all segments */
+  unsigned long length_ms;
+
+  /** The peak random deviation added to each axis, in milli-g */
+  unsigned noise;
+  h8_u32 seed;
+
+  /**
+   * If set, the schedule repeats forever. Otherwise the wearer rests after
+   * the last segment.
+   */
+  h8_bool repeat;
+} h8_gait_t;
+
+void h8_gait_init(h8_gait_t *gait, h8_u32 seed, unsigned noise);
+
+/**
+ * Appends a segment to the schedule.
+ * @return FALSE if the schedule is full
+ */
+h8_bool h8_gait_add(h8_gait_t *gait, h8_gait_type type,
+                    unsigned long duration_ms, unsigned cadence,
+                    unsigned amplitude);
+
+/**
+ * Computes a block of samples taken at a regular period, which is much
+ * cheaper per sample than one at a time.
+ * @param start_us The emulated time of the first sample
+ * @param period_us The time between samples
+ */
+void h8_gait_block(const h8_gait_t *gait, h8_u64 start_us,
+                   unsigned long period_us, h8_s16 *x, h8_s16 *y, h8_s16 *z,
+                   unsigned count);
+
+/**
+ * The number of steps the wearer has taken by a time, for checking the
+ * accuracy of the firmware's step counter.
+ */
+h8_u64 h8_gait_steps(const h8_gait_t *gait, h8_u64 time_us);
+
+#endif
@@ -1,7 +1,5 @@
 #include "generic_adc.h"
 
-#include "../dma.h"
-
 typedef struct
 {
   h8_word_t value;
@@ -10,7 +8,7 @@ typedef struct
 void h8_generic_adc_init(h8_device_t *device)
 {
   if (device)
-    device->device = h8_dma_alloc(sizeof(h8_generic_adc_t), FALSE);
+    device->device = h8_device_alloc(device, sizeof(h8_generic_adc_t), FALSE);
 }
 
 void h8_generic_adrr_set(h8_device_t *device, h8_word_t value)
@@ -1,8 +1,9 @@
 #include "lcd.h"
 
-#include "../dma.h"
 #include "../logger.h"
 
+#include <string.h>
+
 static const char *name = "128x64 LCD device";
 static const h8_device_id type = H8_DEVICE_LCD;
 
@@ -20,6 +21,49 @@ static const h8_device_id type = H8_DEVICE_LCD;
  *         |------|------|------|------|
  */
 
+void h8_lcd_display_state(const h8_lcd_t *m_lcd, h8_u8 *state)
+{
+  state[0] = m_lcd->all_on;
+  state[1] = m_lcd->inverse_display;
+  state[2] = m_lcd->power_save;
+  state[3] = m_lcd->x_flip;
+  state[4] = m_lcd->y_flip;
+  state[5] = m_lcd->display_on;
+  state[6] = m_lcd->contrast;
+  state[7] = m_lcd->start_line;
+  memcpy(&state[8], m_lcd->palette_modes, H8_LCD_PALETTE_SIZE);
+}
+
+void h8_lcd_set_display_state(h8_lcd_t *m_lcd, const h8_u8 *state)
+{
+  m_lcd->all_on = state[0];
+  m_lcd->inverse_display = state[1];
+  m_lcd->power_save = state[2];
+  m_lcd->x_flip = state[3];
+  m_lcd->y_flip = state[4];
+  m_lcd->display_on = state[5];
+  m_lcd->contrast = state[6];
+  m_lcd->start_line = state[7];
+  memcpy(m_lcd->palette_modes, &state[8], H8_LCD_PALETTE_SIZE);
+  m_lcd->dirty_all = TRUE;
+}
+
+/** Records that a column of a VRAM page has changed */
+static void h8_lcd_mark(h8_lcd_t *m_lcd, unsigned page, h8_u8 x)
+{
+  page &= H8_LCD_PAGES - 1;
+  if (!(m_lcd->dirty_pages & (1 << page)))
+  {
+    m_lcd->dirty_pages |= 1 << page;
+    m_lcd->dirty_x0[page] = x;
+    m_lcd->dirty_x1[page] = x;
+  }
+  else if (x < m_lcd->dirty_x0[page])
+    m_lcd->dirty_x0[page] = x;
+  else if (x > m_lcd->dirty_x1[page])
+    m_lcd->dirty_x1[page] = x;
+}
+
 void h8_lcd_read(h8_device_t *device, h8_byte_t *dst)
 {
   h8_lcd_t *m_lcd = device->device;
@@ -62,7 +106,11 @@ void h8_lcd_write(h8_device_t *device, h8_byte_t *dst, const h8_byte_t value)
                       m_lcd->x * 2 +
                       (m_lcd->second_write_data ? 1 : 0);
 
-    m_lcd->vram[offset] = value.u;
+    if (m_lcd->vram[offset] != value.u)
+    {
+      m_lcd->vram[offset] = value.u;
+      h8_lcd_mark(m_lcd, m_lcd->y, m_lcd->x);
+    }
 
     /* If we are writing the second byte, increment only the X address */
     if (m_lcd->second_write_data)
@@ -75,6 +123,11 @@ void h8_lcd_write(h8_device_t *device, h8_byte_t *dst, const h8_byte_t value)
   }
   else
   {
+    h8_u8 state[H8_LCD_DISPLAY_STATE_SIZE];
+    h8_u8 new_state[H8_LCD_DISPLAY_STATE_SIZE];
+
+    h8_lcd_display_state(m_lcd, state);
+
     /* Command mode write -- execute commands */
     if (!m_lcd->second_write_cmd)
     {
@@ -318,24 +371,69 @@ void h8_lcd_write(h8_device_t *device, h8_byte_t *dst, const h8_byte_t value)
       case 0xFE:
       case 0xFF:
         /** Unknown/custom purpose extended command */
-        h8_log(H8_LOG_INFO, H8_LOG_LCD, "Custom command %02X -> %u (0x%02X)",
-               m_lcd->command, value.u, value.u);
+        H8_LOGI(H8_LOG_LCD, ("Custom command %02X -> %u (0x%02X)",
+                             m_lcd->command, value.u, value.u));
         break;
       default:
         break;
       }
       m_lcd->second_write_cmd = FALSE;
     }
+
+    h8_lcd_display_state(m_lcd, new_state);
+    if (memcmp(state, new_state, sizeof(state)))
+      m_lcd->dirty_all = TRUE;
   }
 
   *dst = value;
 }
 
+unsigned h8_lcd_write_bulk(h8_device_t *device, const h8_byte_t *src,
+                           unsigned count)
+{
+  h8_lcd_t *m_lcd = device->device;
+  h8_u8 *page;
+  unsigned offset, done = 0;
+
+  if (!m_lcd->selected || !m_lcd->data_mode)
+    return 0;
+
+  /* Data writes walk through one page, wrapping back to its first column */
+  page = &m_lcd->vram[m_lcd->y * 0x0100];
+  offset = m_lcd->x * 2 + (m_lcd->second_write_data ? 1 : 0);
+  while (done < count)
+  {
+    unsigned span = count - done, first, last;
+
+    if (span > 0x0100 - offset)
+      span = 0x0100 - offset;
+    for (first = 0; first < span; first++)
+      if (page[offset + first] != src[done + first].u)
+        break;
+    if (first < span)
+    {
+      for (last = span - 1; last > first; last--)
+        if (page[offset + last] != src[done + last].u)
+          break;
+      memcpy(&page[offset + first], &src[done + first], last - first + 1);
+      h8_lcd_mark(m_lcd, m_lcd->y, (h8_u8)((offset + first) >> 1));
+      h8_lcd_mark(m_lcd, m_lcd->y, (h8_u8)((offset + last) >> 1));
+    }
+    done += span;
+    offset = (offset + span) & 0xFF;
+  }
+  m_lcd->x = (h8_u8)(offset >> 1);
+  m_lcd->second_write_data = offset & 1;
+
+  return count;
+}
+
 void h8_lcd_select_out(h8_device_t *device, const h8_bool on)
 {
   h8_lcd_t *m_lcd = device->device;
 
   m_lcd->selected = !on;
+  h8_device_ssu_select(device, m_lcd->selected);
 }
 
 void h8_lcd_mode_out(h8_device_t *device, const h8_bool on)
@@ -349,14 +447,16 @@ void h8_lcd_init(h8_device_t *device)
 {
   if (device)
   {
-    h8_lcd_t *m_lcd = h8_dma_alloc(sizeof(h8_lcd_t), TRUE);
+    h8_lcd_t *m_lcd = h8_device_alloc(device, sizeof(h8_lcd_t), TRUE);
 
     m_lcd->status.flags.on = TRUE;
     m_lcd->status.flags.id = 0x08;
+    m_lcd->dirty_all = TRUE;
 
     device->device = m_lcd;
     device->ssu_in = h8_lcd_read;
     device->ssu_out = h8_lcd_write;
+    device->ssu_out_bulk = h8_lcd_write_bulk;
     device->data = m_lcd->vram;
     device->size = sizeof(m_lcd->vram);
     device->name = name;
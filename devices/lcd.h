@@ -28,6 +28,38 @@ typedef union
 #define H8_LCD_PALETTE_BLACK 3
 #define H8_LCD_PALETTE_SIZE 4
 
+/** The visible area of the panel, in pixels */
+#define H8_LCD_WIDTH 128
+#define H8_LCD_HEIGHT 64
+
+/** The number of rows held in VRAM, of which H8_LCD_HEIGHT are displayed */
+#define H8_LCD_VRAM_ROWS 128
+
+/** The number of 8-row pages in VRAM */
+#define H8_LCD_PAGES (H8_LCD_VRAM_ROWS / 8)
+
+/** The number of bytes used by h8_lcd_display_state */
+#define H8_LCD_DISPLAY_STATE_SIZE 12
+
+/** A region of the displayed image, in pixels */
+typedef struct
+{
+  h8_u8 x, y, width, height;
+} h8_lcd_rect_t;
+
+typedef enum
+{
+  H8_LCD_FORMAT_INVALID = 0,
+
+  /** One byte per pixel, 0x00 is black and 0xFF is white */
+  H8_LCD_FORMAT_GRAY8,
+
+  /** Four bytes per pixel in R, G, B, A order in memory */
+  H8_LCD_FORMAT_RGBA8888,
+
+  H8_LCD_FORMAT_SIZE
+} h8_lcd_format;
+
 typedef struct
 {
   /** Max X by max Y */
@@ -74,12 +106,70 @@ typedef struct
   h8_u8 palette_modes[H8_LCD_PALETTE_SIZE];
 
   h8_lcd_sr_t status;
+
+  /**
+   * The first and last VRAM column changed in each page since the last call
+   * to h8_lcd_dirty_rects. Only meaningful for pages set in dirty_pages.
+   */
+  h8_u8 dirty_x0[H8_LCD_PAGES], dirty_x1[H8_LCD_PAGES];
+  h8_u16 dirty_pages;
+
+  /** Whether display state affecting every pixel has changed */
+  h8_bool dirty_all;
 } h8_lcd_t;
 
 void h8_lcd_init(h8_device_t *device);
 
+void h8_lcd_read(h8_device_t *device, h8_byte_t *dst);
+
+void h8_lcd_write(h8_device_t *device, h8_byte_t *dst, const h8_byte_t value);
+
+/**
+ * Writes a span of VRAM in data mode, incrementing the column address as
+ * h8_lcd_write does for each byte.
+ * @return The number of bytes written, or 0 outside of data mode
+ */
+unsigned h8_lcd_write_bulk(h8_device_t *device, const h8_byte_t *src,
+                           unsigned count);
+
 void h8_lcd_select_out(h8_device_t *device, const h8_bool on);
 
 void h8_lcd_mode_out(h8_device_t *device, const h8_bool on);
 
+/**
+ * Copies the state other than VRAM that affects how every pixel is displayed
+ * (palette, contrast, inversion, flips, start line, on/off) into
+ * H8_LCD_DISPLAY_STATE_SIZE bytes, ie: for detecting changes or capturing.
+ */
+void h8_lcd_display_state(const h8_lcd_t *lcd, h8_u8 *state);
+
+/** Restores state copied by h8_lcd_display_state */
+void h8_lcd_set_display_state(h8_lcd_t *lcd, const h8_u8 *state);
+
+/**
+ * Converts the displayed contents of VRAM into an image of H8_LCD_WIDTH by
+ * H8_LCD_HEIGHT pixels, applying the palette, contrast, inversion, all-on,
+ * display-on, flip and start line state as the panel would.
+ * @param dst The first pixel of the image
+ * @param pitch The distance in bytes between the starts of two rows of dst
+ * @return FALSE if a parameter is invalid
+ */
+h8_bool h8_lcd_render(const h8_lcd_t *lcd, void *dst, unsigned pitch,
+                      h8_lcd_format format);
+
+/**
+ * Reports which parts of the displayed image have changed since the last
+ * call, then resets tracking. Intended to be called once per frame by a
+ * single consumer, which can skip rendering and uploading entirely when
+ * nothing changed.
+ * @param rects Receives one rectangle per changed VRAM page that is visible.
+ * If there are more than count, a single bounding rectangle is given instead.
+ * @return The number of rectangles written, 0 if the image is unchanged
+ */
+unsigned h8_lcd_dirty_rects(h8_lcd_t *lcd, h8_lcd_rect_t *rects,
+                            unsigned count);
+
+/** Returns the name of the instruction set h8_lcd_render uses on this host */
+const char *h8_lcd_render_isa(void);
+
 #endif
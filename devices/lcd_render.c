@@ -0,0 +1,433 @@
+#include "lcd.h"
+
+#include <string.h>
+
+/**
+ * Host-side conversion of LCD VRAM into images for frontends.
+ *
+ * Each 8-row page of VRAM is 0x100 bytes: two bytes per column, the first
+ * holding rows 0-3 and the second rows 4-7, at two bits per pixel with the
+ * topmost row in the least significant bits. Rendering a row is therefore a
+ * strided load, a shift, a mask and a 4-entry table lookup, which the SIMD
+ * kernels below do 16 or 32 pixels at a time.
+ */
+
+#if H8_SIMD && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define H8_LCD_SSE2 1
+#else
+#define H8_LCD_SSE2 0
+#endif
+
+#if H8_LCD_SSE2 && (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#include <immintrin.h>
+#define H8_LCD_AVX2 1
+#else
+#define H8_LCD_AVX2 0
+#endif
+
+#if H8_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define H8_LCD_NEON 1
+#else
+#define H8_LCD_NEON 0
+#endif
+
+/**
+ * The contrast value at which palette levels map linearly from white (0) to
+ * black (15). Higher values darken every level, lower values lighten them.
+ * @todo Approximates the panel's response; not measured against hardware
+ */
+#define H8_LCD_CONTRAST_NEUTRAL 32
+
+/**
+ * Renders one row of pixels.
+ * @param page The 0x100 bytes of VRAM holding the page the row is in
+ * @param row The row within the page, 0-7
+ * @param shades The gray value for each of the four pixel values
+ */
+typedef void H8_LCD_ROW_T(h8_u8 *dst, const h8_u8 *page, unsigned row,
+                          const h8_u8 *shades, h8_lcd_format format);
+
+static void h8_lcd_row_scalar(h8_u8 *dst, const h8_u8 *page, unsigned row,
+                              const h8_u8 *shades, h8_lcd_format format)
+{
+  const h8_u8 *src = &page[row >> 2];
+  unsigned shift = (row & 3) * 2;
+  unsigned x;
+
+  if (format == H8_LCD_FORMAT_GRAY8)
+    for (x = 0; x < H8_LCD_WIDTH; x++)
+      dst[x] = shades[(src[x * 2] >> shift) & 3];
+  else for (x = 0; x < H8_LCD_WIDTH; x++)
+  {
+    h8_u8 shade = shades[(src[x * 2] >> shift) & 3];
+
+    dst[x * 4 + 0] = shade;
+    dst[x * 4 + 1] = shade;
+    dst[x * 4 + 2] = shade;
+    dst[x * 4 + 3] = 0xFF;
+  }
+}
+
+#if H8_LCD_SSE2
+/**
+ * Returns the shades of the 16 pixels whose column bytes start at src.
+ * table holds each of the four shades broadcast to every byte.
+ */
+static __m128i h8_lcd_shades_sse2(const h8_u8 *src, __m128i count,
+                                  const __m128i *table)
+{
+  __m128i mask = _mm_set1_epi16(3);
+  __m128i lo = _mm_loadu_si128((const __m128i*)src);
+  __m128i hi = _mm_loadu_si128((const __m128i*)(src + 16));
+  __m128i index, result;
+  unsigned i;
+
+  /* Both bytes of a column are shifted at once, then the wanted bits kept */
+  lo = _mm_and_si128(_mm_srl_epi16(lo, count), mask);
+  hi = _mm_and_si128(_mm_srl_epi16(hi, count), mask);
+  index = _mm_packus_epi16(lo, hi);
+
+  /* No byte shuffle in SSE2, so select each of the four shades by mask */
+  result = table[0];
+  for (i = 1; i < 4; i++)
+  {
+    __m128i match = _mm_cmpeq_epi8(index, _mm_set1_epi8((char)i));
+
+    result = _mm_or_si128(_mm_andnot_si128(match, result),
+                          _mm_and_si128(match, table[i]));
+  }
+
+  return result;
+}
+
+static void h8_lcd_store_rgba_sse2(h8_u8 *dst, __m128i gray)
+{
+  __m128i alpha = _mm_set1_epi8((char)0xFF);
+  __m128i gg_lo = _mm_unpacklo_epi8(gray, gray);
+  __m128i ga_lo = _mm_unpacklo_epi8(gray, alpha);
+  __m128i gg_hi = _mm_unpackhi_epi8(gray, gray);
+  __m128i ga_hi = _mm_unpackhi_epi8(gray, alpha);
+
+  _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(gg_lo, ga_lo));
+  _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(gg_lo, ga_lo));
+  _mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(gg_hi, ga_hi));
+  _mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(gg_hi, ga_hi));
+}
+
+static void h8_lcd_row_sse2(h8_u8 *dst, const h8_u8 *page, unsigned row,
+                            const h8_u8 *shades, h8_lcd_format format)
+{
+  __m128i count = _mm_cvtsi32_si128((int)((row >> 2) * 8 + (row & 3) * 2));
+  __m128i table[4];
+  unsigned x;
+
+  for (x = 0; x < 4; x++)
+    table[x] = _mm_set1_epi8((char)shades[x]);
+  for (x = 0; x < H8_LCD_WIDTH; x += 16)
+  {
+    __m128i gray = h8_lcd_shades_sse2(&page[x * 2], count, table);
+
+    if (format == H8_LCD_FORMAT_GRAY8)
+      _mm_storeu_si128((__m128i*)&dst[x], gray);
+    else
+      h8_lcd_store_rgba_sse2(&dst[x * 4], gray);
+  }
+}
+#endif
+
+#if H8_LCD_AVX2
+__attribute__((target("avx2")))
+static void h8_lcd_row_avx2(h8_u8 *dst, const h8_u8 *page, unsigned row,
+                            const h8_u8 *shades, h8_lcd_format format)
+{
+  __m128i count = _mm_cvtsi32_si128((int)((row >> 2) * 8 + (row & 3) * 2));
+  __m256i mask = _mm256_set1_epi16(3);
+  __m256i table = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i*)shades));
+  unsigned x;
+
+  for (x = 0; x < H8_LCD_WIDTH; x += 32)
+  {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)&page[x * 2]);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)&page[x * 2 + 32]);
+    __m256i gray;
+
+    lo = _mm256_and_si256(_mm256_srl_epi16(lo, count), mask);
+    hi = _mm256_and_si256(_mm256_srl_epi16(hi, count), mask);
+
+    /* Packing works within 128-bit lanes, so put the quarters back in order */
+    gray = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+    gray = _mm256_shuffle_epi8(table, gray);
+
+    if (format == H8_LCD_FORMAT_GRAY8)
+      _mm256_storeu_si256((__m256i*)&dst[x], gray);
+    else
+    {
+      __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+      __m128i half[2];
+      unsigned i;
+
+      half[0] = _mm256_castsi256_si128(gray);
+      half[1] = _mm256_extracti128_si256(gray, 1);
+      for (i = 0; i < 4; i++)
+      {
+        __m256i pixels = _mm256_cvtepu8_epi32(
+          i & 1 ? _mm_srli_si128(half[i >> 1], 8) : half[i >> 1]);
+
+        pixels = _mm256_or_si256(
+          _mm256_or_si256(pixels, _mm256_slli_epi32(pixels, 8)),
+          _mm256_or_si256(_mm256_slli_epi32(pixels, 16), alpha));
+        _mm256_storeu_si256((__m256i*)&dst[(x + i * 8) * 4], pixels);
+      }
+    }
+  }
+}
+#endif
+
+#if H8_LCD_NEON
+static void h8_lcd_row_neon(h8_u8 *dst, const h8_u8 *page, unsigned row,
+                            const h8_u8 *shades, h8_lcd_format format)
+{
+  int8x16_t count = vdupq_n_s8((signed char)-(int)((row & 3) * 2));
+  uint8x16_t mask = vdupq_n_u8(3);
+#if defined(__aarch64__)
+  uint8x16_t table = vld1q_u8(shades);
+#else
+  uint8x8_t table = vld1_u8(shades);
+#endif
+  unsigned x;
+
+  for (x = 0; x < H8_LCD_WIDTH; x += 16)
+  {
+    /* Deinterleaves the two bytes of each column while loading */
+    uint8x16x2_t columns = vld2q_u8(&page[x * 2]);
+    uint8x16_t index = vandq_u8(vshlq_u8(columns.val[row >> 2], count), mask);
+    uint8x16_t gray;
+
+#if defined(__aarch64__)
+    gray = vqtbl1q_u8(table, index);
+#else
+    gray = vcombine_u8(vtbl1_u8(table, vget_low_u8(index)),
+                       vtbl1_u8(table, vget_high_u8(index)));
+#endif
+    if (format == H8_LCD_FORMAT_GRAY8)
+      vst1q_u8(&dst[x], gray);
+    else
+    {
+      uint8x16x4_t pixels;
+
+      pixels.val[0] = gray;
+      pixels.val[1] = gray;
+      pixels.val[2] = gray;
+      pixels.val[3] = vdupq_n_u8(0xFF);
+      vst4q_u8(&dst[x * 4], pixels);
+    }
+  }
+}
+#endif
+
+static H8_LCD_ROW_T *h8_lcd_row = NULL;
+static const char *h8_lcd_isa = "scalar";
+
+/** Picks the fastest row kernel the compiler and host support */
+static void h8_lcd_render_select(void)
+{
+  h8_lcd_row = h8_lcd_row_scalar;
+  h8_lcd_isa = "scalar";
+#if H8_LCD_SSE2
+  h8_lcd_row = h8_lcd_row_sse2;
+  h8_lcd_isa = "SSE2";
+#endif
+#if H8_LCD_AVX2
+  if (__builtin_cpu_supports("avx2"))
+  {
+    h8_lcd_row = h8_lcd_row_avx2;
+    h8_lcd_isa = "AVX2";
+  }
+#endif
+#if H8_LCD_NEON
+  h8_lcd_row = h8_lcd_row_neon;
+  h8_lcd_isa = "NEON";
+#endif
+}
+
+/**
+ * Fills shades with the gray value for each pixel value, 0-3. Padded to 16
+ * entries so SIMD table lookups can load it directly.
+ */
+static void h8_lcd_shades(const h8_lcd_t *lcd, h8_u8 *shades)
+{
+  unsigned i;
+
+  memset(shades, 0, 16);
+  for (i = 0; i < H8_LCD_PALETTE_SIZE; i++)
+  {
+    unsigned level = lcd->all_on ? 15 : lcd->palette_modes[i];
+    unsigned darkness = level * lcd->contrast * 255 /
+                        (15 * H8_LCD_CONTRAST_NEUTRAL);
+
+    if (!lcd->display_on || lcd->power_save)
+      shades[i] = 0xFF;
+    else
+    {
+      if (darkness > 0xFF)
+        darkness = 0xFF;
+      shades[i] = (h8_u8)(lcd->inverse_display ? darkness : 0xFF - darkness);
+    }
+  }
+}
+
+/** Reverses the order of the pixels in one rendered row */
+static void h8_lcd_mirror(h8_u8 *row, unsigned size)
+{
+  unsigned left = 0;
+  unsigned right = (H8_LCD_WIDTH - 1) * size;
+
+  while (left < right)
+  {
+    h8_u8 pixel[4];
+
+    memcpy(pixel, &row[left], size);
+    memcpy(&row[left], &row[right], size);
+    memcpy(&row[right], pixel, size);
+    left += size;
+    right -= size;
+  }
+}
+
+h8_bool h8_lcd_render(const h8_lcd_t *lcd, void *dst, unsigned pitch,
+                      h8_lcd_format format)
+{
+  unsigned size = format == H8_LCD_FORMAT_GRAY8 ? 1 : 4;
+
+  if (!lcd || !dst || format == H8_LCD_FORMAT_INVALID ||
+      format >= H8_LCD_FORMAT_SIZE || pitch < H8_LCD_WIDTH * size)
+    return FALSE;
+  else
+  {
+    h8_u8 shades[16];
+    unsigned y;
+
+    if (!h8_lcd_row)
+      h8_lcd_render_select();
+    h8_lcd_shades(lcd, shades);
+
+    for (y = 0; y < H8_LCD_HEIGHT; y++)
+    {
+      h8_u8 *row = (h8_u8*)dst + y * pitch;
+      unsigned line = ((lcd->y_flip ? H8_LCD_HEIGHT - 1 - y : y) +
+                       lcd->start_line) & (H8_LCD_VRAM_ROWS - 1);
+
+      h8_lcd_row(row, &lcd->vram[(line >> 3) * 0x100], line & 7, shades,
+                 format);
+      if (lcd->x_flip)
+        h8_lcd_mirror(row, size);
+    }
+
+    return TRUE;
+  }
+}
+
+/** Grows a rectangle to also cover another */
+static void h8_lcd_rect_merge(h8_lcd_rect_t *dst, const h8_lcd_rect_t *src)
+{
+  unsigned x1 = dst->x + dst->width, y1 = dst->y + dst->height;
+
+  if (src->x + src->width > x1)
+    x1 = src->x + src->width;
+  if (src->y + src->height > y1)
+    y1 = src->y + src->height;
+  if (src->x < dst->x)
+    dst->x = src->x;
+  if (src->y < dst->y)
+    dst->y = src->y;
+  dst->width = (h8_u8)(x1 - dst->x);
+  dst->height = (h8_u8)(y1 - dst->y);
+}
+
+unsigned h8_lcd_dirty_rects(h8_lcd_t *lcd, h8_lcd_rect_t *rects,
+                            unsigned count)
+{
+  h8_lcd_rect_t bounds;
+  unsigned found = 0;
+
+  if (!lcd || !rects || !count)
+    return 0;
+  else if (lcd->dirty_all)
+  {
+    rects[0].x = 0;
+    rects[0].y = 0;
+    rects[0].width = H8_LCD_WIDTH;
+    rects[0].height = H8_LCD_HEIGHT;
+    found = 1;
+  }
+  else
+  {
+    unsigned page;
+
+    for (page = 0; page < H8_LCD_PAGES; page++)
+    {
+      h8_lcd_rect_t rect;
+      unsigned top = H8_LCD_HEIGHT, bottom = 0, row, x0, x1;
+
+      if (!(lcd->dirty_pages & (1 << page)))
+        continue;
+
+      /* Find which displayed rows, if any, show this page */
+      for (row = 0; row < 8; row++)
+      {
+        unsigned y = (page * 8 + row - lcd->start_line) &
+                     (H8_LCD_VRAM_ROWS - 1);
+
+        if (y >= H8_LCD_HEIGHT)
+          continue;
+        if (lcd->y_flip)
+          y = H8_LCD_HEIGHT - 1 - y;
+        if (y < top)
+          top = y;
+        if (y > bottom)
+          bottom = y;
+      }
+      if (top > bottom)
+        continue;
+
+      x0 = lcd->x_flip ? H8_LCD_WIDTH - 1 - lcd->dirty_x1[page] :
+                         lcd->dirty_x0[page];
+      x1 = lcd->x_flip ? H8_LCD_WIDTH - 1 - lcd->dirty_x0[page] :
+                         lcd->dirty_x1[page];
+      rect.x = (h8_u8)x0;
+      rect.y = (h8_u8)top;
+      rect.width = (h8_u8)(x1 - x0 + 1);
+      rect.height = (h8_u8)(bottom - top + 1);
+
+      if (!found)
+        bounds = rect;
+      else
+        h8_lcd_rect_merge(&bounds, &rect);
+      if (found < count)
+        rects[found] = rect;
+      found++;
+    }
+    if (found > count)
+    {
+      rects[0] = bounds;
+      found = 1;
+    }
+  }
+  lcd->dirty_all = FALSE;
+  lcd->dirty_pages = 0;
+
+  return found;
+}
+
+const char *h8_lcd_render_isa(void)
+{
+  if (!h8_lcd_row)
+    h8_lcd_render_select();
+
+  return h8_lcd_isa;
+}
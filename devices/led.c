@@ -1,4 +1,3 @@
-#include "../dma.h"
 #include "led.h"
 
 static const char *name = "LED device";
@@ -17,7 +16,7 @@ void h8_led_init(h8_device_t *device)
   {
     device->name = name;
     device->type = type;
-    device->device = h8_dma_alloc(sizeof(h8_led_t), TRUE);
+    device->device = h8_device_alloc(device, sizeof(h8_led_t), TRUE);
   }
 }
 
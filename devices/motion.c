@@ -0,0 +1,271 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "../config.h"
+#include "../dma.h"
+#include "motion.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if H8_EEPROM_MMAP && !defined(_WIN32)
+#define H8_MOTION_MMAP_IMPL 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define H8_MOTION_MMAP_IMPL 0
+#endif
+
+static const h8_u8 magic[4] = { 'H', '8', 'M', 'T' };
+
+/**
+ * Samples the cursor steps over one at a time before switching to a binary
+ * search, ie: after seeking far ahead
+ */
+#define H8_MOTION_LINEAR_STEPS 16
+
+static unsigned long h8_motion_time(const h8_motion_t *motion,
+                                    unsigned long index)
+{
+  const h8_u8 *sample = &motion->samples[index * H8_MOTION_SAMPLE];
+
+  return (unsigned long)sample[0] | (unsigned long)sample[1] << 8 |
+         (unsigned long)sample[2] << 16 | (unsigned long)sample[3] << 24;
+}
+
+static h8_s16 h8_motion_axis(const h8_motion_t *motion, unsigned long index,
+                             unsigned axis)
+{
+  const h8_u8 *value = &motion->samples[index * H8_MOTION_SAMPLE + 4 + axis * 2];
+  unsigned raw = value[0] | value[1] << 8;
+
+  return (h8_s16)(raw & 0x8000 ? (int)raw - 0x10000 : (int)raw);
+}
+
+/** Points samples and count at the contents of base, if they are a trace */
+static h8_bool h8_motion_validate(h8_motion_t *motion)
+{
+  const h8_u8 *header = (const h8_u8*)motion->base;
+
+  if (motion->size < H8_MOTION_HEADER ||
+      memcmp(header, magic, sizeof(magic)) ||
+      header[4] != H8_MOTION_VERSION)
+    return FALSE;
+  motion->samples = &header[H8_MOTION_HEADER];
+  motion->count = (motion->size - H8_MOTION_HEADER) / H8_MOTION_SAMPLE;
+  motion->cursor = 0;
+
+  return TRUE;
+}
+
+h8_bool h8_motion_open(h8_motion_t *motion, const char *path,
+                       h8_dma_arena_t *arena)
+{
+  FILE *file;
+  long size;
+
+  memset(motion, 0, sizeof(*motion));
+#if H8_MOTION_MMAP_IMPL
+  {
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return FALSE;
+    if (!fstat(fd, &info) && info.st_size >= H8_MOTION_HEADER)
+    {
+      void *base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+
+      if (base != MAP_FAILED)
+      {
+        motion->base = base;
+        motion->size = (unsigned long)info.st_size;
+        motion->mapped = TRUE;
+      }
+    }
+    close(fd);
+    if (motion->mapped)
+    {
+      if (h8_motion_validate(motion))
+        return TRUE;
+      h8_motion_close(motion);
+      return FALSE;
+    }
+  }
+#endif
+
+  /* Fall back to reading the whole trace into memory */
+  file = fopen(path, "rb");
+  if (!file)
+    return FALSE;
+  if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < H8_MOTION_HEADER ||
+      fseek(file, 0, SEEK_SET))
+  {
+    fclose(file);
+    return FALSE;
+  }
+  motion->base = arena ? h8_dma_arena_alloc(arena, (unsigned)size, FALSE) :
+                 h8_dma_alloc((unsigned)size, FALSE);
+  motion->size = (unsigned long)size;
+  motion->arena = arena;
+  if (!motion->base || fread(motion->base, motion->size, 1, file) != 1 ||
+      !h8_motion_validate(motion))
+  {
+    fclose(file);
+    h8_motion_close(motion);
+    return FALSE;
+  }
+  fclose(file);
+
+  return TRUE;
+}
+
+void h8_motion_close(h8_motion_t *motion)
+{
+  if (!motion->base)
+    return;
+  if (motion->mapped)
+  {
+#if H8_MOTION_MMAP_IMPL
+    munmap(motion->base, motion->size);
+#endif
+  }
+  else if (!motion->arena)
+    h8_dma_free(motion->base);
+  memset(motion, 0, sizeof(*motion));
+}
+
+unsigned long h8_motion_convert_csv(FILE *csv, FILE *out)
+{
+  char line[128];
+  h8_u8 header[H8_MOTION_HEADER];
+  unsigned long count = 0;
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, magic, sizeof(magic));
+  header[4] = H8_MOTION_VERSION;
+  if (fwrite(header, sizeof(header), 1, out) != 1)
+    return 0;
+
+  while (fgets(line, sizeof(line), csv))
+  {
+    h8_u8 sample[H8_MOTION_SAMPLE];
+    unsigned long time;
+    long axes[3];
+    char *pos = line;
+    unsigned i;
+
+    if (*pos < '0' || *pos > '9')
+      continue;
+    time = strtoul(pos, &pos, 10);
+    for (i = 0; i < 3; i++)
+    {
+      if (*pos != ',')
+        break;
+      axes[i] = strtol(pos + 1, &pos, 10);
+      if (axes[i] < -32768)
+        axes[i] = -32768;
+      else if (axes[i] > 32767)
+        axes[i] = 32767;
+    }
+    if (i < 3)
+      continue;
+
+    for (i = 0; i < 4; i++)
+      sample[i] = (h8_u8)(time >> (i * 8));
+    for (i = 0; i < 3; i++)
+    {
+      sample[4 + i * 2] = (h8_u8)(axes[i] & 0xFF);
+      sample[5 + i * 2] = (h8_u8)((axes[i] >> 8) & 0xFF);
+    }
+    if (fwrite(sample, sizeof(sample), 1, out) != 1)
+      return 0;
+    count++;
+  }
+
+  return count;
+}
+
+/** Moves the cursor to the last sample at or before a time, if any */
+static void h8_motion_seek(h8_motion_t *motion, unsigned long time_ms)
+{
+  unsigned long low, high, steps;
+
+  if (h8_motion_time(motion, motion->cursor) > time_ms)
+  {
+    low = 0;
+    high = motion->cursor;
+  }
+  else
+  {
+    /* Usually the next sample or two, as emulated time moves forward */
+    for (steps = 0; steps < H8_MOTION_LINEAR_STEPS; steps++)
+    {
+      if (motion->cursor + 1 >= motion->count ||
+          h8_motion_time(motion, motion->cursor + 1) > time_ms)
+        return;
+      motion->cursor++;
+    }
+    low = motion->cursor;
+    high = motion->count;
+  }
+
+  /* Find the first sample after the time within [low, high) */
+  while (low < high)
+  {
+    unsigned long mid = low + (high - low) / 2;
+
+    if (h8_motion_time(motion, mid) > time_ms)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  motion->cursor = low ? low - 1 : 0;
+}
+
+h8_bool h8_motion_sample(h8_motion_t *motion, h8_u64 time_us, h8_s16 *x,
+                         h8_s16 *y, h8_s16 *z)
+{
+  h8_s16 *axes[3];
+  unsigned long index, start, end;
+  unsigned i;
+
+  if (!motion->count)
+    return FALSE;
+  axes[0] = x;
+  axes[1] = y;
+  axes[2] = z;
+
+  h8_motion_seek(motion,
+                 time_us / 1000 > 0xFFFFFFFFUL ? 0xFFFFFFFFUL :
+                 (unsigned long)(time_us / 1000));
+  index = motion->cursor;
+  start = h8_motion_time(motion, index);
+
+  if (index + 1 >= motion->count || time_us <= (h8_u64)start * 1000 ||
+      (end = h8_motion_time(motion, index + 1)) == start)
+  {
+    for (i = 0; i < 3; i++)
+      *axes[i] = h8_motion_axis(motion, index, i);
+  }
+  else
+  {
+    double t = (double)(time_us - (h8_u64)start * 1000) /
+               ((double)(end - start) * 1000);
+
+    for (i = 0; i < 3; i++)
+    {
+      double a = h8_motion_axis(motion, index, i);
+      double b = h8_motion_axis(motion, index + 1, i);
+      double value = a + (b - a) * t;
+
+      *axes[i] = (h8_s16)(value < 0 ? value - 0.5 : value + 0.5);
+    }
+  }
+
+  return TRUE;
+}
@@ -0,0 +1,78 @@
+#ifndef H8_MOTION_H
+#define H8_MOTION_H
+
+#include "../dma.h"
+#include "../types.h"
+
+#include <stdio.h>
+
+/**
+ * A recorded 3-axis acceleration trace, ie: from a phone or a fitness band,
+ * that can drive an accelerometer device in emulated time.
+ *
+ * Traces are stored as a packed binary file that is memory-mapped where
+ * possible, so even multi-day traces only cost the pages around the current
+ * time. The layout, with all values little-endian:
+ *   "H8MT", version, 3 reserved bytes
+ *   { time in milliseconds (32-bit), x, y, z in milli-g (signed 16-bit) }...
+ * Sample times must not decrease. CSV traces are converted to this format
+ * once with h8_motion_convert_csv.
+ */
+
+#define H8_MOTION_VERSION 1
+
+/** The size of the binary header */
+#define H8_MOTION_HEADER 8
+
+/** The size of one binary sample */
+#define H8_MOTION_SAMPLE 10
+
+typedef struct
+{
+  /** The first sample, inside the mapping or buffer at `base` */
+  const h8_u8 *samples;
+  unsigned long count;
+
+  /** The sample at or before the most recently requested time */
+  unsigned long cursor;
+
+  void *base;
+  unsigned long size;
+  h8_bool mapped;
+
+  /** The arena a trace read into memory was carved from, if any */
+  h8_dma_arena_t *arena;
+} h8_motion_t;
+
+/**
+ * Opens a binary trace. It is memory-mapped on POSIX hosts when
+ * H8_EEPROM_MMAP is enabled, otherwise it is read into memory.
+ * @param arena The arena to read the trace into, such as that of the system
+ * it drives, or NULL to allocate it with h8_dma_alloc. A trace in an arena is
+ * released with it rather than by h8_motion_close.
+ * @return FALSE if the file could not be opened or is not a trace
+ */
+h8_bool h8_motion_open(h8_motion_t *motion, const char *path,
+                       h8_dma_arena_t *arena);
+
+void h8_motion_close(h8_motion_t *motion);
+
+/**
+ * Converts CSV lines of "time_ms,x_mg,y_mg,z_mg" into a binary trace,
+ * streaming so that memory use does not depend on the length of the trace.
+ * Blank lines and lines that do not start with a number, ie: a header or
+ * comments, are skipped.
+ * @return The number of samples written, or 0 on error
+ */
+unsigned long h8_motion_convert_csv(FILE *csv, FILE *out);
+
+/**
+ * Linearly interpolates the acceleration at a time, in milli-g. Times before
+ * the first sample or after the last one take that sample's value. Lookups
+ * are fastest when times increase between calls, as when emulating.
+ * @return FALSE if the trace is empty
+ */
+h8_bool h8_motion_sample(h8_motion_t *motion, h8_u64 time_us, h8_s16 *x,
+                         h8_s16 *y, h8_s16 *z);
+
+#endif
@@ -2,54 +2,107 @@
 #include "dma.h"
 #include "types.h"
 
+#include <string.h>
+
+/** Rounds a size or offset up to the alignment of arena allocations */
+#define H8_DMA_ROUND(a) \
+  (((a) + H8_DMA_ALIGN - 1) & ~(unsigned)(H8_DMA_ALIGN - 1))
+
+/** The start of each block an owned arena allocates */
+typedef struct h8_dma_block_t
+{
+  struct h8_dma_block_t *previous;
+  unsigned size;
+} h8_dma_block_t;
+
+#define H8_DMA_HEADER H8_DMA_ROUND(sizeof(h8_dma_block_t))
+
+static void (*h8_dma_oom_cb)(void) = NULL;
+
 #if H8_NO_DMA
+/** Precedes each value allocated from the static heap */
+typedef struct
+{
+  /** The offset of the header of the value allocated before this one */
+  unsigned previous;
+  h8_bool freed;
+} h8_dma_heap_t;
+
+#define H8_DMA_HEAP_HEADER H8_DMA_ROUND(sizeof(h8_dma_heap_t))
+
+/** The offset of a header when there is no value allocated before it */
+#define H8_DMA_HEAP_NONE (~0U)
+
 static h8_u8 h8_heap[H8_NO_DMA_SIZE];
 static unsigned h8_heap_alloc = 0;
-
-static void (*h8_dma_oom_cb)(void) = NULL;
+static unsigned h8_heap_last = H8_DMA_HEAP_NONE;
 #else
 #include <stdlib.h>
 #endif
 
+static void h8_dma_oom(void)
+{
+  if (h8_dma_oom_cb)
+    h8_dma_oom_cb();
+}
+
 void *h8_dma_alloc(unsigned size, unsigned zero)
 {
 /**
  * Implements very simple DMA for embedded systems that have no access to
- * malloc. Uses a static-sized heap, allocates purely linearly, and does not
- * actually free values. Use only if absolutely necessary.
+ * malloc. Uses a static-sized heap and allocates purely linearly, so a freed
+ * value is only given back once every value allocated after it is freed too.
+ * Use only if absolutely necessary.
  */
 #if H8_NO_DMA
-  if (size + h8_heap_alloc >= H8_NO_DMA_SIZE)
+  unsigned offset = H8_DMA_ROUND(h8_heap_alloc);
+
+  if (offset > H8_NO_DMA_SIZE ||
+      H8_NO_DMA_SIZE - offset < H8_DMA_HEAP_HEADER ||
+      size > H8_NO_DMA_SIZE - offset - H8_DMA_HEAP_HEADER)
   {
-    if (h8_dma_oom_cb)
-      h8_dma_oom_cb();
+    h8_dma_oom();
 
     return NULL;
   }
   else
   {
-    h8_u8 *allocated_value = &h8_heap[h8_heap_alloc];
+    h8_dma_heap_t *header = (h8_dma_heap_t*)&h8_heap[offset];
+    h8_u8 *allocated_value = &h8_heap[offset + H8_DMA_HEAP_HEADER];
 
+    header->previous = h8_heap_last;
+    header->freed = FALSE;
     if (zero)
-    {
-      unsigned offset;
-
-      for (offset = h8_heap_alloc; offset < h8_heap_alloc + size; offset++)
-        h8_heap[offset] = 0;
-    }
-    h8_heap_alloc += size;
+      memset(allocated_value, 0, size);
+    h8_heap_last = offset;
+    h8_heap_alloc = offset + H8_DMA_HEAP_HEADER + size;
 
     return allocated_value;
   }
 #else
-  return zero ? calloc(size, 1) : malloc(size);
+  void *value = zero ? calloc(size, 1) : malloc(size);
+
+  if (!value && size)
+    h8_dma_oom();
+
+  return value;
 #endif
 }
 
 void h8_dma_free(void *value)
 {
 #if H8_NO_DMA
-  H8_UNUSED(value);
+  if (!value)
+    return;
+  ((h8_dma_heap_t*)((h8_u8*)value - H8_DMA_HEAP_HEADER))->freed = TRUE;
+
+  /* Give back the end of the heap, up to the newest value still in use */
+  while (h8_heap_last != H8_DMA_HEAP_NONE &&
+         ((h8_dma_heap_t*)&h8_heap[h8_heap_last])->freed)
+  {
+    h8_heap_alloc = h8_heap_last;
+    h8_heap_last = ((h8_dma_heap_t*)&h8_heap[h8_heap_last])->previous;
+  }
 #else
   free(value);
 #endif
@@ -57,9 +110,102 @@ void h8_dma_free(void *value)
 
 void h8_dma_set_oom_cb(void (*cb)(void))
 {
-#if H8_NO_DMA
   h8_dma_oom_cb = cb;
-#else
-  H8_UNUSED(cb);
-#endif
+}
+
+void h8_dma_arena_init(h8_dma_arena_t *arena, void *buffer, unsigned size)
+{
+  arena->used = 0;
+  arena->owned = buffer == NULL;
+  if (arena->owned)
+  {
+    arena->base = NULL;
+    arena->size = 0;
+    arena->block_size = size;
+  }
+  else
+  {
+    /* Start at the first aligned address of the buffer */
+    unsigned pad = (H8_DMA_ALIGN - (unsigned)((unsigned long)buffer &
+                    (H8_DMA_ALIGN - 1))) & (H8_DMA_ALIGN - 1);
+
+    arena->base = (h8_u8*)buffer + pad;
+    arena->size = size > pad ? size - pad : 0;
+    arena->block_size = 0;
+  }
+}
+
+void *h8_dma_arena_alloc(h8_dma_arena_t *arena, unsigned size, unsigned zero)
+{
+  unsigned offset = H8_DMA_ROUND(arena->used);
+  h8_u8 *value;
+
+  if (!arena->base || offset > arena->size || size > arena->size - offset)
+  {
+    h8_dma_block_t *block;
+    unsigned block_size;
+
+    if (!arena->owned)
+    {
+      h8_dma_oom();
+
+      return NULL;
+    }
+
+    /* Start a new block, large enough for the allocation if need be */
+    block_size = arena->block_size;
+    if (block_size < H8_DMA_HEADER + size)
+      block_size = H8_DMA_HEADER + size;
+    block = h8_dma_alloc(block_size, FALSE);
+    if (!block)
+      return NULL;
+    block->previous = (h8_dma_block_t*)arena->base;
+    block->size = block_size;
+    arena->base = (h8_u8*)block;
+    arena->size = block_size;
+    offset = H8_DMA_HEADER;
+  }
+  value = arena->base + offset;
+  if (zero)
+    memset(value, 0, size);
+  arena->used = offset + size;
+
+  return value;
+}
+
+h8_bool h8_dma_arena_owns(const h8_dma_arena_t *arena, const void *value)
+{
+  const h8_u8 *p = (const h8_u8*)value;
+
+  if (arena->owned)
+  {
+    const h8_dma_block_t *block = (const h8_dma_block_t*)arena->base;
+
+    for (; block; block = block->previous)
+      if (p >= (const h8_u8*)block && p < (const h8_u8*)block + block->size)
+        return TRUE;
+
+    return FALSE;
+  }
+
+  return arena->base && p >= arena->base && p < arena->base + arena->size;
+}
+
+void h8_dma_arena_free(h8_dma_arena_t *arena)
+{
+  if (arena->owned)
+  {
+    h8_dma_block_t *block = (h8_dma_block_t*)arena->base;
+
+    while (block)
+    {
+      h8_dma_block_t *previous = block->previous;
+
+      h8_dma_free(block);
+      block = previous;
+    }
+    arena->base = NULL;
+    arena->size = 0;
+  }
+  arena->used = 0;
 }
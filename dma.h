@@ -1,10 +1,69 @@
 #ifndef H8_DMA_H
 #define H8_DMA_H
 
+#include "types.h"
+
+/** The alignment of every allocation carved from an arena */
+#define H8_DMA_ALIGN 16
+
+/**
+ * A region that allocations are carved from one after another, and that is
+ * released all at once rather than value by value.
+ *
+ * An arena either uses a single buffer provided by the caller, or allocates
+ * blocks with h8_dma_alloc as it needs them. Each block starts with a header
+ * pointing to the block filled before it, so an arena sized for everything it
+ * holds is one contiguous block.
+ */
+typedef struct
+{
+  /** The block allocations are carved from, or NULL before the first one */
+  h8_u8 *base;
+
+  /** The size of the current block, in bytes */
+  unsigned size;
+
+  /** The bytes of the current block in use */
+  unsigned used;
+
+  /** The size of each block allocated by an owned arena */
+  unsigned block_size;
+
+  /** Whether blocks are allocated by the arena rather than by the caller */
+  h8_bool owned;
+} h8_dma_arena_t;
+
 void *h8_dma_alloc(unsigned size, unsigned zero);
 
 void h8_dma_free(void *value);
 
+/**
+ * Sets a function called when an allocation fails, either because the
+ * H8_NO_DMA heap or a caller-provided arena is full, or because the host is
+ * out of memory.
+ */
 void h8_dma_set_oom_cb(void (*cb)(void));
 
+/**
+ * Sets up an arena.
+ * @param buffer The memory to carve allocations from, or NULL to allocate
+ * blocks of `size` bytes with h8_dma_alloc as they are needed
+ */
+void h8_dma_arena_init(h8_dma_arena_t *arena, void *buffer, unsigned size);
+
+/**
+ * Allocates memory from an arena, aligned to H8_DMA_ALIGN.
+ * @return NULL if a caller-provided buffer is full
+ */
+void *h8_dma_arena_alloc(h8_dma_arena_t *arena, unsigned size, unsigned zero);
+
+/** @return Whether a value was allocated from an arena */
+h8_bool h8_dma_arena_owns(const h8_dma_arena_t *arena, const void *value);
+
+/**
+ * Releases everything allocated from an arena. Blocks it allocated are
+ * freed, while a caller-provided buffer is emptied and can be used again.
+ */
+void h8_dma_arena_free(h8_dma_arena_t *arena);
+
 #endif
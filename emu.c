@@ -1,3 +1,4 @@
+#include "ir_capture.h"
 #include "logger.h"
 #include "system.h"
 
@@ -278,54 +279,76 @@ H8_SHL_OP(l, h8_long_t, 0x00000001, r, >>=)
 #define H8_IO_DUMMY_IN H8_UNUSED(system); H8_UNUSED(byte);
 #define H8_IO_DUMMY_OUT H8_UNUSED(system); H8_UNUSED(byte); H8_UNUSED(value);
 
-H8_IN(pdr1i)
+/**
+ * Reads the levels of a port's hooked input pins into its data register.
+ * @param shift The register bit of the port's first pin
+ */
+static void h8_port_in(h8_system_t *system, const h8_system_port_t *port,
+                       const h8_system_pin_in_t *pins, unsigned shift,
+                       h8_byte_t *byte)
 {
+  unsigned mask = port->in_mask >> shift;
   unsigned i;
 
-  for (i = 0; i < 3; i++)
-  {
-    if (system->pdr1_in[i].device && system->pdr1_in[i].func)
+  if (!mask)
+    return;
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+  for (i = 0; mask; i++, mask >>= 1)
+    if (mask & 1)
     {
-      byte->u &= ~(1 << i);
-      byte->u |= (system->pdr1_in[i].func(system->pdr1_in[i].device) & 0x01) << i;
+      byte->u &= ~(1 << (i + shift));
+      byte->u |= (pins[i].func(pins[i].device) & 0x01) << (i + shift);
     }
-  }
+  H8_PROFILE_LEAVE(&system->profile);
 }
 
-H8_OUT(pdr1o)
+/**
+ * Passes the levels of a port's hooked output pins to their devices, but only
+ * for pins whose level changed since the last write (or that were never
+ * written), then stores the register.
+ * @param shift The register bit of the port's first pin
+ */
+static void h8_port_out(h8_system_t *system, h8_system_port_t *port,
+                        const h8_system_pin_out_t *pins, unsigned shift,
+                        h8_byte_t *byte, h8_byte_t value)
 {
+  unsigned changed = ((value.u ^ port->out_levels) | ~port->out_driven) &
+                     port->out_mask;
   unsigned i;
 
-  for (i = 0; i < 3; i++)
-    if (system->pdr1_out[i].device && system->pdr1_out[i].func)
-      system->pdr1_out[i].func(system->pdr1_out[i].device, (value.u >> i) & 1);
+  if (changed)
+  {
+    port->out_levels = value.u;
+    port->out_driven = port->out_mask;
+    changed >>= shift;
+    H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+    for (i = 0; changed; i++, changed >>= 1)
+      if (changed & 1)
+        pins[i].func(pins[i].device, (value.u >> (i + shift)) & 1);
+    H8_PROFILE_LEAVE(&system->profile);
+  }
 
   *byte = value;
 }
 
-H8_IN(pdr3i)
+H8_IN(pdr1i)
 {
-  unsigned i;
-
-  for (i = 0; i < 3; i++)
-  {
-    if (system->pdr3_in[i].device && system->pdr3_in[i].func)
-    {
-      byte->u &= ~(1 << i);
-      byte->u |= (system->pdr3_in[i].func(system->pdr3_in[i].device) & 0x01) << i;
-    }
-  }
+  h8_port_in(system, &system->pdr1, system->pdr1_in, 0, byte);
 }
 
-H8_OUT(pdr3o)
+H8_OUT(pdr1o)
 {
-  unsigned i;
+  h8_port_out(system, &system->pdr1, system->pdr1_out, 0, byte, value);
+}
 
-  for (i = 0; i < 3; i++)
-    if (system->pdr3_out[i].device && system->pdr3_out[i].func)
-      system->pdr3_out[i].func(system->pdr3_out[i].device, (value.u >> i) & 1);
+H8_IN(pdr3i)
+{
+  h8_port_in(system, &system->pdr3, system->pdr3_in, 0, byte);
+}
 
-  *byte = value;
+H8_OUT(pdr3o)
+{
+  h8_port_out(system, &system->pdr3, system->pdr3_out, 0, byte, value);
 }
 
 /**
@@ -334,52 +357,22 @@ H8_OUT(pdr3o)
 
 H8_IN(pdr8i)
 {
-  unsigned i;
-
-  for (i = 0; i < 3; i++)
-  {
-    if (system->pdr8_in[i].device && system->pdr8_in[i].func)
-    {
-      byte->u &= ~(1 << (i + 2));
-      byte->u |= (system->pdr8_in[i].func(system->pdr8_in[i].device) & 0x01) << (i + 2);
-    }
-  }
+  h8_port_in(system, &system->pdr8, system->pdr8_in, 2, byte);
 }
 
 H8_OUT(pdr8o)
 {
-  unsigned i;
-
-  for (i = 0; i < 3; i++)
-    if (system->pdr8_out[i].device && system->pdr8_out[i].func)
-      system->pdr8_out[i].func(system->pdr8_out[i].device, (value.u >> (i + 2)) & 1);
-
-  *byte = value;
+  h8_port_out(system, &system->pdr8, system->pdr8_out, 2, byte, value);
 }
 
 H8_IN(pdr9i)
 {
-  unsigned i;
-
-  for (i = 0; i < 4; i++)
-  {
-    if (system->pdr9_in[i].device && system->pdr9_in[i].func)
-    {
-      byte->u &= ~(1 << i);
-      byte->u |= (system->pdr9_in[i].func(system->pdr9_in[i].device) & 0x01) << i;
-    }
-  }
+  h8_port_in(system, &system->pdr9, system->pdr9_in, 0, byte);
 }
 
 H8_OUT(pdr9o)
 {
-  unsigned i;
-
-  for (i = 0; i < 4; i++)
-    if (system->pdr9_out[i].device && system->pdr9_out[i].func)
-      system->pdr9_out[i].func(system->pdr9_out[i].device, (value.u >> i) & 1);
-
-  *byte = value;
+  h8_port_out(system, &system->pdr9, system->pdr9_out, 0, byte, value);
 }
 
 /**
@@ -388,16 +381,7 @@ H8_OUT(pdr9o)
 
 H8_IN(pdrbi)
 {
-  unsigned i;
-
-  for (i = 0; i < 6; i++)
-  {
-    if (system->pdrb_in[i].device && system->pdrb_in[i].func)
-    {
-      byte->u &= ~(1 << i);
-      byte->u |= (system->pdrb_in[i].func(system->pdrb_in[i].device) & 1) << i;
-    }
-  }
+  h8_port_in(system, &system->pdrb, system->pdrb_in, 0, byte);
 }
 
 H8_OUT(pdrbo)
@@ -445,11 +429,17 @@ H8_OUT(sssro)
 
 H8_IN(ssrdri)
 {
-  unsigned i;
+  h8_device_t *device = system->ssu_device;
 
-  for (i = 0; i < system->device_count; i++)
-    if (system->devices[i].ssu_in)
-      system->devices[i].ssu_in(&system->devices[i], byte);
+  if (device && device->ssu_in)
+  {
+    H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+    device->ssu_in(device, byte);
+    H8_PROFILE_LEAVE(&system->profile);
+  }
+#if H8_SSU_BURSTS
+  system->ssu_burst = TRUE;
+#endif
 }
 
 H8_OUT(ssrdro)
@@ -466,24 +456,81 @@ H8_OUT(ssrdro)
 
 H8_OUT(sstdro)
 {
-  unsigned i;
+  h8_device_t *device = system->ssu_device;
 
-  for (i = 0; i < system->device_count; i++)
-    if (system->devices[i].ssu_out)
-      system->devices[i].ssu_out(&system->devices[i], byte, value);
+  if (device && device->ssu_out)
+  {
+    H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+    device->ssu_out(device, byte, value);
+    H8_PROFILE_LEAVE(&system->profile);
+  }
+#if H8_SSU_BURSTS
+  system->ssu_burst = TRUE;
+#endif
 }
 
+#if H8_SSU_BURSTS
 /**
- * 15.3.8 SS Shift Register (SSTRSR)
- * ????
+ * Sends a span of bytes through SSTDR, as if by that many writes to it.
  */
+static void h8_ssu_out_bulk(h8_system_t *system, const h8_byte_t *src,
+                            unsigned count)
+{
+  h8_device_t *device = system->ssu_device;
+  h8_byte_t *sstdr = &system->vmem.parts.io1.ssu.sstdr;
+  unsigned i = 0;
+
+  if (!device || !count)
+    return;
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+  if (device->ssu_out_bulk)
+    i = device->ssu_out_bulk(device, src, count);
+  if (i)
+    *sstdr = src[i - 1];
+  if (device->ssu_out)
+    for (; i < count; i++)
+      device->ssu_out(device, sstdr, src[i]);
+  H8_PROFILE_LEAVE(&system->profile);
+}
 
-H8_IN(adsri)
+/**
+ * Performs a number of full-duplex transfers, each sending the same byte
+ * through SSTDR and then reading SSRDR into a span.
+ */
+static void h8_ssu_in_bulk(h8_system_t *system, h8_byte_t value,
+                           h8_byte_t *dst, unsigned count)
 {
-  /** @todo A/DC simply assumes result is done when status is read */
-  system->vmem.parts.io2.adc.adsr.flags.adsf = 0;
-  *byte = system->vmem.parts.io2.adc.adsr.raw;
+  h8_device_t *device = system->ssu_device;
+  h8_byte_t *sstdr = &system->vmem.parts.io1.ssu.sstdr;
+  h8_byte_t *ssrdr = &system->vmem.parts.io1.ssu.ssrdr;
+  unsigned i = 0;
+
+  if (!count)
+    return;
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
+  if (device && device->ssu_in_bulk)
+    i = device->ssu_in_bulk(device, dst, count);
+  if (i)
+  {
+    *sstdr = value;
+    *ssrdr = dst[i - 1];
+  }
+  for (; i < count; i++)
+  {
+    if (device && device->ssu_out)
+      device->ssu_out(device, sstdr, value);
+    if (device && device->ssu_in)
+      device->ssu_in(device, ssrdr);
+    dst[i] = *ssrdr;
+  }
+  H8_PROFILE_LEAVE(&system->profile);
 }
+#endif
+
+/**
+ * 15.3.8 SS Shift Register (SSTRSR)
+ * ????
+ */
 
 static void h8_adc_read(h8_system_t *system)
 {
@@ -496,14 +543,27 @@ static void h8_adc_read(h8_system_t *system)
     h8_system_adc_t *adc = &system->adc[channel - H8_ADC_AN0];
     h8_word_t result;
 
+    /* Nothing attached reads as ground */
+    result.u = 0;
     if (adc->device && adc->func)
+    {
+      H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DEVICES);
       result = adc->func(adc->device);
+      H8_PROFILE_LEAVE(&system->profile);
+    }
 
     system->vmem.parts.io2.adc.adrr.raw.h = result.h;
     system->vmem.parts.io2.adc.adrr.raw.l = result.l;
   }
 }
 
+/**
+ * The length of an A/D conversion for each setting of AMR.CKS, in states.
+ * CKS selects phi/8, phi/4 or phi/2 as the conversion clock, and a conversion
+ * takes 15.5 of its cycles. The fourth setting is reserved and runs as phi/2.
+ */
+static const unsigned h8_adc_states[4] = { 124, 62, 31, 31 };
+
 H8_OUT(adrrho)
 {
   H8_IO_DUMMY_OUT
@@ -532,19 +592,52 @@ H8_OUT(amro)
   }
 }
 
+static void h8_schedule(h8_system_t *system);
+
 H8_OUT(adsro)
 {
-  h8_adsr_t adsr;
+  h8_adsr_t *adsr = (h8_adsr_t*)byte;
+  h8_adsr_t src;
 
-  adsr.raw = value;
-  if (adsr.flags.adsf)
+  src.raw = value;
+  adsr->flags.lads = src.flags.lads;
+  if (src.flags.adsf && !adsr->flags.adsf)
+  {
+    /* The result is latched when the conversion ends, see h8_adc_end */
+    unsigned states =
+      h8_adc_states[system->vmem.parts.io2.adc.amr.flags.cks];
+
+    system->adc_end = system->instructions +
+      ((h8_u64)states * H8_INSTRUCTIONS_PER_SECOND + H8_SYSTEM_CLOCK_HZ - 1) /
+      H8_SYSTEM_CLOCK_HZ;
+    adsr->flags.adsf = 1;
+  }
+  else if (!src.flags.adsf)
   {
-    /* Immediately complete A/DC operation upon start */
-    h8_adc_read(system);
-    adsr.flags.adsf = 0;
+    system->adc_end = H8_ADC_IDLE;
+    adsr->flags.adsf = 0;
   }
+  h8_schedule(system);
+}
+
+/**
+ * How long the SCI3 takes to shift out one character at its current mode and
+ * bit rate (SMR3 and BRR3), in emulated microseconds
+ */
+static h8_u64 h8_sci3_byte_us(const h8_system_t *system)
+{
+  unsigned smr = system->vmem.parts.io2.aec_sci3.smr3.u;
+  unsigned brr = system->vmem.parts.io2.aec_sci3.brr3.u;
+  h8_u64 bits, clocks;
+
+  /* Start bit, 7 or 8 data bits, optional parity, then 1 or 2 stop bits */
+  bits = 1 + (smr & B01000000 ? 7 : 8) + (smr & B00100000 ? 1 : 0) +
+         (smr & B00001000 ? 2 : 1);
 
-  *byte = adsr.raw;
+  /* B = phi / (64 * 2^(2n - 1) * (N + 1)), or 32 * 4^n clocks per bit */
+  clocks = (h8_u64)32 << ((smr & B00000011) * 2);
+
+  return bits * clocks * (brr + 1) * 1000000 / H8_SYSTEM_CLOCK_HZ;
 }
 
 H8_IN(ssr3i)
@@ -559,11 +652,23 @@ H8_IN(ssr3i)
   if (system->vmem.parts.io2.aec_sci3.scr3.flags.re && !ssr3->flags.rdrf)
   {
     if (system->vmem.parts.io2.aec_sci3.ircr.flags.enable)
+    {
+      if (system->ir.link)
+        h8_ir_link_poll(&system->ir, h8_system_time_us(system));
+      else if (system->ir.transport)
+        h8_ir_transport_poll(&system->ir);
       ssr3->flags.rdrf = h8_ir_in(&system->ir,
                                   &system->vmem.parts.io2.aec_sci3.rdr3);
+    }
     if (ssr3->flags.rdrf)
-      h8_log(H8_LOG_WARN, H8_LOG_IR, "IR receive: %02X",
-             system->vmem.parts.io2.aec_sci3.rdr3.u);
+    {
+      if (system->ir.capture)
+        h8_ir_capture_byte(system->ir.capture, H8_IR_CAPTURE_RX,
+                           system->vmem.parts.io2.aec_sci3.rdr3.u,
+                           system->instructions);
+      H8_LOGD(H8_LOG_IR, ("IR receive: %02X",
+                          system->vmem.parts.io2.aec_sci3.rdr3.u));
+    }
   }
 }
 
@@ -578,9 +683,15 @@ H8_OUT(ssr3o)
     if (!src.flags.tdre)
     {
       if (system->vmem.parts.io2.aec_sci3.ircr.flags.enable)
-        h8_ir_transmit(&system->ir);
+      {
+        /* Linked bytes are already on their way */
+        if (system->ir.transport)
+          h8_ir_transport_flush(&system->ir, system->instructions);
+        else if (!system->ir.link)
+          h8_ir_transmit(&system->ir);
+      }
       else
-        h8_log(H8_LOG_WARN, H8_LOG_CPU, "Unimplemented SCI3 transmit!");
+        H8_LOGW(H8_LOG_CPU, ("Unimplemented SCI3 transmit!"));
       src.flags.tdre = 1;
     }
   }
@@ -599,20 +710,153 @@ H8_OUT(tdr3o)
   {
     if (system->vmem.parts.io2.aec_sci3.ssr3.flags.tdre)
     {
-      if (system->vmem.parts.io2.aec_sci3.ircr.flags.enable)
-        h8_ir_out(&system->ir, value);
+      if (!system->vmem.parts.io2.aec_sci3.ircr.flags.enable)
+        H8_LOGW(H8_LOG_CPU, ("Unimplemented SCI3 transmit!"));
+      else if (system->ir.link)
+        h8_ir_link_send(&system->ir, value, h8_system_time_us(system),
+                        h8_sci3_byte_us(system));
       else
-        h8_log(H8_LOG_WARN, H8_LOG_CPU, "Unimplemented SCI3 transmit!");
-      h8_log(H8_LOG_WARN, H8_LOG_IR, "IR transmit: %02X", value.u);
+        h8_ir_out(&system->ir, value);
+      if (system->ir.capture &&
+          system->vmem.parts.io2.aec_sci3.ircr.flags.enable)
+        h8_ir_capture_byte(system->ir.capture, H8_IR_CAPTURE_TX, value.u,
+                           system->instructions);
+      H8_LOGD(H8_LOG_IR, ("IR transmit: %02X", value.u));
       system->vmem.parts.io2.aec_sci3.ssr3.flags.tdre = 0;
       system->vmem.parts.io2.aec_sci3.ssr3.flags.tend = 0;
     }
   }
   else
-    h8_log(H8_LOG_WARN, H8_LOG_CPU, "TDR written but transmit disabled!");
+    H8_LOGW(H8_LOG_CPU, ("TDR written but transmit disabled!"));
   *byte = value;
 }
 
+/** Sets when h8_step next needs to handle a timed event */
+static void h8_schedule(h8_system_t *system)
+{
+  system->event = system->rtc.next < system->wdt.deadline ?
+                  system->rtc.next : system->wdt.deadline;
+  if (system->tw.deadline < system->event)
+    system->event = system->tw.deadline;
+  if (system->adc_end < system->event)
+    system->event = system->adc_end;
+  if (h8_input_next(&system->input) < system->event)
+    system->event = h8_input_next(&system->input);
+}
+
+/** Restarts the watchdog count after its counter or clock changed */
+static void h8_wdt_changed(h8_system_t *system)
+{
+  h8_wdt_restart(&system->vmem.parts.io2.wdt, &system->wdt,
+                 system->instructions);
+  h8_schedule(system);
+}
+
+H8_OUT(tmwdo)
+{
+  h8_wdt_sync(&system->vmem.parts.io2.wdt, &system->wdt,
+              system->instructions);
+  byte->u = value.u | 0xF0;
+  h8_wdt_changed(system);
+}
+
+H8_OUT(tcsrwd1o)
+{
+  h8_tcsrwd1_t *dst = (h8_tcsrwd1_t*)byte;
+  h8_tcsrwd1_t src;
+
+  h8_wdt_sync(&system->vmem.parts.io2.wdt, &system->wdt,
+              system->instructions);
+  src.raw = value;
+  *dst = h8_wdt_write_tcsrwd1(*dst, src);
+  h8_wdt_changed(system);
+}
+
+H8_OUT(tcsrwd2o)
+{
+  h8_tcsrwd2_t *dst = (h8_tcsrwd2_t*)byte;
+  h8_tcsrwd2_t src;
+
+  src.raw = value;
+  *dst = h8_wdt_write_tcsrwd2(*dst, src);
+}
+
+H8_IN(tcwdi)
+{
+  h8_wdt_sync(&system->vmem.parts.io2.wdt, &system->wdt,
+              system->instructions);
+}
+
+H8_OUT(tcwdo)
+{
+  /* Writes are ignored unless enabled by TCWE */
+  if (system->vmem.parts.io2.wdt.tcsrwd1.flags.tcwe)
+  {
+    *byte = value;
+    h8_wdt_changed(system);
+  }
+}
+
+/** Restarts the Timer W count after its counter or controls changed */
+static void h8_tw_changed(h8_system_t *system)
+{
+  h8_tw_restart(&system->vmem.parts.io1.tw, &system->tw, system->instructions);
+  h8_schedule(system);
+}
+
+/** Writes a Timer W register, counting up to the write with the old value */
+static void h8_tw_write(h8_system_t *system, h8_byte_t *byte,
+                        const h8_u8 value)
+{
+  h8_tw_sync(&system->vmem.parts.io1.tw, &system->tw, system->instructions);
+  byte->u = value;
+  h8_tw_changed(system);
+}
+
+H8_OUT(tmrwo)
+{
+  h8_tw_write(system, byte, value.u | 0x48);
+}
+
+H8_OUT(tierwo)
+{
+  const h8_tw_t *tw = &system->vmem.parts.io1.tw;
+
+  h8_tw_write(system, byte, value.u | 0x70);
+  if (tw->tsrw.raw.u & tw->tierw.raw.u & H8_TSRW_FLAGS)
+    system->interrupt = TRUE;
+}
+
+H8_IN(tsrwi)
+{
+  if (h8_tw_update(&system->vmem.parts.io1.tw, &system->tw,
+                   system->instructions))
+    system->interrupt = TRUE;
+  h8_schedule(system);
+}
+
+H8_OUT(tsrwo)
+{
+  /* Flags can only be cleared */
+  h8_tw_write(system, byte, byte->u & (value.u | 0x70));
+}
+
+H8_OUT(tioro)
+{
+  h8_tw_write(system, byte, value.u | 0x88);
+}
+
+H8_IN(tcnti)
+{
+  h8_tw_sync(&system->vmem.parts.io1.tw, &system->tw, system->instructions);
+}
+
+/** TCRW, TCNT and GRA to GRD */
+H8_OUT(twro)
+{
+  h8_tw_write(system, byte, value.u);
+}
+
 static H8_IN_T reg_ins[0x160] =
 {
   /* IO region 1 (0xF020) */
@@ -656,7 +900,7 @@ static H8_IN_T reg_ins[0x160] =
   NULL, NULL, NULL, NULL, sssri, NULL, NULL, NULL,
   NULL, ssrdri, NULL, NULL, NULL, NULL, NULL, NULL,
   /* 0xF0F0 */
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, tsrwi, NULL, NULL, tcnti, tcnti,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 
   /* IO region 2 (0xFF80) */
@@ -670,8 +914,8 @@ static H8_IN_T reg_ins[0x160] =
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   /* 0xFFB0 */
+  NULL, NULL, NULL, tcwdi, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, adsri,
   /* 0xFFC0 */
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -729,8 +973,8 @@ static H8_OUT_T reg_outs[0x160] =
   NULL, NULL, NULL, NULL, sssro, NULL, NULL, NULL,
   NULL, ssrdro, NULL, sstdro, NULL, NULL, NULL, NULL,
   /* 0xF0F0 */
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  tmrwo, twro, tierwo, tsrwo, tioro, tioro, twro, twro,
+  twro, twro, twro, twro, twro, twro, twro, twro,
 
   /* IO region 2 (0xFF80) */
   /* 0xFF80 */
@@ -743,7 +987,7 @@ static H8_OUT_T reg_outs[0x160] =
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   /* 0xFFB0 */
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  tmwdo, tcsrwd1o, tcsrwd2o, tcwdo, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, adrrho, adrrlo, amro, adsro,
   /* 0xFFC0 */
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -805,7 +1049,7 @@ static H8_IN_T h8_register_in(h8_system_t *system, unsigned address)
   {
 #if H8_DEBUG_PRINT_REGISTERS
     if (!reg_ins[address - H8_MEMORY_REGION_IO1])
-      h8_log(H8_LOG_WARN, H8_LOG_CPU, "%04X input not implemented.", address);
+      H8_LOGW(H8_LOG_CPU, ("%04X input not implemented.", address));
 #endif
     return reg_ins[address - H8_MEMORY_REGION_IO1];
   }
@@ -814,7 +1058,7 @@ static H8_IN_T h8_register_in(h8_system_t *system, unsigned address)
   {
 #if H8_DEBUG_PRINT_REGISTERS
     if (!reg_ins[address - H8_MEMORY_REGION_IO2 + sizeof(system->vmem.parts.io1)])
-      h8_log(H8_LOG_WARN, H8_LOG_CPU, "%04X input not implemented.", address);
+      H8_LOGW(H8_LOG_CPU, ("%04X input not implemented.", address));
 #endif
     return reg_ins[address - H8_MEMORY_REGION_IO2 + sizeof(system->vmem.parts.io1)];
   }
@@ -854,8 +1098,12 @@ static H8_OUT_T h8_register_out(h8_system_t *system, unsigned address)
  */
 static h8_byte_t h8_byte_in(h8_system_t *system, unsigned address)
 {
-  H8_IN_T in = h8_register_in(system, address);
-  h8_byte_t *byte = h8_find(system, address);
+  H8_IN_T in;
+  h8_byte_t *byte;
+
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_MEMORY);
+  in = h8_register_in(system, address);
+  byte = h8_find(system, address);
 
   /** @todo Hack: keep sleep mode off */
   system->vmem.raw[0xF7B5].u = (system->vmem.raw[0xF7B5].u | 1) & ~(1 << 4);
@@ -864,7 +1112,12 @@ static h8_byte_t h8_byte_in(h8_system_t *system, unsigned address)
   /* system->vmem.raw[0xFB8C].u = 0x13; */
 
   if (in)
+  {
+    H8_PROFILE_ENTER(&system->profile, H8_PROFILE_IO);
     in(system, byte);
+    H8_PROFILE_LEAVE(&system->profile);
+  }
+  H8_PROFILE_LEAVE(&system->profile);
 
   return *byte;
 }
@@ -872,6 +1125,7 @@ static h8_byte_t h8_byte_in(h8_system_t *system, unsigned address)
 static void h8_byte_out(h8_system_t *system, const unsigned address,
                         const h8_byte_t value)
 {
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_MEMORY);
   if ((address >= H8_MEMORY_REGION_IO1 &&
         address < H8_MEMORY_REGION_IO1 + sizeof(system->vmem.parts.io1)) ||
       address >= H8_MEMORY_REGION_RAM_2K)
@@ -880,13 +1134,18 @@ static void h8_byte_out(h8_system_t *system, const unsigned address,
     h8_byte_t *byte = h8_find(system, address & 0xFFFF);
 
     if (out)
+    {
+      H8_PROFILE_ENTER(&system->profile, H8_PROFILE_IO);
       out(system, byte, value);
+      H8_PROFILE_LEAVE(&system->profile);
+    }
     else
       *byte = value;
   }
   else
-    h8_log(H8_LOG_WARN, H8_LOG_CPU,
-           "Write to invalid address 0x%04X -> 0x%02X", address, value.u);
+    H8_LOGW(H8_LOG_CPU, ("Write to invalid address 0x%04X -> 0x%02X",
+                         address, value.u));
+  H8_PROFILE_LEAVE(&system->profile);
 }
 
 static h8_byte_t h8_read_b(h8_system_t *system, const unsigned address)
@@ -1378,8 +1637,8 @@ void btst(h8_system_t *system, h8_byte_t *dst, unsigned src)
   if (src > B0111)
   {
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Bad BTST parameter - %02X at %04X",
-           src, system->cpu.pc - 2);
+    H8_LOGE(H8_LOG_CPU, ("Bad BTST parameter - %02X at %04X",
+                         src, system->cpu.pc - 2));
   }
 #endif
   system->cpu.ccr.flags.z = dst->u & (1 << (src & B00000111)) ? 0 : 1;
@@ -1391,8 +1650,8 @@ h8_byte_t bst(h8_system_t *system, h8_byte_t dst, const h8_byte_t src)
   if (src.u > B0111)
   {
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Bad BST parameter - %02X at %04X",
-           src.u, system->cpu.pc - 2);
+    H8_LOGE(H8_LOG_CPU, ("Bad BST parameter - %02X at %04X",
+                         src.u, system->cpu.pc - 2));
   }
 #endif
   dst.u &= ~(1 << src.u);
@@ -1406,8 +1665,8 @@ h8_byte_t bist(h8_system_t *system, h8_byte_t dst, const h8_byte_t src)
   if (src.u > B0111)
   {
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Bad BIST parameter - %02X at %04X",
-           src.u, system->cpu.pc - 2);
+    H8_LOGE(H8_LOG_CPU, ("Bad BIST parameter - %02X at %04X",
+                         src.u, system->cpu.pc - 2));
   }
 #endif
   dst.u &= ~(1 << src.u);
@@ -1421,8 +1680,8 @@ void bld(h8_system_t *system, h8_byte_t val, unsigned bit)
   if (bit > B0111)
   {
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Bad BLD parameter - %02X at %04X",
-           bit, system->cpu.pc - 2);
+    H8_LOGE(H8_LOG_CPU, ("Bad BLD parameter - %02X at %04X",
+                         bit, system->cpu.pc - 2));
   }
 #endif
   system->cpu.ccr.flags.c = val.u & (1 << (bit & B00000111)) ? 1 : 0;
@@ -1434,8 +1693,8 @@ void bild(h8_system_t *system, h8_byte_t val, unsigned bit)
   if (bit > B0111)
   {
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Bad BILD parameter - %02X at %04X",
-           bit, system->cpu.pc - 2);
+    H8_LOGE(H8_LOG_CPU, ("Bad BILD parameter - %02X at %04X",
+                         bit, system->cpu.pc - 2));
   }
 #endif
   system->cpu.ccr.flags.c = val.u & (1 << (bit & B00000111)) ? 0 : 1;
@@ -1488,185 +1747,325 @@ H8_OP(op00)
   (void)system;
 }
 
-/** @todo Nasty code */
-H8_OP(op01)
+/**
+ * A second-level handler for the 0x01 prefix, and the opcode byte expected at
+ * the start of the extension word for the handler to be valid.
+ */
+typedef struct
 {
-  switch (system->dbus.b.u)
-  {
-  case 0x00:
-    h8_fetch(system);
-    switch (system->dbus.a.u)
-    {
-    case 0x69:
-      if (system->dbus.bh & B1000)
-        /** MOV.L ERs, @ERd */
-        rs_md_l(system, *rd_l(system, system->dbus.bl), er(system, system->dbus.bh), mov_l);
-      else
-        /** MOV.L @ERs, ERd */
-        ms_rd_l(system, er(system, system->dbus.bh), rd_l(system, system->dbus.bl), mov_l);
-      break;
-    case 0x6B:
-    {
-      switch (system->dbus.bh)
-      {
-      case 0x0:
-      {
-        /** MOV.L @aa:16, ERd */
-        h8_u8 erd = system->dbus.bl;
-
-        h8_fetch(system);
-        ms_rd_l(system, aa16(system->dbus.bits), rd_l(system, erd), mov_l);
-        break;
-      }
-      case 0x2:
-        H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-        break;
-      case 0x8:
-      {
-        h8_u8 ers = system->dbus.bl;
-
-        h8_fetch(system);
-        if (!ers)
-          /** MOV.L ERs, @aa:16 */
-          rs_md_l(system, *rd_l(system, ers), system->dbus.bits.u, mov_l);
-        else
-        {
-          /** STC.W CCR, @aa:16 */
-          h8_word_t w;
-          w.u = system->cpu.ccr.raw.u;
-          h8_write_w(system, system->dbus.bits.u, w);
-        }
-        break;
-      }
-      case 0xA:
-        H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-        break;
-      default:
-        H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-      }
-      break;
-    }
-    case 0x6D:
-      if (system->dbus.bh & B1000)
-        /** MOV.L ERs, @-ERd */
-        rs_md_l(system, *rd_l(system, system->dbus.bl), erpd_l(system, system->dbus.bh), mov_l);
-      else
-        /** MOV.L @ERs+, ERd */
-        ms_rd_l(system, erpi_l(system, system->dbus.bh), rd_l(system, system->dbus.bl), mov_l);
-      break;
-    case 0x6F:
-    {
-      h8_byte_t sd = system->dbus.b;
+  h8_u8 a;
+  H8_OP_T func;
+} h8_op_ext_t;
 
-      h8_fetch(system);
-      if (sd.h & B1000)
-        /** MOV.L ERs, @(d:16, ERd) */
-        rs_md_l(system, *rd_l(system, sd.l), erd16(system, sd.h, system->dbus.bits.i), mov_l);
-      else
-        /** MOV.L @(d:16, ERs), ERd */
-        ms_rd_l(system, erd16(system, sd.h, system->dbus.bits.i), rd_l(system, sd.l), mov_l);
-      break;
-    }
-    case 0x78:
-      H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-    break;
-  case 0x40:
-    /** @todo STC.W / LDC.W stuff */
-    h8_fetch(system);
-    switch (system->dbus.a.u)
-    {
-    case 0x69:
-      if (system->dbus.bh & B1000)
-        /** STC.W CCR, @ERd */
-        h8_write_b(system, rd_w(system, system->dbus.bl)->u, system->cpu.ccr.raw);
-      else
-        /** LDC.W @ERs, CCR */
-        system->cpu.ccr.raw = h8_read_b(system, rd_w(system, system->dbus.bl)->u);
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-    }
-    break;
-  case 0x80:
-    /** SLEEP */
-    /** @todo make this actually do something */
-    system->sleep = TRUE;
-    break;
-  case 0xC0:
-    h8_fetch(system);
-    switch (system->dbus.a.u)
-    {
-    case 0x50:
-      /** MULXS.B Rs, Rd */
-      *rd_w(system, system->dbus.bl) = mulxs_b(system, *rd_w(system, system->dbus.bl), *rd_b(system, system->dbus.bh));
-      break;
-    case 0x52:
-      /** MULXS.W Rs, ERd */
-      *rd_l(system, system->dbus.bl) = mulxs_w(system, *rd_l(system, system->dbus.bl), *rd_w(system, system->dbus.bh));
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-    break;
-  case 0xD0:
-    h8_fetch(system);
-    switch (system->dbus.a.u)
-    {
-    case 0x51:
-      /** DIVXS.B Rs, Rd */
-      *rd_w(system, system->dbus.bl) = divxs_b(system, *rd_w(system, system->dbus.bl), *rd_b(system, system->dbus.bh));
-      break;
-    case 0x53:
-      /** DIVXS.W Rs, ERd */
-      *rd_l(system, system->dbus.bl) = divxs_w(system, *rd_l(system, system->dbus.bl), *rd_w(system, system->dbus.bh));
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-    break;
-  case 0xF0:
-    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+/** Dispatches to a second-level handler, or reports a malformed opcode */
+#define H8_DISPATCH(table, index) \
+{ \
+  H8_OP_T function = table[index]; \
+  if (function) \
+    function(system); \
+  else \
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE) \
 }
 
-H8_OP(op02)
+H8_OP(op0100_69)
 {
-  /** STC CCR, Rd */
-  *rd_b(system, system->dbus.bl) = system->cpu.ccr.raw;
+  if (system->dbus.bh & B1000)
+    /** MOV.L ERs, @ERd */
+    rs_md_l(system, *rd_l(system, system->dbus.bl), er(system, system->dbus.bh), mov_l);
+  else
+    /** MOV.L @ERs, ERd */
+    ms_rd_l(system, er(system, system->dbus.bh), rd_l(system, system->dbus.bl), mov_l);
 }
 
-H8_OP(op03)
+H8_OP(op0100_6b)
 {
-  /** LDC Rs, CCR */
-  system->cpu.ccr.raw = *rd_b(system, system->dbus.bl);
+  h8_u8 func = system->dbus.bh;
+  h8_u8 reg = system->dbus.bl;
+
+  if (func & ~B1010)
+  {
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+    return;
+  }
+  h8_fetch(system);
+  if (func & B0010)
+    /* @aa:24, @todo only works for non-extended mode */
+    h8_fetch(system);
+  if (func & B1000)
+    /** MOV.L ERs, @aa:16 / MOV.L ERs, @aa:24 */
+    rs_md_l(system, *rd_l(system, reg), aa16(system->dbus.bits), mov_l);
+  else
+    /** MOV.L @aa:16, ERd / MOV.L @aa:24, ERd */
+    ms_rd_l(system, aa16(system->dbus.bits), rd_l(system, reg), mov_l);
 }
 
-H8_OP(op04)
+H8_OP(op0100_6d)
 {
-  /** ORC #xx:8, CCR */
-  system->cpu.ccr.raw.u |= system->dbus.b.u;
+  if (system->dbus.bh & B1000)
+    /** MOV.L ERs, @-ERd */
+    rs_md_l(system, *rd_l(system, system->dbus.bl), erpd_l(system, system->dbus.bh), mov_l);
+  else
+    /** MOV.L @ERs+, ERd */
+    ms_rd_l(system, erpi_l(system, system->dbus.bh), rd_l(system, system->dbus.bl), mov_l);
 }
 
-H8_OP(op05)
+H8_OP(op0100_6f)
 {
-  /** XORC #xx:8, CCR */
-  system->cpu.ccr.raw.u ^= system->dbus.b.u;
+  h8_byte_t sd = system->dbus.b;
+
+  h8_fetch(system);
+  if (sd.h & B1000)
+    /** MOV.L ERs, @(d:16, ERd) */
+    rs_md_l(system, *rd_l(system, sd.l), erd16(system, sd.h, system->dbus.bits.i), mov_l);
+  else
+    /** MOV.L @(d:16, ERs), ERd */
+    ms_rd_l(system, erd16(system, sd.h, system->dbus.bits.i), rd_l(system, sd.l), mov_l);
 }
 
-H8_OP(op06)
+H8_OP(op0100_78)
 {
-  /** ANDC #xx:8, CCR */
-  system->cpu.ccr.raw.u &= system->dbus.b.u;
+  unsigned r1 = system->dbus.bh;
+  h8_long_t disp;
+
+  h8_fetch(system);
+  disp = h8_peek_l(system, system->cpu.pc);
+  system->cpu.pc += 4;
+  if (system->dbus.a.u != 0x6B)
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+  else if (system->dbus.bh == 0x2)
+    /** MOV.L @(d:24, ERs), ERd */
+    ms_rd_l(system, erd24(system, r1, disp.i), rd_l(system, system->dbus.bl), mov_l);
+  else if (system->dbus.bh == 0xA)
+    /** MOV.L ERs, @(d:24, ERd) */
+    rs_md_l(system, *rd_l(system, system->dbus.bl), erd24(system, r1, disp.i), mov_l);
+  else
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
 }
 
-H8_OP(op07)
+/** LDC.W / STC.W with a memory operand already resolved to an address */
+static void ldc_stc_w(h8_system_t *system, h8_aptr address, h8_bool store)
+{
+  if (store)
+  {
+    /** STC.W CCR, <EAd> */
+    h8_word_t w;
+
+    w.h = system->cpu.ccr.raw;
+    w.l.u = 0;
+    h8_write_w(system, address, w);
+  }
+  else
+    /** LDC.W <EAs>, CCR */
+    system->cpu.ccr.raw = h8_read_w(system, address).h;
+}
+
+H8_OP(op0140_69)
+{
+  /** LDC.W @ERs, CCR / STC.W CCR, @ERd */
+  h8_bool store = (system->dbus.bh & B1000) != 0;
+
+  ldc_stc_w(system, er(system, system->dbus.bh), store);
+}
+
+H8_OP(op0140_6b)
+{
+  /** LDC.W @aa:16, CCR / STC.W CCR, @aa:16 */
+  h8_u8 func = system->dbus.bh;
+
+  if (func & ~B1010 || system->dbus.bl)
+  {
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+    return;
+  }
+  h8_fetch(system);
+  if (func & B0010)
+    /* @aa:24, @todo only works for non-extended mode */
+    h8_fetch(system);
+  ldc_stc_w(system, system->dbus.bits.u, (func & B1000) != 0);
+}
+
+H8_OP(op0140_6d)
+{
+  if (system->dbus.bh & B1000)
+    /** STC.W CCR, @-ERd */
+    ldc_stc_w(system, erpd_w(system, system->dbus.bh), TRUE);
+  else
+    /** LDC.W @ERs+, CCR */
+    ldc_stc_w(system, erpi_w(system, system->dbus.bh), FALSE);
+}
+
+H8_OP(op0140_6f)
+{
+  /** LDC.W @(d:16, ERs), CCR / STC.W CCR, @(d:16, ERd) */
+  h8_u8 reg = system->dbus.bh;
+
+  h8_fetch(system);
+  ldc_stc_w(system, erd16(system, reg, system->dbus.bits.i), (reg & B1000) != 0);
+}
+
+H8_OP(op0140_78)
+{
+  unsigned reg = system->dbus.bh;
+  h8_long_t disp;
+
+  h8_fetch(system);
+  disp = h8_peek_l(system, system->cpu.pc);
+  system->cpu.pc += 4;
+  if (system->dbus.a.u != 0x6B || system->dbus.bl ||
+      (system->dbus.bh & ~B1000) != 0x2)
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+  else
+    /** LDC.W @(d:24, ERs), CCR / STC.W CCR, @(d:24, ERd) */
+    ldc_stc_w(system, erd24(system, reg, disp.i),
+              (system->dbus.bh & B1000) != 0);
+}
+
+H8_OP(op01c0_50)
+{
+  /** MULXS.B Rs, Rd */
+  *rd_w(system, system->dbus.bl) = mulxs_b(system, *rd_w(system, system->dbus.bl), *rd_b(system, system->dbus.bh));
+}
+
+H8_OP(op01c0_52)
+{
+  /** MULXS.W Rs, ERd */
+  *rd_l(system, system->dbus.bl) = mulxs_w(system, *rd_l(system, system->dbus.bl), *rd_w(system, system->dbus.bh));
+}
+
+H8_OP(op01d0_51)
+{
+  /** DIVXS.B Rs, Rd */
+  *rd_w(system, system->dbus.bl) = divxs_b(system, *rd_w(system, system->dbus.bl), *rd_b(system, system->dbus.bh));
+}
+
+H8_OP(op01d0_53)
+{
+  /** DIVXS.W Rs, ERd */
+  *rd_l(system, system->dbus.bl) = divxs_w(system, *rd_l(system, system->dbus.bl), *rd_w(system, system->dbus.bh));
+}
+
+H8_OP(op01f0_64)
+{
+  /** OR.L ERs, ERd */
+  rs_rd_l(system, *rd_l(system, system->dbus.bh), rd_l(system, system->dbus.bl), or_l);
+}
+
+H8_OP(op01f0_65)
+{
+  /** XOR.L ERs, ERd */
+  rs_rd_l(system, *rd_l(system, system->dbus.bh), rd_l(system, system->dbus.bl), xor_l);
+}
+
+H8_OP(op01f0_66)
+{
+  /** AND.L ERs, ERd */
+  rs_rd_l(system, *rd_l(system, system->dbus.bh), rd_l(system, system->dbus.bl), and_l);
+}
+
+/**
+ * Indexed by the high nibble of the byte following 0x01 and the low nibble of
+ * the first byte of the extension word.
+ */
+#define H8_OP_EXT_NONE { 0x00, NULL }
+#define H8_OP_EXT_NONE_ROW \
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, \
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, \
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, \
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE
+static const h8_op_ext_t op01_funcs[256] =
+{
+  /* 0100: MOV.L */
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  { 0x78, op0100_78 }, { 0x69, op0100_69 }, H8_OP_EXT_NONE, { 0x6B, op0100_6b },
+  H8_OP_EXT_NONE, { 0x6D, op0100_6d }, H8_OP_EXT_NONE, { 0x6F, op0100_6f },
+  H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW,
+
+  /* 0140: LDC.W / STC.W */
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  { 0x78, op0140_78 }, { 0x69, op0140_69 }, H8_OP_EXT_NONE, { 0x6B, op0140_6b },
+  H8_OP_EXT_NONE, { 0x6D, op0140_6d }, H8_OP_EXT_NONE, { 0x6F, op0140_6f },
+  H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW,
+  H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW, H8_OP_EXT_NONE_ROW,
+
+  /* 01C0: MULXS */
+  { 0x50, op01c0_50 }, H8_OP_EXT_NONE, { 0x52, op01c0_52 }, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+
+  /* 01D0: DIVXS */
+  H8_OP_EXT_NONE, { 0x51, op01d0_51 }, H8_OP_EXT_NONE, { 0x53, op01d0_53 },
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+
+  H8_OP_EXT_NONE_ROW,
+
+  /* 01F0: OR.L / XOR.L / AND.L */
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  { 0x64, op01f0_64 }, { 0x65, op01f0_65 }, { 0x66, op01f0_66 }, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE,
+  H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE, H8_OP_EXT_NONE
+};
+
+H8_OP(op01)
+{
+  h8_u8 prefix = system->dbus.b.u;
+  const h8_op_ext_t *ext;
+
+  if (prefix == 0x80)
+  {
+    /** SLEEP, see h8_step */
+    system->sleep = TRUE;
+    return;
+  }
+  else if (prefix & 0x0F)
+  {
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+    return;
+  }
+
+  h8_fetch(system);
+  ext = &op01_funcs[prefix | system->dbus.al];
+  if (ext->func && ext->a == system->dbus.a.u)
+    ext->func(system);
+  else
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+}
+
+H8_OP(op02)
+{
+  /** STC CCR, Rd */
+  *rd_b(system, system->dbus.bl) = system->cpu.ccr.raw;
+}
+
+H8_OP(op03)
+{
+  /** LDC Rs, CCR */
+  system->cpu.ccr.raw = *rd_b(system, system->dbus.bl);
+}
+
+H8_OP(op04)
+{
+  /** ORC #xx:8, CCR */
+  system->cpu.ccr.raw.u |= system->dbus.b.u;
+}
+
+H8_OP(op05)
+{
+  /** XORC #xx:8, CCR */
+  system->cpu.ccr.raw.u ^= system->dbus.b.u;
+}
+
+H8_OP(op06)
+{
+  /** ANDC #xx:8, CCR */
+  system->cpu.ccr.raw.u &= system->dbus.b.u;
+}
+
+H8_OP(op07)
 {
   /** LDC #xx:8, CCR */
   system->cpu.ccr.raw = system->dbus.b;
@@ -1701,48 +2100,72 @@ H8_OP(op0a)
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
 }
 
-H8_OP(op0b)
+H8_OP(op0b_0)
+{
+  /** @todo Verify ADDS.L #1, ERd */
+  adds_l(system, rd_l(system, system->dbus.bl), 1);
+}
+
+H8_OP(op0b_5)
+{
+  /** INC.W #1, Rd */
+  h8_word_t w;
+
+  w.u = 1;
+  rs_rd_w(system, w, rd_w(system, system->dbus.bl), add_w);
+}
+
+H8_OP(op0b_7)
 {
+  /** INC.L #1, ERd */
   h8_long_t l;
+
+  l.u = 1;
+  rs_rd_l(system, l, rd_l(system, system->dbus.bl), add_l);
+}
+
+H8_OP(op0b_8)
+{
+  /** @todo Verify ADDS.L #2, ERd */
+  adds_l(system, rd_l(system, system->dbus.bl), 2);
+}
+
+H8_OP(op0b_9)
+{
+  /** @todo Verify ADDS.L #4, ERd */
+  adds_l(system, rd_l(system, system->dbus.bl), 4);
+}
+
+H8_OP(op0b_d)
+{
+  /** INC.W #2, Rd */
   h8_word_t w;
 
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** @todo Verify ADDS.L #1, ERd */
-    adds_l(system, rd_l(system, system->dbus.bl), 1);
-    break;
-  case 0x5:
-    /** INC.W #1, Rd */
-    w.u = 1;
-    rs_rd_w(system, w, rd_w(system, system->dbus.bl), add_w);
-    break;
-  case 0x7:
-    /** INC.L #1, ERd */
-    l.u = 1;
-    rs_rd_l(system, l, rd_l(system, system->dbus.bl), add_l);
-    break;
-  case 0x8:
-    /** @todo Verify ADDS.L #2, ERd */
-    adds_l(system, rd_l(system, system->dbus.bl), 2);
-    break;
-  case 0x9:
-    /** @todo Verify ADDS.L #4, ERd */
-    adds_l(system, rd_l(system, system->dbus.bl), 4);
-    break;
-  case 0xD:
-    /** INC.W #2, Rd */
-    w.u = 2;
-    rs_rd_w(system, w, rd_w(system, system->dbus.bl), add_w);
-    break;
-  case 0xF:
-    /** INC.L #2, ERd */
-    l.u = 2;
-    rs_rd_l(system, l, rd_l(system, system->dbus.bl), add_l);
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  w.u = 2;
+  rs_rd_w(system, w, rd_w(system, system->dbus.bl), add_w);
+}
+
+H8_OP(op0b_f)
+{
+  /** INC.L #2, ERd */
+  h8_long_t l;
+
+  l.u = 2;
+  rs_rd_l(system, l, rd_l(system, system->dbus.bl), add_l);
+}
+
+/** ADDS / INC, indexed by the high nibble of the second byte */
+static const H8_OP_T op0b_funcs[16] =
+{
+  op0b_0, NULL, NULL, NULL,
+  NULL, op0b_5, NULL, op0b_7,
+  op0b_8, op0b_9, NULL, NULL,
+  NULL, op0b_d, NULL, op0b_f
+};
+
+H8_OP(op0b)
+{
+  H8_DISPATCH(op0b_funcs, system->dbus.bh)
 }
 
 H8_OP(op0c)
@@ -1775,203 +2198,296 @@ H8_OP(op0f)
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
 }
 
-H8_OP(op10)
+H8_OP(op10_0)
 {
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** SHLL.B Rd */
-    shll_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x1:
-    /** SHLL.W Rd */
-    shll_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x3:
-    /** SHLL.L ERd */
-    shll_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x8:
-    /** SHAL.B Rd */
-    shal_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x9:
-    /** SHAL.W Rd */
-    shal_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xB:
-    /** SHAL.L ERd */
-    shal_l(system, rd_l(system, system->dbus.bl));
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  /** SHLL.B Rd */
+  shll_b(system, rd_b(system, system->dbus.bl));
 }
 
-H8_OP(op11)
+H8_OP(op10_1)
 {
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** SHLR.B Rd */
-    shlr_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x1:
-    /** SHLR.W Rd */
-    shlr_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x3:
-    /** SHLR.L ERd */
-    shlr_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x8:
-    /** SHAR.B Rd */
-    shar_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x9:
-    /** SHAR.W Rd */
-    shar_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xB:
-    /** SHAR.L ERd */
-    shar_l(system, rd_l(system, system->dbus.bl));
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  /** SHLL.W Rd */
+  shll_w(system, rd_w(system, system->dbus.bl));
 }
 
-H8_OP(op12)
+H8_OP(op10_3)
 {
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** ROTXL.B Rd */
-    rotxl_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x1:
-    /** ROTXL.W Rd */
-    rotxl_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x3:
-    /** ROTXL.L ERd */
-    rotxl_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x8:
-    /** ROTL.B Rd */
-    rotl_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x9:
-    /** ROTL.W Rd */
-    rotl_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xB:
-    /** ROTL.L ERd */
-    rotl_l(system, rd_l(system, system->dbus.bl));
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  /** SHLL.L ERd */
+  shll_l(system, rd_l(system, system->dbus.bl));
 }
 
-H8_OP(op13)
+H8_OP(op10_8)
 {
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** ROTXR.B Rd */
-    rotxr_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x1:
-    /** ROTXR.W Rd */
-    rotxr_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x3:
-    /** ROTXR.L ERd */
-    rotxr_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x8:
-    /** ROTR.B Rd */
-    rotr_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x9:
-    /** ROTR.W Rd */
-    rotr_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xB:
-    /** ROTR.L ERd */
-    rotr_l(system, rd_l(system, system->dbus.bl));
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  /** SHAL.B Rd */
+  shal_b(system, rd_b(system, system->dbus.bl));
 }
 
-H8_OP(op14)
+H8_OP(op10_9)
 {
-  /** OR.B Rs, Rd */
-  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), or_b);
+  /** SHAL.W Rd */
+  shal_w(system, rd_w(system, system->dbus.bl));
 }
 
-H8_OP(op15)
+H8_OP(op10_b)
 {
-  /** XOR.B Rs, Rd */
-  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), xor_b);
+  /** SHAL.L ERd */
+  shal_l(system, rd_l(system, system->dbus.bl));
 }
 
-H8_OP(op16)
+/** SHLL / SHAL, indexed by the high nibble of the second byte */
+static const H8_OP_T op10_funcs[16] =
 {
-  /** AND.B Rs, Rd */
-  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), and_b);
+  op10_0, op10_1, NULL, op10_3,
+  NULL, NULL, NULL, NULL,
+  op10_8, op10_9, NULL, op10_b,
+  NULL, NULL, NULL, NULL
+};
+
+H8_OP(op10)
+{
+  H8_DISPATCH(op10_funcs, system->dbus.bh)
 }
 
-H8_OP(op17)
+H8_OP(op11_0)
 {
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** NOT.B Rd */
-    not_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x1:
-    /** NOT.W Rd */
-    not_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x3:
-    /** NOT.L ERd */
-    not_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x5:
-    /** EXTU.W Rd */
-    extu_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0x7:
-    /** EXTU.L ERd */
-    extu_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0x8:
-    /** NEG.B Rd */
-    neg_b(system, rd_b(system, system->dbus.bl));
-    break;
-  case 0x9:
-    /** NEG.W Rd */
-    neg_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xB:
-    /** NEG.L ERd */
-    neg_l(system, rd_l(system, system->dbus.bl));
-    break;
-  case 0xD:
-    /** EXTS.W Rd */
-    exts_w(system, rd_w(system, system->dbus.bl));
-    break;
-  case 0xF:
-    /** EXTS.L ERd */
-    exts_l(system, rd_l(system, system->dbus.bl));
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  /** SHLR.B Rd */
+  shlr_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op11_1)
+{
+  /** SHLR.W Rd */
+  shlr_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op11_3)
+{
+  /** SHLR.L ERd */
+  shlr_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op11_8)
+{
+  /** SHAR.B Rd */
+  shar_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op11_9)
+{
+  /** SHAR.W Rd */
+  shar_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op11_b)
+{
+  /** SHAR.L ERd */
+  shar_l(system, rd_l(system, system->dbus.bl));
+}
+
+/** SHLR / SHAR, indexed by the high nibble of the second byte */
+static const H8_OP_T op11_funcs[16] =
+{
+  op11_0, op11_1, NULL, op11_3,
+  NULL, NULL, NULL, NULL,
+  op11_8, op11_9, NULL, op11_b,
+  NULL, NULL, NULL, NULL
+};
+
+H8_OP(op11)
+{
+  H8_DISPATCH(op11_funcs, system->dbus.bh)
+}
+
+H8_OP(op12_0)
+{
+  /** ROTXL.B Rd */
+  rotxl_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op12_1)
+{
+  /** ROTXL.W Rd */
+  rotxl_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op12_3)
+{
+  /** ROTXL.L ERd */
+  rotxl_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op12_8)
+{
+  /** ROTL.B Rd */
+  rotl_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op12_9)
+{
+  /** ROTL.W Rd */
+  rotl_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op12_b)
+{
+  /** ROTL.L ERd */
+  rotl_l(system, rd_l(system, system->dbus.bl));
+}
+
+/** ROTXL / ROTL, indexed by the high nibble of the second byte */
+static const H8_OP_T op12_funcs[16] =
+{
+  op12_0, op12_1, NULL, op12_3,
+  NULL, NULL, NULL, NULL,
+  op12_8, op12_9, NULL, op12_b,
+  NULL, NULL, NULL, NULL
+};
+
+H8_OP(op12)
+{
+  H8_DISPATCH(op12_funcs, system->dbus.bh)
+}
+
+H8_OP(op13_0)
+{
+  /** ROTXR.B Rd */
+  rotxr_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op13_1)
+{
+  /** ROTXR.W Rd */
+  rotxr_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op13_3)
+{
+  /** ROTXR.L ERd */
+  rotxr_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op13_8)
+{
+  /** ROTR.B Rd */
+  rotr_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op13_9)
+{
+  /** ROTR.W Rd */
+  rotr_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op13_b)
+{
+  /** ROTR.L ERd */
+  rotr_l(system, rd_l(system, system->dbus.bl));
+}
+
+/** ROTXR / ROTR, indexed by the high nibble of the second byte */
+static const H8_OP_T op13_funcs[16] =
+{
+  op13_0, op13_1, NULL, op13_3,
+  NULL, NULL, NULL, NULL,
+  op13_8, op13_9, NULL, op13_b,
+  NULL, NULL, NULL, NULL
+};
+
+H8_OP(op13)
+{
+  H8_DISPATCH(op13_funcs, system->dbus.bh)
+}
+
+H8_OP(op14)
+{
+  /** OR.B Rs, Rd */
+  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), or_b);
+}
+
+H8_OP(op15)
+{
+  /** XOR.B Rs, Rd */
+  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), xor_b);
+}
+
+H8_OP(op16)
+{
+  /** AND.B Rs, Rd */
+  rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), and_b);
+}
+
+H8_OP(op17_0)
+{
+  /** NOT.B Rd */
+  not_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op17_1)
+{
+  /** NOT.W Rd */
+  not_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op17_3)
+{
+  /** NOT.L ERd */
+  not_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op17_5)
+{
+  /** EXTU.W Rd */
+  extu_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op17_7)
+{
+  /** EXTU.L ERd */
+  extu_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op17_8)
+{
+  /** NEG.B Rd */
+  neg_b(system, rd_b(system, system->dbus.bl));
+}
+
+H8_OP(op17_9)
+{
+  /** NEG.W Rd */
+  neg_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op17_b)
+{
+  /** NEG.L ERd */
+  neg_l(system, rd_l(system, system->dbus.bl));
+}
+
+H8_OP(op17_d)
+{
+  /** EXTS.W Rd */
+  exts_w(system, rd_w(system, system->dbus.bl));
+}
+
+H8_OP(op17_f)
+{
+  /** EXTS.L ERd */
+  exts_l(system, rd_l(system, system->dbus.bl));
+}
+
+/** NOT / EXTU / NEG / EXTS, indexed by the high nibble of the second byte */
+static const H8_OP_T op17_funcs[16] =
+{
+  op17_0, op17_1, NULL, op17_3,
+  NULL, op17_5, NULL, op17_7,
+  op17_8, op17_9, NULL, op17_b,
+  NULL, op17_d, NULL, op17_f
+};
+
+H8_OP(op17)
+{
+  H8_DISPATCH(op17_funcs, system->dbus.bh)
 }
 
 H8_OP(op18)
@@ -2003,48 +2519,72 @@ H8_OP(op1a)
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
 }
 
-H8_OP(op1b)
+H8_OP(op1b_0)
+{
+  /** SUBS.L #1, ERd */
+  subs_l(system, rd_l(system, system->dbus.bl), 1);
+}
+
+H8_OP(op1b_5)
+{
+  /** DEC.W #1, Rd */
+  h8_word_t w;
+
+  w.u = 1;
+  rs_rd_w(system, w, rd_w(system, system->dbus.bl), sub_w);
+}
+
+H8_OP(op1b_7)
 {
+  /** DEC.L #1, ERd */
   h8_long_t l;
+
+  l.u = 1;
+  rs_rd_l(system, l, rd_l(system, system->dbus.bl), sub_l);
+}
+
+H8_OP(op1b_8)
+{
+  /** SUBS.L #2, ERd */
+  subs_l(system, rd_l(system, system->dbus.bl), 2);
+}
+
+H8_OP(op1b_9)
+{
+  /** SUBS.L #4, ERd */
+  subs_l(system, rd_l(system, system->dbus.bl), 4);
+}
+
+H8_OP(op1b_d)
+{
+  /** DEC.W #2, Rd */
   h8_word_t w;
 
-  switch (system->dbus.bh)
-  {
-  case 0x0:
-    /** SUBS.L #1, ERd */
-    subs_l(system, rd_l(system, system->dbus.bl), 1);
-    break;
-  case 0x5:
-    /** DEC.W #1, Rd */
-    w.u = 1;
-    rs_rd_w(system, w, rd_w(system, system->dbus.bl), sub_w);
-    break;
-  case 0x7:
-    /** DEC.L #1, ERd */
-    l.u = 1;
-    rs_rd_l(system, l, rd_l(system, system->dbus.bl), sub_l);
-    break;
-  case 0x8:
-    /** SUBS.L #2, ERd */
-    subs_l(system, rd_l(system, system->dbus.bl), 2);
-    break;
-  case 0x9:
-    /** SUBS.L #4, ERd */
-    subs_l(system, rd_l(system, system->dbus.bl), 4);
-    break;
-  case 0xD:
-    /** DEC.W #2, Rd */
-    w.u = 2;
-    rs_rd_w(system, w, rd_w(system, system->dbus.bl), sub_w);
-    break;
-  case 0xF:
-    /** DEC.L #2, ERd */
-    l.u = 2;
-    rs_rd_l(system, l, rd_l(system, system->dbus.bl), sub_l);
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  w.u = 2;
+  rs_rd_w(system, w, rd_w(system, system->dbus.bl), sub_w);
+}
+
+H8_OP(op1b_f)
+{
+  /** DEC.L #2, ERd */
+  h8_long_t l;
+
+  l.u = 2;
+  rs_rd_l(system, l, rd_l(system, system->dbus.bl), sub_l);
+}
+
+/** SUBS / DEC, indexed by the high nibble of the second byte */
+static const H8_OP_T op1b_funcs[16] =
+{
+  op1b_0, NULL, NULL, NULL,
+  NULL, op1b_5, NULL, op1b_7,
+  op1b_8, op1b_9, NULL, NULL,
+  NULL, op1b_d, NULL, op1b_f
+};
+
+H8_OP(op1b)
+{
+  H8_DISPATCH(op1b_funcs, system->dbus.bh)
 }
 
 H8_OP(op1c)
@@ -2252,6 +2792,22 @@ H8_OP(op55)
   bsr(system, system->dbus.b.i);
 }
 
+H8_OP(op56)
+{
+  /** RTE */
+  if (system->dbus.b.u == 0x70)
+  {
+    unsigned sp = system->cpu.regs[7].er.u;
+
+    /* The CCR is stacked twice as a word; its second copy is ignored */
+    system->cpu.ccr.raw = h8_read_b(system, sp);
+    system->cpu.pc = h8_read_w(system, sp + 2).u;
+    system->cpu.regs[7].er.u += 4;
+  }
+  else
+    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+}
+
 H8_OP(op58)
 {
   h8_u8 condition = system->dbus.bh;
@@ -2341,7 +2897,6 @@ H8_OP(op58)
   }
 }
 
-
 H8_OP(op59)
 {
   /** JMP @ERs */
@@ -2439,10 +2994,15 @@ H8_OP(op66)
 
 H8_OP(op67)
 {
-  if (system->dbus.b.u & 0x80)
-    rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), bist);
+  h8_byte_t immediate;
+
+  immediate.u = system->dbus.bh & B0111;
+  if (system->dbus.bh & B1000)
+    /** BIST #xx:3, Rd */
+    rs_rd_b(system, immediate, rd_b(system, system->dbus.bl), bist);
   else
-    rs_rd_b(system, *rd_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), bst);
+    /** BST #xx:3, Rd */
+    rs_rd_b(system, immediate, rd_b(system, system->dbus.bl), bst);
 }
 
 H8_OP(op68)
@@ -2465,97 +3025,147 @@ H8_OP(op69)
     ms_rd_w(system, er(system, system->dbus.bh), rd_w(system, system->dbus.bl), mov_w);
 }
 
-H8_OP(op6a)
+H8_OP(op6a_0)
 {
-  h8_word_t func = system->dbus.bits;
+  /** MOV.B @aa:16, Rd */
+  h8_u8 reg = system->dbus.bl;
 
   h8_fetch(system);
-  switch (func.l.h)
-  {
-  case 0x0:
-    /** MOV.B @aa:16, Rd */
-    ms_rd_b(system, system->dbus.bits.u, rd_b(system, func.l.l), mov_b);
-    break;
-  case 0x2:
-    /** MOV.B @aa:24, Rd */
-    h8_fetch(system);
-    ms_rd_b(system, system->dbus.bits.u, rd_b(system, func.l.l), mov_b);
-    break;
-  case 0x4:
-    /** MOVFPE @aa:16, Rd */
-    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-    break;
-  case 0x8:
-    /** MOV.B Rs, @aa:16 */
-    rs_md_b(system, *rd_b(system, func.l.l), system->dbus.bits.u, mov_b);
-    break;
-  case 0xA:
-    /** MOV.B Rs, @aa:24 @todo only works for non-extended mode */
-    h8_fetch(system);
-    rs_md_b(system, *rd_b(system, func.l.l), system->dbus.bits.u, mov_b);
-    break;
-  case 0xC:
-    /** MOVFPE Rs, @aa:16 */
-    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  ms_rd_b(system, system->dbus.bits.u, rd_b(system, reg), mov_b);
 }
 
-H8_OP(op6b)
+H8_OP(op6a_2)
 {
-  h8_word_t func = system->dbus.bits;
+  /** MOV.B @aa:24, Rd */
+  h8_u8 reg = system->dbus.bl;
 
   h8_fetch(system);
-  switch (func.l.h)
-  {
-  case 0x0:
-    /** MOV.W @aa:16, Rd */
-    ms_rd_w(system, system->dbus.bits.u, rd_w(system, func.l.l), mov_w);
-    break;
-  case 0x2:
-    /** MOV.W @aa:24, Rd */
-    h8_fetch(system);
-    ms_rd_w(system, system->dbus.bits.u, rd_w(system, func.l.l), mov_w);
-    break;
-  case 0x8:
-    /** MOV.W Rs, @aa:16 */
-    rs_md_w(system, *rd_w(system, func.l.l), system->dbus.bits.u, mov_w);
-    break;
-  case 0xA:
-    /** MOV.W Rs, @aa:24 */
-    h8_fetch(system);
-    rs_md_w(system, *rd_w(system, func.l.l), system->dbus.bits.u, mov_w);
-    break;
-  default:
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
+  h8_fetch(system);
+  ms_rd_b(system, system->dbus.bits.u, rd_b(system, reg), mov_b);
 }
 
-H8_OP(op6c)
+H8_OP(op6a_4)
 {
-  if (system->dbus.bh & B1000)
-    /** MOV.B Rs, @-ERd */
-    rs_md_b(system, *rd_b(system, system->dbus.bl), erpd_b(system, system->dbus.bh), mov_b);
-  else
-    /** MOV.B @ERs+, Rd */
-    ms_rd_b(system, erpi_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), mov_b);
+  /** MOVFPE @aa:16, Rd */
+  h8_fetch(system);
+  H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
 }
 
-H8_OP(op6d)
+H8_OP(op6a_8)
 {
-  if (system->dbus.bh & B1000)
-    /** MOV.W Rs, @-ERd */
-    rs_md_w(system, *rd_w(system, system->dbus.bl), erpd_w(system, system->dbus.bh), mov_w);
-  else
-    /** MOV.W @ERs+, Rd */
-    ms_rd_w(system, erpi_w(system, system->dbus.bh), rd_w(system, system->dbus.bl), mov_w);
+  /** MOV.B Rs, @aa:16 */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  rs_md_b(system, *rd_b(system, reg), system->dbus.bits.u, mov_b);
 }
 
-H8_OP(op6e)
+H8_OP(op6a_a)
 {
-  h8_instruction_t func = system->dbus;
+  /** MOV.B Rs, @aa:24 @todo only works for non-extended mode */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  h8_fetch(system);
+  rs_md_b(system, *rd_b(system, reg), system->dbus.bits.u, mov_b);
+}
+
+H8_OP(op6a_c)
+{
+  /** MOVFPE Rs, @aa:16 */
+  h8_fetch(system);
+  H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
+}
+
+/** MOV.B with an absolute address, indexed by the high nibble of the second byte */
+static const H8_OP_T op6a_funcs[16] =
+{
+  op6a_0, NULL, op6a_2, NULL,
+  op6a_4, NULL, NULL, NULL,
+  op6a_8, NULL, op6a_a, NULL,
+  op6a_c, NULL, NULL, NULL
+};
+
+H8_OP(op6a)
+{
+  H8_DISPATCH(op6a_funcs, system->dbus.bh)
+}
+
+H8_OP(op6b_0)
+{
+  /** MOV.W @aa:16, Rd */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  ms_rd_w(system, system->dbus.bits.u, rd_w(system, reg), mov_w);
+}
+
+H8_OP(op6b_2)
+{
+  /** MOV.W @aa:24, Rd */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  h8_fetch(system);
+  ms_rd_w(system, system->dbus.bits.u, rd_w(system, reg), mov_w);
+}
+
+H8_OP(op6b_8)
+{
+  /** MOV.W Rs, @aa:16 */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  rs_md_w(system, *rd_w(system, reg), system->dbus.bits.u, mov_w);
+}
+
+H8_OP(op6b_a)
+{
+  /** MOV.W Rs, @aa:24 */
+  h8_u8 reg = system->dbus.bl;
+
+  h8_fetch(system);
+  h8_fetch(system);
+  rs_md_w(system, *rd_w(system, reg), system->dbus.bits.u, mov_w);
+}
+
+/** MOV.W with an absolute address, indexed by the high nibble of the second byte */
+static const H8_OP_T op6b_funcs[16] =
+{
+  op6b_0, NULL, op6b_2, NULL,
+  NULL, NULL, NULL, NULL,
+  op6b_8, NULL, op6b_a, NULL,
+  NULL, NULL, NULL, NULL
+};
+
+H8_OP(op6b)
+{
+  H8_DISPATCH(op6b_funcs, system->dbus.bh)
+}
+
+H8_OP(op6c)
+{
+  if (system->dbus.bh & B1000)
+    /** MOV.B Rs, @-ERd */
+    rs_md_b(system, *rd_b(system, system->dbus.bl), erpd_b(system, system->dbus.bh), mov_b);
+  else
+    /** MOV.B @ERs+, Rd */
+    ms_rd_b(system, erpi_b(system, system->dbus.bh), rd_b(system, system->dbus.bl), mov_b);
+}
+
+H8_OP(op6d)
+{
+  if (system->dbus.bh & B1000)
+    /** MOV.W Rs, @-ERd */
+    rs_md_w(system, *rd_w(system, system->dbus.bl), erpd_w(system, system->dbus.bh), mov_w);
+  else
+    /** MOV.W @ERs+, Rd */
+    ms_rd_w(system, erpi_w(system, system->dbus.bh), rd_w(system, system->dbus.bl), mov_w);
+}
+
+H8_OP(op6e)
+{
+  h8_instruction_t func = system->dbus;
 
   h8_fetch(system);
   if (func.bh & B1000)
@@ -2622,289 +3232,264 @@ H8_OP(op77)
     bld(system, *rd_b(system, system->dbus.bl), system->dbus.bh);
 }
 
+/**
+ * Handlers for instructions operating on a memory operand whose effective
+ * address was resolved by the first-level handler.
+ */
+#define H8_MEM_OP(a) static void a(h8_system_t *system, h8_aptr ea)
+typedef void (*H8_MEM_OP_T)(h8_system_t*, h8_aptr);
+
+H8_MEM_OP(mov_b_ld_m)
+{
+  /** MOV.B @(d:24, ERs), Rd */
+  ms_rd_b(system, ea, rd_b(system, system->dbus.bl), mov_b);
+}
+
+H8_MEM_OP(mov_b_st_m)
+{
+  /** MOV.B Rs, @(d:24, ERd) */
+  rs_md_b(system, *rd_b(system, system->dbus.bl), ea, mov_b);
+}
+
+H8_MEM_OP(mov_w_ld_m)
+{
+  /** MOV.W @(d:24, ERs), Rd */
+  ms_rd_w(system, ea, rd_w(system, system->dbus.bl), mov_w);
+}
+
+H8_MEM_OP(mov_w_st_m)
+{
+  /** MOV.W Rs, @(d:24, ERd) */
+  rs_md_w(system, *rd_w(system, system->dbus.bl), ea, mov_w);
+}
+
+/**
+ * MOV with 24-bit displacement, indexed by the low bit of the extension word's
+ * opcode (6A or 6B) and the high nibble of its second byte.
+ */
+static const H8_MEM_OP_T op78_funcs[32] =
+{
+  NULL, NULL, mov_b_ld_m, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, mov_b_st_m, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, mov_w_ld_m, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, mov_w_st_m, NULL, NULL, NULL, NULL, NULL
+};
+
 H8_OP(op78)
 {
-  h8_instruction_t curr = system->dbus;
+  unsigned r1 = system->dbus.bh;
+  H8_MEM_OP_T function;
   h8_long_t address;
-  unsigned r1, r2;
 
   h8_fetch(system);
   address = h8_peek_l(system, system->cpu.pc);
   system->cpu.pc += 4;
-  r1 = curr.bh;
-  r2 = system->dbus.bl;
-
-  switch (system->dbus.a.u)
-  {
-  case 0x6A:
-    if (system->dbus.bh == 0x2)
-      /** MOV.B @(d:24, ERs), Rd */
-      ms_rd_b(system, erd24(system, r1, address.i), rd_b(system, r2), mov_b);
-    else if (system->dbus.bh == 0xA)
-      /** MOV.B Rs, @(d:24, ERd) */
-      rs_md_b(system, *rd_b(system, r2), erd24(system, r1, address.i), mov_b);
-    else
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    break;
-  case 0x6B:
-    if (system->dbus.bh == 0x2)
-      /** MOV.W @(d:24, ERs), Rd */
-      ms_rd_w(system, erd24(system, r1, address.i), rd_w(system, r2), mov_w);
-    else if (system->dbus.bh == 0xA)
-      /** MOV.W Rs, @(d:24, ERd) */
-      rs_md_w(system, *rd_w(system, r2), erd24(system, r1, address.i), mov_w);
-    else
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    break;
-  default:
+
+  function = op78_funcs[((system->dbus.a.u & 1) << 4) | system->dbus.bh];
+  if ((system->dbus.a.u & 0xFE) == 0x6A && function)
+    function(system, erd24(system, r1, address.i));
+  else
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
 }
 
+/** The operations of MOV/ADD/CMP/SUB/OR/XOR/AND.W #xx:16, Rd */
+static h8_word_t (*const op79_funcs[16])(h8_system_t*, h8_word_t,
+                                         const h8_word_t) =
+{
+  mov_w, add_w, cmp_w, sub_w,
+  or_w, xor_w, and_w, NULL,
+  NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, NULL
+};
+
 H8_OP(op79)
 {
+  /** MOV/ADD/CMP/SUB/OR/XOR/AND.W #xx:16, Rd */
   h8_instruction_t curr = system->dbus;
 
   h8_fetch(system);
-  switch (curr.bh)
-  {
-  case 0:
-    /** MOV.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), mov_w);
-    break;
-  case 1:
-    /** ADD.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), add_w);
-    break;
-  case 2:
-    /** CMP.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), cmp_w);
-    break;
-  case 3:
-    /** SUB.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), sub_w);
-    break;
-  case 4:
-    /** OR.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), or_w);
-    break;
-  case 5:
-    /** XOR.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), xor_w);
-    break;
-  case 6:
-    /** AND.W #xx:16, Rd */
-    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), and_w);
-    break;
-  default:
+  if (op79_funcs[curr.bh])
+    rs_rd_w(system, system->dbus.bits, rd_w(system, curr.bl), op79_funcs[curr.bh]);
+  else
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
 }
 
+/** The operations of MOV/ADD/CMP/SUB/OR/XOR/AND.L #xx:32, ERd */
+static h8_long_t (*const op7a_funcs[16])(h8_system_t*, h8_long_t,
+                                         const h8_long_t) =
+{
+  mov_l, add_l, cmp_l, sub_l,
+  or_l, xor_l, and_l, NULL,
+  NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, NULL
+};
+
 H8_OP(op7a)
 {
+  /** MOV/ADD/CMP/SUB/OR/XOR/AND.L #xx:32, ERd */
   h8_long_t imm = h8_read_l(system, system->cpu.pc);
 
   system->cpu.pc += sizeof(h8_long_t);
-  switch (system->dbus.bh)
-  {
-  case 0:
-    /** MOV.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), mov_l);
-    break;
-  case 1:
-    /** ADD.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), add_l);
-    break;
-  case 2:
-    /** CMP.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), cmp_l);
-    break;
-  case 3:
-    /** SUB.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), sub_l);
-    break;
-  case 4:
-    /** OR.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), or_l);
-    break;
-  case 5:
-    /** XOR.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), xor_l);
-    break;
-  case 6:
-    /** AND.L #xx:32, ERd */
-    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), and_l);
-    break;
-  default:
+  if (op7a_funcs[system->dbus.bh])
+    rs_rd_l(system, imm, rd_l(system, system->dbus.bl), op7a_funcs[system->dbus.bh]);
+  else
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-  }
 }
 
-H8_OP(op7d)
+H8_MEM_OP(bset_r_m)
 {
-  h8_word_t func = system->dbus.bits;
+  /** BSET Rn, @ERd / BSET Rn, @aa:8 */
+  rs_md_b(system, *rd_b(system, system->dbus.bh), ea, bset);
+}
 
-  h8_fetch(system);
-  if (system->dbus.ah == 0x6)
-  {
-    switch (system->dbus.al)
-    {
-    case 0x0:
-      /** BSET Rs, @ERd */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), er(system, func.l.u), bset);
-      break;
-    case 0x1:
-      /** BNOT Rs, @ERd */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), er(system, func.l.u), bnot);
-      break;
-    case 0x2:
-      /** BCLR Rs, @ERd */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), er(system, func.l.u), bclr);
-      break;
-    case 0x7:
-    {
-      h8_byte_t immediate;
+H8_MEM_OP(bnot_r_m)
+{
+  /** BNOT Rn, @ERd / BNOT Rn, @aa:8 */
+  rs_md_b(system, *rd_b(system, system->dbus.bh), ea, bnot);
+}
 
-      immediate.u = system->dbus.bh;
-      if (system->dbus.bh & B1000)
-        /** BIST #xx:3, @ERd */
-        rs_md_b(system, immediate, er(system, func.l.u), bist);
-      else
-        /** BST #xx:3, @ERd */
-        rs_md_b(system, immediate, er(system, func.l.u), bst);
-      break;
-    }
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-  }
-  else if (system->dbus.ah == 0x7)
-  {
-    h8_byte_t immediate;
+H8_MEM_OP(bclr_r_m)
+{
+  /** BCLR Rn, @ERd / BCLR Rn, @aa:8 */
+  rs_md_b(system, *rd_b(system, system->dbus.bh), ea, bclr);
+}
 
-    immediate.u = system->dbus.bh;
-    switch (system->dbus.al)
-    {
-    case 0x0:
-      /** BSET #xx:3, @ERd */
-      rs_md_b(system, immediate, er(system, func.l.h), bset);
-      break;
-    case 0x1:
-      /** BNOT #xx:3, @ERd */
-      rs_md_b(system, immediate, er(system, func.l.h), bnot);
-      break;
-    case 0x2:
-      /** BCLR #xx:3, @ERd */
-      rs_md_b(system, immediate, er(system, func.l.h), bclr);
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-  }
+H8_MEM_OP(btst_r_m)
+{
+  /** BTST Rn, @ERd / BTST Rn, @aa:8 */
+  h8_byte_t byte = h8_read_b(system, ea);
+
+  btst(system, &byte, rd_b(system, system->dbus.bh)->u);
+}
+
+H8_MEM_OP(bst_m)
+{
+  h8_byte_t immediate;
+
+  immediate.u = system->dbus.bh & B0111;
+  if (system->dbus.bh & B1000)
+    /** BIST #xx:3, @ERd / BIST #xx:3, @aa:8 */
+    rs_md_b(system, immediate, ea, bist);
   else
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+    /** BST #xx:3, @ERd / BST #xx:3, @aa:8 */
+    rs_md_b(system, immediate, ea, bst);
 }
 
-H8_OP(op7e)
+H8_MEM_OP(bset_m)
 {
-  h8_word_t func = system->dbus.bits;
+  /** BSET #xx:3, @ERd / BSET #xx:3, @aa:8 */
+  h8_byte_t immediate;
 
-  h8_fetch(system);
-  if (system->dbus.ah == 0x6 && system->dbus.al == 0x3)
-    /** BTST? */
-    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-  else if (system->dbus.ah == 0x7)
-  {
-    switch (system->dbus.al)
-    {
-    case 0x3:
-    case 0x4:
-    case 0x5:
-    case 0x6:
-      H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
-      break;
-    case 0x7:
-      if (system->dbus.bh & B1000)
-        /** BILD #xx:3, @aa:8 */
-        bild(system, h8_read_b(system, 0xFF00 | func.l.u), system->dbus.bh);
-      else
-        /** BLD #xx:3, @aa:8 */
-        bld(system, h8_read_b(system, 0xFF00 | func.l.u), system->dbus.bh);
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-  }
+  immediate.u = system->dbus.bh;
+  rs_md_b(system, immediate, ea, bset);
+}
+
+H8_MEM_OP(bnot_m)
+{
+  /** BNOT #xx:3, @ERd / BNOT #xx:3, @aa:8 */
+  h8_byte_t immediate;
+
+  immediate.u = system->dbus.bh;
+  rs_md_b(system, immediate, ea, bnot);
+}
+
+H8_MEM_OP(bclr_m)
+{
+  /** BCLR #xx:3, @ERd / BCLR #xx:3, @aa:8 */
+  h8_byte_t immediate;
+
+  immediate.u = system->dbus.bh;
+  rs_md_b(system, immediate, ea, bclr);
+}
+
+H8_MEM_OP(btst_m)
+{
+  /** BTST #xx:3, @ERd / BTST #xx:3, @aa:8 */
+  h8_byte_t byte = h8_read_b(system, ea);
+
+  btst(system, &byte, system->dbus.bh);
+}
+
+H8_MEM_OP(bld_m)
+{
+  if (system->dbus.bh & B1000)
+    /** BILD #xx:3, @ERd / BILD #xx:3, @aa:8 */
+    bild(system, h8_read_b(system, ea), system->dbus.bh & B0111);
   else
-    H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
+    /** BLD #xx:3, @ERd / BLD #xx:3, @aa:8 */
+    bld(system, h8_read_b(system, ea), system->dbus.bh);
 }
 
-H8_OP(op7f)
+H8_MEM_OP(bit_unimplemented_m)
 {
-  h8_word_t func = system->dbus.bits;
+  /** @todo BOR, BXOR, BAND and their inverted forms */
+  H8_UNUSED(ea);
+  H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
+}
 
-  h8_fetch(system);
-  if (system->dbus.ah == 0x6)
-  {
-    switch (system->dbus.al)
-    {
-    case 0x0:
-      /** BSET Rs, @aa:8 */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), aa8(func.l), bset);
-      break;
-    case 0x1:
-      /** BNOT Rs, @aa:8 */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), aa8(func.l), bnot);
-      break;
-    case 0x2:
-      /** BCLR Rs, @aa:8 */
-      rs_md_b(system, *rd_b(system, system->dbus.bh), aa8(func.l), bclr);
-      break;
-    case 0x7:
-    {
-      h8_byte_t immediate;
+/**
+ * Bit manipulation on memory that only reads its operand (7C / 7E prefixes),
+ * indexed by the low bit of the high nibble and the low nibble of the
+ * extension word's opcode.
+ */
+static const H8_MEM_OP_T op7c_funcs[32] =
+{
+  NULL, NULL, NULL, btst_r_m, NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, btst_m, bit_unimplemented_m, bit_unimplemented_m,
+  bit_unimplemented_m, bld_m,
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
 
-      immediate.u = system->dbus.bh;
-      if (system->dbus.bh & B1000)
-        /** BIST #xx:3, @aa:8 */
-        rs_md_b(system, immediate, aa8(func.l), bist);
-      else
-        /** BST #xx:3, @aa:8 */
-        rs_md_b(system, immediate, aa8(func.l), bst);
-      break;
-    }
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-  }
-  else if (system->dbus.ah == 0x7)
-  {
-    h8_byte_t immediate;
+/**
+ * Bit manipulation on memory that writes its operand (7D / 7F prefixes),
+ * indexed the same way as above.
+ */
+static const H8_MEM_OP_T op7d_funcs[32] =
+{
+  bset_r_m, bnot_r_m, bclr_r_m, NULL, NULL, NULL, NULL, bst_m,
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  bset_m, bnot_m, bclr_m, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
 
-    immediate.u = system->dbus.bh;
-    switch (system->dbus.al)
-    {
-    case 0x0:
-      /** BSET #xx:3, @aa:8 */
-      rs_md_b(system, immediate, aa8(func.l), bset);
-      break;
-    case 0x1:
-      /** BNOT #xx:3, @aa:8 */
-      rs_md_b(system, immediate, aa8(func.l), bnot);
-      break;
-    case 0x2:
-      /** BCLR #xx:3, @aa:8 */
-      rs_md_b(system, immediate, aa8(func.l), bclr);
-      break;
-    default:
-      H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
-    }
-  }
+/**
+ * Fetches the extension word of a 7C-7F bit manipulation instruction and runs
+ * its handler on the already resolved address.
+ */
+static void h8_bit_m(h8_system_t *system, const H8_MEM_OP_T *funcs,
+                     h8_aptr ea)
+{
+  H8_MEM_OP_T function;
+
+  h8_fetch(system);
+  function = funcs[((system->dbus.ah & 1) << 4) | system->dbus.al];
+  if ((system->dbus.ah & 0xE) == 0x6 && function)
+    function(system, ea);
   else
     H8_ERROR(H8_DEBUG_MALFORMED_OPCODE)
 }
 
+H8_OP(op7c)
+{
+  h8_bit_m(system, op7c_funcs, er(system, system->dbus.bh));
+}
+
+H8_OP(op7d)
+{
+  h8_bit_m(system, op7d_funcs, er(system, system->dbus.bh));
+}
+
+H8_OP(op7e)
+{
+  h8_bit_m(system, op7c_funcs, aa8(system->dbus.b));
+}
+
+H8_OP(op7f)
+{
+  h8_bit_m(system, op7d_funcs, aa8(system->dbus.b));
+}
+
 #define OP8X(al, reg) \
 void op8##al(h8_system_t *system) \
 { \
@@ -2977,14 +3562,14 @@ void h8_init(h8_system_t *system)
   system->vmem.parts.io1.ssu.sscrh.flags.solp = 1;
   system->vmem.parts.io1.ssu.sssr.flags.tdre = 1;
 
-  system->vmem.parts.io1.tw.gra.h.u = 0xFF;
-  system->vmem.parts.io1.tw.gra.l.u = 0xFF;
-  system->vmem.parts.io1.tw.grb.h.u = 0xFF;
-  system->vmem.parts.io1.tw.grb.l.u = 0xFF;
-  system->vmem.parts.io1.tw.grc.h.u = 0xFF;
-  system->vmem.parts.io1.tw.grc.l.u = 0xFF;
-  system->vmem.parts.io1.tw.grd.h.u = 0xFF;
-  system->vmem.parts.io1.tw.grd.l.u = 0xFF;
+  system->vmem.parts.io1.tw.tmrw.raw.u = 0x48;
+  system->vmem.parts.io1.tw.tierw.flags.reserved = B0111;
+  system->vmem.parts.io1.tw.tsrw.flags.reserved = B0111;
+  system->vmem.parts.io1.tw.tior0.raw.u = 0x88;
+  system->vmem.parts.io1.tw.tior1.raw.u = 0x88;
+  memset(system->vmem.parts.io1.tw.gr, 0xFF,
+         sizeof(system->vmem.parts.io1.tw.gr));
+  h8_tw_changed(system);
 
   system->vmem.parts.io2.aec_sci3.scr3.raw.u = B11000000;
   system->vmem.parts.io2.aec_sci3.brr3.u = 0xFF;
@@ -2997,8 +3582,12 @@ void h8_init(h8_system_t *system)
   system->vmem.parts.io2.wdt.tcsrwd1.flags.b2wi = 1;
   system->vmem.parts.io2.wdt.tcsrwd1.flags.b4wi = 1;
   system->vmem.parts.io2.wdt.tcsrwd1.flags.b6wi = 1;
+  system->vmem.parts.io2.wdt.tcsrwd2.raw.u = 0x5F;
+  h8_wdt_changed(system);
 
   system->vmem.parts.io2.adc.adsr.flags.reserved = B00111111;
+  system->adc_end = H8_ADC_IDLE;
+  h8_schedule(system);
 
   /* Jump to program entrypoint */
   system->cpu.pc = h8_read_w(system, 0).u;
@@ -3016,12 +3605,12 @@ static H8_OP_T funcs[256] =
   op38, op39, op3a, op3b, op3c, op3d, op3e, op3f,
   op40, op41, op42, op43, op44, op45, op46, op47,
   op48, op49, op4a, op4b, op4c, op4d, op4e, op4f,
-  op50, op51, op52, op53, op54, op55, NULL, NULL,
+  op50, op51, op52, op53, op54, op55, op56, NULL,
   op58, op59, op5a, op5b, op5c, op5d, op5e, NULL,
   op60, op61, op62, op63, op64, op65, op66, op67,
   op68, op69, op6a, op6b, op6c, op6d, op6e, op6f,
   op70, op71, op72, op73, NULL, NULL, NULL, op77,
-  op78, op79, op7a, NULL, NULL, op7d, op7e, op7f,
+  op78, op79, op7a, NULL, op7c, op7d, op7e, op7f,
   op80, op81, op82, op83, op84, op85, op86, op87,
   op88, op89, op8a, op8b, op8c, op8d, op8e, op8f,
   op90, op91, op92, op93, op94, op95, op96, op97,
@@ -3040,190 +3629,1978 @@ static H8_OP_T funcs[256] =
   opf8, opf9, opfa, opfb, opfc, opfd, opfe, opff
 };
 
-void h8_step(h8_system_t *system)
+#if H8_SSU_BURSTS
+/**
+ * Called after the instruction at `pc` made an SSU transfer. If it belongs to
+ * one of these loops, runs as many of the loop's remaining iterations at once
+ * as fit before the next timed event:
+ *
+ *   loop: mov.b @ERs+, Rd          loop: mov.b Rx, @SSTDR:16
+ *         mov.b Rd, @SSTDR:16            mov.b @SSRDR:16, Rd
+ *         dec.w #1, Rn                   mov.b Rd, @ERt
+ *         bne loop                       adds #1, ERt
+ *                                        dec.w #1, Rn
+ *                                        bne loop
+ *
+ * A burst cut short by an event stops at the same SSU transfer it started
+ * from, so that the event is handled at the instruction count it would be
+ * when stepping. Loops using overlapping registers or buffers outside of ROM
+ * and RAM, and loops an interrupt is waiting to preempt, are left to run
+ * normally.
+ */
+static void h8_ssu_burst(h8_system_t *system, unsigned pc)
 {
-  H8_OP_T function;
+  const h8_byte_t *code = &system->vmem.raw[pc];
+  h8_word_t *counter, one;
+  h8_byte_t *rd, last;
+  unsigned d, n, s, x, k, j;
+  h8_u64 left;
+  h8_aptr address;
 
-  if (system->error_code)
+  /* Both loops lie in ROM, which also bounds the bytes read around pc */
+  if (pc < 4 || pc + 12 > H8_MEMORY_REGION_IO1)
+    return;
+  else if ((system->interrupt && !system->cpu.ccr.flags.i) ||
+           system->event <= system->instructions + 1)
     return;
 
-  /** @todo While unusual, executing out of RAM is not illegal */
-  if (system->cpu.pc > 0xFFFF || system->cpu.pc & 1 ||
-      system->cpu.pc > 0xF020 || system->cpu.pc < 0x0050)
-    H8_ERROR(H8_DEBUG_BAD_PC)
-
-  h8_fetch(system);
-
-  function = funcs[system->dbus.a.u];
-
-  if (function)
-    function(system);
-  else
+  /* The instructions that can run before h8_step counts this one */
+  left = system->event - system->instructions - 1;
+  one.u = 1;
+  if (code[0].u != 0x6A || code[2].u != 0xF0)
+    return;
+  else if (code[1].u & 0x80 && code[3].u == 0xEB)
   {
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "Undefined opcode - %02X%02X at %04X",
-           system->dbus.a.u, system->dbus.b.u, system->cpu.pc - 2);
-    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
+    /* Write loop, stopped after its store to SSTDR */
+    d = code[1].u & 0x0F;
+    s = code[-1].u >> 4;
+    n = code[5].u & 0x0F;
+    if (code[-2].u != 0x6C || (code[-1].u & 0x0F) != d || s > 7 ||
+        code[4].u != 0x1B || (code[5].u & 0xF0) != 0x50 ||
+        code[6].u != 0x46 || code[7].u != 0xF6 ||
+        (d & 7) == s || (n & 7) == s || (n < 8 && (d & 7) == n))
+      return;
+
+    counter = rd_w(system, n);
+    k = (counter->u - 1) & 0xFFFF;
+    address = er(system, s);
+    if (!k || !(address + k <= H8_MEMORY_REGION_IO1 ||
+                (address >= H8_MEMORY_REGION_RAM_2K &&
+                 address + k <= H8_MEMORY_REGION_IO2)))
+      return;
+
+    /* Either finish the loop, or stop after a later store to SSTDR */
+    j = left >= 2 + 4 * (h8_u64)k ? k + 1 : (unsigned)(left / 4);
+    if (!j)
+      return;
+    rd = rd_b(system, d);
+    h8_ssu_out_bulk(system, &system->vmem.raw[address], j > k ? k : j);
+    counter->u = (h8_u16)(counter->u - (j - 1));
+    rs_rd_w(system, one, counter, sub_w);
+    if (j > k)
+    {
+      *rd = system->vmem.raw[address + k - 1];
+      rd_l(system, s)->u += k;
+      system->cpu.pc = pc + 8;
+      system->instructions += 2 + 4 * k;
+    }
+    else
+    {
+      rs_rd_b(system, system->vmem.raw[address + j - 1], rd, mov_b);
+      rd_l(system, s)->u += j;
+      system->instructions += 4 * j;
+    }
+  }
+  else if (code[1].u < 0x10 && code[3].u == 0xE9)
+  {
+    /* Read loop, stopped after its load from SSRDR */
+    d = code[1].u;
+    x = code[-3].u & 0x0F;
+    s = (code[5].u >> 4) & 7;
+    n = code[9].u & 0x0F;
+    if (code[-4].u != 0x6A || (code[-3].u & 0xF0) != 0x80 ||
+        code[-2].u != 0xF0 || code[-1].u != 0xEB ||
+        code[4].u != 0x68 || code[5].u != (0x80 | s << 4 | d) ||
+        code[6].u != 0x0B || code[7].u != s ||
+        code[8].u != 0x1B || (code[9].u & 0xF0) != 0x50 ||
+        code[10].u != 0x46 || code[11].u != 0xF0 ||
+        x == d || (x & 7) == s || (d & 7) == s || (n & 7) == s ||
+        (n < 8 && ((x & 7) == n || (d & 7) == n)))
+      return;
+
+    counter = rd_w(system, n);
+    k = (counter->u - 1) & 0xFFFF;
+    address = er(system, s);
+    if (!k || address < H8_MEMORY_REGION_RAM_2K ||
+        address + 1 + k > H8_MEMORY_REGION_IO2)
+      return;
+
+    /* Either finish the loop, or stop after a later load from SSRDR */
+    j = left >= 4 + 6 * (h8_u64)k ? k + 1 : (unsigned)(left / 6);
+    if (!j)
+      return;
+    rd = rd_b(system, d);
+    system->vmem.raw[address] = *rd;
+    counter->u = (h8_u16)(counter->u - (j - 1));
+    rs_rd_w(system, one, counter, sub_w);
+    if (j > k)
+    {
+      h8_ssu_in_bulk(system, *rd_b(system, x), &system->vmem.raw[address + 1],
+                     k);
+      *rd = system->vmem.raw[address + k];
+      rd_l(system, s)->u += 1 + k;
+      system->cpu.pc = pc + 12;
+      system->instructions += 4 + 6 * k;
+    }
+    else
+    {
+      /* The last byte read is left in Rd, not yet stored */
+      last = system->vmem.raw[address + j];
+      h8_ssu_in_bulk(system, *rd_b(system, x), &system->vmem.raw[address + 1],
+                     j);
+      rs_rd_b(system, system->vmem.raw[address + j], rd, mov_b);
+      system->vmem.raw[address + j] = last;
+      rd_l(system, s)->u += j;
+      system->instructions += 6 * j;
+    }
+  }
+}
+#endif
+
+/**
+ * Takes an interrupt: stacks the PC and CCR, masks further interrupts and
+ * jumps to the vector. Also wakes the CPU from SLEEP.
+ */
+static void h8_exception(h8_system_t *system, h8_vector vector)
+{
+  h8_word_t pc;
+  unsigned sp;
+
+  system->cpu.regs[7].er.u -= 4;
+  sp = system->cpu.regs[7].er.u;
+  pc.u = (h8_u16)system->cpu.pc;
+  h8_write_b(system, sp, system->cpu.ccr.raw);
+  h8_write_b(system, sp + 1, system->cpu.ccr.raw);
+  h8_write_w(system, sp + 2, pc);
+  system->cpu.ccr.flags.i = 1;
+  system->cpu.pc = h8_read_w(system, vector * 2).u;
+  system->sleep = FALSE;
+}
+
+/** @return The RTC events that are both flagged and enabled */
+static h8_u8 h8_rtc_requests(const h8_system_t *system)
+{
+  const h8_rtc_t *rtc = &system->vmem.parts.io1.rtc;
+
+  if (!(system->vmem.raw[H8_REG_IENR1].u & H8_IENR1_IENRTC))
+    return 0;
+
+  return rtc->rtcflg.raw.u & rtc->rtccr2.raw.u;
+}
+
+/**
+ * Accepts the highest priority interrupt being requested, if any. Called only
+ * while interrupts are unmasked.
+ */
+static void h8_interrupt(h8_system_t *system)
+{
+  const h8_tcsrwd2_t *tcsrwd2 = &system->vmem.parts.io2.wdt.tcsrwd2;
+  const h8_tw_t *tw = &system->vmem.parts.io1.tw;
+  h8_u8 events = h8_rtc_requests(system);
+  unsigned vector = H8_VECTOR_RTC_QUARTER_SECOND;
+
+  if (events)
+  {
+    /* Lower vectors take priority */
+    while (!(events & 1))
+    {
+      events >>= 1;
+      vector++;
+    }
+    h8_exception(system, (h8_vector)vector);
+  }
+  else if (tcsrwd2->flags.ovf && tcsrwd2->flags.ieovf)
+    h8_exception(system, H8_VECTOR_WATCHDOG_TIMER);
+  else if (tw->tsrw.raw.u & tw->tierw.raw.u & H8_TSRW_FLAGS)
+    h8_exception(system, H8_VECTOR_TIMER_W);
+  else if (system->vmem.raw[H8_REG_IRR2].u &
+           system->vmem.raw[H8_REG_IENR2].u & H8_IRR2_IRRAD)
+    h8_exception(system, H8_VECTOR_AD_CONVERSION_END);
+  else
+    system->interrupt = FALSE;
+}
+
+/** Advances the RTC through every quarter second that has elapsed */
+static void h8_rtc_update(h8_system_t *system)
+{
+  h8_rtc_state_t *state = &system->rtc;
+
+  while (system->instructions >=
+         (state->ticks + 1) * H8_INSTRUCTIONS_PER_SECOND / 4)
+  {
+    state->ticks++;
+    if (h8_rtc_tick(&system->vmem.parts.io1.rtc, state->ticks))
+      system->interrupt = TRUE;
+  }
+  state->next = (state->ticks + 1) * H8_INSTRUCTIONS_PER_SECOND / 4;
+}
+
+/** Forgets the levels last passed to a port's output callbacks */
+static void h8_port_reset(h8_system_port_t *port)
+{
+  port->out_driven = 0;
+  port->out_levels = 0;
+}
+
+/**
+ * Resets the system as a watchdog overflow does. The CPU and I/O registers
+ * return to their initial values, while RAM and the RTC keep theirs.
+ *
+ * The ports go back to inputs, so no chip select is left active and the
+ * first write after the reset reaches every output pin again. Devices stay
+ * hooked up and keep their own state, as they are separate chips, as do
+ * queued input and the IR link.
+ */
+static void h8_wdt_reset(h8_system_t *system)
+{
+  h8_rtc_t rtc = system->vmem.parts.io1.rtc;
+
+  memset(&system->vmem.parts.io1, 0, sizeof(system->vmem.parts.io1));
+  memset(&system->vmem.parts.io2, 0, sizeof(system->vmem.parts.io2));
+  system->vmem.parts.io1.rtc = rtc;
+  system->sleep = FALSE;
+  system->interrupt = FALSE;
+  system->ssu_device = NULL;
+#if H8_SSU_BURSTS
+  system->ssu_burst = FALSE;
+#endif
+  h8_port_reset(&system->pdr1);
+  h8_port_reset(&system->pdr3);
+  h8_port_reset(&system->pdr8);
+  h8_port_reset(&system->pdr9);
+  h8_port_reset(&system->pdrb);
+  h8_init(system);
+
+  /* Left set so that firmware can tell why it restarted */
+  system->vmem.parts.io2.wdt.tcsrwd1.flags.wrst = 1;
+  system->wdt.resets++;
+}
+
+static void h8_wdt_overflow(h8_system_t *system)
+{
+  h8_wdt_t *wdt = &system->vmem.parts.io2.wdt;
+
+  if (wdt->tcsrwd2.flags.ieovf)
+  {
+    /* Count on from 0, as of the moment of the overflow */
+    wdt->tcsrwd2.flags.ovf = 1;
+    wdt->tcwd.u = 0;
+    h8_wdt_restart(wdt, &system->wdt, system->wdt.deadline);
+    system->interrupt = TRUE;
+  }
+  else
+  {
+    H8_LOGW(H8_LOG_CPU, ("Watchdog reset at %04X", system->cpu.pc));
+    h8_wdt_reset(system);
+  }
+}
+
+/** Latches the result of the A/D conversion that has just ended */
+static void h8_adc_end(h8_system_t *system)
+{
+  h8_adc_read(system);
+  system->vmem.parts.io2.adc.adsr.flags.adsf = 0;
+  system->vmem.raw[H8_REG_IRR2].u |= H8_IRR2_IRRAD;
+  system->adc_end = H8_ADC_IDLE;
+  system->interrupt = TRUE;
+}
+
+/**
+ * Applies every posted input event that is due. Input wakes the CPU from
+ * SLEEP in place of the key interrupts, which are not emulated yet.
+ * @todo IRQ and wakeup interrupts
+ */
+static void h8_input_update(h8_system_t *system)
+{
+  const h8_input_event_t *event;
+
+  while ((event = h8_input_front(&system->input)) != NULL &&
+         event->time <= system->instructions)
+  {
+    if (event->type == H8_INPUT_BUTTON)
+      h8_system_button(system, event->index, event->level);
+    else
+    {
+      h8_byte_t *pdr = &system->vmem.raw[event->address];
+
+      pdr->u = (h8_u8)((pdr->u & ~(1 << event->index)) |
+                       event->level << event->index);
+    }
+    h8_input_pop(&system->input);
+    system->sleep = FALSE;
+  }
+}
+
+/** Handles every timed event that is due, then schedules the next */
+static void h8_events(h8_system_t *system)
+{
+  if (system->instructions >= system->rtc.next)
+    h8_rtc_update(system);
+  if (system->instructions >= system->wdt.deadline)
+    h8_wdt_overflow(system);
+  if (system->instructions >= system->tw.deadline &&
+      h8_tw_update(&system->vmem.parts.io1.tw, &system->tw,
+                   system->instructions))
+    system->interrupt = TRUE;
+  if (system->instructions >= system->adc_end)
+    h8_adc_end(system);
+  if (system->instructions >= h8_input_next(&system->input))
+    h8_input_update(system);
+  h8_schedule(system);
+}
+
+/** @return Whether something will eventually wake the CPU from SLEEP */
+static h8_bool h8_wakes(const h8_system_t *system)
+{
+  const h8_rtc_t *rtc = &system->vmem.parts.io1.rtc;
+  const h8_tw_t *tw = &system->vmem.parts.io1.tw;
+  const h8_wdt_t *wdt = &system->vmem.parts.io2.wdt;
+
+  /* A watchdog overflow resets the system even with interrupts masked */
+  if (wdt->tcsrwd1.flags.wdon && !wdt->tcsrwd2.flags.ieovf)
+    return TRUE;
+  else if (system->cpu.ccr.flags.i)
+    return FALSE;
+
+  return wdt->tcsrwd1.flags.wdon ||
+         (rtc->rtccr1.flags.run && rtc->rtccr2.raw.u &&
+          system->vmem.raw[H8_REG_IENR1].u & H8_IENR1_IENRTC) ||
+         (tw->tmrw.flags.cts &&
+          ~tw->tsrw.raw.u & tw->tierw.raw.u & H8_TSRW_FLAGS) ||
+         (system->adc_end != H8_ADC_IDLE &&
+          system->vmem.raw[H8_REG_IENR2].u & H8_IENR2_IENAD) ||
+         h8_input_next(&system->input) != H8_INPUT_NEVER;
+}
+
+void h8_step(h8_system_t *system)
+{
+  H8_OP_T function;
+#if H8_SSU_BURSTS
+  unsigned pc;
+#endif
+
+  if (system->error_code)
+    return;
+
+  if (system->interrupt && !system->cpu.ccr.flags.i)
+    h8_interrupt(system);
+
+  if (system->sleep)
+  {
+    /*
+     * The CPU idles until an interrupt wakes it. If none ever could, carry on
+     * as if it had not slept, which firmware relying on other wakeups expects.
+     */
+    if (h8_wakes(system))
+    {
+      system->instructions++;
+      if (system->instructions >= system->event)
+        h8_events(system);
+      return;
+    }
+    system->sleep = FALSE;
+  }
+
+  /** @todo While unusual, executing out of RAM is not illegal */
+  if (system->cpu.pc > 0xFFFF || system->cpu.pc & 1 ||
+      system->cpu.pc > 0xF020 || system->cpu.pc < 0x0050)
+    H8_ERROR(H8_DEBUG_BAD_PC)
+
+#if H8_LOGGER_DEFERRED
+  h8_log_set_ring(system->log_ring);
+#endif
+#if H8_PROFILE_SUBSYSTEMS
+  h8_profile_set_current(&system->profile);
+#endif
+  H8_PROFILE_ENTER(&system->profile, H8_PROFILE_DECODE);
+#if H8_SSU_BURSTS
+  pc = system->cpu.pc;
+#endif
+  h8_fetch(system);
+
+  function = funcs[system->dbus.a.u];
+
+  if (function)
+    function(system);
+  else
+  {
+    H8_LOGE(H8_LOG_CPU, ("Undefined opcode - %02X%02X at %04X",
+                         system->dbus.a.u, system->dbus.b.u,
+                         system->cpu.pc - 2));
+    H8_ERROR(H8_DEBUG_UNIMPLEMENTED_OPCODE)
+  }
+  H8_PROFILE_LEAVE(&system->profile);
+
+#if H8_SSU_BURSTS
+  if (system->ssu_burst)
+  {
+    system->ssu_burst = FALSE;
+    if (!system->error_code)
+      h8_ssu_burst(system, pc);
+  }
+#endif
+
+  if (system->error_code)
+    H8_LOGE(H8_LOG_CPU, ("CRITICAL EMULATION ERROR %u at %u",
+                         system->error_code, system->error_line));
+
+  system->instructions++;
+  if (system->instructions >= system->event)
+    h8_events(system);
+}
+
+void h8_run(h8_system_t *system)
+{
+  h8_run_until(system,
+               system->instructions + H8_INSTRUCTIONS_PER_SECOND / 60);
+}
+
+void h8_run_until(h8_system_t *system, h8_u64 instructions)
+{
+  /* Notice input posted since the last run */
+  h8_schedule(system);
+  while (system->instructions < instructions && !system->error_code)
+  {
+    /* Notice input posted by another thread during the run */
+    if (h8_input_next(&system->input) < system->event)
+      system->event = h8_input_next(&system->input);
+
+    /* Nothing happens while asleep until the next timed event */
+    if (system->sleep && !system->interrupt && h8_wakes(system) &&
+        system->instructions + 1 < system->event)
+    {
+      h8_u64 wake = system->event < instructions ?
+                    system->event : instructions;
+
+      system->instructions = wake - 1;
+    }
+    h8_step(system);
+  }
+}
+
+h8_u64 h8_system_time_us(const h8_system_t *system)
+{
+  return system->instructions / H8_INSTRUCTIONS_PER_SECOND * 1000000 +
+         system->instructions % H8_INSTRUCTIONS_PER_SECOND * 1000000 /
+         H8_INSTRUCTIONS_PER_SECOND;
+}
+
+#if H8_TESTS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "assembler.h"
+#include "capture.h"
+#include "devices/accelerometer.h"
+#include "devices/bma150.h"
+#include "devices/buttons.h"
+#include "devices/eeprom.h"
+#include "devices/generic_adc.h"
+#include "devices/lcd.h"
+#include "dma.h"
+#include "transport.h"
+
+#define H8_TEST_FAIL(a) { printf("Test failed in %s on line %u.\n", \
+  __FILE__, \
+  __LINE__); \
+  exit(a); }
+
+/**
+ * Starts an A/D conversion and polls it through to the end, then converts
+ * while sleeping and takes the result from the conversion end interrupt.
+ */
+void h8_test_adc(void)
+{
+  static h8_system_t system;
+  h8_adc_t *adc = &system.vmem.parts.io2.adc;
+  h8_device_t device;
+  h8_asm_label start, idle, handler;
+  h8_byte_t value;
+  h8_u64 end;
+  h8_asm_t a;
+
+  memset(&system, 0, sizeof(system));
+  memset(&device, 0, sizeof(device));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, start);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(1)
+  h8_init(&system);
+  system.adc[0].device = &device;
+  system.adc[0].func = h8_generic_adrr_max;
+
+  /* AN0 at the slowest clock, 124 states */
+  value.u = H8_ADC_AN0;
+  h8_write_b(&system, 0xFFBE, value);
+  value.u = 0x80;
+  h8_write_b(&system, 0xFFBF, value);
+  end = system.instructions + ((h8_u64)124 * H8_INSTRUCTIONS_PER_SECOND +
+                               H8_SYSTEM_CLOCK_HZ - 1) / H8_SYSTEM_CLOCK_HZ;
+  if (system.adc_end != end || !adc->adsr.flags.adsf)
+    H8_TEST_FAIL(2)
+  while (system.instructions < end - 1)
+    h8_step(&system);
+  if (!adc->adsr.flags.adsf || adc->adrr.raw.h.u || adc->adrr.raw.l.u)
+    H8_TEST_FAIL(3)
+  h8_step(&system);
+  if (adc->adsr.flags.adsf || adc->adrr.raw.h.u != 0xFF ||
+      adc->adrr.raw.l.u != 0xC0 ||
+      !(system.vmem.raw[H8_REG_IRR2].u & H8_IRR2_IRRAD) ||
+      system.adc_end != H8_ADC_IDLE)
+    H8_TEST_FAIL(4)
+
+  memset(&system, 0, sizeof(system));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  handler = h8_asm_new_label(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_vector(&a, H8_VECTOR_AD_CONVERSION_END, handler);
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+  h8_asm_mov_b_imm(&a, H8_IENR2_IENAD, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_IENR2);
+  h8_asm_mov_b_imm(&a, H8_ADC_AN0, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFBE);
+  h8_asm_andc(&a, 0x7F);
+  h8_asm_mov_b_imm(&a, 0x80, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFBF);
+  h8_asm_sleep(&a);
+  idle = h8_asm_here(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+
+  /* Store the result and clear the request */
+  h8_asm_bind(&a, handler);
+  h8_asm_mov_w_ld_abs16(&a, 0xFFBC, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, 0xF800);
+  h8_asm_mov_b_imm(&a, 0, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_IRR2);
+  h8_asm_rte(&a);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(5)
+
+  h8_init(&system);
+  system.adc[0].device = &device;
+  system.adc[0].func = h8_generic_adrr_max;
+  h8_run_until(&system, 1000);
+  if (system.error_code || system.vmem.raw[0xF800].u != 0xFF ||
+      system.vmem.raw[0xF801].u != 0xC0 || adc->adsr.flags.adsf ||
+      system.vmem.raw[H8_REG_IRR2].u & H8_IRR2_IRRAD)
+    H8_TEST_FAIL(6)
+
+  printf("A/D converter test passed!\n");
+}
+
+void h8_test_add(void)
+{
+  h8_system_t system = {0};
+  h8_byte_t dst_byte, src_byte, result;
+
+  /* 10 + 5 = 15 */
+  dst_byte.u = 10;
+  src_byte.u = 5;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 0 ||
+      system.cpu.ccr.flags.z != 0 ||
+      system.cpu.ccr.flags.v != 0 ||
+      system.cpu.ccr.flags.n != 0 ||
+      result.u != 15)
+    H8_TEST_FAIL(1)
+
+  /* 255 + 1 = 0 */
+  dst_byte.u = 255;
+  src_byte.u = 1;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 1 ||
+      system.cpu.ccr.flags.z != 1 ||
+      system.cpu.ccr.flags.v != 0 ||
+      system.cpu.ccr.flags.n != 0 ||
+      result.u != 0)
+    H8_TEST_FAIL(2)
+
+  /* 127 + 1 = 128 */
+  dst_byte.u = 127;
+  src_byte.u = 1;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 0 ||
+      system.cpu.ccr.flags.z != 0 ||
+      system.cpu.ccr.flags.v != 1 ||
+      system.cpu.ccr.flags.n != 1 ||
+      result.u != 128)
+    H8_TEST_FAIL(3)
+
+  /* -128 + (-1) = 127 */
+  dst_byte.i = -128;
+  src_byte.i = -1;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 1 ||
+      system.cpu.ccr.flags.z != 0 ||
+      system.cpu.ccr.flags.v != 1 ||
+      system.cpu.ccr.flags.n != 0 ||
+      result.u != 127)
+    H8_TEST_FAIL(4)
+
+  /* 0 + 0 = 0 */
+  dst_byte.u = 0;
+  src_byte.u = 0;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 0 ||
+      system.cpu.ccr.flags.h != 0 ||
+      system.cpu.ccr.flags.z != 1 ||
+      system.cpu.ccr.flags.v != 0 ||
+      system.cpu.ccr.flags.n != 0 ||
+      result.u != 0)
+    H8_TEST_FAIL(5)
+
+  /* 127 + 127 = 254 */
+  dst_byte.u = 127;
+  src_byte.u = 127;
+  result = add_b(&system, dst_byte, src_byte);
+  if (system.cpu.ccr.flags.c != 0 ||
+      system.cpu.ccr.flags.z != 0 ||
+      system.cpu.ccr.flags.v != 1 ||
+      system.cpu.ccr.flags.n != 1 ||
+      result.u != 254)
+    H8_TEST_FAIL(7)
+
+  printf("Addition test passed!\n");
+}
+
+static unsigned h8_test_arena_ooms;
+
+static void h8_test_arena_oom(void)
+{
+  h8_test_arena_ooms++;
+}
+
+/**
+ * Creates and frees a system many times over, with its device state carved
+ * from an arena it allocates and then from a static buffer, checks that the
+ * state is released each time, and runs an arena out of memory.
+ */
+void h8_test_arena(void)
+{
+  static h8_u8 buffer[H8_SYSTEM_ARENA_SIZE + H8_DMA_ALIGN];
+  static h8_system_t system;
+  h8_dma_arena_t arena;
+  h8_u8 *a, *b;
+  unsigned i, j;
+
+  for (i = 0; i < 64; i++)
+  {
+    memset(&system, 0, sizeof(system));
+    if (i & 1)
+      h8_dma_arena_init(&system.arena, buffer, sizeof(buffer));
+    h8_init(&system);
+    h8_system_init(&system, H8_SYSTEM_NTR_032);
+    if (!system.device_count)
+      H8_TEST_FAIL(1)
+
+    /* Every device and the IR queues are held in the one block */
+    for (j = 0; j < system.device_count; j++)
+    {
+      const h8_u8 *state = system.devices[j].device;
+
+      if (state && (state < system.arena.base ||
+                    state >= system.arena.base + system.arena.size))
+        H8_TEST_FAIL(2)
+    }
+    if (!h8_dma_arena_owns(&system.arena, system.ir.rx.data) ||
+        !h8_dma_arena_owns(&system.arena, system.ir.tx.data))
+      H8_TEST_FAIL(3)
+    if (i & 1 && (system.arena.base < buffer ||
+                  system.arena.base >= buffer + H8_DMA_ALIGN))
+      H8_TEST_FAIL(4)
+    if (!h8_system_button(&system, H8_BUTTON_MAIN, TRUE) ||
+        !system.pdrb_in[0].device)
+      H8_TEST_FAIL(5)
+
+    h8_system_free(&system);
+    if (system.device_count || system.arena.used || system.ir.rx.data)
+      H8_TEST_FAIL(6)
+    else if (i & 1 ? system.arena.base < buffer : system.arena.base != NULL)
+      H8_TEST_FAIL(7)
+
+    /* Nothing is left hooked up to the released devices */
+    if (system.pdrb.in_mask || system.pdrb_in[0].device)
+      H8_TEST_FAIL(8)
+    for (j = 0; j < sizeof(system.adc) / sizeof(system.adc[0]); j++)
+    {
+      if (system.adc[j].device)
+        H8_TEST_FAIL(9)
+    }
+  }
+
+  /* Allocations are aligned, and owned arenas grow by another block */
+  h8_dma_arena_init(&arena, NULL, 64);
+  a = h8_dma_arena_alloc(&arena, 1, TRUE);
+  b = h8_dma_arena_alloc(&arena, 100, TRUE);
+  if (!a || !b || (unsigned long)b % H8_DMA_ALIGN || a[0] || b[99])
+    H8_TEST_FAIL(10)
+  else if (!h8_dma_arena_owns(&arena, a) || !h8_dma_arena_owns(&arena, b) ||
+           h8_dma_arena_owns(&arena, buffer))
+    H8_TEST_FAIL(11)
+  h8_dma_arena_free(&arena);
+  if (arena.base || h8_dma_arena_owns(&arena, a))
+    H8_TEST_FAIL(12)
+
+  /* A caller-provided buffer refuses what does not fit */
+  h8_dma_set_oom_cb(h8_test_arena_oom);
+  h8_dma_arena_init(&arena, buffer, 64 + H8_DMA_ALIGN);
+  if (!h8_dma_arena_alloc(&arena, 48, FALSE) ||
+      h8_dma_arena_alloc(&arena, 48, FALSE) || h8_test_arena_ooms != 1)
+    H8_TEST_FAIL(13)
+  h8_dma_arena_free(&arena);
+  if (!h8_dma_arena_alloc(&arena, 64, FALSE) || h8_test_arena_ooms != 1)
+    H8_TEST_FAIL(14)
+  h8_dma_set_oom_cb(NULL);
+
+  printf("Arena test passed!\n");
+}
+
+/**
+ * Assembles a small program summing a countdown loop and calling a subroutine,
+ * then runs it to ensure the assembler and CPU agree on encodings.
+ */
+void h8_test_assembler(void)
+{
+  h8_system_t system = {0};
+  h8_asm_t a;
+  h8_asm_label start, loop, sub, result;
+  unsigned i;
+
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  loop = h8_asm_new_label(&a);
+  sub = h8_asm_new_label(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_IO2, H8_ASM_SP);
+  h8_asm_mov_w_imm(&a, 0, H8_ASM_R0);
+  h8_asm_mov_w_imm(&a, 10, H8_ASM_R1);
+  h8_asm_bind(&a, loop);
+  h8_asm_add_w(&a, H8_ASM_R1, H8_ASM_R0);
+  h8_asm_dec_w(&a, 1, H8_ASM_R1);
+  h8_asm_bcc_8(&a, H8_ASM_BNE, loop);
+  h8_asm_bsr_8(&a, sub);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R0, H8_MEMORY_REGION_RAM_1K);
+  h8_asm_sleep(&a);
+  result = h8_asm_here(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, result);
+  h8_asm_bind(&a, sub);
+  h8_asm_inc_w(&a, 1, H8_ASM_R0);
+  h8_asm_rts(&a);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(1)
+
+  h8_init(&system);
+  if (system.cpu.pc != h8_asm_address(&a, start))
+    H8_TEST_FAIL(2)
+  for (i = 0; i < 1000 && !system.sleep && !system.error_code; i++)
+    h8_step(&system);
+  if (!system.sleep || system.error_code)
+    H8_TEST_FAIL(3)
+  if (system.cpu.regs[0].word.r.u != 56 ||
+      system.vmem.raw[H8_MEMORY_REGION_RAM_1K].u != 0x00 ||
+      system.vmem.raw[H8_MEMORY_REGION_RAM_1K + 1].u != 56)
+    H8_TEST_FAIL(4)
+  if (system.cpu.regs[7].er.u != H8_MEMORY_REGION_IO2)
+    H8_TEST_FAIL(5)
+
+  /* Out of range branches should be reported rather than silently wrapped */
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  loop = h8_asm_here(&a);
+  for (i = 0; i < 100; i++)
+    h8_asm_nop(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, loop);
+  if (h8_asm_finish(&a) || a.error != H8_ASM_ERROR_RANGE)
+    H8_TEST_FAIL(6)
+
+  printf("Assembler test passed!\n");
+}
+
+int h8_test_bit_manip(void)
+{
+  h8_system_t system = {0};
+  h8_byte_t b, bits, result;
+
+  b.u = 0;
+  bits.u = B10000010;
+  result = bset(&system, b, bits);
+  if (result.u != B00000100)
+    H8_TEST_FAIL(1)
+
+  bits.u = B00000010;
+  result = bclr(&system, b, bits);
+  if (result.u != 0)
+    H8_TEST_FAIL(2)
+
+  /** @todo Tests for more functions */
+
+  printf("Bit manipulation test passed!\n");
+
+  return 0;
+}
+
+void h8_test_bit_order(void)
+{
+  h8_ccr_t ccr_test;
+
+  ccr_test.raw.u = 0;
+  ccr_test.flags.c = 1;
+  if (ccr_test.raw.u != 1)
+  {
+    printf("This program does not support the current bit ordering.\n"
+           "Try redefining H8_REVERSE_BITFIELDS.\n");
+    H8_TEST_FAIL(1)
+  }
+
+  printf("Bit ordering test passed!\n");
+}
+
+/**
+ * Captures a keyframe, a long run of unchanged frames and two small changes,
+ * then ensures the stream stays small and decodes back to the same frames.
+ */
+void h8_test_capture(void)
+{
+  static h8_capture_t capture;
+  static h8_capture_reader_t reader;
+  static h8_lcd_t lcd, decoded;
+  FILE *stream, *video;
+  unsigned long i;
+  long size;
+
+  memset(&lcd, 0, sizeof(lcd));
+  for (i = 0; i < sizeof(lcd.vram); i++)
+    lcd.vram[i] = (h8_u8)(i * 7);
+  lcd.palette_modes[3] = 15;
+  lcd.contrast = 26;
+  lcd.display_on = TRUE;
+
+  stream = tmpfile();
+  if (!stream || !h8_capture_init(&capture, stream))
+    H8_TEST_FAIL(1)
+  for (i = 0; i < 10000; i++)
+    if (!h8_capture_frame(&capture, &lcd))
+      H8_TEST_FAIL(2)
+  lcd.vram[100] ^= 0xFF;
+  h8_capture_frame(&capture, &lcd);
+  lcd.contrast = 30;
+  h8_capture_frame(&capture, &lcd);
+  if (!h8_capture_flush(&capture))
+    H8_TEST_FAIL(3)
+
+  /* Header, keyframe, a 3-byte repeat and two small deltas */
+  size = ftell(stream);
+  if (size > 8 + 1 + H8_CAPTURE_FRAME_SIZE + 4 + 16)
+    H8_TEST_FAIL(4)
+
+  rewind(stream);
+  if (!h8_capture_reader_init(&reader, stream))
+    H8_TEST_FAIL(5)
+  for (i = 0; h8_capture_read(&reader, &decoded); i++)
+  {
+    if (i == 9999 && decoded.vram[100] != (h8_u8)(100 * 7))
+      H8_TEST_FAIL(6)
+    if (i == 10000 && decoded.vram[100] != (h8_u8)~(100 * 7))
+      H8_TEST_FAIL(7)
+  }
+  if (i != 10002 || decoded.contrast != 30 ||
+      memcmp(decoded.vram, lcd.vram, sizeof(lcd.vram)))
+    H8_TEST_FAIL(8)
+
+  rewind(stream);
+  video = tmpfile();
+  if (!video || h8_capture_export_y4m(stream, video, 30) != 10002)
+    H8_TEST_FAIL(9)
+  fclose(video);
+  fclose(stream);
+
+  printf("Capture test passed!\n");
+}
+
+/**
+ * Runs instructions decoded through the second-level tables, including forms
+ * which previously decoded the wrong register.
+ */
+void h8_test_decode(void)
+{
+  h8_system_t system = {0};
+  h8_asm_t a;
+  h8_asm_label start;
+  unsigned i;
+
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_IO2, H8_ASM_SP);
+  h8_asm_mov_l_imm(&a, 0x12345678, H8_ASM_ER3);
+  h8_asm_mov_l_st_abs16(&a, H8_ASM_ER3, H8_MEMORY_REGION_RAM_1K);
+  h8_asm_mov_l_ld_abs16(&a, H8_MEMORY_REGION_RAM_1K, H8_ASM_ER4);
+  h8_asm_mov_l_imm(&a, 0, H8_ASM_ER6);
+  h8_asm_or_l(&a, H8_ASM_ER3, H8_ASM_ER6);
+  h8_asm_mov_l_imm(&a, H8_MEMORY_REGION_RAM_1K + 0x10, H8_ASM_ER5);
+  h8_asm_mov_b_imm(&a, 3, H8_ASM_R1L);
+  h8_asm_bset_r_ind(&a, H8_ASM_R1L, H8_ASM_ER5);
+  h8_asm_btst_ind(&a, 3, H8_ASM_ER5);
+  h8_asm_stc(&a, H8_ASM_R2H);
+  h8_asm_ldc_imm(&a, 0x05);
+  h8_asm_stc_w_dec(&a, H8_ASM_SP);
+  h8_asm_ldc_imm(&a, 0x00);
+  h8_asm_ldc_w_inc(&a, H8_ASM_SP);
+  h8_asm_stc(&a, H8_ASM_R2L);
+  h8_asm_mov_b_imm(&a, 0, H8_ASM_R0L);
+  h8_asm_bst(&a, 2, H8_ASM_R0L);
+  h8_asm_ldc_imm(&a, 0x0A);
+  h8_asm_stc_w_d24(&a, 0x20, H8_ASM_ER5);
+  h8_asm_ldc_imm(&a, 0x00);
+  h8_asm_ldc_w_d24(&a, 0x20, H8_ASM_ER5);
+  h8_asm_stc(&a, H8_ASM_R1H);
+  h8_asm_sleep(&a);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(1)
+
+  h8_init(&system);
+  for (i = 0; i < 100 && !system.sleep && !system.error_code; i++)
+    h8_step(&system);
+  if (!system.sleep || system.error_code)
+    H8_TEST_FAIL(2)
+  if (system.cpu.regs[4].er.u != 0x12345678 ||
+      system.cpu.regs[6].er.u != 0x12345678)
+    H8_TEST_FAIL(3)
+  if (system.vmem.raw[H8_MEMORY_REGION_RAM_1K + 0x10].u != 0x08 ||
+      system.cpu.regs[2].byte.rh.u & 0x04)
+    H8_TEST_FAIL(4)
+  if (system.cpu.regs[2].byte.rl.u != 0x05 ||
+      system.cpu.regs[7].er.u != H8_MEMORY_REGION_IO2)
+    H8_TEST_FAIL(5)
+  if (system.cpu.regs[0].byte.rl.u != 0x04)
+    H8_TEST_FAIL(6)
+  if (system.cpu.regs[1].byte.rh.u != 0x0A ||
+      system.vmem.raw[H8_MEMORY_REGION_RAM_1K + 0x30].u != 0x0A)
+    H8_TEST_FAIL(7)
+
+  printf("Decode test passed!\n");
+}
+
+void h8_test_division(void)
+{
+  h8_system_t system = {0};
+  h8_byte_t b;
+  h8_word_t w;
+  h8_long_t l;
+
+  w.u = 358;
+  b.u = 2;
+  w = divxu_b(&system, w, b);
+  if (w.l.u != 179 || w.h.u != 0)
+    H8_TEST_FAIL(1)
+
+  l.u = 1234567;
+  w.u = 890;
+  l = divxu_w(&system, l, w);
+  if (l.l.u != 1387 || l.h.u != 137)
+    H8_TEST_FAIL(2)
+
+  l.u = 999;
+  w.u = 0;
+  divxu_w(&system, l, w);
+  if (system.cpu.ccr.flags.z != 1)
+    H8_TEST_FAIL(3)
+
+  printf("Division test passed!\n");
+}
+
+/** Sends one command to an EEPROM, framed by its chip select */
+static void h8_test_eeprom_command(h8_device_t *device, const h8_u8 *bytes,
+                                   unsigned count)
+{
+  h8_byte_t dst, value;
+  unsigned i;
+
+  h8_eeprom_select_out(device, FALSE);
+  for (i = 0; i < count; i++)
+  {
+    value.u = bytes[i];
+    h8_eeprom_write(device, &dst, value);
+  }
+  h8_eeprom_select_out(device, TRUE);
+}
+
+/**
+ * Checks that a new EEPROM reads as erased, that savestates account for their
+ * size, and that writes to a mapped EEPROM reach its file.
+ */
+void h8_test_eeprom(void)
+{
+  static const h8_u8 wren[] = { 6 };
+  static const h8_u8 write[] = { 2, 0x01, 0x00, 'H', '8' };
+  static const h8_u8 write_far[] = { 2, 0x1F, 0xFF, 0x42 };
+  static const char *path = "libh8300h-test.eep";
+  static h8_system_t system;
+  h8_device_t device, mapped;
+  h8_u8 state[8 * 1024 + 1], *out = state;
+  const h8_u8 *in = state;
+  unsigned size = sizeof(state);
+  h8_u16 pages[H8_EEPROM_PAGES_MAX];
+  FILE *file, *journal;
+  char buffer[2];
+  h8_u8 record[H8_EEPROM_JOURNAL_HEADER];
+  h8_u64 time;
+  unsigned i;
+
+  memset(&device, 0, sizeof(device));
+  h8_eeprom_init_8k(&device);
+  if (((h8_u8*)device.data)[0] != 0xFF ||
+      ((h8_u8*)device.data)[0x1FFF] != 0xFF)
+    H8_TEST_FAIL(1)
+
+  h8_test_eeprom_command(&device, wren, sizeof(wren));
+  h8_test_eeprom_command(&device, write, sizeof(write));
+  if (!device.save(&device, &out, &size) || size != 0 ||
+      out != state + sizeof(state) || device.save(&device, &out, &size))
+    H8_TEST_FAIL(2)
+  ((h8_u8*)device.data)[0x100] = 0;
+  size = sizeof(state);
+  if (!device.load(&device, &in, &size) || size != 0 ||
+      ((h8_u8*)device.data)[0x100] != 'H')
+    H8_TEST_FAIL(3)
+
+  /* Loading replaces every page; after that only written pages count */
+  if (h8_eeprom_checkpoint(&device, pages) != 8 * 1024 / H8_EEPROM_PAGE_SIZE)
+    H8_TEST_FAIL(4)
+  /* Records are stamped with the time of a system long past 2^32 */
+  memset(&system, 0, sizeof(system));
+  system.instructions = ((h8_u64)1 << 32) * 3 + 5;
+  device.system = &system;
+  journal = tmpfile();
+  if (!journal || !h8_eeprom_journal(&device, journal))
+    H8_TEST_FAIL(5)
+  h8_test_eeprom_command(&device, wren, sizeof(wren));
+  h8_test_eeprom_command(&device, write, sizeof(write));
+  h8_test_eeprom_command(&device, wren, sizeof(wren));
+  h8_test_eeprom_command(&device, write_far, sizeof(write_far));
+  if (h8_eeprom_checkpoint(&device, pages) != 2 ||
+      pages[0] != 0x100 / H8_EEPROM_PAGE_SIZE ||
+      pages[1] != 0x1FFF / H8_EEPROM_PAGE_SIZE ||
+      h8_eeprom_checkpoint(&device, pages) != 0)
+    H8_TEST_FAIL(6)
+
+  /* Replaying the journal over an erased image gives the written bytes */
+  h8_eeprom_journal(&device, NULL);
+  rewind(journal);
+  memset(state, 0xFF, sizeof(state));
+  if (h8_eeprom_journal_replay(journal, state, 8 * 1024) != 2 ||
+      state[0x100] != 'H' || state[0x101] != '8' || state[0x1FFE] != 0xFF ||
+      state[0x1FFF] != 0x42)
+    H8_TEST_FAIL(7)
+  if (fseek(journal, 9, SEEK_SET) ||
+      fread(record, sizeof(record), 1, journal) != 1)
+    H8_TEST_FAIL(8)
+  for (i = 0, time = 0; i < 8; i++)
+    time |= (h8_u64)record[4 + i] << (i * 8);
+  if (time != system.instructions)
+    H8_TEST_FAIL(9)
+  fclose(journal);
+  h8_eeprom_free(&device);
+  h8_dma_free(device.device);
+
+#if H8_EEPROM_MMAP && !defined(_WIN32)
+  remove(path);
+  memset(&mapped, 0, sizeof(mapped));
+  h8_eeprom_init_8k(&mapped);
+  if (!h8_eeprom_map(&mapped, path) ||
+      ((h8_u8*)mapped.data)[0x100] != 0xFF)
+    H8_TEST_FAIL(10)
+  h8_test_eeprom_command(&mapped, wren, sizeof(wren));
+  h8_test_eeprom_command(&mapped, write, sizeof(write));
+
+  /* The write is visible through the file before the mapping is released */
+  file = fopen(path, "rb");
+  if (!file || fseek(file, 0x100, SEEK_SET) ||
+      fread(buffer, 1, 2, file) != 2 || buffer[0] != 'H' || buffer[1] != '8')
+    H8_TEST_FAIL(11)
+  fclose(file);
+  h8_eeprom_free(&mapped);
+  h8_dma_free(mapped.device);
+
+  /* Mapping the file again restores its contents */
+  memset(&mapped, 0, sizeof(mapped));
+  h8_eeprom_init_8k(&mapped);
+  if (!h8_eeprom_map(&mapped, path) ||
+      ((h8_u8*)mapped.data)[0x101] != '8')
+    H8_TEST_FAIL(12)
+  h8_eeprom_free(&mapped);
+  h8_dma_free(mapped.device);
+  remove(path);
+#else
+  H8_UNUSED(mapped);
+  H8_UNUSED(path);
+  H8_UNUSED(file);
+  H8_UNUSED(buffer);
+#endif
+
+  printf("EEPROM test passed!\n");
+}
+
+/**
+ * Renders VRAM filled with a pattern under a few combinations of display
+ * state, comparing every pixel against a direct decode of the VRAM layout.
+ */
+/** Reads consecutive BMA150 registers over its SSU callbacks */
+static void h8_test_bma150_read(h8_device_t *device, unsigned address,
+                                h8_u8 *dst, unsigned count)
+{
+  h8_byte_t value, out;
+  unsigned i;
+
+  h8_bma150_select_out(device, FALSE);
+  value.u = (h8_u8)(B10000000 | address);
+  device->ssu_out(device, &out, value);
+  for (i = 0; i < count; i++)
+  {
+    value.u = 0xFF;
+    device->ssu_out(device, &out, value);
+    device->ssu_in(device, &value);
+    dst[i] = value.u;
+  }
+  h8_bma150_select_out(device, TRUE);
+}
+
+/**
+ * Builds a schedule of resting, walking and running, then ensures the
+ * waveform and step count follow it, that blocks match single samples, and
+ * that both kinds of accelerometer read it in emulated time.
+ */
+void h8_test_gait(void)
+{
+  static h8_system_t system;
+  static h8_s16 x[250], y[250], z[250];
+  h8_device_t device;
+  h8_gait_t gait;
+  h8_s16 sx, sy, sz;
+  h8_word_t value;
+  h8_u8 regs[2];
+  unsigned i;
+
+  h8_gait_init(&gait, 0, 0);
+  if (!h8_gait_add(&gait, H8_GAIT_REST, 1000, 0, 0) ||
+      !h8_gait_add(&gait, H8_GAIT_WALK, 10000, 120, 400) ||
+      !h8_gait_add(&gait, H8_GAIT_RUN, 5000, 180, 1000))
+    H8_TEST_FAIL(1)
+
+  /* Resting is gravity alone */
+  h8_gait_block(&gait, 500000, 0, &sx, &sy, &sz, 1);
+  if (sx != 1000 || sy || sz)
+    H8_TEST_FAIL(2)
+
+  /* The first step of a 2Hz walk peaks a quarter of a step in */
+  h8_gait_block(&gait, 1125000, 0, &sx, &sy, &sz, 1);
+  if (sx < 1396 || sx > 1404 || sy < -2 || sy > 2)
+    H8_TEST_FAIL(3)
+
+  if (h8_gait_steps(&gait, 1000000) != 0 ||
+      h8_gait_steps(&gait, 6000000) != 10 ||
+      h8_gait_steps(&gait, 16000000) != 35 ||
+      h8_gait_steps(&gait, 100000000) != 35)
+    H8_TEST_FAIL(4)
+  gait.repeat = TRUE;
+  if (h8_gait_steps(&gait, 32000000) != 70)
+    H8_TEST_FAIL(5)
+
+  /* Blocks crossing segments match single samples, noise included */
+  gait.noise = 50;
+  gait.seed = 1234;
+  h8_gait_block(&gait, 10000000, 4000, x, y, z, 250);
+  for (i = 0; i < 250; i++)
+  {
+    h8_gait_block(&gait, 10000000 + i * 4000, 0, &sx, &sy, &sz, 1);
+    if (sx != x[i] || sy != y[i] || sz != z[i])
+      H8_TEST_FAIL(6)
+  }
+  gait.noise = 0;
+
+  /* The analog X sensor reads the vertical axis at 256 counts per g */
+  memset(&system, 0, sizeof(system));
+  memset(&device, 0, sizeof(device));
+  h8_accelerometer_init_x(&device);
+  device.system = &system;
+  h8_accelerometer_set_gait(&device, &gait);
+  system.instructions = H8_INSTRUCTIONS_PER_SECOND / 2;
+  value = h8_accelerometer_adrr_get(&device);
+  if (value.u != (512 + 256) << 6)
+    H8_TEST_FAIL(7)
+  h8_accelerometer_set_gait(&device, NULL);
+  h8_dma_free(device.device);
+
+  /* The BMA150 reads it at 128 LSB/g */
+  memset(&device, 0, sizeof(device));
+  h8_bma150_init(&device);
+  device.system = &system;
+  h8_bma150_set_gait(&device, &gait);
+  h8_test_bma150_read(&device, 0x02, regs, 2);
+  if (regs[0] != B00000001 || regs[1] != 128 >> 2)
+    H8_TEST_FAIL(8)
+  h8_dma_free(device.device);
+
+  printf("Gait test passed!\n");
+}
+
+/** Sets up a system's SCI3 for IrDA at the fastest bit rate, 8N1 */
+static void h8_test_ir_sci3(h8_system_t *system)
+{
+  memset(system, 0, sizeof(*system));
+  h8_ir_init(&system->ir, 16, NULL);
+  system->vmem.parts.io2.aec_sci3.scr3.flags.te = 1;
+  system->vmem.parts.io2.aec_sci3.scr3.flags.re = 1;
+  system->vmem.parts.io2.aec_sci3.ircr.flags.enable = 1;
+}
+
+/**
+ * Connects two systems over an in-process link, then ensures bytes written
+ * to one's TDR3 arrive at the other only after the time to shift them out.
+ */
+static void h8_test_ir_link(void)
+{
+  static h8_system_t a, b;
+  static h8_ir_link_t link;
+  h8_byte_t value;
+  h8_u64 byte_us;
+
+  h8_test_ir_sci3(&a);
+  h8_test_ir_sci3(&b);
+  h8_ir_link_init(&link);
+  if (!h8_ir_link_attach(&link, &a.ir) || !h8_ir_link_attach(&link, &b.ir))
+    H8_TEST_FAIL(9)
+
+  /* 10 bits of 32 clocks each */
+  byte_us = h8_sci3_byte_us(&a);
+  if (byte_us != 320 * 1000000 / H8_SYSTEM_CLOCK_HZ)
+    H8_TEST_FAIL(10)
+
+  /* Two bytes written back to back go out one after the other */
+  a.vmem.parts.io2.aec_sci3.ssr3.flags.tdre = 1;
+  value.u = 0x5A;
+  h8_write_b(&a, H8_REG_TDR3, value);
+  a.vmem.parts.io2.aec_sci3.ssr3.flags.tdre = 1;
+  value.u = 0xA5;
+  h8_write_b(&a, H8_REG_TDR3, value);
+
+  b.instructions = byte_us * H8_INSTRUCTIONS_PER_SECOND / 1000000 - 1;
+  h8_read_b(&b, H8_REG_SSR3);
+  if (b.vmem.parts.io2.aec_sci3.ssr3.flags.rdrf)
+    H8_TEST_FAIL(11)
+  b.instructions = byte_us * H8_INSTRUCTIONS_PER_SECOND / 1000000;
+  h8_read_b(&b, H8_REG_SSR3);
+  if (!b.vmem.parts.io2.aec_sci3.ssr3.flags.rdrf ||
+      h8_read_b(&b, H8_REG_RDR3).u != 0x5A)
+    H8_TEST_FAIL(12)
+  h8_read_b(&b, H8_REG_SSR3);
+  if (b.vmem.parts.io2.aec_sci3.ssr3.flags.rdrf)
+    H8_TEST_FAIL(13)
+  b.instructions *= 2;
+  h8_read_b(&b, H8_REG_SSR3);
+  if (!b.vmem.parts.io2.aec_sci3.ssr3.flags.rdrf ||
+      h8_read_b(&b, H8_REG_RDR3).u != 0xA5)
+    H8_TEST_FAIL(14)
+
+  /* The sender does not hear itself */
+  h8_read_b(&a, H8_REG_SSR3);
+  if (a.vmem.parts.io2.aec_sci3.ssr3.flags.rdrf)
+    H8_TEST_FAIL(15)
+
+  h8_ir_free(&a.ir);
+  h8_ir_free(&b.ir);
+}
+
+/** Posts a pin change from inside a run, as another thread would */
+static void h8_test_input_post(h8_device_t *device, const h8_bool on)
+{
+  H8_UNUSED(on);
+  h8_input_pin(&device->system->input, 1000, 0xFFD6, 2, TRUE);
+}
+
+/**
+ * Posts button and pin changes ahead of time and checks that each lands on
+ * its instruction, that input wakes a sleeping CPU, that a full queue
+ * refuses events rather than losing earlier ones, and that input posted
+ * during a run still wakes the CPU on time.
+ */
+void h8_test_input(void)
+{
+  static h8_system_t system;
+  h8_asm_label start, idle;
+  unsigned i;
+  h8_asm_t a;
+
+  memset(&system, 0, sizeof(system));
+  h8_system_init(&system, H8_SYSTEM_NTR_032);
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+  h8_asm_andc(&a, 0x7F);
+  h8_asm_sleep(&a);
+  h8_asm_mov_b_ld_abs8(&a, 0xDE, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF800);
+  idle = h8_asm_here(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(1)
+  h8_init(&system);
+
+  /* A press for only one instruction, and a pin on unhooked port 3 */
+  if (!h8_input_button(&system.input, 50000, H8_BUTTON_MAIN, TRUE) ||
+      !h8_input_pin(&system.input, 50000, 0xFFD6, 2, TRUE) ||
+      !h8_input_button(&system.input, 50001, H8_BUTTON_MAIN, FALSE))
+    H8_TEST_FAIL(2)
+
+  /* Asleep with nothing else to wake it until the press */
+  h8_run_until(&system, 49999);
+  if (system.error_code || !system.sleep || system.vmem.raw[0xF800].u)
+    H8_TEST_FAIL(3)
+
+  /* The CPU reads the press, which is released by the time it stores it */
+  h8_run_until(&system, 50002);
+  if (system.sleep || system.vmem.raw[0xF800].u != 0x01 ||
+      !(system.vmem.raw[0xFFD6].u & 0x04))
+    H8_TEST_FAIL(4)
+  if (h8_read_b(&system, 0xFFDE).u & 0x01 ||
+      h8_input_next(&system.input) != H8_INPUT_NEVER)
+    H8_TEST_FAIL(5)
+
+  /* Pins outside of the port data registers are refused */
+  if (h8_input_pin(&system.input, 0, 0xF800, 0, TRUE) ||
+      h8_input_pin(&system.input, 0, 0xFFD0, 0, TRUE) ||
+      h8_input_pin(&system.input, 0, 0xFFD6, 8, TRUE))
+    H8_TEST_FAIL(6)
+
+  for (i = 0; i < H8_INPUT_QUEUE_EVENTS; i++)
+    if (!h8_input_button(&system.input, 60000 + i, H8_BUTTON_LEFT, i & 1))
+      H8_TEST_FAIL(7)
+  if (h8_input_button(&system.input, 70000, H8_BUTTON_LEFT, TRUE) ||
+      system.input.dropped != 1 ||
+      h8_input_front(&system.input)->time != 60000)
+    H8_TEST_FAIL(8)
+  h8_run_until(&system, 70000);
+  if (h8_input_next(&system.input) != H8_INPUT_NEVER)
+    H8_TEST_FAIL(9)
+  h8_system_free(&system);
+
+  /* A pin posted while the run is under way, just before the CPU sleeps */
+  memset(&system, 0, sizeof(system));
+  h8_system_init(&system, H8_SYSTEM_NTR_032);
+  system.pdr1_out[0].func = h8_test_input_post;
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xD4);
+  h8_asm_andc(&a, 0x7F);
+  h8_asm_sleep(&a);
+  h8_asm_mov_b_ld_abs8(&a, 0xD6, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF800);
+  idle = h8_asm_here(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(10)
+  h8_init(&system);
+
+  /* One run, so nothing reschedules between the post and the sleep */
+  h8_run_until(&system, 1010);
+  if (system.error_code || system.sleep ||
+      !(system.vmem.raw[0xF800].u & 0x04) ||
+      h8_input_next(&system.input) != H8_INPUT_NEVER)
+    H8_TEST_FAIL(11)
+  h8_system_free(&system);
+
+  printf("Input test passed!\n");
+}
+
+/**
+ * Ensures IR queues keep bytes in order across wrapping, both one at a time
+ * and in bulk, and hold packets much longer than the old 8-byte buffers.
+ * Also runs a pair of systems over an in-process link.
+ */
+void h8_test_ir(void)
+{
+  h8_byte_t src[12], dst[12], value, *span;
+  h8_ir_t ir;
+  unsigned i;
+
+  memset(&ir, 0, sizeof(ir));
+  h8_ir_init(&ir, 5, NULL);
+  if (ir.rx.size != 8 || h8_ir_in(&ir, &value))
+    H8_TEST_FAIL(1)
+
+  for (i = 0; i < sizeof(src); i++)
+    src[i].u = (h8_u8)(i + 1);
+  for (i = 0; i < 6; i++)
+    h8_ir_ring_push(&ir.rx, src[i]);
+  for (i = 0; i < 4; i++)
+    if (!h8_ir_in(&ir, &value) || value.u != i + 1)
+      H8_TEST_FAIL(2)
+
+  /* Fill the queue so it wraps, then overflow it */
+  if (h8_ir_ring_write(&ir.rx, &src[6], 6) != 6 ||
+      h8_ir_ring_count(&ir.rx) != 8 ||
+      h8_ir_ring_push(&ir.rx, src[0]) ||
+      h8_ir_ring_free_span(&ir.rx, &span))
+    H8_TEST_FAIL(3)
+
+  /* The queued bytes come out in two spans, then in order */
+  if (h8_ir_ring_peek_span(&ir.rx, &span) != 4 || span[0].u != 5)
+    H8_TEST_FAIL(4)
+  if (h8_ir_ring_read(&ir.rx, dst, sizeof(dst)) != 8)
+    H8_TEST_FAIL(5)
+  for (i = 0; i < 8; i++)
+    if (dst[i].u != i + 5)
+      H8_TEST_FAIL(6)
+  h8_ir_free(&ir);
+
+  h8_ir_init(&ir, H8_IR_QUEUE_SIZE, NULL);
+  for (i = 0; i < 256; i++)
+    if (!h8_ir_out(&ir, src[i % sizeof(src)]))
+      H8_TEST_FAIL(7)
+  if (h8_ir_ring_count(&ir.tx) != 256)
+    H8_TEST_FAIL(8)
+  h8_ir_free(&ir);
+
+  h8_test_ir_link();
+
+  printf("IR test passed!\n");
+}
+
+void h8_test_ir_capture(void)
+{
+  static h8_ir_capture_t capture;
+  static h8_ir_capture_record_t record;
+  static const h8_u8 request[] = { 'A', 'B', 'C' };
+  h8_ir_capture_reader_t reader;
+  FILE *file = tmpfile(), *out = tmpfile();
+  char report[512];
+  unsigned i;
+
+  if (!file || !out || !h8_ir_capture_init(&capture, file))
+    H8_TEST_FAIL(1)
+
+  /* A request, its reply, a retransmitted request, then a later session */
+  for (i = 0; i < sizeof(request); i++)
+    h8_ir_capture_byte(&capture, H8_IR_CAPTURE_TX, request[i], 1000 + i * 10);
+  h8_ir_capture_byte(&capture, H8_IR_CAPTURE_RX, 'o', 1500);
+  h8_ir_capture_byte(&capture, H8_IR_CAPTURE_RX, 'k', 1510);
+  for (i = 0; i < sizeof(request); i++)
+    h8_ir_capture_byte(&capture, H8_IR_CAPTURE_TX, request[i], 5000 + i * 10);
+  h8_ir_capture_byte(&capture, H8_IR_CAPTURE_TX, 'Z', 3000000);
+  if (!h8_ir_capture_flush(&capture) || capture.records != 4)
+    H8_TEST_FAIL(2)
+
+  rewind(file);
+  if (!h8_ir_capture_reader_init(&reader, file) ||
+      reader.instructions_per_second != H8_INSTRUCTIONS_PER_SECOND)
+    H8_TEST_FAIL(3)
+  if (!h8_ir_capture_read(&reader, &record) || record.time != 1000 ||
+      record.span != 20 || record.direction != H8_IR_CAPTURE_TX ||
+      record.length != 3 || memcmp(record.data, request, 3))
+    H8_TEST_FAIL(4)
+
+  rewind(file);
+  if (h8_ir_capture_report(file, out, 0) != 2)
+    H8_TEST_FAIL(5)
+  rewind(out);
+  i = fread(report, 1, sizeof(report) - 1, out);
+  report[i] = '\0';
+  if (!strstr(report, "TX: 2 packets, 6 bytes, 1 retransmits") ||
+      !strstr(report, "latency 1985 average, 3490 max") ||
+      !strstr(report, "Session 2: 3000000"))
+    H8_TEST_FAIL(6)
+
+  fclose(file);
+  fclose(out);
+  printf("IR capture test passed!\n");
+}
+
+void h8_test_lcd(void)
+{
+  static h8_lcd_t lcd;
+  static h8_u8 gray[H8_LCD_HEIGHT][H8_LCD_WIDTH];
+  static h8_u8 rgba[H8_LCD_HEIGHT][H8_LCD_WIDTH * 4];
+  unsigned i, x, y;
+
+  memset(&lcd, 0, sizeof(lcd));
+  for (i = 0; i < sizeof(lcd.vram); i++)
+    lcd.vram[i] = (h8_u8)(i * 37 + (i >> 8) * 11);
+  lcd.palette_modes[0] = 0;
+  lcd.palette_modes[1] = 5;
+  lcd.palette_modes[2] = 10;
+  lcd.palette_modes[3] = 15;
+  lcd.contrast = 32;
+  lcd.display_on = TRUE;
+
+  for (i = 0; i < 4; i++)
+  {
+    lcd.start_line = (h8_u8)(i * 37);
+    lcd.y_flip = i & 1;
+    lcd.x_flip = (i >> 1) & 1;
+    if (!h8_lcd_render(&lcd, gray, sizeof(gray[0]), H8_LCD_FORMAT_GRAY8) ||
+        !h8_lcd_render(&lcd, rgba, sizeof(rgba[0]), H8_LCD_FORMAT_RGBA8888))
+      H8_TEST_FAIL(1)
+    for (y = 0; y < H8_LCD_HEIGHT; y++)
+    {
+      unsigned line = ((lcd.y_flip ? H8_LCD_HEIGHT - 1 - y : y) +
+                       lcd.start_line) % H8_LCD_VRAM_ROWS;
+
+      for (x = 0; x < H8_LCD_WIDTH; x++)
+      {
+        unsigned column = lcd.x_flip ? H8_LCD_WIDTH - 1 - x : x;
+        unsigned value = lcd.vram[(line / 8) * 0x100 + column * 2 +
+                                  (line % 8) / 4] >> ((line % 4) * 2) & 3;
+        h8_u8 shade = (h8_u8)(0xFF - value * 0x55);
+
+        if (gray[y][x] != shade)
+          H8_TEST_FAIL(2)
+        if (rgba[y][x * 4] != shade || rgba[y][x * 4 + 1] != shade ||
+            rgba[y][x * 4 + 2] != shade || rgba[y][x * 4 + 3] != 0xFF)
+          H8_TEST_FAIL(3)
+      }
+    }
+  }
+
+  /* Inverted, every pixel forced on, then the display turned off */
+  lcd.inverse_display = TRUE;
+  lcd.all_on = TRUE;
+  h8_lcd_render(&lcd, gray, sizeof(gray[0]), H8_LCD_FORMAT_GRAY8);
+  if (gray[0][0] != 0xFF || gray[H8_LCD_HEIGHT - 1][H8_LCD_WIDTH - 1] != 0xFF)
+    H8_TEST_FAIL(4)
+  lcd.inverse_display = FALSE;
+  h8_lcd_render(&lcd, gray, sizeof(gray[0]), H8_LCD_FORMAT_GRAY8);
+  if (gray[0][0] != 0x00 || gray[H8_LCD_HEIGHT - 1][H8_LCD_WIDTH - 1] != 0x00)
+    H8_TEST_FAIL(5)
+  lcd.display_on = FALSE;
+  h8_lcd_render(&lcd, gray, sizeof(gray[0]), H8_LCD_FORMAT_GRAY8);
+  if (gray[0][0] != 0xFF || gray[H8_LCD_HEIGHT - 1][H8_LCD_WIDTH - 1] != 0xFF)
+    H8_TEST_FAIL(6)
+  if (h8_lcd_render(&lcd, gray, H8_LCD_WIDTH - 1, H8_LCD_FORMAT_GRAY8))
+    H8_TEST_FAIL(7)
+
+  printf("LCD (%s) test passed!\n", h8_lcd_render_isa());
+}
+
+/**
+ * Writes to VRAM and display state through the device, ensuring only the
+ * affected region of the displayed image is reported as changed.
+ */
+void h8_test_lcd_dirty(void)
+{
+  static const h8_u8 place[] = { 0xB2, 0x10, 0x0A };
+  h8_lcd_rect_t rects[2];
+  h8_device_t device;
+  h8_lcd_t *lcd;
+  h8_byte_t dst, value;
+  unsigned i;
+
+  memset(&device, 0, sizeof(device));
+  h8_lcd_init(&device);
+  lcd = device.device;
+  h8_lcd_select_out(&device, FALSE);
+
+  /* Everything is changed at first, then nothing */
+  if (h8_lcd_dirty_rects(lcd, rects, 2) != 1 || rects[0].width != 128 ||
+      rects[0].height != 64 || h8_lcd_dirty_rects(lcd, rects, 2))
+    H8_TEST_FAIL(1)
+
+  /* Page 2, column 10, then both bytes of the column */
+  h8_lcd_mode_out(&device, FALSE);
+  for (i = 0; i < sizeof(place); i++)
+  {
+    value.u = place[i];
+    h8_lcd_write(&device, &dst, value);
+  }
+  h8_lcd_mode_out(&device, TRUE);
+  value.u = 0x55;
+  h8_lcd_write(&device, &dst, value);
+  h8_lcd_write(&device, &dst, value);
+  if (h8_lcd_dirty_rects(lcd, rects, 2) != 1 || rects[0].x != 10 ||
+      rects[0].y != 16 || rects[0].width != 1 || rects[0].height != 8)
+    H8_TEST_FAIL(2)
+
+  /* Rewriting the same values changes nothing */
+  h8_lcd_mode_out(&device, FALSE);
+  for (i = 0; i < sizeof(place); i++)
+  {
+    value.u = place[i];
+    h8_lcd_write(&device, &dst, value);
   }
+  h8_lcd_mode_out(&device, TRUE);
+  value.u = 0x55;
+  h8_lcd_write(&device, &dst, value);
+  h8_lcd_write(&device, &dst, value);
+  if (h8_lcd_dirty_rects(lcd, rects, 2))
+    H8_TEST_FAIL(3)
 
-  if (system->error_code)
-    h8_log(H8_LOG_ERROR, H8_LOG_CPU, "CRITICAL EMULATION ERROR %u at %u",
-           system->error_code, system->error_line);
+  /* Starting the display at row 20 leaves only the last 4 rows of page 2 */
+  h8_lcd_mode_out(&device, FALSE);
+  value.u = 0x40;
+  h8_lcd_write(&device, &dst, value);
+  value.u = 20;
+  h8_lcd_write(&device, &dst, value);
+  if (h8_lcd_dirty_rects(lcd, rects, 2) != 1 || rects[0].height != 64)
+    H8_TEST_FAIL(4)
+  h8_lcd_mode_out(&device, TRUE);
+  h8_lcd_write(&device, &dst, value);
+  if (h8_lcd_dirty_rects(lcd, rects, 2) != 1 || rects[0].x != 11 ||
+      rects[0].y != 0 || rects[0].height != 4)
+    H8_TEST_FAIL(5)
 
-  system->instructions++;
+  h8_dma_free(device.device);
+
+  printf("LCD dirty region test passed!\n");
 }
 
-void h8_run(h8_system_t *system);
+#if H8_LOGGER_DEFERRED
+/**
+ * Records messages into a ring, then ensures they format the same as they
+ * would have synchronously and that a full ring drops rather than blocks.
+ */
+void h8_test_logger(void)
+{
+  static h8_log_ring_t ring;
+#if H8_LOGGER_MIN_LEVEL <= 3
+  h8_log_record_t record;
+#endif
+#if H8_LOGGER_MIN_LEVEL <= 4
+  char buffer[128];
+  FILE *stream;
+#endif
+  unsigned i;
 
-#if H8_TESTS
+  h8_log_ring_init(&ring);
+#if H8_LOGGER_MIN_LEVEL <= 3 /* H8_LOG_WARN */
+  h8_log_set_ring(&ring);
+  h8_log(H8_LOG_DEBUG, H8_LOG_CPU, "Filtered %u", 1);
+  h8_log(H8_LOG_WARN, H8_LOG_IR, "Byte %02X from %s (%u%%) %ld", 0xAB,
+         "a long device name exceeding thirty-two characters", 50, -3L);
+  h8_log_set_ring(NULL);
+  if (ring.head != 1 || ring.dropped)
+    H8_TEST_FAIL(1)
+  if (!h8_log_ring_pop(&ring, &record) || h8_log_ring_pop(&ring, &record))
+    H8_TEST_FAIL(2)
+  if (record.level != H8_LOG_WARN || record.source != H8_LOG_IR ||
+      record.arg_count != 4)
+    H8_TEST_FAIL(3)
 
-#include <stdio.h>
-#include <stdlib.h>
+  stream = tmpfile();
+  if (!stream)
+    H8_TEST_FAIL(4)
+  h8_log_record_print(&record, stream);
+  rewind(stream);
+  if (!fgets(buffer, sizeof(buffer), stream) ||
+      strcmp(buffer, "[IR ] Byte AB from a long device name exceeding t "
+                     "(50%) -3\n"))
+    H8_TEST_FAIL(5)
+  fclose(stream);
+#endif
 
-#define H8_TEST_FAIL(a) { printf("Test failed in %s on line %u.\n", \
-  __FILE__, \
-  __LINE__); \
-  exit(a); }
+#if H8_LOGGER_MIN_LEVEL <= 4 /* H8_LOG_ERROR */
+  h8_log_set_ring(&ring);
+  for (i = 0; i <= H8_LOGGER_RING_SIZE; i++)
+    h8_log(H8_LOG_ERROR, H8_LOG_EEP, "Write %u", i);
+  h8_log_set_ring(NULL);
+  if (ring.dropped != 1)
+    H8_TEST_FAIL(6)
+  stream = tmpfile();
+  if (!stream)
+    H8_TEST_FAIL(7)
+  if (h8_log_ring_drain(&ring, stream) != H8_LOGGER_RING_SIZE)
+    H8_TEST_FAIL(8)
+  rewind(stream);
+  if (!fgets(buffer, sizeof(buffer), stream) ||
+      strcmp(buffer, "[EEP] Write 0\n"))
+    H8_TEST_FAIL(9)
+  fclose(stream);
+#endif
 
-void h8_test_add(void)
-{
-  h8_system_t system = {0};
-  h8_byte_t dst_byte, src_byte, result;
+  /* Filtered messages through the macros must not evaluate their arguments */
+  h8_log_ring_init(&ring);
+  h8_log_set_ring(&ring);
+  h8_log_set_level(H8_LOG_EEP, H8_LOG_DEBUG);
+  i = 0;
+  H8_LOGD(H8_LOG_EEP, ("Enabled %u", i++));
+  H8_LOGD(H8_LOG_CPU, ("Filtered %u", i++));
+  h8_log_set_level(H8_LOG_SOURCE_INVALID, H8_LOGGER_DEFAULT_LEVEL);
+  H8_LOGD(H8_LOG_EEP, ("Filtered %u", i++));
+  h8_log_set_ring(NULL);
+
+  /* Below H8_LOGGER_MIN_LEVEL, even enabled sources are compiled out */
+  if (i != (H8_LOGGER_MIN_LEVEL <= H8_LOG_DEBUG) || ring.head != i)
+    H8_TEST_FAIL(10)
 
-  /* 10 + 5 = 15 */
-  dst_byte.u = 10;
-  src_byte.u = 5;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 0 ||
-      system.cpu.ccr.flags.z != 0 ||
-      system.cpu.ccr.flags.v != 0 ||
-      system.cpu.ccr.flags.n != 0 ||
-      result.u != 15)
-    H8_TEST_FAIL(1)
+  printf("Logger test passed!\n");
+}
+#endif
 
-  /* 255 + 1 = 0 */
-  dst_byte.u = 255;
-  src_byte.u = 1;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 1 ||
-      system.cpu.ccr.flags.z != 1 ||
-      system.cpu.ccr.flags.v != 0 ||
-      system.cpu.ccr.flags.n != 0 ||
-      result.u != 0)
+/**
+ * Converts a short CSV trace, then ensures it is interpolated in emulated
+ * time and reaches the firmware through the BMA150 registers, with new data
+ * flags set once per sensor update.
+ */
+void h8_test_motion(void)
+{
+  static h8_system_t system;
+  static const char *path = "libh8300h-test.mot";
+  static h8_u8 buffer[64 + H8_DMA_ALIGN];
+  h8_dma_arena_t arena;
+  h8_device_t device;
+  h8_motion_t motion;
+  h8_s16 x, y, z;
+  h8_u8 regs[6];
+  FILE *csv, *out;
+
+  csv = tmpfile();
+  out = fopen(path, "wb");
+  if (!csv || !out)
+    H8_TEST_FAIL(1)
+  fputs("time_ms,x,y,z\n# Flat, then tilted\n0,0,0,1000\n"
+        "1000,1000,-1000,0\n", csv);
+  rewind(csv);
+  if (h8_motion_convert_csv(csv, out) != 2)
     H8_TEST_FAIL(2)
+  fclose(csv);
+  fclose(out);
 
-  /* 127 + 1 = 128 */
-  dst_byte.u = 127;
-  src_byte.u = 1;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 0 ||
-      system.cpu.ccr.flags.z != 0 ||
-      system.cpu.ccr.flags.v != 1 ||
-      system.cpu.ccr.flags.n != 1 ||
-      result.u != 128)
+  /* Read into the arena if it cannot be mapped */
+  h8_dma_arena_init(&arena, buffer, sizeof(buffer));
+  if (!h8_motion_open(&motion, path, &arena) || motion.count != 2 ||
+      (!motion.mapped && !h8_dma_arena_owns(&arena, motion.base)))
     H8_TEST_FAIL(3)
-
-  /* -128 + (-1) = 127 */
-  dst_byte.i = -128;
-  src_byte.i = -1;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 1 ||
-      system.cpu.ccr.flags.z != 0 ||
-      system.cpu.ccr.flags.v != 1 ||
-      system.cpu.ccr.flags.n != 0 ||
-      result.u != 127)
+  if (!h8_motion_sample(&motion, 500000, &x, &y, &z) ||
+      x != 500 || y != -500 || z != 500)
     H8_TEST_FAIL(4)
-
-  /* 0 + 0 = 0 */
-  dst_byte.u = 0;
-  src_byte.u = 0;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 0 ||
-      system.cpu.ccr.flags.h != 0 ||
-      system.cpu.ccr.flags.z != 1 ||
-      system.cpu.ccr.flags.v != 0 ||
-      system.cpu.ccr.flags.n != 0 ||
-      result.u != 0)
+  if (!h8_motion_sample(&motion, 5000000, &x, &y, &z) ||
+      x != 1000 || y != -1000 || z != 0)
     H8_TEST_FAIL(5)
+  if (!h8_motion_sample(&motion, 0, &x, &y, &z) || z != 1000)
+    H8_TEST_FAIL(6)
 
-  /* 127 + 127 = 254 */
-  dst_byte.u = 127;
-  src_byte.u = 127;
-  result = add_b(&system, dst_byte, src_byte);
-  if (system.cpu.ccr.flags.c != 0 ||
-      system.cpu.ccr.flags.z != 0 ||
-      system.cpu.ccr.flags.v != 1 ||
-      system.cpu.ccr.flags.n != 1 ||
-      result.u != 254)
+  /* Halfway through at the default +/-4g range, 128 LSB/g: 64 and -64 */
+  memset(&system, 0, sizeof(system));
+  memset(&device, 0, sizeof(device));
+  h8_bma150_init(&device);
+  device.system = &system;
+  h8_bma150_set_motion(&device, &motion);
+  system.instructions = H8_INSTRUCTIONS_PER_SECOND / 2;
+  h8_test_bma150_read(&device, 0x02, regs, 6);
+  if (regs[0] != B00000001 || regs[1] != 0x10 ||
+      regs[2] != B00000001 || regs[3] != 0xF0 ||
+      regs[4] != B00000001 || regs[5] != 0x10)
     H8_TEST_FAIL(7)
 
-  printf("Addition test passed!\n");
+  /* No new data until the sensor's next update */
+  h8_test_bma150_read(&device, 0x02, regs, 1);
+  if (regs[0] & B00000001)
+    H8_TEST_FAIL(8)
+  system.instructions += H8_INSTRUCTIONS_PER_SECOND / 1000;
+  h8_test_bma150_read(&device, 0x02, regs, 1);
+  if (!(regs[0] & B00000001))
+    H8_TEST_FAIL(9)
+
+  h8_bma150_set_motion(&device, NULL);
+  h8_motion_close(&motion);
+  h8_dma_free(device.device);
+  remove(path);
+
+  printf("Motion test passed!\n");
 }
 
-int h8_test_bit_manip(void)
+static unsigned h8_test_port_calls;
+static h8_bool h8_test_port_level;
+
+static void h8_test_port_out(h8_device_t *device, const h8_bool on)
 {
-  h8_system_t system = {0};
-  h8_byte_t b, bits, result;
+  H8_UNUSED(device);
+  h8_test_port_calls++;
+  h8_test_port_level = on;
+}
 
-  b.u = 0;
-  bits.u = B10000010;
-  result = bset(&system, b, bits);
-  if (result.u != B00000100)
+/**
+ * Ensures output pin callbacks are only called when their level changes, and
+ * that pins are found in the right register bits.
+ */
+void h8_test_port(void)
+{
+  static h8_system_t system;
+  h8_byte_t value;
+
+  memset(&system, 0, sizeof(system));
+  h8_system_init(&system, H8_SYSTEM_NTR_032);
+  if (system.pdr1.out_mask != B00000111 || !system.pdr1_out[0].device)
     H8_TEST_FAIL(1)
+  system.pdr1_out[0].func = h8_test_port_out;
 
-  bits.u = B00000010;
-  result = bclr(&system, b, bits);
-  if (result.u != 0)
+  /* The first write reaches every pin */
+  value.u = 0x07;
+  h8_write_b(&system, 0xFFD4, value);
+  if (h8_test_port_calls != 1 || !h8_test_port_level)
     H8_TEST_FAIL(2)
 
-  /** @todo Tests for more functions */
+  /* Writes leaving pin 0 alone do not */
+  h8_write_b(&system, 0xFFD4, value);
+  value.u = 0x03;
+  h8_write_b(&system, 0xFFD4, value);
+  if (h8_test_port_calls != 1)
+    H8_TEST_FAIL(3)
 
-  printf("Bit manipulation test passed!\n");
+  value.u = 0x02;
+  h8_write_b(&system, 0xFFD4, value);
+  if (h8_test_port_calls != 2 || h8_test_port_level ||
+      system.vmem.raw[0xFFD4].u != 0x02)
+    H8_TEST_FAIL(4)
+  h8_system_free(&system);
 
-  return 0;
+  printf("Port test passed!\n");
 }
 
-void h8_test_bit_order(void)
+#if H8_PROFILE_SUBSYSTEMS
+/**
+ * Runs a short loop writing to RAM and reading a port data register, which
+ * goes through a read handler, then ensures each involved layer was charged
+ * time and the breakdown adds up.
+ */
+void h8_test_profile(void)
 {
-  h8_ccr_t ccr_test;
+  h8_system_t system = {0};
+  h8_asm_t a;
+  h8_asm_label start, loop;
+  unsigned i;
 
-  ccr_test.raw.u = 0;
-  ccr_test.flags.c = 1;
-  if (ccr_test.raw.u != 1)
-  {
-    printf("This program does not support the current bit ordering.\n"
-           "Try redefining H8_REVERSE_BITFIELDS.\n");
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_w_imm(&a, 100, H8_ASM_R1);
+  loop = h8_asm_here(&a);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, H8_MEMORY_REGION_RAM_1K);
+  h8_asm_mov_b_ld_abs16(&a, 0xFFD6, H8_ASM_R0L);
+  h8_asm_dec_w(&a, 1, H8_ASM_R1);
+  h8_asm_bcc_8(&a, H8_ASM_BNE, loop);
+  h8_asm_sleep(&a);
+  if (!h8_asm_finish(&a))
     H8_TEST_FAIL(1)
-  }
 
-  printf("Bit ordering test passed!\n");
-}
+  h8_init(&system);
+  h8_profile_reset(&system.profile);
+  for (i = 0; i < 1000 && !system.sleep && !system.error_code; i++)
+    h8_step(&system);
+  h8_profile_set_current(NULL);
+  if (!system.sleep || system.profile.depth)
+    H8_TEST_FAIL(2)
+  if (!system.profile.calls[H8_PROFILE_DECODE] ||
+      !system.profile.calls[H8_PROFILE_MEMORY] ||
+      !system.profile.calls[H8_PROFILE_IO] ||
+      !h8_profile_total(&system.profile))
+    H8_TEST_FAIL(3)
+  if (system.profile.calls[H8_PROFILE_DECODE] != i)
+    H8_TEST_FAIL(4)
 
-void h8_test_division(void)
-{
-  h8_system_t system = {0};
-  h8_byte_t b;
-  h8_word_t w;
-  h8_long_t l;
+  /* Prints the breakdown, as it would when a frontend shuts down */
+  h8_system_free(&system);
 
-  w.u = 358;
-  b.u = 2;
-  w = divxu_b(&system, w, b);
-  if (w.l.u != 179 || w.h.u != 0)
+  printf("Profiler test passed!\n");
+}
+#endif
+
+/**
+ * Sleeps in a loop with only the RTC's day interrupt enabled, counting days
+ * in RAM from the handler, and fast-forwards thirty emulated days. The
+ * watchdog is turned off first, as firmware that sleeps this long would.
+ */
+void h8_test_rtc(void)
+{
+  static h8_system_t system;
+  h8_rtc_t *rtc = &system.vmem.parts.io1.rtc;
+  h8_asm_label start, idle, handler;
+  h8_u64 end;
+  h8_asm_t a;
+
+  memset(&system, 0, sizeof(system));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  handler = h8_asm_new_label(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_vector(&a, H8_VECTOR_RTC_DAY, handler);
+
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+  h8_asm_mov_b_imm(&a, H8_IENR1_IENRTC, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_IENR1);
+  h8_asm_mov_b_imm(&a, H8_RTC_EVENT_DAY, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF06D);
+  h8_asm_mov_b_imm(&a, 0xC0, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF06C);
+  h8_asm_andc(&a, 0x7F);
+  idle = h8_asm_here(&a);
+  h8_asm_sleep(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+
+  /* Count the day and acknowledge it */
+  h8_asm_bind(&a, handler);
+  h8_asm_mov_w_ld_abs16(&a, 0xF800, H8_ASM_R1);
+  h8_asm_inc_w(&a, 1, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, 0xF800);
+  h8_asm_mov_b_imm(&a, 0, H8_ASM_R2L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R2L, 0xF067);
+  h8_asm_rte(&a);
+  if (!h8_asm_finish(&a))
     H8_TEST_FAIL(1)
 
-  l.u = 1234567;
-  w.u = 890;
-  l = divxu_w(&system, l, w);
-  if (l.l.u != 1387 || l.h.u != 137)
+  /* 2023-11-14 22:13:20, a Tuesday */
+  h8_init(&system);
+  rtc->rtccr1.flags.om = H8_RTC_24H;
+  h8_rtc_set(rtc, 1700000000);
+  if (rtc->rhrdr.flags.ct != 2 || rtc->rhrdr.flags.co != 2 ||
+      rtc->rwkdr.flags.wk != H8_RTC_TUESDAY)
     H8_TEST_FAIL(2)
 
-  l.u = 999;
-  w.u = 0;
-  divxu_w(&system, l, w);
-  if (system.cpu.ccr.flags.z != 1)
+  end = (h8_u64)30 * 86400 * H8_INSTRUCTIONS_PER_SECOND + 100;
+  h8_run_until(&system, end);
+  if (system.error_code || system.instructions != end)
     H8_TEST_FAIL(3)
+  if (system.vmem.raw[0xF800].u != 0 || system.vmem.raw[0xF801].u != 30)
+    H8_TEST_FAIL(4)
 
-  printf("Division test passed!\n");
+  /* Thirty days on is a Thursday at the same time */
+  if (rtc->rsecdr.flags.ct != 2 || rtc->rsecdr.flags.co != 0 ||
+      rtc->rmindr.flags.ct != 1 || rtc->rmindr.flags.co != 3 ||
+      rtc->rhrdr.flags.ct != 2 || rtc->rhrdr.flags.co != 2 ||
+      rtc->rwkdr.flags.wk != H8_RTC_THURSDAY)
+    H8_TEST_FAIL(5)
+
+  /* Halted, the RTC wakes nothing and does not count */
+  rtc->rtccr1.flags.run = 0;
+  end += H8_INSTRUCTIONS_PER_SECOND;
+  h8_run_until(&system, end);
+  if (rtc->rsecdr.flags.co != 0 || system.instructions != end)
+    H8_TEST_FAIL(6)
+
+  printf("RTC test passed!\n");
 }
 
 void h8_test_shift(void)
@@ -3390,10 +5767,126 @@ void h8_test_size(void)
   if ((void*)&system.vmem.raw[0xffbe] !=
       (void*)&system.vmem.parts.io2.adc.amr)
     H8_TEST_FAIL(8)
+  if ((void*)&system.vmem.raw[0xf068] !=
+      (void*)&system.vmem.parts.io1.rtc.rsecdr)
+    H8_TEST_FAIL(9)
 
   printf("Size test passed!\n");
 }
 
+/**
+ * Streams bytes to the LCD, then reads a block from the EEPROM, switching
+ * between the two with their chip selects on port 1 as the NTR-032 does. Both
+ * transfers are written as loops that H8_SSU_BURSTS recognizes, which must
+ * leave the same state as stepping through them. The second pass has timed
+ * events throughout the transfers, none of which may be handled late.
+ */
+void h8_test_ssu(void)
+{
+  static h8_system_t system;
+  h8_device_t *lcd_device = NULL, *eeprom_device = NULL;
+  h8_asm_label start, data, lcd_loop, eeprom_loop;
+  unsigned i, pass, steps;
+  h8_u64 next;
+  h8_asm_t a;
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    memset(&system, 0, sizeof(system));
+    h8_system_init(&system, H8_SYSTEM_NTR_032);
+    for (i = 0; i < system.device_count; i++)
+      if (system.devices[i].type == H8_DEVICE_LCD)
+        lcd_device = &system.devices[i];
+      else if (system.devices[i].type == H8_DEVICE_EEPROM_64K)
+        eeprom_device = &system.devices[i];
+    if (!lcd_device || !eeprom_device)
+      H8_TEST_FAIL(1)
+    for (i = 0; i < 16; i++)
+      ((h8_u8*)eeprom_device->data)[0x1234 + i] = (h8_u8)(i ^ 0x5A);
+
+    h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+    start = h8_asm_here(&a);
+    data = h8_asm_new_label(&a);
+    h8_asm_vector(&a, H8_VECTOR_RESET, start);
+
+    /* LCD selected in data mode: write 64 bytes of VRAM from ROM */
+    h8_asm_mov_l_imm(&a, 0, H8_ASM_ER2);
+    h8_asm_mov_w_label(&a, data, H8_ASM_R2);
+    h8_asm_mov_b_imm(&a, 0x06, H8_ASM_R0L);
+    h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFD4);
+    h8_asm_mov_w_imm(&a, 64, H8_ASM_R1);
+    lcd_loop = h8_asm_here(&a);
+    h8_asm_mov_b_ld_inc(&a, H8_ASM_ER2, H8_ASM_R3L);
+    h8_asm_mov_b_st_abs16(&a, H8_ASM_R3L, 0xF0EB);
+    h8_asm_dec_w(&a, 1, H8_ASM_R1);
+    h8_asm_bcc_8(&a, H8_ASM_BNE, lcd_loop);
+
+    /* EEPROM selected: READ 16 bytes from 0x1234 into RAM */
+    h8_asm_mov_b_imm(&a, 0x03, H8_ASM_R0L);
+    h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, 0xFFD4);
+    h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+    h8_asm_mov_b_imm(&a, 0x12, H8_ASM_R0L);
+    h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+    h8_asm_mov_b_imm(&a, 0x34, H8_ASM_R0L);
+    h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+    h8_asm_mov_l_imm(&a, 0xF800, H8_ASM_ER4);
+    h8_asm_mov_w_imm(&a, 16, H8_ASM_R1);
+    eeprom_loop = h8_asm_here(&a);
+    h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, 0xF0EB);
+    h8_asm_mov_b_ld_abs16(&a, 0xF0E9, H8_ASM_R5L);
+    h8_asm_mov_b_st_ind(&a, H8_ASM_R5L, H8_ASM_ER4);
+    h8_asm_adds(&a, 1, H8_ASM_ER4);
+    h8_asm_dec_w(&a, 1, H8_ASM_R1);
+    h8_asm_bcc_8(&a, H8_ASM_BNE, eeprom_loop);
+    h8_asm_sleep(&a);
+
+    h8_asm_bind(&a, data);
+    for (i = 0; i < 64; i++)
+      h8_asm_byte(&a, i * 3 + 1);
+    if (!h8_asm_finish(&a))
+      H8_TEST_FAIL(2)
+
+    /* Pin changes on unhooked port 3, every few instructions of the loops */
+    if (pass)
+      for (i = 0; i < 48; i++)
+        if (!h8_input_pin(&system.input, 20 + i * 7, 0xFFD6, 0, i & 1))
+          H8_TEST_FAIL(3)
+    h8_init(&system);
+    for (steps = 0; steps < 1000 && !system.sleep && !system.error_code;
+         steps++)
+    {
+      next = h8_input_next(&system.input);
+      h8_step(&system);
+      if (system.instructions > next)
+        H8_TEST_FAIL(4)
+    }
+    if (!system.sleep || system.ssu_device != eeprom_device)
+      H8_TEST_FAIL(5)
+    for (i = 0; i < 64; i++)
+      if (((h8_lcd_t*)lcd_device->device)->vram[i] != i * 3 + 1)
+        H8_TEST_FAIL(6)
+    for (i = 0; i < 16; i++)
+      if (system.vmem.raw[0xF800 + i].u != (i ^ 0x5A))
+        H8_TEST_FAIL(7)
+    if (system.cpu.regs[1].word.r.u != 0 || !system.cpu.ccr.flags.z ||
+        system.cpu.regs[3].byte.rl.u != 64 * 3 - 2 ||
+        system.cpu.regs[4].er.u != 0xF810 ||
+        system.cpu.regs[5].byte.rl.u != (15 ^ 0x5A) ||
+        system.instructions != 367)
+      H8_TEST_FAIL(8)
+    if (h8_input_next(&system.input) != H8_INPUT_NEVER ||
+        (system.vmem.raw[0xFFD6].u & 0x01) != pass)
+      H8_TEST_FAIL(9)
+#if H8_SSU_BURSTS
+    if (!pass && steps >= system.instructions)
+      H8_TEST_FAIL(10)
+#endif
+    h8_system_free(&system);
+  }
+
+  printf("SSU test passed!\n");
+}
+
 void h8_test_sub(void)
 {
   h8_system_t system = {0};
@@ -3459,15 +5952,320 @@ void h8_test_sub(void)
 
 #endif
 
+#if H8_IR_TRANSPORT
+/**
+ * Waits up to a few seconds for the I/O thread to deliver a frame.
+ * @return The length of the frame, or 0 if none arrived
+ */
+static unsigned h8_test_transport_wait(const h8_transport_t *transport)
+{
+  time_t start = time(NULL);
+  unsigned length;
+
+  while (!(length = h8_transport_peek(transport)) &&
+         time(NULL) - start < 5);
+
+  return length;
+}
+
+/**
+ * Connects two transports over loopback, then ensures frames cross in both
+ * directions with their boundaries and timestamps intact, including one
+ * sent from an IR interface.
+ */
+void h8_test_transport(void)
+{
+  static h8_transport_t server, client;
+  static const h8_u8 hello[5] = { 'H', 'E', 'L', 'L', 'O' };
+  h8_u8 data[16];
+  h8_ir_t ir;
+  h8_byte_t value;
+  h8_u64 time;
+  unsigned i;
+
+  if (!h8_transport_listen(&server, "127.0.0.1", 0) ||
+      !h8_transport_port(&server))
+    H8_TEST_FAIL(1)
+  if (!h8_transport_connect(&client, "127.0.0.1", h8_transport_port(&server)))
+    H8_TEST_FAIL(2)
+
+  /* Queued before the connection completes */
+  if (!h8_transport_send(&client, hello, sizeof(hello), 1234))
+    H8_TEST_FAIL(3)
+  if (h8_test_transport_wait(&server) != sizeof(hello) ||
+      h8_transport_receive(&server, data, sizeof(data), &time) !=
+      sizeof(hello) || memcmp(data, hello, sizeof(hello)) || time != 1234)
+    H8_TEST_FAIL(4)
+
+  /* Back to back frames stay separate */
+  h8_transport_send(&server, hello, 2, 1);
+  h8_transport_send(&server, &hello[2], 3, 2);
+  if (h8_test_transport_wait(&client) != 2 ||
+      h8_transport_receive(&client, data, sizeof(data), &time) != 2 ||
+      time != 1 || h8_test_transport_wait(&client) != 3 ||
+      h8_transport_receive(&client, data, sizeof(data), &time) != 3 ||
+      memcmp(data, &hello[2], 3) || time != 2)
+    H8_TEST_FAIL(5)
+
+  /* An IR transmission arrives as one frame and fills the RX buffer */
+  memset(&ir, 0, sizeof(ir));
+  h8_ir_init(&ir, 16, NULL);
+  ir.transport = &client;
+  for (i = 0; i < sizeof(hello); i++)
+  {
+    value.u = hello[i];
+    h8_ir_out(&ir, value);
+  }
+  h8_ir_transport_flush(&ir, 99);
+  if (h8_test_transport_wait(&server) != sizeof(hello) ||
+      h8_transport_receive(&server, data, sizeof(data), &time) !=
+      sizeof(hello) || time != 99)
+    H8_TEST_FAIL(6)
+  h8_transport_send(&server, data, sizeof(hello), 100);
+  h8_test_transport_wait(&client);
+  h8_ir_transport_poll(&ir);
+  for (i = 0; i < sizeof(hello); i++)
+    if (!h8_ir_in(&ir, &value) || value.u != hello[i])
+      H8_TEST_FAIL(7)
+  h8_ir_free(&ir);
+
+  h8_transport_close(&client);
+  h8_transport_close(&server);
+
+  printf("Transport test passed!\n");
+}
+#endif
+
+/**
+ * Reads TCNT and the TSRW flags after skipping ahead without stepping, then
+ * runs a sleeping program woken a hundred times a second by compare match A.
+ */
+void h8_test_tw(void)
+{
+  static h8_system_t system;
+  h8_tw_t *tw = &system.vmem.parts.io1.tw;
+  h8_asm_label start, idle, handler;
+  h8_byte_t value;
+  h8_asm_t a;
+
+  memset(&system, 0, sizeof(system));
+  h8_init(&system);
+  if (system.tw.deadline != H8_TW_NEVER)
+    H8_TEST_FAIL(1)
+
+  /* Count phi from 0, then skip 100000 instructions */
+  value.u = 0x80;
+  h8_write_b(&system, H8_REG_TMRW, value);
+  system.instructions += 100000;
+  if (h8_read_w(&system, H8_REG_TCNT).u !=
+      (h8_u16)((h8_u64)100000 * H8_SYSTEM_CLOCK_HZ /
+               H8_INSTRUCTIONS_PER_SECOND))
+    H8_TEST_FAIL(2)
+
+  /* TCNT has passed every GR at 0xFFFF and overflowed */
+  if (h8_read_b(&system, H8_REG_TSRW).u != 0xFF)
+    H8_TEST_FAIL(3)
+
+  /* Clearing OVF schedules the next overflow, and nothing else */
+  value.u = 0x7F;
+  h8_write_b(&system, H8_REG_TSRW, value);
+  if (tw->tsrw.raw.u != 0x7F ||
+      system.tw.deadline != 100000 + ((h8_u64)(0x10000 - 0xA000) *
+        H8_INSTRUCTIONS_PER_SECOND + H8_SYSTEM_CLOCK_HZ - 1) /
+        H8_SYSTEM_CLOCK_HZ)
+    H8_TEST_FAIL(4)
+
+  /* A stopped counter holds its value */
+  value.u = 0x00;
+  h8_write_b(&system, H8_REG_TMRW, value);
+  system.instructions += 100000;
+  if (h8_read_w(&system, H8_REG_TCNT).u != 0xA000 ||
+      system.tw.deadline != H8_TW_NEVER || tw->tmrw.raw.u != 0x48)
+    H8_TEST_FAIL(5)
+
+  memset(&system, 0, sizeof(system));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  handler = h8_asm_new_label(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_vector(&a, H8_VECTOR_TIMER_W, handler);
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x92, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD1);
+
+  /* phi/8 cleared every 4608 counts is 100 Hz */
+  h8_asm_mov_w_imm(&a, 4607, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, H8_REG_GRA);
+  h8_asm_mov_b_imm(&a, 0xB0, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, H8_REG_TCRW);
+  h8_asm_mov_b_imm(&a, 0x01, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, H8_REG_TIERW);
+  h8_asm_mov_b_imm(&a, 0x80, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, H8_REG_TMRW);
+  h8_asm_andc(&a, 0x7F);
+  idle = h8_asm_here(&a);
+  h8_asm_sleep(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+
+  /* Count the match and clear its flag */
+  h8_asm_bind(&a, handler);
+  h8_asm_mov_w_ld_abs16(&a, 0xF800, H8_ASM_R1);
+  h8_asm_inc_w(&a, 1, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, 0xF800);
+  h8_asm_mov_b_ld_abs16(&a, H8_REG_TSRW, H8_ASM_R0L);
+  h8_asm_and_b_imm(&a, 0xFE, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs16(&a, H8_ASM_R0L, H8_REG_TSRW);
+  h8_asm_rte(&a);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(6)
+
+  h8_init(&system);
+  h8_run_until(&system, H8_INSTRUCTIONS_PER_SECOND + 5000);
+  if (system.error_code || system.vmem.raw[0xF801].u != 100 ||
+      tw->tsrw.flags.imfa || tw->tsrw.flags.ovf)
+    H8_TEST_FAIL(7)
+
+  printf("Timer W test passed!\n");
+}
+
+/**
+ * Lets the watchdog overflow in both of its modes: first resetting a program
+ * that counts its boots in RAM, then interrupting one that sleeps.
+ */
+void h8_test_wdt(void)
+{
+  static h8_system_t system;
+  h8_wdt_t *wdt = &system.vmem.parts.io2.wdt;
+  h8_asm_label start, idle, handler;
+  h8_byte_t value;
+  h8_asm_t a;
+
+  memset(&system, 0, sizeof(system));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_mov_w_ld_abs16(&a, 0xF800, H8_ASM_R1);
+  h8_asm_inc_w(&a, 1, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, 0xF800);
+  idle = h8_asm_here(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(1)
+
+  /* The on-chip oscillator overflows TCWD every half second */
+  h8_init(&system);
+  system.ssu_device = &system.devices[0];
+  system.pdrb.out_mask = B00000011;
+  system.pdrb.out_driven = B00000011;
+  system.pdrb.out_levels = B00000001;
+  h8_run_until(&system, H8_INSTRUCTIONS_PER_SECOND * 6 / 5);
+  if (system.error_code || system.wdt.resets != 2 ||
+      system.vmem.raw[0xF801].u != 3 || !wdt->tcsrwd1.flags.wrst)
+    H8_TEST_FAIL(2)
+
+  /* The reset deselects the SSU device and forgets the port levels */
+  if (system.ssu_device || system.pdrb.out_driven ||
+      system.pdrb.out_levels || system.pdrb.out_mask != B00000011)
+    H8_TEST_FAIL(3)
+  h8_read_b(&system, H8_REG_TCWD);
+  if (wdt->tcwd.u != 0x100 * 2 / 5)
+    H8_TEST_FAIL(4)
+
+  /* Writing TCWD needs TCWE, which needs B6WI written as 0 */
+  value.u = 0;
+  h8_write_b(&system, H8_REG_TCWD, value);
+  if (h8_read_b(&system, H8_REG_TCWD).u != 0x100 * 2 / 5)
+    H8_TEST_FAIL(5)
+  value.u = 0x6A;
+  h8_write_b(&system, H8_REG_TCSRWD1, value);
+  value.u = 0;
+  h8_write_b(&system, H8_REG_TCWD, value);
+  if (h8_read_b(&system, H8_REG_TCWD).u != 0 || !wdt->tcsrwd1.flags.tcwe ||
+      !wdt->tcsrwd1.flags.wdon)
+    H8_TEST_FAIL(6)
+
+  /* phi/8192 overflows after 256 * 8192 clocks */
+  wdt->tmwd.raw.u = 0xFF;
+  wdt->tcwd.u = 0;
+  h8_wdt_restart(wdt, &system.wdt, 0);
+  if (system.wdt.deadline != ((h8_u64)0x100 * 8192 *
+        H8_INSTRUCTIONS_PER_SECOND + H8_SYSTEM_CLOCK_HZ - 1) /
+        H8_SYSTEM_CLOCK_HZ)
+    H8_TEST_FAIL(7)
+  h8_wdt_sync(wdt, &system.wdt, system.wdt.deadline - 1);
+  if (wdt->tcwd.u != 0xFF)
+    H8_TEST_FAIL(8)
+
+  memset(&system, 0, sizeof(system));
+  h8_asm_init(&a, system.vmem.raw, H8_MEMORY_REGION_IO1);
+  start = h8_asm_here(&a);
+  handler = h8_asm_new_label(&a);
+  h8_asm_vector(&a, H8_VECTOR_RESET, start);
+  h8_asm_vector(&a, H8_VECTOR_WATCHDOG_TIMER, handler);
+  h8_asm_mov_l_imm(&a, 0xFF00, H8_ASM_SP);
+  h8_asm_mov_b_imm(&a, 0x20, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD2);
+  h8_asm_andc(&a, 0x7F);
+  idle = h8_asm_here(&a);
+  h8_asm_sleep(&a);
+  h8_asm_bcc_8(&a, H8_ASM_BRA, idle);
+
+  /* Count the overflow and clear its flag */
+  h8_asm_bind(&a, handler);
+  h8_asm_mov_w_ld_abs16(&a, 0xF800, H8_ASM_R1);
+  h8_asm_inc_w(&a, 1, H8_ASM_R1);
+  h8_asm_mov_w_st_abs16(&a, H8_ASM_R1, 0xF800);
+  h8_asm_mov_b_imm(&a, 0x5F, H8_ASM_R0L);
+  h8_asm_mov_b_st_abs8(&a, H8_ASM_R0L, H8_REG_TCSRWD2);
+  h8_asm_rte(&a);
+  if (!h8_asm_finish(&a))
+    H8_TEST_FAIL(9)
+
+  h8_init(&system);
+  h8_run_until(&system, H8_INSTRUCTIONS_PER_SECOND * 5 + 100);
+  if (system.error_code || system.wdt.resets ||
+      system.vmem.raw[0xF801].u != 10 || wdt->tcsrwd2.flags.ovf)
+    H8_TEST_FAIL(10)
+
+  printf("WDT test passed!\n");
+}
+
 void h8_test(void)
 {
 #if H8_TESTS
+  h8_test_adc();
   h8_test_add();
+  h8_test_arena();
+  h8_test_assembler();
   h8_test_bit_manip();
   h8_test_bit_order();
+  h8_test_capture();
+  h8_test_decode();
   h8_test_division();
+  h8_test_eeprom();
+  h8_test_gait();
+  h8_test_input();
+  h8_test_ir();
+  h8_test_ir_capture();
+  h8_test_lcd();
+  h8_test_lcd_dirty();
+#if H8_LOGGER_DEFERRED
+  h8_test_logger();
+#endif
+  h8_test_motion();
+  h8_test_port();
+#if H8_PROFILE_SUBSYSTEMS
+  h8_test_profile();
+#endif
+  h8_test_rtc();
   h8_test_shift();
   h8_test_size();
+  h8_test_ssu();
   h8_test_sub();
+#if H8_IR_TRANSPORT
+  h8_test_transport();
+#endif
+  h8_test_tw();
+  h8_test_wdt();
 #endif
 }
@@ -0,0 +1,85 @@
+#include "input.h"
+
+#define H8_INPUT_MASK (H8_INPUT_QUEUE_EVENTS - 1)
+
+/** @return Whether an address is the data register of an IO port */
+static h8_bool h8_input_port(unsigned address)
+{
+  switch (address)
+  {
+  case 0xFFD4: /* PDR1 */
+  case 0xFFD6: /* PDR3 */
+  case 0xFFDB: /* PDR8 */
+  case 0xFFDC: /* PDR9 */
+  case 0xFFDE: /* PDRB */
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+h8_bool h8_input_post(h8_input_queue_t *queue, const h8_input_event_t *event)
+{
+  unsigned tail = H8_LOAD_ACQUIRE(queue->tail);
+
+  if (event->type == H8_INPUT_PIN &&
+      (!h8_input_port(event->address) || event->index > 7))
+    return FALSE;
+  else if (queue->head - tail >= H8_INPUT_QUEUE_EVENTS)
+  {
+    queue->dropped++;
+    return FALSE;
+  }
+  queue->events[queue->head & H8_INPUT_MASK] = *event;
+  H8_STORE_RELEASE(queue->head, queue->head + 1);
+
+  return TRUE;
+}
+
+h8_bool h8_input_button(h8_input_queue_t *queue, h8_u64 time,
+                        unsigned button, h8_bool pressed)
+{
+  h8_input_event_t event;
+
+  event.time = time;
+  event.address = 0;
+  event.type = H8_INPUT_BUTTON;
+  event.index = (h8_u8)button;
+  event.level = pressed ? 1 : 0;
+
+  return h8_input_post(queue, &event);
+}
+
+h8_bool h8_input_pin(h8_input_queue_t *queue, h8_u64 time, unsigned address,
+                     unsigned pin, h8_bool level)
+{
+  h8_input_event_t event;
+
+  event.time = time;
+  event.address = (h8_u16)address;
+  event.type = H8_INPUT_PIN;
+  event.index = (h8_u8)pin;
+  event.level = level ? 1 : 0;
+
+  return h8_input_post(queue, &event);
+}
+
+const h8_input_event_t *h8_input_front(const h8_input_queue_t *queue)
+{
+  if (queue->tail == H8_LOAD_ACQUIRE(queue->head))
+    return NULL;
+
+  return &queue->events[queue->tail & H8_INPUT_MASK];
+}
+
+void h8_input_pop(h8_input_queue_t *queue)
+{
+  H8_STORE_RELEASE(queue->tail, queue->tail + 1);
+}
+
+h8_u64 h8_input_next(const h8_input_queue_t *queue)
+{
+  const h8_input_event_t *event = h8_input_front(queue);
+
+  return event ? event->time : H8_INPUT_NEVER;
+}
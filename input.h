@@ -0,0 +1,101 @@
+#ifndef H8_INPUT_H
+#define H8_INPUT_H
+
+#include "config.h"
+#include "types.h"
+
+/**
+ * Input changes posted by a frontend or script, each stamped with the
+ * emulated time at which it takes effect. One producer thread, such as a UI
+ * thread, pushes events while the emulator pops them, without locks.
+ *
+ * Because changes are applied at their timestamp rather than whenever the
+ * frontend gets to them, a press and its release can be placed far enough
+ * apart for the firmware to see the press, however briefly it was held, and
+ * scripted input replays the same way every time.
+ *
+ * Events are applied in the order they were posted, so they should be posted
+ * in order of time; one stamped earlier than the event before it takes
+ * effect along with that one. Events posted during h8_run_until are picked up
+ * before its next instruction.
+ *
+ * The emulator thread updates `system->instructions` without synchronization,
+ * so another thread must not read it to stamp events while a run is under
+ * way. Stamp them with a time that thread keeps itself, such as the target of
+ * the last h8_run_until it requested.
+ */
+
+typedef enum
+{
+  /** Sets whether a button of the system's button device is held */
+  H8_INPUT_BUTTON = 0,
+
+  /** Sets the level of a port pin that has no device hooked to it */
+  H8_INPUT_PIN
+} h8_input_type;
+
+typedef struct
+{
+  /** The instruction count at which the change takes effect */
+  h8_u64 time;
+
+  /** For H8_INPUT_PIN, the address of the port data register */
+  h8_u16 address;
+
+  h8_u8 type;
+
+  /** The button, or the bit of the pin in its port data register */
+  h8_u8 index;
+
+  h8_u8 level;
+} h8_input_event_t;
+
+/**
+ * Events passed from one producer to the emulator. The head and tail count
+ * every event ever pushed and popped. A zeroed queue is empty.
+ */
+typedef struct
+{
+  h8_input_event_t events[H8_INPUT_QUEUE_EVENTS];
+  unsigned head;
+  unsigned tail;
+
+  /** Events the producer could not post because the queue was full */
+  unsigned long dropped;
+} h8_input_queue_t;
+
+/** The time of the next event, while there is none */
+#define H8_INPUT_NEVER (~(h8_u64)0)
+
+/**
+ * Posts an event. Only call from one thread at a time.
+ * @return FALSE if the event is invalid or the queue is full
+ */
+h8_bool h8_input_post(h8_input_queue_t *queue, const h8_input_event_t *event);
+
+/**
+ * Posts a button press or release.
+ * @param time The instruction count at which the change takes effect
+ */
+h8_bool h8_input_button(h8_input_queue_t *queue, h8_u64 time,
+                        unsigned button, h8_bool pressed);
+
+/**
+ * Posts a change in the level of an input pin.
+ * @param address The address of the port data register: 0xFFD4 (PDR1),
+ * 0xFFD6 (PDR3), 0xFFDB (PDR8), 0xFFDC (PDR9) or 0xFFDE (PDRB)
+ * @param pin The bit of the pin in the register
+ */
+h8_bool h8_input_pin(h8_input_queue_t *queue, h8_u64 time, unsigned address,
+                     unsigned pin, h8_bool level);
+
+/** @return The oldest event, or NULL if the queue is empty */
+const h8_input_event_t *h8_input_front(const h8_input_queue_t *queue);
+
+/** Removes the oldest event, after it has been applied */
+void h8_input_pop(h8_input_queue_t *queue);
+
+/** @return The time of the oldest event, or H8_INPUT_NEVER */
+h8_u64 h8_input_next(const h8_input_queue_t *queue);
+
+#endif
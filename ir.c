@@ -1,83 +1,365 @@
 #include "ir.h"
 
+#include "dma.h"
 #include "frontend.h"
 #include "logger.h"
+#include "transport.h"
 
-/** @todo remove */
-#include <stdio.h>
+#include <string.h>
 
-h8_bool h8_ir_out(h8_ir_t *ir, h8_byte_t out)
+#if H8_LOGGER_DEFERRED
+/**
+ * The number of bytes shown in hex when logging a transfer, which keeps the
+ * string within what a deferred log record can hold
+ */
+#define H8_IR_LOG_BYTES ((H8_LOG_STRINGS_SIZE - 1) / 2)
+#else
+#define H8_IR_LOG_BYTES 16
+#endif
+
+void h8_ir_init(h8_ir_t *ir, unsigned size, h8_dma_arena_t *arena)
 {
-  if (ir->tx_len < H8_IR_BUFFER_LEN)
-  {
-    ir->tx[ir->tx_len] = out;
-    ir->tx_len++;
+  unsigned capacity = 1;
 
-    return TRUE;
+  while (capacity < size)
+    capacity <<= 1;
+  h8_ir_free(ir);
+  ir->arena = arena;
+  if (arena)
+  {
+    ir->rx.data = h8_dma_arena_alloc(arena, capacity * sizeof(h8_byte_t),
+                                     TRUE);
+    ir->tx.data = h8_dma_arena_alloc(arena, capacity * sizeof(h8_byte_t),
+                                     TRUE);
   }
   else
-    return FALSE;
+  {
+    ir->rx.data = h8_dma_alloc(capacity * sizeof(h8_byte_t), TRUE);
+    ir->tx.data = h8_dma_alloc(capacity * sizeof(h8_byte_t), TRUE);
+  }
+  ir->rx.size = capacity;
+  ir->tx.size = capacity;
 }
 
-h8_bool h8_ir_in(h8_ir_t *ir, h8_byte_t *in)
+void h8_ir_free(h8_ir_t *ir)
 {
-  if (ir->rx_len > 0)
+  h8_ir_link_detach(ir);
+  if (!ir->arena)
   {
-    unsigned i;
+    if (ir->rx.data)
+      h8_dma_free(ir->rx.data);
+    if (ir->tx.data)
+      h8_dma_free(ir->tx.data);
+  }
+  memset(ir, 0, sizeof(*ir));
+}
 
-    *in = ir->rx[0];
-    ir->rx_len--;
-    for (i = 0; i < ir->rx_len; i++)
-      ir->rx[i] = ir->rx[i + 1];
+unsigned h8_ir_ring_count(const h8_ir_ring_t *ring)
+{
+  return ring->head - ring->tail;
+}
 
-    return TRUE;
-  }
-  else
+h8_bool h8_ir_ring_push(h8_ir_ring_t *ring, h8_byte_t value)
+{
+  if (ring->head - ring->tail >= ring->size)
     return FALSE;
+  ring->data[ring->head++ & (ring->size - 1)] = value;
+
+  return TRUE;
 }
 
-void h8_ir_receive(h8_ir_t *ir)
+h8_bool h8_ir_ring_pop(h8_ir_ring_t *ring, h8_byte_t *value)
 {
-  char log[32];
-  unsigned i;
-  unsigned len = 0;
+  if (ring->head == ring->tail)
+    return FALSE;
+  *value = ring->data[ring->tail++ & (ring->size - 1)];
+
+  return TRUE;
+}
+
+unsigned h8_ir_ring_peek_span(const h8_ir_ring_t *ring, h8_byte_t **span)
+{
+  unsigned start, count = ring->head - ring->tail;
+
+  if (!count)
+    return 0;
+  start = ring->tail & (ring->size - 1);
+  *span = &ring->data[start];
+
+  return count < ring->size - start ? count : ring->size - start;
+}
+
+void h8_ir_ring_consume(h8_ir_ring_t *ring, unsigned count)
+{
+  ring->tail += count;
+}
+
+unsigned h8_ir_ring_free_span(const h8_ir_ring_t *ring, h8_byte_t **span)
+{
+  unsigned start, count = ring->size - (ring->head - ring->tail);
 
-  log[0] = '\0';
+  if (!count)
+    return 0;
+  start = ring->head & (ring->size - 1);
+  *span = &ring->data[start];
 
-  for (i = 0; i < ir->rx_len && len < sizeof(log) - 3; i++)
+  return count < ring->size - start ? count : ring->size - start;
+}
+
+void h8_ir_ring_commit(h8_ir_ring_t *ring, unsigned count)
+{
+  ring->head += count;
+}
+
+unsigned h8_ir_ring_write(h8_ir_ring_t *ring, const h8_byte_t *src,
+                          unsigned count)
+{
+  unsigned done = 0;
+
+  while (done < count)
   {
-    int written = snprintf(&log[len], sizeof(log) - len, "%02X", ir->rx[i].u);
+    h8_byte_t *span;
+    unsigned size = h8_ir_ring_free_span(ring, &span);
 
-    if (written < 0 || (size_t)written >= sizeof(log) - len)
+    if (!size)
       break;
-    len += written;
+    if (size > count - done)
+      size = count - done;
+    memcpy(span, &src[done], size * sizeof(h8_byte_t));
+    h8_ir_ring_commit(ring, size);
+    done += size;
   }
 
-  h8_log(H8_LOG_WARN, H8_LOG_IR, "Unimplemented receive: %u <- %s",
-         ir->rx_len, log);
-  h8_fe_network_receive(ir->rx, ir->rx_len);
-  ir->rx_len = 0;
+  return done;
 }
 
-void h8_ir_transmit(h8_ir_t *ir)
+unsigned h8_ir_ring_read(h8_ir_ring_t *ring, h8_byte_t *dst, unsigned count)
+{
+  unsigned done = 0;
+
+  while (done < count)
+  {
+    h8_byte_t *span;
+    unsigned size = h8_ir_ring_peek_span(ring, &span);
+
+    if (!size)
+      break;
+    if (size > count - done)
+      size = count - done;
+    memcpy(&dst[done], span, size * sizeof(h8_byte_t));
+    h8_ir_ring_consume(ring, size);
+    done += size;
+  }
+
+  return done;
+}
+
+void h8_ir_link_init(h8_ir_link_t *link)
+{
+  memset(link, 0, sizeof(*link));
+}
+
+h8_bool h8_ir_link_attach(h8_ir_link_t *link, h8_ir_t *ir)
+{
+  unsigned i, j;
+
+  for (i = 0; i < H8_IR_LINK_ENDPOINTS; i++)
+  {
+    if (!link->endpoints[i].attached)
+    {
+      /* Start reading each queue from where it is now */
+      for (j = 0; j < H8_IR_LINK_ENDPOINTS; j++)
+        link->endpoints[j].tails[i] = link->endpoints[j].head;
+      link->endpoints[i].attached = TRUE;
+      ir->link = link;
+      ir->endpoint = i;
+      ir->busy_until_us = 0;
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+void h8_ir_link_detach(h8_ir_t *ir)
+{
+  if (ir->link)
+  {
+    ir->link->endpoints[ir->endpoint].attached = FALSE;
+    ir->link = NULL;
+  }
+}
+
+h8_bool h8_ir_link_send(h8_ir_t *ir, h8_byte_t value, h8_u64 time_us,
+                        h8_u64 byte_us)
 {
-  char log[32];
+  h8_ir_link_endpoint_t *sender = &ir->link->endpoints[ir->endpoint];
+  h8_ir_link_byte_t *entry;
   unsigned i;
-  unsigned len = 0;
 
-  log[0] = '\0';
+  /* The slowest receiver decides whether there is space */
+  for (i = 0; i < H8_IR_LINK_ENDPOINTS; i++)
+  {
+    if (i != ir->endpoint && ir->link->endpoints[i].attached &&
+        sender->head - H8_LOAD_ACQUIRE(sender->tails[i]) >=
+        H8_IR_LINK_QUEUE_SIZE)
+    {
+      sender->dropped++;
+      return FALSE;
+    }
+  }
+
+  if (ir->busy_until_us > time_us)
+    time_us = ir->busy_until_us;
+  ir->busy_until_us = time_us + byte_us;
+  entry = &sender->queue[sender->head & (H8_IR_LINK_QUEUE_SIZE - 1)];
+  entry->due_us = ir->busy_until_us;
+  entry->value = value;
+  H8_STORE_RELEASE(sender->head, sender->head + 1);
+
+  return TRUE;
+}
+
+unsigned h8_ir_link_poll(h8_ir_t *ir, h8_u64 time_us)
+{
+  unsigned i, received = 0;
 
-  for (i = 0; i < ir->tx_len && len < sizeof(log) - 3; i++)
+  for (i = 0; i < H8_IR_LINK_ENDPOINTS; i++)
   {
-    int written = snprintf(&log[len], sizeof(log) - len, "%02X", ir->tx[i].u);
+    h8_ir_link_endpoint_t *sender = &ir->link->endpoints[i];
+    unsigned *tail = &sender->tails[ir->endpoint];
+    unsigned head, position;
 
-    if (written < 0 || (size_t)written >= sizeof(log) - len)
-      break;
-    len += written;
+    if (i == ir->endpoint || !sender->attached)
+      continue;
+    head = H8_LOAD_ACQUIRE(sender->head);
+    position = *tail;
+    while (position != head)
+    {
+      const h8_ir_link_byte_t *entry =
+        &sender->queue[position & (H8_IR_LINK_QUEUE_SIZE - 1)];
+
+      if (entry->due_us > time_us || !h8_ir_ring_push(&ir->rx, entry->value))
+        break;
+      position++;
+      received++;
+    }
+    H8_STORE_RELEASE(*tail, position);
+  }
+
+  return received;
+}
+
+h8_bool h8_ir_out(h8_ir_t *ir, h8_byte_t out)
+{
+  return h8_ir_ring_push(&ir->tx, out);
+}
+
+h8_bool h8_ir_in(h8_ir_t *ir, h8_byte_t *in)
+{
+  return h8_ir_ring_pop(&ir->rx, in);
+}
+
+#if H8_LOGGER_MIN_LEVEL <= 3 /* H8_LOG_WARN */
+/** Formats the first queued bytes of a ring in hex, for logging */
+static void h8_ir_hex(const h8_ir_ring_t *ring, char *dst)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  unsigned i, count = h8_ir_ring_count(ring);
+
+  if (count > H8_IR_LOG_BYTES)
+    count = H8_IR_LOG_BYTES;
+  for (i = 0; i < count; i++)
+  {
+    h8_u8 value = ring->data[(ring->tail + i) & (ring->size - 1)].u;
+
+    *dst++ = digits[value >> 4];
+    *dst++ = digits[value & 0xF];
   }
+  *dst = '\0';
+}
+#endif
+
+void h8_ir_receive(h8_ir_t *ir)
+{
+  h8_byte_t *span;
+  unsigned space = h8_ir_ring_free_span(&ir->rx, &span);
+
+  /* A size of 0 means no limit to the frontend, so never ask for it */
+  if (space)
+    h8_ir_ring_commit(&ir->rx, h8_fe_network_receive(span, space));
 
-  h8_log(H8_LOG_WARN, H8_LOG_IR, "Unimplemented transmit: %u -> %s",
-         ir->tx_len, log);
-  h8_fe_network_transmit(ir->tx, ir->tx_len);
-  ir->tx_len = 0;
+#if H8_LOGGER_MIN_LEVEL <= 3 /* H8_LOG_WARN */
+  if (H8_LOG_ENABLED(H8_LOG_WARN, H8_LOG_IR))
+  {
+    char log[H8_IR_LOG_BYTES * 2 + 1];
+
+    h8_ir_hex(&ir->rx, log);
+    H8_LOGW(H8_LOG_IR, ("Receive: %u <- %s", h8_ir_ring_count(&ir->rx), log));
+  }
+#endif
+}
+
+void h8_ir_transport_poll(h8_ir_t *ir)
+{
+  unsigned length;
+
+  while ((length = h8_transport_peek(ir->transport)) != 0 &&
+         length <= ir->rx.size - h8_ir_ring_count(&ir->rx))
+  {
+    h8_u8 data[H8_TRANSPORT_FRAME_MAX];
+    unsigned i;
+
+    h8_transport_receive(ir->transport, data, sizeof(data), NULL);
+    for (i = 0; i < length; i++)
+    {
+      h8_byte_t value;
+
+      value.u = data[i];
+      h8_ir_ring_push(&ir->rx, value);
+    }
+  }
+}
+
+void h8_ir_transport_flush(h8_ir_t *ir, h8_u64 time)
+{
+  h8_byte_t *span;
+  unsigned size;
+
+  while ((size = h8_ir_ring_peek_span(&ir->tx, &span)) != 0)
+  {
+    h8_u8 data[H8_TRANSPORT_FRAME_MAX];
+    unsigned i;
+
+    if (size > sizeof(data))
+      size = sizeof(data);
+    for (i = 0; i < size; i++)
+      data[i] = span[i].u;
+    if (!h8_transport_send(ir->transport, data, size, time))
+      H8_LOGW(H8_LOG_IR, ("Transport queue full, dropped %u bytes", size));
+    h8_ir_ring_consume(&ir->tx, size);
+  }
+}
+
+void h8_ir_transmit(h8_ir_t *ir)
+{
+  h8_byte_t *span;
+  unsigned size;
+
+#if H8_LOGGER_MIN_LEVEL <= 3 /* H8_LOG_WARN */
+  if (H8_LOG_ENABLED(H8_LOG_WARN, H8_LOG_IR))
+  {
+    char log[H8_IR_LOG_BYTES * 2 + 1];
+
+    h8_ir_hex(&ir->tx, log);
+    H8_LOGW(H8_LOG_IR, ("Transmit: %u -> %s", h8_ir_ring_count(&ir->tx), log));
+  }
+#endif
+
+  while ((size = h8_ir_ring_peek_span(&ir->tx, &span)) != 0)
+  {
+    h8_fe_network_transmit(span, size);
+    h8_ir_ring_consume(&ir->tx, size);
+  }
 }
@@ -1,18 +1,163 @@
 #ifndef H8_IR_H
 #define H8_IR_H
 
+#include "dma.h"
 #include "types.h"
 
-#define H8_IR_BUFFER_LEN 8
+/**
+ * A byte queue whose size is a power of two, so positions wrap with a mask.
+ * The head and tail count every byte ever pushed and popped, and their
+ * difference is the number of bytes queued.
+ */
+typedef struct
+{
+  h8_byte_t *data;
+  unsigned size;
+  unsigned head;
+  unsigned tail;
+} h8_ir_ring_t;
 
 typedef struct
 {
-  h8_byte_t rx[H8_IR_BUFFER_LEN];
-  unsigned rx_len;
-  h8_byte_t tx[H8_IR_BUFFER_LEN];
-  unsigned tx_len;
+  /** Bytes received from the link, waiting for the firmware to read them */
+  h8_ir_ring_t rx;
+
+  /** Bytes written by the firmware, waiting to be transmitted */
+  h8_ir_ring_t tx;
+
+  /** The in-process link this interface is attached to, if any */
+  struct h8_ir_link_t *link;
+  unsigned endpoint;
+
+  /** When the byte last sent over the link finishes, in emulated time */
+  h8_u64 busy_until_us;
+
+  /**
+   * The network transport this interface sends and receives through, if
+   * any, in place of the frontend
+   */
+  struct h8_transport_t *transport;
+
+  /** The capture recording traffic through this interface, if any */
+  struct h8_ir_capture_t *capture;
+
+  /** The arena both queues were carved from, or NULL if allocated alone */
+  h8_dma_arena_t *arena;
 } h8_ir_t;
 
+/** A byte in flight over an in-process IR link */
+typedef struct
+{
+  /** The emulated time at which the last bit has arrived */
+  h8_u64 due_us;
+  h8_byte_t value;
+} h8_ir_link_byte_t;
+
+/**
+ * The bytes one endpoint has sent. Only that endpoint pushes, and each other
+ * endpoint pops with its own tail, so no locks are needed.
+ */
+typedef struct
+{
+  h8_ir_link_byte_t queue[H8_IR_LINK_QUEUE_SIZE];
+  unsigned head;
+  unsigned tails[H8_IR_LINK_ENDPOINTS];
+  h8_bool attached;
+
+  /** Bytes dropped because a receiver had fallen too far behind */
+  unsigned long dropped;
+} h8_ir_link_endpoint_t;
+
+/**
+ * Connects the IR interfaces of systems in the same process, as if their
+ * windows faced each other, without going through the network frontend.
+ * Every byte sent reaches every other endpoint once the emulated time to
+ * shift it out at the sender's SCI3 bit rate has passed on the receiver.
+ *
+ * Each system may run on its own thread, but attaching and detaching must
+ * happen while none of them are running.
+ */
+typedef struct h8_ir_link_t
+{
+  h8_ir_link_endpoint_t endpoints[H8_IR_LINK_ENDPOINTS];
+} h8_ir_link_t;
+
+/**
+ * Allocates both queues of an IR interface.
+ * @param size The capacity of each queue, rounded up to a power of two
+ * @param arena The arena to carve the queues from, such as that of the
+ * system, or NULL to allocate them with h8_dma_alloc. Queues carved from an
+ * arena are released with it rather than by h8_ir_free.
+ */
+void h8_ir_init(h8_ir_t *ir, unsigned size, h8_dma_arena_t *arena);
+
+void h8_ir_free(h8_ir_t *ir);
+
+/** @return The number of bytes queued */
+unsigned h8_ir_ring_count(const h8_ir_ring_t *ring);
+
+h8_bool h8_ir_ring_push(h8_ir_ring_t *ring, h8_byte_t value);
+
+h8_bool h8_ir_ring_pop(h8_ir_ring_t *ring, h8_byte_t *value);
+
+/**
+ * Queues as many bytes as fit.
+ * @return The number of bytes queued
+ */
+unsigned h8_ir_ring_write(h8_ir_ring_t *ring, const h8_byte_t *src,
+                          unsigned count);
+
+/**
+ * Dequeues up to a number of bytes.
+ * @return The number of bytes dequeued
+ */
+unsigned h8_ir_ring_read(h8_ir_ring_t *ring, h8_byte_t *dst, unsigned count);
+
+/**
+ * Gets the queued bytes that are contiguous in memory, for consuming them in
+ * place. Follow with h8_ir_ring_consume; call twice to reach bytes that wrap.
+ * @return The number of bytes at *span
+ */
+unsigned h8_ir_ring_peek_span(const h8_ir_ring_t *ring, h8_byte_t **span);
+
+void h8_ir_ring_consume(h8_ir_ring_t *ring, unsigned count);
+
+/**
+ * Gets the free space that is contiguous in memory, for filling it in place.
+ * Follow with h8_ir_ring_commit.
+ * @return The number of bytes available at *span
+ */
+unsigned h8_ir_ring_free_span(const h8_ir_ring_t *ring, h8_byte_t **span);
+
+void h8_ir_ring_commit(h8_ir_ring_t *ring, unsigned count);
+
+void h8_ir_link_init(h8_ir_link_t *link);
+
+/**
+ * Attaches an IR interface to a link. Bytes sent before attaching are not
+ * received.
+ * @return FALSE if every endpoint is in use
+ */
+h8_bool h8_ir_link_attach(h8_ir_link_t *link, h8_ir_t *ir);
+
+void h8_ir_link_detach(h8_ir_t *ir);
+
+/**
+ * Sends a byte to every other endpoint. It is shifted out after any byte
+ * still being sent.
+ * @param time_us The current emulated time of the sender
+ * @param byte_us How long one byte takes at the sender's bit rate
+ * @return FALSE if a receiver's queue is full and the byte was dropped
+ */
+h8_bool h8_ir_link_send(h8_ir_t *ir, h8_byte_t value, h8_u64 time_us,
+                        h8_u64 byte_us);
+
+/**
+ * Moves bytes that have arrived by an emulated time into the RX buffer.
+ * @return The number of bytes received
+ */
+unsigned h8_ir_link_poll(h8_ir_t *ir, h8_u64 time_us);
+
 h8_bool h8_ir_in(h8_ir_t *ir, h8_byte_t *value);
 
 /**
@@ -20,8 +165,24 @@ h8_bool h8_ir_in(h8_ir_t *ir, h8_byte_t *value);
  */
 h8_bool h8_ir_out(h8_ir_t *ir, h8_byte_t out);
 
+/**
+ * Fills the RX buffer with whatever the frontend has received, up to the
+ * space available
+ */
 void h8_ir_receive(h8_ir_t *ir);
 
+/**
+ * Moves frames received by the network transport into the RX buffer, as long
+ * as each fits whole
+ */
+void h8_ir_transport_poll(h8_ir_t *ir);
+
+/**
+ * Sends the TX buffer through the network transport as one frame.
+ * @param time The sender's emulated time, in instructions
+ */
+void h8_ir_transport_flush(h8_ir_t *ir, h8_u64 time);
+
 /**
  * Transmit the finalized TX buffer via TCP/IP
  * Should be called when the TE bit in SCR is cleared to 0 (?)
@@ -0,0 +1,282 @@
+#include "ir_capture.h"
+
+#include <string.h>
+
+static const h8_u8 magic[4] = { 'H', '8', 'I', 'R' };
+
+static void h8_ir_capture_put(h8_u8 *dst, h8_u64 value, unsigned size)
+{
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    dst[i] = (h8_u8)(value >> (i * 8));
+}
+
+static h8_u64 h8_ir_capture_get(const h8_u8 *src, unsigned size)
+{
+  h8_u64 value = 0;
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    value |= (h8_u64)src[i] << (i * 8);
+
+  return value;
+}
+
+static void h8_ir_capture_write(h8_ir_capture_t *capture)
+{
+  if (capture->used &&
+      fwrite(capture->buffer, capture->used, 1, capture->file) != 1)
+    capture->failed = TRUE;
+  capture->used = 0;
+}
+
+/** Moves the packet being collected into the write buffer */
+static void h8_ir_capture_end(h8_ir_capture_t *capture)
+{
+  h8_ir_capture_record_t *packet = &capture->packet;
+  h8_u8 *record;
+
+  if (!packet->length)
+    return;
+  if (capture->used + H8_IR_CAPTURE_RECORD_HEADER + packet->length >
+      H8_IR_CAPTURE_BUFFER)
+    h8_ir_capture_write(capture);
+
+  record = &capture->buffer[capture->used];
+  h8_ir_capture_put(&record[0], packet->time, 8);
+  h8_ir_capture_put(&record[8], capture->last_time - packet->time, 4);
+  record[12] = packet->direction;
+  h8_ir_capture_put(&record[13], packet->length, 2);
+  memcpy(&record[H8_IR_CAPTURE_RECORD_HEADER], packet->data, packet->length);
+  capture->used += H8_IR_CAPTURE_RECORD_HEADER + packet->length;
+  capture->records++;
+  packet->length = 0;
+}
+
+h8_bool h8_ir_capture_init(h8_ir_capture_t *capture, FILE *file)
+{
+  h8_u8 header[H8_IR_CAPTURE_HEADER];
+
+  if (!capture || !file)
+    return FALSE;
+  memset(capture, 0, sizeof(*capture));
+  capture->file = file;
+
+  memcpy(header, magic, sizeof(magic));
+  h8_ir_capture_put(&header[4], H8_IR_CAPTURE_VERSION, 2);
+  h8_ir_capture_put(&header[6], 0, 2);
+  h8_ir_capture_put(&header[8], H8_INSTRUCTIONS_PER_SECOND, 4);
+
+  return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+void h8_ir_capture_byte(h8_ir_capture_t *capture,
+                        h8_ir_capture_direction direction, h8_u8 value,
+                        h8_u64 time)
+{
+  h8_ir_capture_record_t *packet = &capture->packet;
+
+  if (capture->failed)
+    return;
+  else if (packet->length &&
+           (packet->direction != direction ||
+            time - capture->last_time > H8_IR_CAPTURE_PACKET_GAP ||
+            packet->length == H8_IR_CAPTURE_RECORD_MAX))
+    h8_ir_capture_end(capture);
+
+  if (!packet->length)
+  {
+    packet->time = time;
+    packet->direction = (h8_u8)direction;
+  }
+  packet->data[packet->length++] = value;
+  capture->last_time = time;
+}
+
+h8_bool h8_ir_capture_flush(h8_ir_capture_t *capture)
+{
+  h8_ir_capture_end(capture);
+  h8_ir_capture_write(capture);
+
+  return !capture->failed;
+}
+
+h8_bool h8_ir_capture_reader_init(h8_ir_capture_reader_t *reader, FILE *file)
+{
+  h8_u8 header[H8_IR_CAPTURE_HEADER];
+
+  if (!reader || !file)
+    return FALSE;
+  reader->file = file;
+
+  if (fread(header, sizeof(header), 1, file) != 1 ||
+      memcmp(header, magic, sizeof(magic)) ||
+      h8_ir_capture_get(&header[4], 2) != H8_IR_CAPTURE_VERSION)
+    return FALSE;
+  reader->instructions_per_second =
+    (unsigned long)h8_ir_capture_get(&header[8], 4);
+
+  return TRUE;
+}
+
+h8_bool h8_ir_capture_read(h8_ir_capture_reader_t *reader,
+                           h8_ir_capture_record_t *record)
+{
+  h8_u8 header[H8_IR_CAPTURE_RECORD_HEADER];
+
+  if (fread(header, sizeof(header), 1, reader->file) != 1)
+    return FALSE;
+  record->time = h8_ir_capture_get(&header[0], 8);
+  record->span = (unsigned long)h8_ir_capture_get(&header[8], 4);
+  record->direction = header[12];
+  record->length = (unsigned)h8_ir_capture_get(&header[13], 2);
+
+  return record->length <= H8_IR_CAPTURE_RECORD_MAX &&
+         record->direction <= H8_IR_CAPTURE_RX &&
+         (!record->length ||
+          fread(record->data, record->length, 1, reader->file) == 1);
+}
+
+/** A packet reassembled from one or more records */
+typedef struct
+{
+  h8_u64 start;
+  h8_u64 end;
+  h8_u8 direction;
+  unsigned long length;
+
+  /** FNV-1a of the bytes, for spotting retransmits */
+  h8_u32 hash;
+} h8_ir_capture_packet_t;
+
+typedef struct
+{
+  unsigned long packets;
+  unsigned long bytes;
+  unsigned long retransmits;
+  h8_u32 last_hash;
+  unsigned long last_length;
+} h8_ir_capture_side_t;
+
+typedef struct
+{
+  unsigned long number;
+  h8_bool open;
+  h8_u64 start;
+  h8_u64 end;
+  h8_u8 last_direction;
+  h8_ir_capture_side_t sides[2];
+  unsigned long replies;
+  h8_u64 latency_total;
+  h8_u64 latency_max;
+} h8_ir_capture_session_t;
+
+static void h8_ir_capture_print(const h8_ir_capture_session_t *session,
+                                FILE *out)
+{
+  static const char *names[2] = { "TX", "RX" };
+  unsigned i;
+
+  fprintf(out, "Session %lu: %lu to %lu (%lu instructions)\n",
+          session->number, (unsigned long)session->start,
+          (unsigned long)session->end,
+          (unsigned long)(session->end - session->start));
+  for (i = 0; i < 2; i++)
+    fprintf(out, "  %s: %lu packets, %lu bytes, %lu retransmits\n",
+            names[i], session->sides[i].packets, session->sides[i].bytes,
+            session->sides[i].retransmits);
+  fprintf(out, "  Replies: %lu, latency %lu average, %lu max instructions\n",
+          session->replies,
+          session->replies ?
+            (unsigned long)(session->latency_total / session->replies) : 0UL,
+          (unsigned long)session->latency_max);
+}
+
+static void h8_ir_capture_add(h8_ir_capture_session_t *session,
+                              const h8_ir_capture_packet_t *packet,
+                              h8_u64 session_gap, FILE *out)
+{
+  h8_ir_capture_side_t *side;
+
+  if (session->open && packet->start - session->end > session_gap)
+  {
+    h8_ir_capture_print(session, out);
+    session->open = FALSE;
+  }
+  if (!session->open)
+  {
+    unsigned long number = session->number + 1;
+
+    memset(session, 0, sizeof(*session));
+    session->number = number;
+    session->open = TRUE;
+    session->start = packet->start;
+  }
+  else if (session->last_direction != packet->direction)
+  {
+    h8_u64 latency = packet->start - session->end;
+
+    session->replies++;
+    session->latency_total += latency;
+    if (latency > session->latency_max)
+      session->latency_max = latency;
+  }
+
+  side = &session->sides[packet->direction];
+  if (side->packets && side->last_hash == packet->hash &&
+      side->last_length == packet->length)
+    side->retransmits++;
+  side->packets++;
+  side->bytes += packet->length;
+  side->last_hash = packet->hash;
+  side->last_length = packet->length;
+  session->end = packet->end;
+  session->last_direction = packet->direction;
+}
+
+unsigned long h8_ir_capture_report(FILE *in, FILE *out, h8_u64 session_gap)
+{
+  static h8_ir_capture_record_t record;
+  h8_ir_capture_reader_t reader;
+  h8_ir_capture_session_t session;
+  h8_ir_capture_packet_t packet;
+  h8_bool pending = FALSE;
+
+  if (!h8_ir_capture_reader_init(&reader, in))
+    return 0;
+  if (!session_gap)
+    session_gap = reader.instructions_per_second;
+  memset(&session, 0, sizeof(session));
+
+  while (h8_ir_capture_read(&reader, &record))
+  {
+    unsigned i;
+
+    /* Records split from one long packet follow on without a gap */
+    if (pending && (record.direction != packet.direction ||
+                    record.time - packet.end > H8_IR_CAPTURE_PACKET_GAP))
+    {
+      h8_ir_capture_add(&session, &packet, session_gap, out);
+      pending = FALSE;
+    }
+    if (!pending)
+    {
+      packet.start = record.time;
+      packet.direction = record.direction;
+      packet.length = 0;
+      packet.hash = 2166136261U;
+      pending = TRUE;
+    }
+    for (i = 0; i < record.length; i++)
+      packet.hash = (packet.hash ^ record.data[i]) * 16777619U;
+    packet.length += record.length;
+    packet.end = record.time + record.span;
+  }
+  if (pending)
+    h8_ir_capture_add(&session, &packet, session_gap, out);
+  if (session.open)
+    h8_ir_capture_print(&session, out);
+
+  return session.number;
+}
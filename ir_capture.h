@@ -0,0 +1,118 @@
+#ifndef H8_IR_CAPTURE_H
+#define H8_IR_CAPTURE_H
+
+#include "types.h"
+
+#include <stdio.h>
+
+/**
+ * A binary log of IR traffic for offline analysis, in the spirit of pcap.
+ * Bytes passing through SCI3 in IrDA mode are grouped into packets: a run of
+ * bytes in one direction with no gap longer than H8_IR_CAPTURE_PACKET_GAP
+ * instructions between them. Records are collected in memory and written in
+ * large blocks, so capturing costs little more than a copy per byte.
+ *
+ * Layout, with all values little-endian:
+ *   "H8IR", version (16-bit), reserved (16-bit), instructions per second
+ *   (32-bit)
+ *   { time of the first byte (64-bit), time from the first byte to the last
+ *     (32-bit), direction, length (16-bit), bytes }...
+ * Times are in emulated instructions.
+ */
+
+#define H8_IR_CAPTURE_VERSION 1
+
+#define H8_IR_CAPTURE_HEADER 12
+#define H8_IR_CAPTURE_RECORD_HEADER 15
+
+/** The most bytes one record holds; longer packets span several records */
+#define H8_IR_CAPTURE_RECORD_MAX 1024
+
+/** The size of the block records are collected in before being written */
+#define H8_IR_CAPTURE_BUFFER 16384
+
+/** The longest idle time within a packet, in instructions */
+#define H8_IR_CAPTURE_PACKET_GAP 2000
+
+typedef enum
+{
+  /** Sent by the emulated system */
+  H8_IR_CAPTURE_TX = 0,
+
+  /** Received by the emulated system */
+  H8_IR_CAPTURE_RX
+} h8_ir_capture_direction;
+
+typedef struct
+{
+  h8_u64 time;
+  unsigned long span;
+  h8_u8 direction;
+  unsigned length;
+  h8_u8 data[H8_IR_CAPTURE_RECORD_MAX];
+} h8_ir_capture_record_t;
+
+typedef struct h8_ir_capture_t
+{
+  FILE *file;
+  h8_u8 buffer[H8_IR_CAPTURE_BUFFER];
+  unsigned used;
+
+  /** The packet being collected, if its length is not 0 */
+  h8_ir_capture_record_t packet;
+  h8_u64 last_time;
+
+  /** The number of records written */
+  unsigned long records;
+
+  /** Set if writing to the file failed; later bytes are discarded */
+  h8_bool failed;
+} h8_ir_capture_t;
+
+typedef struct
+{
+  FILE *file;
+  unsigned long instructions_per_second;
+} h8_ir_capture_reader_t;
+
+/**
+ * Begins a capture, writing its header to an open binary file.
+ * @return FALSE if the header could not be written
+ */
+h8_bool h8_ir_capture_init(h8_ir_capture_t *capture, FILE *file);
+
+/**
+ * Adds one byte to a capture.
+ * @param time The emulated time, in instructions
+ */
+void h8_ir_capture_byte(h8_ir_capture_t *capture,
+                        h8_ir_capture_direction direction, h8_u8 value,
+                        h8_u64 time);
+
+/**
+ * Ends the packet being collected and writes everything buffered. Call
+ * before closing the file; the capture may continue afterwards.
+ * @return FALSE if writing failed at any point
+ */
+h8_bool h8_ir_capture_flush(h8_ir_capture_t *capture);
+
+/**
+ * Begins reading a capture from an open binary file.
+ * @return FALSE if the file is not a capture of this version
+ */
+h8_bool h8_ir_capture_reader_init(h8_ir_capture_reader_t *reader, FILE *file);
+
+/** @return FALSE at the end of the capture or if it is malformed */
+h8_bool h8_ir_capture_read(h8_ir_capture_reader_t *reader,
+                           h8_ir_capture_record_t *record);
+
+/**
+ * Reassembles the packets of a whole capture and prints statistics for each
+ * session: bytes and packets each way, retransmits (a packet repeating the
+ * previous one in the same direction) and reply latency.
+ * @param session_gap The idle time, in instructions, that ends a session
+ * @return The number of sessions found
+ */
+unsigned long h8_ir_capture_report(FILE *in, FILE *out, h8_u64 session_gap);
+
+#endif
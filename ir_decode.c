@@ -0,0 +1,40 @@
+#include "ir_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Prints per-session statistics for an IR capture written with
+ * h8_ir_capture_init. Build with `make ir-decode`.
+ * Usage: h8-ir-decode <capture> [session gap in instructions]
+ */
+int main(int argc, char **argv)
+{
+  FILE *file;
+  unsigned long sessions;
+  h8_u64 gap = 0;
+
+  if (argc < 2 || argc > 3)
+  {
+    fprintf(stderr, "Usage: %s <capture> [session gap]\n", argv[0]);
+    return 1;
+  }
+  else if (argc == 3)
+    gap = strtoul(argv[2], NULL, 10);
+
+  file = fopen(argv[1], "rb");
+  if (!file)
+  {
+    fprintf(stderr, "Could not open %s\n", argv[1]);
+    return 1;
+  }
+  sessions = h8_ir_capture_report(file, stdout, gap);
+  fclose(file);
+  if (!sessions)
+  {
+    fprintf(stderr, "No sessions found in %s\n", argv[1]);
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,6 +1,8 @@
 H8_ROOT_DIR := $(dir $(realpath $(lastword $(MAKEFILE_LIST))))
 
 H8_SOURCES := \
+  $(H8_ROOT_DIR)/assembler.c \
+  $(H8_ROOT_DIR)/capture.c \
   $(H8_ROOT_DIR)/device.c \
   $(H8_ROOT_DIR)/devices/accelerometer.c \
   $(H8_ROOT_DIR)/devices/battery.c \
@@ -8,18 +10,29 @@ H8_SOURCES := \
   $(H8_ROOT_DIR)/devices/buttons.c \
   $(H8_ROOT_DIR)/devices/eeprom.c \
   $(H8_ROOT_DIR)/devices/factory_control.c \
+  $(H8_ROOT_DIR)/devices/gait.c \
   $(H8_ROOT_DIR)/devices/generic.c \
   $(H8_ROOT_DIR)/devices/generic_adc.c \
   $(H8_ROOT_DIR)/devices/lcd.c \
+  $(H8_ROOT_DIR)/devices/lcd_render.c \
   $(H8_ROOT_DIR)/devices/led.c \
+  $(H8_ROOT_DIR)/devices/motion.c \
   $(H8_ROOT_DIR)/dma.c \
   $(H8_ROOT_DIR)/emu.c \
   $(H8_ROOT_DIR)/frontend.c \
+  $(H8_ROOT_DIR)/input.c \
   $(H8_ROOT_DIR)/ir.c \
+  $(H8_ROOT_DIR)/ir_capture.c \
   $(H8_ROOT_DIR)/logger.c \
-  $(H8_ROOT_DIR)/rtc.c
+  $(H8_ROOT_DIR)/profiler.c \
+  $(H8_ROOT_DIR)/rtc.c \
+  $(H8_ROOT_DIR)/transport.c \
+  $(H8_ROOT_DIR)/tw.c \
+  $(H8_ROOT_DIR)/wdt.c
 
 H8_HEADERS := \
+  $(H8_ROOT_DIR)/assembler.h \
+  $(H8_ROOT_DIR)/capture.h \
   $(H8_ROOT_DIR)/config.h \
   $(H8_ROOT_DIR)/device.h \
   $(H8_ROOT_DIR)/devices/accelerometer.h \
@@ -28,15 +41,23 @@ H8_HEADERS := \
   $(H8_ROOT_DIR)/devices/buttons.h \
   $(H8_ROOT_DIR)/devices/eeprom.h \
   $(H8_ROOT_DIR)/devices/factory_control.h \
+  $(H8_ROOT_DIR)/devices/gait.h \
   $(H8_ROOT_DIR)/devices/generic.h \
   $(H8_ROOT_DIR)/devices/generic_adc.h \
   $(H8_ROOT_DIR)/devices/lcd.h \
   $(H8_ROOT_DIR)/devices/led.h \
+  $(H8_ROOT_DIR)/devices/motion.h \
   $(H8_ROOT_DIR)/dma.h \
   $(H8_ROOT_DIR)/frontend.h \
+  $(H8_ROOT_DIR)/input.h \
   $(H8_ROOT_DIR)/ir.h \
+  $(H8_ROOT_DIR)/ir_capture.h \
   $(H8_ROOT_DIR)/logger.h \
+  $(H8_ROOT_DIR)/profiler.h \
   $(H8_ROOT_DIR)/registers.h \
   $(H8_ROOT_DIR)/rtc.h \
   $(H8_ROOT_DIR)/system.h \
-  $(H8_ROOT_DIR)/types.h
+  $(H8_ROOT_DIR)/transport.h \
+  $(H8_ROOT_DIR)/tw.h \
+  $(H8_ROOT_DIR)/types.h \
+  $(H8_ROOT_DIR)/wdt.h
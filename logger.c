@@ -1,48 +1,337 @@
 #include "logger.h"
 
 #include "config.h"
+#include "profiler.h"
 
-#include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
-static h8_log_level log_level = H8_LOGGER_DEFAULT_LEVEL;
+h8_u8 h8_log_levels[H8_LOG_SOURCE_SIZE] =
+{
+  H8_LOGGER_DEFAULT_LEVEL,
+  H8_LOGGER_DEFAULT_LEVEL,
+  H8_LOGGER_DEFAULT_LEVEL,
+  H8_LOGGER_DEFAULT_LEVEL,
+  H8_LOGGER_DEFAULT_LEVEL,
+  H8_LOGGER_DEFAULT_LEVEL
+};
 
-void h8_log(h8_log_level level, h8_log_source source, const char *fmt, ...)
+#if H8_LOGGER_DEFERRED
+static H8_THREAD_LOCAL h8_log_ring_t *current_ring = NULL;
+#endif
+
+static H8_THREAD_LOCAL h8_u8 selected_level = H8_LOG_LEVEL_INVALID;
+static H8_THREAD_LOCAL h8_u8 selected_source = H8_LOG_SOURCE_INVALID;
+
+static const char *h8_log_source_name(unsigned source)
+{
+  switch (source)
+  {
+  case H8_LOG_CPU:
+    return "CPU";
+  case H8_LOG_LCD:
+    return "LCD";
+  case H8_LOG_EEP:
+    return "EEP";
+  case H8_LOG_SSU:
+    return "SSU";
+  case H8_LOG_IR:
+    return "IR ";
+  default:
+    return "???";
+  }
+}
+
+#if H8_LOGGER_DEFERRED
+
+/**
+ * Scans a printf conversion specification, starting just after its '%'.
+ * Sets end to the character following the specification, and longs to the
+ * number of 'l' length modifiers it contains.
+ * @return The conversion character, or 0 if the format ended early
+ */
+static char h8_log_conversion(const char *fmt, const char **end,
+                              unsigned *longs)
+{
+  *longs = 0;
+  while (*fmt && strchr("-+ #0123456789.hl", *fmt))
+  {
+    if (*fmt == 'l')
+      (*longs)++;
+    fmt++;
+  }
+  *end = *fmt ? fmt + 1 : fmt;
+
+  return *fmt;
+}
+
+/**
+ * Copies the arguments of a log message into the next free record of a ring
+ * without formatting them. Arguments the logger cannot interpret by
+ * conversion alone (ie: '*' widths, long long) end the recording; the rest of
+ * the format is printed unformatted.
+ */
+static void h8_log_record(h8_log_ring_t *ring, h8_log_level level,
+                          h8_log_source source, const char *fmt, va_list args)
 {
-  if (level < log_level)
+  unsigned head = ring->head;
+  unsigned strings = 0;
+  h8_log_record_t *record;
+
+  if (head - H8_LOAD_ACQUIRE(ring->tail) >= H8_LOGGER_RING_SIZE)
+  {
+    ring->dropped++;
     return;
-  else
+  }
+  record = &ring->records[head & (H8_LOGGER_RING_SIZE - 1)];
+  record->timestamp = h8_profile_clock();
+  record->fmt = fmt;
+  record->level = (h8_u8)level;
+  record->source = (h8_u8)source;
+  record->arg_count = 0;
+
+  while (*fmt && record->arg_count < H8_LOG_ARGS_SIZE)
   {
-    const char *source_str;
-    va_list args;
-    va_start(args, fmt);
+    h8_log_arg_t *arg = &record->args[record->arg_count];
+    const char *str;
+    unsigned longs;
 
-    switch (source)
+    if (*fmt++ != '%')
+      continue;
+    switch (h8_log_conversion(fmt, &fmt, &longs))
     {
-    case H8_LOG_CPU:
-      source_str = "CPU";
+    case '%':
+      continue;
+    case 'c':
+      arg->i = va_arg(args, int);
       break;
-    case H8_LOG_LCD:
-      source_str = "LCD";
+    case 'd':
+    case 'i':
+      if (longs > 1)
+        goto done;
+      arg->i = longs ? va_arg(args, long) : va_arg(args, int);
       break;
-    case H8_LOG_EEP:
-      source_str = "EEP";
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      if (longs > 1)
+        goto done;
+      arg->u = longs ? va_arg(args, unsigned long) : va_arg(args, unsigned);
       break;
-    case H8_LOG_SSU:
-      source_str = "SSU";
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'g':
+    case 'G':
+      arg->f = va_arg(args, double);
       break;
-    case H8_LOG_IR:
-      source_str = "IR ";
+    case 'p':
+      arg->p = va_arg(args, const void*);
+      break;
+    case 's':
+      /* Strings that do not fit are truncated, the last byte is always null */
+      str = va_arg(args, const char*);
+      arg->s = strings;
+      while (str && *str && strings < H8_LOG_STRINGS_SIZE - 2)
+        record->strings[strings++] = *str++;
+      record->strings[strings] = '\0';
+      if (strings < H8_LOG_STRINGS_SIZE - 1)
+        strings++;
       break;
     default:
-      source_str = "???";
+      goto done;
+    }
+    record->arg_count++;
+  }
+
+done:
+  H8_STORE_RELEASE(ring->head, head + 1);
+}
+
+void h8_log_ring_init(h8_log_ring_t *ring)
+{
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+}
+
+void h8_log_set_ring(h8_log_ring_t *ring)
+{
+  current_ring = ring;
+}
+
+h8_log_ring_t *h8_log_ring(void)
+{
+  return current_ring;
+}
+
+h8_bool h8_log_ring_pop(h8_log_ring_t *ring, h8_log_record_t *record)
+{
+  unsigned tail = ring->tail;
+
+  if (tail == H8_LOAD_ACQUIRE(ring->head))
+    return FALSE;
+  *record = ring->records[tail & (H8_LOGGER_RING_SIZE - 1)];
+  H8_STORE_RELEASE(ring->tail, tail + 1);
+
+  return TRUE;
+}
+
+void h8_log_record_print(const h8_log_record_t *record, FILE *stream)
+{
+  const char *fmt = record->fmt;
+  unsigned i = 0;
+
+  fprintf(stream, "[%s] ", h8_log_source_name(record->source));
+  while (*fmt)
+  {
+    const h8_log_arg_t *arg;
+    const char *start = fmt;
+    const char *end;
+    char spec[16];
+    unsigned longs;
+    char conversion;
+
+    if (*fmt != '%')
+    {
+      fputc(*fmt++, stream);
+      continue;
+    }
+    conversion = h8_log_conversion(fmt + 1, &end, &longs);
+    fmt = end;
+    if (conversion == '%')
+    {
+      fputc('%', stream);
+      continue;
+    }
+    else if (i >= record->arg_count || (unsigned)(end - start) >= sizeof(spec))
+    {
+      fwrite(start, 1, end - start, stream);
+      continue;
+    }
+    memcpy(spec, start, end - start);
+    spec[end - start] = '\0';
+    arg = &record->args[i++];
+
+    switch (conversion)
+    {
+    case 'c':
+      fprintf(stream, spec, (int)arg->i);
+      break;
+    case 'd':
+    case 'i':
+      if (longs)
+        fprintf(stream, spec, arg->i);
+      else
+        fprintf(stream, spec, (int)arg->i);
+      break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      if (longs)
+        fprintf(stream, spec, arg->u);
+      else
+        fprintf(stream, spec, (unsigned)arg->u);
+      break;
+    case 'p':
+      fprintf(stream, spec, arg->p);
+      break;
+    case 's':
+      fprintf(stream, spec, &record->strings[arg->s]);
+      break;
+    default:
+      fprintf(stream, spec, arg->f);
       break;
     }
+  }
+  fputc('\n', stream);
+}
+
+unsigned h8_log_ring_drain(h8_log_ring_t *ring, FILE *stream)
+{
+  h8_log_record_t record;
+  unsigned count = 0;
+
+  while (h8_log_ring_pop(ring, &record))
+  {
+    h8_log_record_print(&record, stream);
+    count++;
+  }
 
-    printf("[%s] ", source_str);
-    vprintf(fmt, args);
-    printf("\n");
+  return count;
+}
+
+#endif
+
+void h8_log_set_level(h8_log_source source, h8_log_level level)
+{
+  if (source == H8_LOG_SOURCE_INVALID)
+  {
+    unsigned i;
 
-    va_end(args);
+    for (i = 0; i < H8_LOG_SOURCE_SIZE; i++)
+      h8_log_levels[i] = (h8_u8)level;
   }
+  else if (source < H8_LOG_SOURCE_SIZE)
+    h8_log_levels[source] = (h8_u8)level;
+}
+
+static void h8_log_va(h8_log_level level, h8_log_source source,
+                      const char *fmt, va_list args)
+{
+  if (source >= H8_LOG_SOURCE_SIZE || level < h8_log_levels[source] ||
+      level < H8_LOGGER_MIN_LEVEL)
+    return;
+  else
+  {
+#if H8_PROFILE_SUBSYSTEMS
+    h8_profile_t *profile = h8_profile_current();
+
+    if (profile)
+      h8_profile_enter(profile, H8_PROFILE_LOGGING);
+#endif
+
+#if H8_LOGGER_DEFERRED
+    if (current_ring)
+      h8_log_record(current_ring, level, source, fmt, args);
+    else
+#endif
+    {
+      printf("[%s] ", h8_log_source_name(source));
+      vprintf(fmt, args);
+      printf("\n");
+    }
+
+#if H8_PROFILE_SUBSYSTEMS
+    if (profile)
+      h8_profile_leave(profile);
+#endif
+  }
+}
+
+void h8_log(h8_log_level level, h8_log_source source, const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  h8_log_va(level, source, fmt, args);
+  va_end(args);
+}
+
+void h8_log_select(h8_log_level level, h8_log_source source)
+{
+  selected_level = (h8_u8)level;
+  selected_source = (h8_u8)source;
+}
+
+void h8_log_selected(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  h8_log_va((h8_log_level)selected_level, (h8_log_source)selected_source, fmt,
+            args);
+  va_end(args);
 }
@@ -1,6 +1,10 @@
 #ifndef H8_LOGGER_H
 #define H8_LOGGER_H
 
+#include "types.h"
+
+#include <stdio.h>
+
 typedef enum
 {
   H8_LOG_SOURCE_INVALID = 0,
@@ -26,6 +30,138 @@ typedef enum
   H8_LOG_LEVEL_SIZE
 } h8_log_level;
 
+/**
+ * The lowest severity level processed for each source at runtime. Read inline
+ * by the H8_LOG macros; change with h8_log_set_level.
+ */
+extern h8_u8 h8_log_levels[H8_LOG_SOURCE_SIZE];
+
+/**
+ * Whether a message would be processed. Constant false for levels below
+ * H8_LOGGER_MIN_LEVEL, so the compiler can remove the call site.
+ */
+#define H8_LOG_ENABLED(level, source) \
+  ((level) >= H8_LOGGER_MIN_LEVEL && (level) >= h8_log_levels[source])
+
+/**
+ * Logs a message, without evaluating any of its arguments or calling into the
+ * logger if it would be filtered out. Prefer these to calling h8_log. The
+ * format and its arguments go in their own parentheses, as C89 has no
+ * variadic macros:
+ *
+ * H8_LOGW(H8_LOG_CPU, ("Watchdog reset at %04X", pc));
+ */
+#define H8_LOG(level, source, args) do \
+{ \
+  if (H8_LOG_ENABLED(level, source)) \
+  { \
+    h8_log_select(level, source); \
+    h8_log_selected args; \
+  } \
+} while (0)
+
+#define H8_LOGD(source, args) H8_LOG(H8_LOG_DEBUG, source, args)
+#define H8_LOGI(source, args) H8_LOG(H8_LOG_INFO, source, args)
+#define H8_LOGW(source, args) H8_LOG(H8_LOG_WARN, source, args)
+#define H8_LOGE(source, args) H8_LOG(H8_LOG_ERROR, source, args)
+
 void h8_log(h8_log_level level, h8_log_source source, const char *fmt, ...);
 
+/** Sets the level and source of the next h8_log_selected on this thread */
+void h8_log_select(h8_log_level level, h8_log_source source);
+
+/** Logs a message with the level and source given to h8_log_select */
+void h8_log_selected(const char *fmt, ...);
+
+/**
+ * Sets the lowest severity level processed for a source, or for every source
+ * if H8_LOG_SOURCE_INVALID is given.
+ */
+void h8_log_set_level(h8_log_source source, h8_log_level level);
+
+#if H8_LOGGER_DEFERRED
+
+/** The maximum number of conversions recorded for one message */
+#define H8_LOG_ARGS_SIZE 6
+
+/** Space in each record for copies of string arguments, including nulls */
+#define H8_LOG_STRINGS_SIZE 32
+
+typedef union
+{
+  long i;
+  unsigned long u;
+  double f;
+  const void *p;
+
+  /** Offset of a copied string argument within the record's string buffer */
+  unsigned s;
+} h8_log_arg_t;
+
+/**
+ * A log message as it was passed to h8_log, before formatting. The format
+ * string is kept by pointer, so it must be a literal or otherwise outlive the
+ * ring. Strings passed as arguments are copied and truncated to fit.
+ */
+typedef struct
+{
+  /** The host clock at the time of logging, see h8_profile_clock */
+  h8_u64 timestamp;
+
+  const char *fmt;
+  h8_log_arg_t args[H8_LOG_ARGS_SIZE];
+  char strings[H8_LOG_STRINGS_SIZE];
+  h8_u8 level;
+  h8_u8 source;
+  h8_u8 arg_count;
+} h8_log_record_t;
+
+/**
+ * A single-producer single-consumer queue of log records. The producer is the
+ * thread running the system the ring is attached to; the consumer is any one
+ * thread calling h8_log_ring_pop or h8_log_ring_drain, ie: a host thread
+ * printing in the background, or the emulation thread itself at dump time.
+ * Records logged while the ring is full are dropped and counted.
+ */
+typedef struct
+{
+  h8_log_record_t records[H8_LOGGER_RING_SIZE];
+
+  /** Only advanced by the producer */
+  unsigned head;
+
+  /** Only advanced by the consumer */
+  unsigned tail;
+
+  /** The number of records dropped because the ring was full */
+  unsigned dropped;
+} h8_log_ring_t;
+
+void h8_log_ring_init(h8_log_ring_t *ring);
+
+/**
+ * Sets the ring that h8_log records into on the calling thread, instead of
+ * printing. May be NULL to print synchronously.
+ */
+void h8_log_set_ring(h8_log_ring_t *ring);
+
+h8_log_ring_t *h8_log_ring(void);
+
+/**
+ * Removes the oldest record from a ring.
+ * @return FALSE if the ring was empty
+ */
+h8_bool h8_log_ring_pop(h8_log_ring_t *ring, h8_log_record_t *record);
+
+/** Formats a record the same way h8_log prints messages synchronously */
+void h8_log_record_print(const h8_log_record_t *record, FILE *stream);
+
+/**
+ * Formats and prints every record currently in a ring.
+ * @return The number of records printed
+ */
+unsigned h8_log_ring_drain(h8_log_ring_t *ring, FILE *stream);
+
+#endif
+
 #endif
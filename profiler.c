@@ -0,0 +1,133 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define H8_PROFILE_RDTSC 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define H8_PROFILE_RDTSC 1
+#else
+#include <time.h>
+#define H8_PROFILE_RDTSC 0
+#endif
+
+h8_u64 h8_profile_clock(void)
+{
+#if H8_PROFILE_RDTSC
+  return __rdtsc();
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (h8_u64)ts.tv_sec * 1000000000 + (h8_u64)ts.tv_nsec;
+#endif
+}
+
+const char *h8_profile_clock_unit(void)
+{
+#if H8_PROFILE_RDTSC
+  return "cycles";
+#else
+  return "ns";
+#endif
+}
+
+#if H8_PROFILE_SUBSYSTEMS
+
+static H8_THREAD_LOCAL h8_profile_t *current_profile = NULL;
+
+static const char *scope_names[H8_PROFILE_SCOPE_SIZE] =
+{
+  "Decode",
+  "Memory",
+  "IO",
+  "Devices",
+  "Logging"
+};
+
+void h8_profile_reset(h8_profile_t *profile)
+{
+  memset(profile, 0, sizeof(*profile));
+}
+
+void h8_profile_enter(h8_profile_t *profile, h8_profile_scope scope)
+{
+  h8_u64 now = h8_profile_clock();
+
+  if (profile->depth && profile->depth <= H8_PROFILE_DEPTH)
+    profile->ticks[profile->stack[profile->depth - 1]] += now - profile->mark;
+  if (profile->depth < H8_PROFILE_DEPTH)
+    profile->stack[profile->depth] = (h8_u8)scope;
+  profile->depth++;
+  profile->calls[scope]++;
+  profile->mark = now;
+}
+
+void h8_profile_leave(h8_profile_t *profile)
+{
+  h8_u64 now = h8_profile_clock();
+
+  if (profile->depth)
+  {
+    profile->depth--;
+    if (profile->depth < H8_PROFILE_DEPTH)
+      profile->ticks[profile->stack[profile->depth]] += now - profile->mark;
+  }
+  profile->mark = now;
+}
+
+void h8_profile_set_current(h8_profile_t *profile)
+{
+  current_profile = profile;
+}
+
+h8_profile_t *h8_profile_current(void)
+{
+  return current_profile;
+}
+
+const char *h8_profile_scope_name(h8_profile_scope scope)
+{
+  return scope < H8_PROFILE_SCOPE_SIZE ? scope_names[scope] : "???";
+}
+
+h8_u64 h8_profile_total(const h8_profile_t *profile)
+{
+  h8_u64 total = 0;
+  unsigned i;
+
+  for (i = 0; i < H8_PROFILE_SCOPE_SIZE; i++)
+    total += profile->ticks[i];
+
+  return total;
+}
+
+double h8_profile_share(const h8_profile_t *profile, h8_profile_scope scope)
+{
+  h8_u64 total = h8_profile_total(profile);
+
+  if (!total || scope >= H8_PROFILE_SCOPE_SIZE)
+    return 0.0;
+  else
+    return (double)profile->ticks[scope] / (double)total;
+}
+
+void h8_profile_print(const h8_profile_t *profile)
+{
+  unsigned i;
+
+  printf("%-8s %20s %16s %7s\n", "Scope", h8_profile_clock_unit(), "calls",
+         "share");
+  for (i = 0; i < H8_PROFILE_SCOPE_SIZE; i++)
+    printf("%-8s %20llu %16llu %6.2f%%\n", scope_names[i],
+           profile->ticks[i], profile->calls[i],
+           h8_profile_share(profile, (h8_profile_scope)i) * 100.0);
+}
+
+#endif
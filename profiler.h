@@ -0,0 +1,93 @@
+#ifndef H8_PROFILER_H
+#define H8_PROFILER_H
+
+#include "types.h"
+
+/**
+ * Host-side instrumentation measuring where emulation time is spent. Time is
+ * charged exclusively to the innermost active scope, so a memory access
+ * performed while decoding an instruction is not also counted as decoding.
+ *
+ * All of this apart from the host clock is compiled out unless
+ * H8_PROFILE_SUBSYSTEMS is set.
+ */
+
+typedef enum
+{
+  /** Instruction fetch, decode and execution */
+  H8_PROFILE_DECODE = 0,
+
+  /** Memory dispatch in h8_byte_in / h8_byte_out */
+  H8_PROFILE_MEMORY,
+
+  /** Handlers in the IO register tables */
+  H8_PROFILE_IO,
+
+  /** Callbacks into connected devices (SSU, port pins, A/D channels) */
+  H8_PROFILE_DEVICES,
+
+  /** Formatting and printing log messages */
+  H8_PROFILE_LOGGING,
+
+  H8_PROFILE_SCOPE_SIZE
+} h8_profile_scope;
+
+/** An arbitrary maximum for how deeply scopes can be nested */
+#define H8_PROFILE_DEPTH 16
+
+typedef struct
+{
+  /** Exclusive host time spent in each scope, in units of the host clock */
+  h8_u64 ticks[H8_PROFILE_SCOPE_SIZE];
+
+  /** The number of times each scope has been entered */
+  h8_u64 calls[H8_PROFILE_SCOPE_SIZE];
+
+  h8_u8 stack[H8_PROFILE_DEPTH];
+  unsigned depth;
+
+  /** Host clock value when the innermost scope last began being charged */
+  h8_u64 mark;
+} h8_profile_t;
+
+#if H8_PROFILE_SUBSYSTEMS
+#define H8_PROFILE_ENTER(profile, scope) h8_profile_enter(profile, scope)
+#define H8_PROFILE_LEAVE(profile) h8_profile_leave(profile)
+#else
+#define H8_PROFILE_ENTER(profile, scope)
+#define H8_PROFILE_LEAVE(profile)
+#endif
+
+/** Returns the current value of the host clock used for profiling */
+h8_u64 h8_profile_clock(void);
+
+/** Returns the name of the unit h8_profile_clock counts in */
+const char *h8_profile_clock_unit(void);
+
+void h8_profile_reset(h8_profile_t *profile);
+
+void h8_profile_enter(h8_profile_t *profile, h8_profile_scope scope);
+
+void h8_profile_leave(h8_profile_t *profile);
+
+/**
+ * Sets the profile that code without access to a system (such as the logger)
+ * charges its time to on the calling thread. May be NULL.
+ */
+void h8_profile_set_current(h8_profile_t *profile);
+
+h8_profile_t *h8_profile_current(void);
+
+/** Returns the name of a scope, as used by h8_profile_print */
+const char *h8_profile_scope_name(h8_profile_scope scope);
+
+/** Returns the total time charged to all scopes */
+h8_u64 h8_profile_total(const h8_profile_t *profile);
+
+/** Returns the fraction of total time spent in a scope, from 0.0 to 1.0 */
+double h8_profile_share(const h8_profile_t *profile, h8_profile_scope scope);
+
+/** Prints a breakdown of time spent in each scope, ie: at shutdown */
+void h8_profile_print(const h8_profile_t *profile);
+
+#endif
@@ -67,6 +67,17 @@ typedef union
 } h8_spcr_t;
 #define H8_REG_SPCR 0xFF91
 
+/**
+ * Serial Mode Register 3 (SMR3)
+ * Bit 7 selects clock synchronous mode, bit 6 7-bit characters, bit 5 parity,
+ * bit 3 two stop bits, and bits 1-0 the clock for the baud rate generator
+ * (phi, phi/4, phi/16 or phi/64).
+ */
+#define H8_REG_SMR3 0xFF98
+
+/** Bit Rate Register 3 (BRR3) */
+#define H8_REG_BRR3 0xFF99
+
 typedef union
 {
   H8_BITFIELD_8
@@ -295,39 +306,96 @@ typedef struct
   h8_byte_t unknown4[8];
 } h8_aec_sci3_t;
 
+/**
+ * Timer Mode Register WD (TMWD)
+ * Mapped to FFB0
+ */
 typedef union
 {
   H8_BITFIELD_2
   (
+    /**
+     * Clock Select. 1000 to 1111 count phi/64 to phi/8192, doubling each
+     * step; 0xxx counts the on-chip oscillator.
+     */
     h8_u8 cks : 4,
+
     h8_u8 reserved : 4
   ) flags;
   h8_byte_t raw;
 } h8_tmwd_t;
+#define H8_REG_TMWD 0xFFB0
 
+/**
+ * Timer Control/Status Register WD1 (TCSRWD1)
+ * Each BnWI bit must be written as 0 in the same write for the bit above it
+ * to change. All BnWI bits are always read as 1.
+ * Mapped to FFB1
+ */
 typedef union
 {
   H8_BITFIELD_8
   (
+    /** Watchdog Timer Reset. Set when the watchdog resets the system. */
     h8_u8 wrst : 1,
+
     h8_u8 b0wi : 1,
+
+    /** Watchdog Timer On. TCWD counts while set. */
     h8_u8 wdon : 1,
+
     h8_u8 b2wi : 1,
+
+    /** Timer Control/Status Register WD Write Enable, for WDON and WRST */
     h8_u8 tcsrwe : 1,
+
     h8_u8 b4wi : 1,
+
+    /** Timer Counter WD Write Enable */
     h8_u8 tcwe : 1,
+
     h8_u8 b6wi : 1
   ) flags;
   h8_byte_t raw;
 } h8_tcsrwd1_t;
+#define H8_REG_TCSRWD1 0xFFB1
+
+/**
+ * Timer Control/Status Register WD2 (TCSRWD2)
+ * Mapped to FFB2
+ */
+typedef union
+{
+  H8_BITFIELD_4
+  (
+    /** Reserved. These bits are always read as 1. */
+    h8_u8 reserved : 5,
+
+    /**
+     * Overflow Interrupt Enable. When set, TCWD overflowing requests an
+     * interrupt rather than resetting the system.
+     */
+    h8_u8 ieovf : 1,
+
+    h8_u8 b5wi : 1,
+
+    /** Overflow Flag. Set when TCWD overflows; cleared by writing 0. */
+    h8_u8 ovf : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tcsrwd2_t;
+#define H8_REG_TCSRWD2 0xFFB2
 
 typedef struct
 {
   h8_tmwd_t tmwd;
   h8_tcsrwd1_t tcsrwd1;
-  h8_byte_t tcsrwd2;
+  h8_tcsrwd2_t tcsrwd2;
+
+  /** Timer Counter WD, an 8-bit up-counter. Mapped to FFB3 */
   h8_byte_t tcwd;
 } h8_wdt_t;
+#define H8_REG_TCWD 0xFFB3
 
 /** 15.3.1 SS Control Register H (SSCRH) */
 typedef union h8_sscrh_t
@@ -455,20 +523,178 @@ typedef struct
   h8_byte_t unused3[4];
 } h8_ssu_t;
 
-/** @todo Timer W */
+/**
+ * Timer Mode Register W (TMRW)
+ * Mapped to F0F0
+ */
+typedef union
+{
+  H8_BITFIELD_8
+  (
+    /** PWM Mode B. FTIOB outputs PWM when set. */
+    h8_u8 pwmb : 1,
+
+    /** PWM Mode C. FTIOC outputs PWM when set. */
+    h8_u8 pwmc : 1,
+
+    /** PWM Mode D. FTIOD outputs PWM when set. */
+    h8_u8 pwmd : 1,
+
+    /** Reserved. This bit is always read as 1. */
+    h8_u8 reserved1 : 1,
+
+    /** Buffer Operation A. GRC buffers GRA when set. @todo */
+    h8_u8 bufea : 1,
+
+    /** Buffer Operation B. GRD buffers GRB when set. @todo */
+    h8_u8 bufeb : 1,
+
+    /** Reserved. This bit is always read as 1. */
+    h8_u8 reserved2 : 1,
+
+    /** Counter Start. TCNT counts while set. */
+    h8_u8 cts : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tmrw_t;
+#define H8_REG_TMRW 0xF0F0
+
+/**
+ * Timer Control Register W (TCRW)
+ * Mapped to F0F1
+ */
+typedef union
+{
+  H8_BITFIELD_6
+  (
+    /** Timer Output Level Setting A to D, before the first compare match */
+    h8_u8 toa : 1,
+    h8_u8 tob : 1,
+    h8_u8 toc : 1,
+    h8_u8 tod : 1,
+
+    /**
+     * Clock Select. 000 to 011 count phi to phi/8, halving each step; 1xx
+     * counts rising edges on FTCI. @todo FTCI
+     */
+    h8_u8 cks : 3,
+
+    /** Counter Clear. TCNT is cleared by compare match A when set. */
+    h8_u8 cclr : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tcrw_t;
+#define H8_REG_TCRW 0xF0F1
+
+/**
+ * Timer Interrupt Enable Register W (TIERW)
+ * Its bits match those of TSRW.
+ * Mapped to F0F2
+ */
+typedef union
+{
+  H8_BITFIELD_6
+  (
+    /** Input Capture/Compare Match Interrupt Enable A to D */
+    h8_u8 imiea : 1,
+    h8_u8 imieb : 1,
+    h8_u8 imiec : 1,
+    h8_u8 imied : 1,
+
+    /** Reserved. These bits are always read as 1. */
+    h8_u8 reserved : 3,
+
+    /** Timer Overflow Interrupt Enable */
+    h8_u8 ovie : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tierw_t;
+#define H8_REG_TIERW 0xF0F2
+
+/**
+ * Timer Status Register W (TSRW)
+ * Each flag is set by the timer, and cleared by writing 0 to it after reading
+ * it as 1.
+ * Mapped to F0F3
+ */
+typedef union
+{
+  H8_BITFIELD_6
+  (
+    /** Input Capture/Compare Match Flag A to D */
+    h8_u8 imfa : 1,
+    h8_u8 imfb : 1,
+    h8_u8 imfc : 1,
+    h8_u8 imfd : 1,
+
+    /** Reserved. These bits are always read as 1. */
+    h8_u8 reserved : 3,
+
+    /** Timer Overflow Flag. Set when TCNT overflows from 0xFFFF. */
+    h8_u8 ovf : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tsrw_t;
+#define H8_REG_TSRW 0xF0F3
+
+/** The bits of TIERW and TSRW that enable or flag interrupts */
+#define H8_TSRW_FLAGS 0x8F
+
+/**
+ * Timer I/O Control Register 0 (TIOR0), for GRA and GRB, and Timer I/O
+ * Control Register 1 (TIOR1), for GRC and GRD.
+ * Mapped to F0F4 / F0F5
+ */
+typedef union
+{
+  H8_BITFIELD_4
+  (
+    /**
+     * I/O Control A (or C). Bit 2 makes the first register an input capture
+     * register instead of an output compare register. @todo Input capture
+     */
+    h8_u8 ioa : 3,
+
+    /** Reserved. This bit is always read as 1. */
+    h8_u8 reserved1 : 1,
+
+    /** I/O Control B (or D), as above */
+    h8_u8 iob : 3,
+
+    /** Reserved. This bit is always read as 1. */
+    h8_u8 reserved2 : 1
+  ) flags;
+  h8_byte_t raw;
+} h8_tior_t;
+#define H8_REG_TIOR0 0xF0F4
+#define H8_REG_TIOR1 0xF0F5
+
+/** Selects input capture in h8_tior_t.ioa and h8_tior_t.iob */
+#define H8_TIOR_CAPTURE 0x04
+
+/**
+ * Timer Counter (TCNT), a 16-bit up-counter, and General Registers A to D
+ * (GRA to GRD), which TCNT is compared against.
+ * Mapped to F0F6, F0F8, F0FA, F0FC, F0FE
+ */
+#define H8_REG_TCNT 0xF0F6
+#define H8_REG_GRA 0xF0F8
+#define H8_REG_GRB 0xF0FA
+#define H8_REG_GRC 0xF0FC
+#define H8_REG_GRD 0xF0FE
+
 typedef struct
 {
-  h8_byte_t tmrw;
-  h8_byte_t tcrw;
-  h8_byte_t tierw;
-  h8_byte_t tsrw;
-  h8_byte_t tior0;
-  h8_byte_t tior1;
+  h8_tmrw_t tmrw;
+  h8_tcrw_t tcrw;
+  h8_tierw_t tierw;
+  h8_tsrw_t tsrw;
+  h8_tior_t tior0;
+  h8_tior_t tior1;
   h8_word_be_t tcnt;
-  h8_word_be_t gra;
-  h8_word_be_t grb;
-  h8_word_be_t grc;
-  h8_word_be_t grd;
+
+  /** GRA to GRD */
+  h8_word_be_t gr[4];
 } h8_tw_t;
 
 /**
@@ -503,7 +729,7 @@ typedef union
     /** Channel Select */
     h8_u8 ch : 4,
 
-    /** Clock Select (unimplemented) */
+    /** Clock Select. Sets the length of a conversion, see h8_adc_states. */
     h8_u8 cks : 2,
 
     /** External Trigger Select */
@@ -528,8 +754,8 @@ typedef union
     h8_u8 lads : 1,
 
     /**
-     * A/D Start/Finish? Set to 1 to start, then it sets itself to 0 when
-     * finished
+     * A/D Start Flag. Set to 1 to start a conversion, which clears it when
+     * finished. Writing 0 stops a conversion in progress.
      */
     h8_u8 adsf : 1
   ) flags;
@@ -543,4 +769,33 @@ typedef struct
   h8_adsr_t adsr;
 } h8_adc_t;
 
+/**
+ * Interrupt Enable Register 1 (IENR1)
+ * Mapped to FFF3
+ */
+#define H8_REG_IENR1 0xFFF3
+
+/** RTC Interrupt Request Enable */
+#define H8_IENR1_IENRTC 0x80
+
+/**
+ * Interrupt Enable Register 2 (IENR2)
+ * Mapped to FFF4
+ * @todo Confirm the bit layout against hardware
+ */
+#define H8_REG_IENR2 0xFFF4
+
+/** A/D Conversion End Interrupt Enable */
+#define H8_IENR2_IENAD 0x40
+
+/**
+ * Interrupt Flag Register 2 (IRR2)
+ * Flags are cleared by writing 0 to them.
+ * Mapped to FFF7
+ */
+#define H8_REG_IRR2 0xFFF7
+
+/** A/D Conversion End Interrupt Request Flag */
+#define H8_IRR2_IRRAD 0x40
+
 #endif
@@ -2,50 +2,45 @@
 
 #include "rtc.h"
 
-void h8_rtc_set(h8_rtc_t *rtc, const time_t time)
+#define H8_RTC_SECONDS_PER_DAY 86400
+
+/** 1970-01-01 was a Thursday */
+#define H8_RTC_EPOCH_WEEKDAY H8_RTC_THURSDAY
+
+static void h8_rtc_set_hour(h8_rtc_t *rtc, unsigned hour)
 {
-  time_t ttime = (time_t)time;
-  struct tm *local_time;
+  if (!rtc->rtccr1.flags.om)
+  {
+    /* 12-hour mode counts 0 to 11, with noon onwards flagged as PM */
+    rtc->rtccr1.flags.pm = hour >= 12;
+    hour %= 12;
+  }
+  rtc->rhrdr.flags.co = hour % 10;
+  rtc->rhrdr.flags.ct = hour / 10;
+  rtc->rhrdr.flags.bsy = 0;
+}
 
-  local_time = localtime(&ttime);
+void h8_rtc_set(h8_rtc_t *rtc, const time_t time)
+{
+  h8_u64 seconds = time > 0 ? (h8_u64)time : 0;
+  unsigned of_day = (unsigned)(seconds % H8_RTC_SECONDS_PER_DAY);
+  unsigned days = (unsigned)(seconds / H8_RTC_SECONDS_PER_DAY);
 
   /* Update seconds */
-  rtc->rsecdr.flags.co = local_time->tm_sec % 10;
-  rtc->rsecdr.flags.ct = (h8_u8)local_time->tm_sec / 10;
+  rtc->rsecdr.flags.co = of_day % 60 % 10;
+  rtc->rsecdr.flags.ct = of_day % 60 / 10;
   rtc->rsecdr.flags.bsy = 0;
 
   /* Update minutes */
-  rtc->rmindr.flags.co = local_time->tm_min % 10;
-  rtc->rmindr.flags.ct = (h8_u8)local_time->tm_min / 10;
+  rtc->rmindr.flags.co = of_day / 60 % 60 % 10;
+  rtc->rmindr.flags.ct = of_day / 60 % 60 / 10;
   rtc->rmindr.flags.bsy = 0;
 
   /* Update hours */
-  if (rtc->rtccr1.flags.om)
-  {
-    /* Update in 24-hour mode */
-    rtc->rhrdr.flags.co = local_time->tm_hour % 10;
-    rtc->rhrdr.flags.ct = (h8_u8)local_time->tm_hour / 10;
-  }
-  else
-  {
-    /* Update in 12-hour mode */
-    int trunctime = local_time->tm_hour;
-
-    if (trunctime >= 12)
-    {
-      rtc->rtccr1.flags.pm = 1;
-      trunctime -= 12;
-    }
-    else
-      rtc->rtccr1.flags.pm = 0;
-
-    rtc->rhrdr.flags.co = trunctime % 10;
-    rtc->rhrdr.flags.ct = (h8_u8)trunctime / 10;
-  }
-  rtc->rhrdr.flags.bsy = 0;
+  h8_rtc_set_hour(rtc, of_day / 3600);
 
   /* Update day of the week */
-  rtc->rwkdr.flags.wk = (h8_u8)local_time->tm_wday;
+  rtc->rwkdr.flags.wk = (days + H8_RTC_EPOCH_WEEKDAY) % 7;
   rtc->rwkdr.flags.bsy = 0;
 }
 
@@ -53,3 +48,57 @@ void h8_rtc_set_current(h8_rtc_t *rtc, const time_t offset)
 {
   h8_rtc_set(rtc, time(NULL) + offset);
 }
+
+h8_u8 h8_rtc_tick(h8_rtc_t *rtc, h8_u64 ticks)
+{
+  unsigned value;
+  h8_u8 events = H8_RTC_EVENT_QUARTER_SECOND;
+
+  if (!rtc->rtccr1.flags.run)
+    return 0;
+
+  if (ticks & 1)
+    goto done;
+  events |= H8_RTC_EVENT_HALF_SECOND;
+  if (ticks & 2)
+    goto done;
+  events |= H8_RTC_EVENT_SECOND;
+
+  /* Each counter carries into the next as it wraps */
+  value = rtc->rsecdr.flags.ct * 10 + rtc->rsecdr.flags.co + 1;
+  if (value == 60)
+    value = 0;
+  rtc->rsecdr.flags.co = value % 10;
+  rtc->rsecdr.flags.ct = value / 10;
+  if (value)
+    goto done;
+  events |= H8_RTC_EVENT_MINUTE;
+
+  value = rtc->rmindr.flags.ct * 10 + rtc->rmindr.flags.co + 1;
+  if (value == 60)
+    value = 0;
+  rtc->rmindr.flags.co = value % 10;
+  rtc->rmindr.flags.ct = value / 10;
+  if (value)
+    goto done;
+  events |= H8_RTC_EVENT_HOUR;
+
+  value = rtc->rhrdr.flags.ct * 10 + rtc->rhrdr.flags.co + 1;
+  if (!rtc->rtccr1.flags.om && rtc->rtccr1.flags.pm)
+    value += 12;
+  if (value == 24)
+    value = 0;
+  h8_rtc_set_hour(rtc, value);
+  if (value)
+    goto done;
+  events |= H8_RTC_EVENT_DAY;
+
+  rtc->rwkdr.flags.wk = (rtc->rwkdr.flags.wk + 1) % 7;
+  if (rtc->rwkdr.flags.wk == H8_RTC_SUNDAY)
+    events |= H8_RTC_EVENT_WEEK;
+
+done:
+  rtc->rtcflg.raw.u |= events;
+
+  return events;
+}
@@ -15,6 +15,12 @@ typedef union
 {
   H8_BITFIELD_3
   (
+    /** Counting One's Position. Counts from 0-9. */
+    h8_u8 co : 4,
+
+    /** Counting Ten's Position. Counts from 0-5. */
+    h8_u8 ct : 3,
+
     /**
      * RTC Busy.
      * This bit is set to 1 when the RTC is updating (operating) the values of
@@ -22,13 +28,7 @@ typedef union
      * 0, the values of second, minute, hour, and day-of-week data registers
      * must be adopted.
      */
-    h8_u8 bsy : 1,
-
-    /** Counting Ten's Position. Counts from 0-5. */
-    h8_u8 ct : 3,
-
-    /** Counting One's Position. Counts from 0-9. */
-    h8_u8 co : 4
+    h8_u8 bsy : 1
   ) flags;
   h8_byte_t raw;
 } h8_rsecdr_t;
@@ -42,6 +42,12 @@ typedef union
 {
   H8_BITFIELD_3
   (
+    /** Counting One's Position. Counts from 0-9. */
+    h8_u8 co : 4,
+
+    /** Counting Ten's Position. Counts from 0-5. */
+    h8_u8 ct : 3,
+
     /**
      * RTC Busy.
      * This bit is set to 1 when the RTC is updating (operating) the values of
@@ -49,13 +55,7 @@ typedef union
      * 0, the values of second, minute, hour, and day-of-week data registers
      * must be adopted.
      */
-    h8_u8 bsy : 1,
-
-    /** Counting Ten's Position. Counts from 0-5. */
-    h8_u8 ct : 3,
-
-    /** Counting One's Position. Counts from 0-9. */
-    h8_u8 co : 4
+    h8_u8 bsy : 1
   ) flags;
   h8_byte_t raw;
 } h8_rmindr_t;
@@ -70,6 +70,15 @@ typedef union
 {
   H8_BITFIELD_4
   (
+    /** Counting One's Position. Counts from 0-9. */
+    h8_u8 co : 4,
+
+    /** Counting Ten's Position. Counts from 0-2. */
+    h8_u8 ct : 2,
+
+    /** Reserved. This bit is always read as 0. */
+    h8_u8 r : 1,
+
     /**
      * RTC Busy.
      * This bit is set to 1 when the RTC is updating (operating) the values of
@@ -77,16 +86,7 @@ typedef union
      * 0, the values of second, minute, hour, and day-of-week data registers
      * must be adopted.
      */
-    h8_u8 bsy : 1,
-
-    /** Reserved. This bit is always read as 0. */
-    h8_u8 r : 1,
-
-    /** Counting Ten's Position. Counts from 0-2. */
-    h8_u8 ct : 2,
-
-    /** Counting One's Position. Counts from 0-9. */
-    h8_u8 co : 4
+    h8_u8 bsy : 1
   ) flags;
   h8_byte_t raw;
 } h8_rhrdr_t;
@@ -108,11 +108,18 @@ enum
 /**
  * RWKDR counts the BCD-coded day-of-week value on the carry generated once per
  * day by RHRDR. The setting range is decimal 0 to 6 using bits WK2 to WK0.
+ * Mapped to 0xF06B.
  */
 typedef union
 {
   H8_BITFIELD_3
   (
+    /** Day-of-Week Counting. Counts from 0-6. */
+    h8_u8 wk : 3,
+
+    /** Reserved. These bits are always read as 0. */
+    h8_u8 r : 4,
+
     /**
      * RTC Busy.
      * This bit is set to 1 when the RTC is updating (operating) the values of
@@ -120,13 +127,7 @@ typedef union
      * 0, the values of second, minute, hour, and day-of-week data registers
      * must be adopted.
      */
-    h8_u8 bsy : 1,
-
-    /** Reserved. These bits are always read as 0. */
-    h8_u8 r : 4,
-
-    /** Day-of-Week Counting. Counts from 0-6. */
-    h8_u8 wk : 3
+    h8_u8 bsy : 1
   ) flags;
   h8_byte_t raw;
 } h8_rwkdr_t;
@@ -139,19 +140,17 @@ enum
 
 /**
  * RTCCR1 controls start/stop and reset of the clock timer.
+ * Mapped to 0xF06C.
  */
 typedef union
 {
   H8_BITFIELD_6
   (
-    /** RTC Operation Start. Represents whether RTC is active. */
-    h8_u8 run : 1,
-
-    /** Operating Mode. Using 24H mode when set. */
-    h8_u8 om : 1,
+    /** Reserved. These bits are always read as 0. */
+    h8_u8 r : 3,
 
-    /** AM/PM. Set when after noon in 12H mode. */
-    h8_u8 pm : 1,
+    /** Interrupt Occurrence Timing. @todo */
+    h8_u8 intr : 1,
 
     /**
      * Reset. Resets registers and control circuits except RTCCSR and this
@@ -159,18 +158,51 @@ typedef union
      */
     h8_u8 rst : 1,
 
-    /** Interrupt Occurrence Timing. @todo */
-    h8_u8 intr : 1,
+    /** AM/PM. Set when after noon in 12H mode. */
+    h8_u8 pm : 1,
 
-    /** Reserved. These bits are always read as 0. */
-    h8_u8 r : 3
+    /** Operating Mode. Using 24H mode when set. */
+    h8_u8 om : 1,
+
+    /** RTC Operation Start. Represents whether RTC is active. */
+    h8_u8 run : 1
   ) flags;
   h8_byte_t raw;
 } h8_rtccr1_t;
 
-/** RTCCR2. @todo Not particularly needed for an emulator. */
+/**
+ * RTCCR2 enables each RTC interrupt. Its bits match those of RTCFLG and the
+ * order of the RTC vectors, from the quarter-second upwards.
+ * Mapped to 0xF06D.
+ */
 typedef union
 {
+  H8_BITFIELD_8
+  (
+    /** Quarter-Second Periodic Interrupt Enable */
+    h8_u8 sec025ie : 1,
+
+    /** Half-Second Periodic Interrupt Enable */
+    h8_u8 sec05ie : 1,
+
+    /** One-Second Periodic Interrupt Enable */
+    h8_u8 sec1ie : 1,
+
+    /** Minute Periodic Interrupt Enable */
+    h8_u8 mnie : 1,
+
+    /** Hour Periodic Interrupt Enable */
+    h8_u8 hrie : 1,
+
+    /** Day Periodic Interrupt Enable */
+    h8_u8 dyie : 1,
+
+    /** Week Periodic Interrupt Enable */
+    h8_u8 wkie : 1,
+
+    /** Free Running Counter Overflow Interrupt Enable. @todo */
+    h8_u8 foie : 1
+  ) flags;
   h8_byte_t raw;
 } h8_rtccr2_t;
 
@@ -180,32 +212,103 @@ typedef union
   h8_byte_t raw;
 } h8_rtccsr_t;
 
-/** RTCFLG. @todo Not particularly needed for an emulator. */
+/**
+ * RTCFLG is set by the RTC as each periodic event occurs, and cleared by
+ * writing 0 to a bit after reading it as 1.
+ * Mapped to 0xF067.
+ */
 typedef union
 {
+  H8_BITFIELD_8
+  (
+    /** Quarter-Second Periodic Interrupt Flag */
+    h8_u8 sec025ifg : 1,
+
+    /** Half-Second Periodic Interrupt Flag */
+    h8_u8 sec05ifg : 1,
+
+    /** One-Second Periodic Interrupt Flag */
+    h8_u8 sec1ifg : 1,
+
+    /** Minute Periodic Interrupt Flag */
+    h8_u8 mnifg : 1,
+
+    /** Hour Periodic Interrupt Flag */
+    h8_u8 hrifg : 1,
+
+    /** Day Periodic Interrupt Flag */
+    h8_u8 dyifg : 1,
+
+    /** Week Periodic Interrupt Flag */
+    h8_u8 wkifg : 1,
+
+    /** Free Running Counter Overflow Interrupt Flag. @todo */
+    h8_u8 foifg : 1
+  ) flags;
   h8_byte_t raw;
 } h8_rtcflg_t;
 
+/** RTC events, as bits of RTCFLG and RTCCR2 */
+enum
+{
+  H8_RTC_EVENT_QUARTER_SECOND = 0x01,
+  H8_RTC_EVENT_HALF_SECOND = 0x02,
+  H8_RTC_EVENT_SECOND = 0x04,
+  H8_RTC_EVENT_MINUTE = 0x08,
+  H8_RTC_EVENT_HOUR = 0x10,
+  H8_RTC_EVENT_DAY = 0x20,
+  H8_RTC_EVENT_WEEK = 0x40,
+  H8_RTC_EVENT_FREE_RUNNING = 0x80
+};
+
+/** The RTC registers, 0xF067 to 0xF06F */
 typedef struct
 {
+  h8_rtcflg_t rtcflg;
   h8_rsecdr_t rsecdr;
   h8_rmindr_t rmindr;
   h8_rhrdr_t rhrdr;
   h8_rwkdr_t rwkdr;
   h8_rtccr1_t rtccr1;
   h8_rtccr2_t rtccr2;
+  h8_byte_t reserved;
   h8_rtccsr_t rtccsr;
-  h8_rtcflg_t rtcflg;
 } h8_rtc_t;
 
 /**
- * Updates the system's RTC registers to match a given time_t.
+ * The RTC's count of emulated time, kept outside of its registers. The RTC
+ * counts in quarter seconds of instructions rather than reading the host
+ * clock, so fast-forwarding emulation fast-forwards the clock with it.
+ */
+typedef struct
+{
+  /** The number of quarter seconds elapsed */
+  h8_u64 ticks;
+
+  /** The instruction count at which the next quarter second elapses */
+  h8_u64 next;
+} h8_rtc_state_t;
+
+/**
+ * Sets the RTC registers to a given time, as seconds since 1970-01-01 00:00.
+ * The time is taken as-is, so add any timezone offset beforehand.
  */
 void h8_rtc_set(h8_rtc_t *rtc, const time_t time);
 
 /**
- * Updates the system's RTC registers to match the current time.
+ * Sets the RTC registers to the host's current time. This only sets where
+ * the RTC starts; from then on it follows emulated time.
+ * @param offset Seconds to add to the host time, such as a timezone offset
  */
 void h8_rtc_set_current(h8_rtc_t *rtc, const time_t offset);
 
+/**
+ * Advances the RTC by one quarter second, carrying into the seconds, minutes,
+ * hours and day of week, and sets the flags of the events that occurred.
+ * Does nothing while RTCCR1.RUN is clear.
+ * @param ticks The number of quarter seconds elapsed, including this one
+ * @return The events that occurred, as H8_RTC_EVENT bits
+ */
+h8_u8 h8_rtc_tick(h8_rtc_t *rtc, h8_u64 ticks);
+
 #endif
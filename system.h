@@ -3,10 +3,16 @@
 
 #include "config.h"
 #include "device.h"
+#include "dma.h"
+#include "input.h"
 #include "ir.h"
+#include "logger.h"
+#include "profiler.h"
 #include "registers.h"
 #include "rtc.h"
+#include "tw.h"
 #include "types.h"
+#include "wdt.h"
 
 typedef union
 {
@@ -205,11 +211,49 @@ typedef struct
   h8_word_be_t reserved39;
 } h8_ivat_t;
 
+/**
+ * Indices of each entry in the interrupt vector address table, in the same
+ * order as the members of `h8_ivat_t`.
+ */
+typedef enum
+{
+  H8_VECTOR_RESET = 0,
+  H8_VECTOR_NMI = 7,
+  H8_VECTOR_TRAPA0,
+  H8_VECTOR_TRAPA1,
+  H8_VECTOR_TRAPA2,
+  H8_VECTOR_TRAPA3,
+  H8_VECTOR_SLEEP = 13,
+  H8_VECTOR_IRQ0 = 16,
+  H8_VECTOR_IRQ1,
+  H8_VECTOR_IRQAEC,
+  H8_VECTOR_COMP0 = 21,
+  H8_VECTOR_COMP1,
+  H8_VECTOR_RTC_QUARTER_SECOND,
+  H8_VECTOR_RTC_HALF_SECOND,
+  H8_VECTOR_RTC_SECOND,
+  H8_VECTOR_RTC_MINUTE,
+  H8_VECTOR_RTC_HOUR,
+  H8_VECTOR_RTC_DAY,
+  H8_VECTOR_RTC_WEEK,
+  H8_VECTOR_RTC_FREE_RUNNING,
+  H8_VECTOR_WATCHDOG_TIMER,
+  H8_VECTOR_ASYNC_EVENT_COUNTER,
+  H8_VECTOR_TIMER_B1,
+  H8_VECTOR_SSU_IIC2,
+  H8_VECTOR_TIMER_W,
+  H8_VECTOR_SCI3 = 37,
+  H8_VECTOR_AD_CONVERSION_END,
+
+  H8_VECTOR_SIZE = 40
+} h8_vector;
+
 typedef struct
 {
   h8_byte_t rom[5];
+  h8_byte_t unimplemented1[0x42];
   h8_rtc_t rtc;
-  h8_byte_t unimplemented1[0xB3];
+  h8_byte_t unimplemented2[0x70];
   h8_ssu_t ssu;
   h8_tw_t tw;
 } h8_io1_t;
@@ -265,12 +309,30 @@ typedef struct
   h8_device_t *device;
 } h8_system_pin_out_t;
 
+/**
+ * Which pins of an IO port have callbacks, as masks of bits in the port's
+ * data register, and the levels last passed to its output callbacks
+ */
+typedef struct
+{
+  h8_u8 in_mask;
+  h8_u8 out_mask;
+
+  /** Output pins whose callback has been called at least once */
+  h8_u8 out_driven;
+
+  h8_u8 out_levels;
+} h8_system_port_t;
+
 typedef struct
 {
   H8D_OP_ADRR_T *func;
   h8_device_t *device;
 } h8_system_adc_t;
 
+/** The end of the A/D conversion in progress, while there is none */
+#define H8_ADC_IDLE (~(h8_u64)0)
+
 typedef struct h8_system_t
 {
   h8_cpu_t cpu;
@@ -288,9 +350,18 @@ typedef struct h8_system_t
 
   h8_ir_t ir;
 
+  /**
+   * The arena devices allocate their state from. Unless set up with a
+   * caller-provided buffer before h8_system_init, it allocates its own.
+   */
+  h8_dma_arena_t arena;
+
   /** The number of devices initialized within `devices` */
   unsigned device_count;
 
+  /** The device whose chip select is active, which receives SSU transfers */
+  h8_device_t *ssu_device;
+
   h8_system_pin_in_t pdr1_in[3];
   h8_system_pin_out_t pdr1_out[3];
 
@@ -306,17 +377,84 @@ typedef struct h8_system_t
   h8_system_pin_in_t pdrb_in[6];
   h8_system_pin_out_t pdrb_out[6];
 
+  /**
+   * Hooked pins for each port, set by h8_system_init. Output callbacks are
+   * only called for pins whose level changed since they were last called.
+   */
+  h8_system_port_t pdr1;
+  h8_system_port_t pdr3;
+  h8_system_port_t pdr8;
+  h8_system_port_t pdr9;
+  h8_system_port_t pdrb;
+
   h8_system_adc_t adc[6];
 
   /** Whether or not SLEEP mode is currently active */
   h8_bool sleep;
 
+#if H8_SSU_BURSTS
+  /**
+   * Set by SSU transfers to have h8_step check whether the instruction that
+   * made one is part of a transfer loop, see H8_SSU_BURSTS
+   */
+  h8_bool ssu_burst;
+#endif
+
+  /**
+   * The number of instructions executed, which also serves as the emulated
+   * time base, see h8_system_time_us
+   */
+  h8_u64 instructions;
+
+  /** The RTC's count of emulated time, see h8_rtc_state_t */
+  h8_rtc_state_t rtc;
+
+  /** The watchdog timer's count, including how often it has reset */
+  h8_wdt_state_t wdt;
+
+  /** Timer W's count, see h8_tw_state_t */
+  h8_tw_state_t tw;
+
+  /**
+   * The instruction count at which the A/D conversion in progress ends, or
+   * H8_ADC_IDLE
+   */
+  h8_u64 adc_end;
+
+  /** The instruction count at which the next timed event is due */
+  h8_u64 event;
+
+  /**
+   * Set when an interrupt source may be requesting service, to have h8_step
+   * check whether one can be accepted
+   */
+  h8_bool interrupt;
+
+  /**
+   * Timestamped button and pin changes posted by the frontend. Events posted
+   * while running are noticed the next time h8_run_until is called or
+   * another timed event is handled.
+   */
+  h8_input_queue_t input;
+
 #if H8_PROFILING
-  unsigned instructions;
   unsigned char reads[0x10000];
   unsigned char writes[0x10000];
   unsigned char executes[0x10000];
 #endif
+
+#if H8_LOGGER_DEFERRED
+  /**
+   * If set, messages logged while stepping this system are recorded here
+   * rather than printed, see h8_log_ring_t
+   */
+  h8_log_ring_t *log_ring;
+#endif
+
+#if H8_PROFILE_SUBSYSTEMS
+  /** Host time spent in each emulator layer, see profiler.h */
+  h8_profile_t profile;
+#endif
 } h8_system_t;
 
 /**
@@ -362,6 +500,19 @@ void h8_step(h8_system_t *system);
  */
 void h8_run(h8_system_t *system);
 
+/**
+ * Runs the system until it has executed a number of instructions in total,
+ * or an error occurs. Time spent in SLEEP waiting for an RTC interrupt is
+ * skipped rather than stepped through, so idle emulated days pass quickly.
+ */
+void h8_run_until(h8_system_t *system, h8_u64 instructions);
+
+/**
+ * Returns the emulated time since the system was created, in microseconds,
+ * derived from instructions executed at H8_INSTRUCTIONS_PER_SECOND
+ */
+h8_u64 h8_system_time_us(const h8_system_t *system);
+
 /**
  * Runs unit tests for the emulator, exiting with either an error code or 0
  */
@@ -369,6 +520,22 @@ void h8_test(void);
 
 h8_bool h8_system_init(h8_system_t *system, const h8_system_id id);
 
+/**
+ * Releases all devices of a system and the memory they hold, and unhooks them
+ * from the IO ports and A/DC. Their state is freed at once with the system's
+ * arena, after any device `free` functions are called. The system must be set
+ * up again before it is run.
+ * With H8_PROFILE_SUBSYSTEMS, the time breakdown of the system is printed.
+ */
+void h8_system_free(h8_system_t *system);
+
+/**
+ * Sets whether a button of the system's button device is held.
+ * @return FALSE if the system has no button device
+ */
+h8_bool h8_system_button(h8_system_t *system, unsigned button,
+                         h8_bool pressed);
+
 h8_byte_t h8_peek_b(h8_system_t *system, const unsigned address);
 
 h8_word_t h8_peek_w(h8_system_t *system, const unsigned address);
@@ -0,0 +1,580 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "transport.h"
+
+#include "dma.h"
+#include "logger.h"
+
+#include <string.h>
+
+#define H8_TRANSPORT_MASK (H8_TRANSPORT_QUEUE_FRAMES - 1)
+
+/** @return The oldest frame, or NULL if the queue is empty */
+static const h8_transport_frame_t *h8_transport_queue_front(
+  const h8_transport_queue_t *queue)
+{
+  if (queue->tail == H8_LOAD_ACQUIRE(queue->head))
+    return NULL;
+
+  return &queue->frames[queue->tail & H8_TRANSPORT_MASK];
+}
+
+static void h8_transport_queue_pop(h8_transport_queue_t *queue)
+{
+  H8_STORE_RELEASE(queue->tail, queue->tail + 1);
+}
+
+h8_bool h8_transport_connected(const h8_transport_t *transport)
+{
+  return H8_LOAD_ACQUIRE(transport->connected) != 0;
+}
+
+unsigned h8_transport_peek(const h8_transport_t *transport)
+{
+  const h8_transport_frame_t *frame =
+    h8_transport_queue_front(&transport->rx);
+
+  return frame ? frame->length : 0;
+}
+
+unsigned h8_transport_receive(h8_transport_t *transport, h8_u8 *data,
+                              unsigned size, h8_u64 *time)
+{
+  const h8_transport_frame_t *frame;
+
+  if (!transport->rx.frames ||
+      !(frame = h8_transport_queue_front(&transport->rx)))
+    return 0;
+  if (size > frame->length)
+    size = frame->length;
+  memcpy(data, frame->data, size);
+  if (time)
+    *time = frame->time;
+  h8_transport_queue_pop(&transport->rx);
+
+  return size;
+}
+
+#if H8_IR_TRANSPORT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+static h8_bool h8_transport_queue_init(h8_transport_queue_t *queue)
+{
+  queue->frames = h8_dma_alloc(H8_TRANSPORT_QUEUE_FRAMES *
+                               sizeof(h8_transport_frame_t), FALSE);
+  queue->head = 0;
+  queue->tail = 0;
+
+  return queue->frames != NULL;
+}
+
+static void h8_transport_queue_free(h8_transport_queue_t *queue)
+{
+  if (queue->frames)
+    h8_dma_free(queue->frames);
+  queue->frames = NULL;
+}
+
+/** @return The next frame to fill, or NULL if the queue is full */
+static h8_transport_frame_t *h8_transport_queue_back(
+  h8_transport_queue_t *queue)
+{
+  unsigned tail = H8_LOAD_ACQUIRE(queue->tail);
+
+  if (queue->head - tail >= H8_TRANSPORT_QUEUE_FRAMES)
+    return NULL;
+
+  return &queue->frames[queue->head & H8_TRANSPORT_MASK];
+}
+
+static void h8_transport_queue_push(h8_transport_queue_t *queue)
+{
+  H8_STORE_RELEASE(queue->head, queue->head + 1);
+}
+
+static void h8_transport_put(h8_u8 *dst, h8_u64 value, unsigned size)
+{
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    dst[i] = (h8_u8)(value >> (i * 8));
+}
+
+static h8_u64 h8_transport_get(const h8_u8 *src, unsigned size)
+{
+  h8_u64 value = 0;
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    value |= (h8_u64)src[i] << (i * 8);
+
+  return value;
+}
+
+struct h8_transport_io_s
+{
+  h8_transport_t *transport;
+  pthread_t thread;
+
+  int listener;
+  int peer;
+  int epoll;
+
+  /** Signalled when frames are queued for sending, or to stop */
+  int wake;
+  unsigned stop;
+
+  /** Set while a connection is in progress */
+  h8_bool connecting;
+
+  /** Set while the peer socket is also waiting to become writable */
+  h8_bool writing;
+
+  /** The frame being received */
+  h8_u8 in[H8_TRANSPORT_HEADER + H8_TRANSPORT_FRAME_MAX];
+  unsigned in_size;
+
+  /** The frame being sent */
+  h8_u8 out[H8_TRANSPORT_HEADER + H8_TRANSPORT_FRAME_MAX];
+  unsigned out_size;
+  unsigned out_sent;
+};
+
+static h8_bool h8_transport_nonblocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void h8_transport_watch(h8_transport_io_t *io, int op, int fd,
+                               unsigned events)
+{
+  struct epoll_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.fd = fd;
+  epoll_ctl(io->epoll, op, fd, &event);
+}
+
+static void h8_transport_drop_peer(h8_transport_io_t *io)
+{
+  if (io->peer >= 0)
+  {
+    epoll_ctl(io->epoll, EPOLL_CTL_DEL, io->peer, NULL);
+    close(io->peer);
+    io->peer = -1;
+  }
+  io->connecting = FALSE;
+  io->writing = FALSE;
+  io->in_size = 0;
+  io->out_size = 0;
+  io->out_sent = 0;
+  H8_STORE_RELEASE(io->transport->connected, 0);
+}
+
+static void h8_transport_accept(h8_transport_io_t *io)
+{
+  int peer = accept(io->listener, NULL, NULL);
+  int on = 1;
+
+  if (peer < 0)
+    return;
+  else if (io->peer >= 0 || !h8_transport_nonblocking(peer))
+  {
+    close(peer);
+    return;
+  }
+  setsockopt(peer, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  io->peer = peer;
+  h8_transport_watch(io, EPOLL_CTL_ADD, peer, EPOLLIN | EPOLLRDHUP);
+  H8_STORE_RELEASE(io->transport->connected, 1);
+}
+
+/** Reads whatever the peer has sent, queueing each frame once complete */
+static void h8_transport_read(h8_transport_io_t *io)
+{
+  h8_transport_t *transport = io->transport;
+
+  for (;;)
+  {
+    unsigned need = H8_TRANSPORT_HEADER;
+    ssize_t received;
+
+    if (io->in_size >= H8_TRANSPORT_HEADER)
+    {
+      h8_u64 length = h8_transport_get(io->in, 4);
+
+      if (length > H8_TRANSPORT_FRAME_MAX)
+      {
+        H8_LOGE(H8_LOG_IR, ("Peer sent a %lu byte frame",
+                            (unsigned long)length));
+        h8_transport_drop_peer(io);
+        return;
+      }
+      need += (unsigned)length;
+    }
+
+    if (io->in_size == need)
+    {
+      h8_transport_frame_t *frame = h8_transport_queue_back(&transport->rx);
+
+      /* Drop frames the emulator is too far behind to take */
+      if (frame)
+      {
+        frame->length = need - H8_TRANSPORT_HEADER;
+        frame->time = h8_transport_get(&io->in[4], 8);
+        memcpy(frame->data, &io->in[H8_TRANSPORT_HEADER], frame->length);
+        h8_transport_queue_push(&transport->rx);
+      }
+      else
+        transport->rx_dropped++;
+      io->in_size = 0;
+      continue;
+    }
+
+    received = recv(io->peer, &io->in[io->in_size], need - io->in_size, 0);
+    if (received > 0)
+      io->in_size += (unsigned)received;
+    else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                              errno == EINTR))
+      return;
+    else
+    {
+      h8_transport_drop_peer(io);
+      return;
+    }
+  }
+}
+
+/** Sends queued frames until done or the socket would block */
+static void h8_transport_write(h8_transport_io_t *io)
+{
+  h8_transport_t *transport = io->transport;
+
+  while (io->peer >= 0 && !io->connecting)
+  {
+    ssize_t sent;
+
+    if (io->out_sent == io->out_size)
+    {
+      const h8_transport_frame_t *frame =
+        h8_transport_queue_front(&transport->tx);
+
+      if (!frame)
+        break;
+      h8_transport_put(io->out, frame->length, 4);
+      h8_transport_put(&io->out[4], frame->time, 8);
+      memcpy(&io->out[H8_TRANSPORT_HEADER], frame->data, frame->length);
+      io->out_size = H8_TRANSPORT_HEADER + frame->length;
+      io->out_sent = 0;
+      h8_transport_queue_pop(&transport->tx);
+    }
+
+    sent = send(io->peer, &io->out[io->out_sent], io->out_size - io->out_sent,
+                MSG_NOSIGNAL);
+    if (sent > 0)
+      io->out_sent += (unsigned)sent;
+    else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                          errno == EINTR))
+    {
+      if (!io->writing)
+      {
+        h8_transport_watch(io, EPOLL_CTL_MOD, io->peer,
+                           EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+        io->writing = TRUE;
+      }
+      return;
+    }
+    else
+    {
+      h8_transport_drop_peer(io);
+      return;
+    }
+  }
+
+  if (io->writing && io->peer >= 0 && !io->connecting)
+  {
+    h8_transport_watch(io, EPOLL_CTL_MOD, io->peer, EPOLLIN | EPOLLRDHUP);
+    io->writing = FALSE;
+  }
+}
+
+static void *h8_transport_thread(void *data)
+{
+  h8_transport_io_t *io = data;
+
+  while (!H8_LOAD_ACQUIRE(io->stop))
+  {
+    struct epoll_event events[4];
+    int count = epoll_wait(io->epoll, events, 4, -1), i;
+
+    for (i = 0; i < count; i++)
+    {
+      int fd = events[i].data.fd;
+
+      if (fd == io->wake)
+      {
+        h8_u64 value;
+
+        if (read(io->wake, &value, sizeof(value)) < 0)
+          continue;
+      }
+      else if (fd == io->listener)
+        h8_transport_accept(io);
+      else if (fd == io->peer)
+      {
+        if (io->connecting && (events[i].events & (EPOLLOUT | EPOLLERR)))
+        {
+          int error = 0;
+          socklen_t size = sizeof(error);
+
+          if (getsockopt(io->peer, SOL_SOCKET, SO_ERROR, &error, &size) ||
+              error)
+          {
+            H8_LOGE(H8_LOG_IR, ("Transport connect failed: %d", error));
+            h8_transport_drop_peer(io);
+            continue;
+          }
+          io->connecting = FALSE;
+          io->writing = TRUE;
+          H8_STORE_RELEASE(io->transport->connected, 1);
+        }
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          h8_transport_read(io);
+      }
+    }
+    h8_transport_write(io);
+  }
+
+  return NULL;
+}
+
+static void h8_transport_io_free(h8_transport_t *transport)
+{
+  h8_transport_io_t *io = transport->io;
+
+  if (io)
+  {
+    if (io->peer >= 0)
+      close(io->peer);
+    if (io->listener >= 0)
+      close(io->listener);
+    if (io->epoll >= 0)
+      close(io->epoll);
+    if (io->wake >= 0)
+      close(io->wake);
+    h8_dma_free(io);
+    transport->io = NULL;
+  }
+  h8_transport_queue_free(&transport->rx);
+  h8_transport_queue_free(&transport->tx);
+}
+
+/** Creates the queues, the epoll set and a TCP socket for an address */
+static int h8_transport_open(h8_transport_t *transport, const char *ip,
+                             unsigned port, struct sockaddr_in *address)
+{
+  h8_transport_io_t *io;
+  int fd;
+
+  memset(transport, 0, sizeof(*transport));
+  memset(address, 0, sizeof(*address));
+  address->sin_family = AF_INET;
+  address->sin_port = htons((unsigned short)port);
+  address->sin_addr.s_addr = inet_addr(ip);
+  if (address->sin_addr.s_addr == INADDR_NONE)
+    return -1;
+
+  io = h8_dma_alloc(sizeof(h8_transport_io_t), TRUE);
+  if (!io)
+    return -1;
+  io->transport = transport;
+  io->listener = -1;
+  io->peer = -1;
+  io->epoll = epoll_create(4);
+  io->wake = eventfd(0, 0);
+  transport->io = io;
+  fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  if (!h8_transport_queue_init(&transport->rx) ||
+      !h8_transport_queue_init(&transport->tx) ||
+      io->epoll < 0 || io->wake < 0 || fd < 0 ||
+      !h8_transport_nonblocking(io->wake) || !h8_transport_nonblocking(fd))
+  {
+    if (fd >= 0)
+      close(fd);
+    h8_transport_io_free(transport);
+    return -1;
+  }
+  h8_transport_watch(io, EPOLL_CTL_ADD, io->wake, EPOLLIN);
+
+  return fd;
+}
+
+static h8_bool h8_transport_start(h8_transport_t *transport)
+{
+  if (pthread_create(&transport->io->thread, NULL, h8_transport_thread,
+                     transport->io))
+  {
+    h8_transport_io_free(transport);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+h8_bool h8_transport_listen(h8_transport_t *transport, const char *ip,
+                            unsigned port)
+{
+  struct sockaddr_in address;
+  int fd = h8_transport_open(transport, ip, port, &address), on = 1;
+
+  if (fd < 0)
+    return FALSE;
+  transport->io->listener = fd;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(fd, (struct sockaddr*)&address, sizeof(address)) ||
+      listen(fd, 1))
+  {
+    H8_LOGE(H8_LOG_IR, ("Transport listen failed: %d", errno));
+    h8_transport_io_free(transport);
+    return FALSE;
+  }
+  h8_transport_watch(transport->io, EPOLL_CTL_ADD, fd, EPOLLIN);
+
+  return h8_transport_start(transport);
+}
+
+h8_bool h8_transport_connect(h8_transport_t *transport, const char *ip,
+                             unsigned port)
+{
+  struct sockaddr_in address;
+  int fd = h8_transport_open(transport, ip, port, &address), on = 1;
+
+  if (fd < 0)
+    return FALSE;
+  transport->io->peer = fd;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  if (!connect(fd, (struct sockaddr*)&address, sizeof(address)))
+    H8_STORE_RELEASE(transport->connected, 1);
+  else if (errno == EINPROGRESS)
+    transport->io->connecting = TRUE;
+  else
+  {
+    H8_LOGE(H8_LOG_IR, ("Transport connect failed: %d", errno));
+    h8_transport_io_free(transport);
+    return FALSE;
+  }
+  h8_transport_watch(transport->io, EPOLL_CTL_ADD, fd,
+                     EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+  transport->io->writing = TRUE;
+
+  return h8_transport_start(transport);
+}
+
+unsigned h8_transport_port(const h8_transport_t *transport)
+{
+  struct sockaddr_in address;
+  socklen_t size = sizeof(address);
+  int fd;
+
+  if (!transport->io)
+    return 0;
+  fd = transport->io->listener >= 0 ? transport->io->listener :
+                                      transport->io->peer;
+  if (fd < 0 || getsockname(fd, (struct sockaddr*)&address, &size))
+    return 0;
+
+  return ntohs(address.sin_port);
+}
+
+void h8_transport_close(h8_transport_t *transport)
+{
+  if (transport->io)
+  {
+    h8_u64 value = 1;
+
+    H8_STORE_RELEASE(transport->io->stop, 1);
+    if (write(transport->io->wake, &value, sizeof(value)) == sizeof(value))
+      pthread_join(transport->io->thread, NULL);
+  }
+  h8_transport_io_free(transport);
+  transport->connected = 0;
+}
+
+h8_bool h8_transport_send(h8_transport_t *transport, const h8_u8 *data,
+                          unsigned length, h8_u64 time)
+{
+  h8_transport_frame_t *frame;
+  h8_u64 value = 1;
+
+  if (!transport->io || length > H8_TRANSPORT_FRAME_MAX ||
+      !(frame = h8_transport_queue_back(&transport->tx)))
+  {
+    transport->tx_dropped++;
+    return FALSE;
+  }
+  frame->length = length;
+  frame->time = time;
+  memcpy(frame->data, data, length);
+  h8_transport_queue_push(&transport->tx);
+
+  return write(transport->io->wake, &value, sizeof(value)) == sizeof(value);
+}
+
+#else
+
+h8_bool h8_transport_listen(h8_transport_t *transport, const char *ip,
+                            unsigned port)
+{
+  H8_UNUSED(ip);
+  H8_UNUSED(port);
+  memset(transport, 0, sizeof(*transport));
+  return FALSE;
+}
+
+h8_bool h8_transport_connect(h8_transport_t *transport, const char *ip,
+                             unsigned port)
+{
+  H8_UNUSED(ip);
+  H8_UNUSED(port);
+  memset(transport, 0, sizeof(*transport));
+  return FALSE;
+}
+
+unsigned h8_transport_port(const h8_transport_t *transport)
+{
+  H8_UNUSED(transport);
+  return 0;
+}
+
+void h8_transport_close(h8_transport_t *transport)
+{
+  H8_UNUSED(transport);
+}
+
+h8_bool h8_transport_send(h8_transport_t *transport, const h8_u8 *data,
+                          unsigned length, h8_u64 time)
+{
+  H8_UNUSED(data);
+  H8_UNUSED(length);
+  H8_UNUSED(time);
+  transport->tx_dropped++;
+  return FALSE;
+}
+
+#endif
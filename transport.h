@@ -0,0 +1,104 @@
+#ifndef H8_TRANSPORT_H
+#define H8_TRANSPORT_H
+
+#include "types.h"
+
+/**
+ * A non-blocking network transport for IR traffic. Socket I/O runs on its own
+ * thread around epoll, so a slow or broken connection never stalls
+ * emulation; the emulator only touches two lock-free frame queues.
+ *
+ * Each frame keeps the boundaries of one IR transmission and is stamped with
+ * the sender's emulated time. On the wire, all values are little-endian:
+ *   length (32-bit), time in instructions (64-bit), bytes
+ */
+
+/** The size of a frame header on the wire */
+#define H8_TRANSPORT_HEADER 12
+
+typedef struct
+{
+  h8_u64 time;
+  unsigned length;
+  h8_u8 data[H8_TRANSPORT_FRAME_MAX];
+} h8_transport_frame_t;
+
+/**
+ * Frames passed between one producer and one consumer thread. The head and
+ * tail count every frame ever pushed and popped.
+ */
+typedef struct
+{
+  h8_transport_frame_t *frames;
+  unsigned head;
+  unsigned tail;
+} h8_transport_queue_t;
+
+typedef struct h8_transport_io_s h8_transport_io_t;
+
+typedef struct h8_transport_t
+{
+  /** Frames received from the peer, for the emulator */
+  h8_transport_queue_t rx;
+
+  /** Frames sent by the emulator, for the peer */
+  h8_transport_queue_t tx;
+
+  /** State owned by the I/O thread */
+  h8_transport_io_t *io;
+
+  /** Set by the I/O thread while a peer is connected */
+  unsigned connected;
+
+  /** Received frames dropped because the emulator had not taken earlier ones */
+  unsigned long rx_dropped;
+
+  /** Frames the emulator could not send because its queue was full */
+  unsigned long tx_dropped;
+} h8_transport_t;
+
+/**
+ * Listens for one peer on an address and starts the I/O thread.
+ * @param port The port to listen on, or 0 to pick any, see h8_transport_port
+ * @return FALSE if the transport could not be started
+ */
+h8_bool h8_transport_listen(h8_transport_t *transport, const char *ip,
+                            unsigned port);
+
+/**
+ * Connects to a listening peer and starts the I/O thread. Does not wait for
+ * the connection; frames sent before it completes are queued.
+ * @return FALSE if the transport could not be started
+ */
+h8_bool h8_transport_connect(h8_transport_t *transport, const char *ip,
+                             unsigned port);
+
+/** @return The local port of a transport, or 0 if it is not started */
+unsigned h8_transport_port(const h8_transport_t *transport);
+
+/** Stops the I/O thread and closes all sockets */
+void h8_transport_close(h8_transport_t *transport);
+
+h8_bool h8_transport_connected(const h8_transport_t *transport);
+
+/**
+ * Queues a frame for the peer without blocking.
+ * @param time The sender's emulated time
+ * @return FALSE if the frame is too large or the queue is full
+ */
+h8_bool h8_transport_send(h8_transport_t *transport, const h8_u8 *data,
+                          unsigned length, h8_u64 time);
+
+/** @return The length of the next received frame, or 0 if there is none */
+unsigned h8_transport_peek(const h8_transport_t *transport);
+
+/**
+ * Takes the next received frame without blocking. Bytes beyond size are
+ * discarded.
+ * @param time If not NULL, set to the sender's emulated time
+ * @return The number of bytes copied, or 0 if there was no frame
+ */
+unsigned h8_transport_receive(h8_transport_t *transport, h8_u8 *data,
+                              unsigned size, h8_u64 *time);
+
+#endif
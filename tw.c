@@ -0,0 +1,174 @@
+#include "tw.h"
+
+/** The bit of TSRW flagging an overflow */
+#define H8_TW_OVERFLOW 7
+
+static h8_u64 h8_tw_gcd(h8_u64 a, h8_u64 b)
+{
+  while (b)
+  {
+    h8_u64 r = a % b;
+
+    a = b;
+    b = r;
+  }
+
+  return a;
+}
+
+/**
+ * Gets the rate TCNT counts at, as the number of counts per `per`
+ * instructions, reduced so that whole multiples of both line up exactly.
+ * @return FALSE if TCNT is stopped or counts an external clock
+ */
+static h8_bool h8_tw_rate(const h8_tw_t *tw, h8_u64 *counts, h8_u64 *per)
+{
+  h8_u64 gcd;
+
+  if (!tw->tmrw.flags.cts || tw->tcrw.flags.cks & B0100)
+    return FALSE;
+  *counts = H8_SYSTEM_CLOCK_HZ;
+  *per = (h8_u64)H8_INSTRUCTIONS_PER_SECOND << tw->tcrw.flags.cks;
+  gcd = h8_tw_gcd(*counts, *per);
+  *counts /= gcd;
+  *per /= gcd;
+
+  return TRUE;
+}
+
+/** @return The counts made in a number of instructions, without overflow */
+static h8_u64 h8_tw_counts(h8_u64 instructions, h8_u64 counts, h8_u64 per)
+{
+  return instructions / per * counts + instructions % per * counts / per;
+}
+
+/** @return The instructions needed to make a number of counts */
+static h8_u64 h8_tw_instructions(h8_u64 n, h8_u64 counts, h8_u64 per)
+{
+  return n / counts * per + (n % counts * per + counts - 1) / counts;
+}
+
+static h8_u32 h8_tw_gr(const h8_tw_t *tw, unsigned index)
+{
+  return (h8_u32)(tw->gr[index].h.u << 8 | tw->gr[index].l.u);
+}
+
+/** @return The value of TCNT after counting n times from c */
+static h8_u32 h8_tw_value(const h8_tw_t *tw, h8_u32 c, h8_u64 n)
+{
+  h8_u32 gra = h8_tw_gr(tw, 0);
+  h8_u64 wrap = 0x10000 - c;
+
+  if (!tw->tcrw.flags.cclr)
+    return (h8_u32)((c + n) & 0xFFFF);
+  else if (c <= gra)
+    return (h8_u32)((c + n) % (gra + 1));
+  /* Above GRA, TCNT runs up to the overflow before being cleared by it */
+  else if (n < wrap)
+    return (h8_u32)(c + n);
+  else
+    return (h8_u32)((n - wrap) % (gra + 1));
+}
+
+/**
+ * @param bit The TSRW flag of the event
+ * @return The number of counts from c until the event next occurs
+ */
+static h8_u64 h8_tw_until(const h8_tw_t *tw, h8_u32 c, unsigned bit)
+{
+  h8_u32 gra = h8_tw_gr(tw, 0);
+  const h8_tior_t *tior = bit < 2 ? &tw->tior0 : &tw->tior1;
+  h8_u32 v;
+
+  if (bit == H8_TW_OVERFLOW)
+    return tw->tcrw.flags.cclr && c <= gra && gra != 0xFFFF ?
+           H8_TW_NEVER : 0x10000 - c;
+  else if ((bit & 1 ? tior->flags.iob : tior->flags.ioa) & H8_TIOR_CAPTURE)
+    return H8_TW_NEVER;
+
+  v = h8_tw_gr(tw, bit);
+  if (!tw->tcrw.flags.cclr)
+    return ((v + 0x10000 - c - 1) & 0xFFFF) + 1;
+  else if (c <= gra)
+    return v > gra ? H8_TW_NEVER : (v + gra - c) % (gra + 1) + 1;
+  else if (v > c)
+    return v - c;
+  else
+    return v <= gra ? 0x10000 - c + v : H8_TW_NEVER;
+}
+
+/**
+ * Schedules the next event that would set a flag. Once a flag is set, later
+ * matches change nothing until it is cleared, so they are not scheduled.
+ */
+static void h8_tw_schedule(const h8_tw_t *tw, h8_tw_state_t *state)
+{
+  h8_u64 counts, per, next = H8_TW_NEVER;
+  h8_u8 wanted = ~tw->tsrw.raw.u & H8_TSRW_FLAGS;
+  h8_u32 c;
+  unsigned bit;
+
+  state->deadline = H8_TW_NEVER;
+  if (!wanted || !h8_tw_rate(tw, &counts, &per))
+    return;
+
+  c = h8_tw_value(tw, state->start, state->done);
+  for (bit = 0; bit < 8; bit++)
+  {
+    if (wanted & (1 << bit))
+    {
+      h8_u64 until = h8_tw_until(tw, c, bit);
+
+      if (until < next)
+        next = until;
+    }
+  }
+  if (next != H8_TW_NEVER)
+    state->deadline = state->base +
+                      h8_tw_instructions(state->done + next, counts, per);
+}
+
+void h8_tw_sync(h8_tw_t *tw, const h8_tw_state_t *state, h8_u64 now)
+{
+  h8_u64 counts, per;
+  h8_u32 value;
+
+  if (!h8_tw_rate(tw, &counts, &per) || now < state->base)
+    return;
+  value = h8_tw_value(tw, state->start,
+                      h8_tw_counts(now - state->base, counts, per));
+  tw->tcnt.h.u = (h8_u8)(value >> 8);
+  tw->tcnt.l.u = (h8_u8)value;
+}
+
+void h8_tw_restart(const h8_tw_t *tw, h8_tw_state_t *state, h8_u64 now)
+{
+  state->base = now;
+  state->start = (h8_u16)(tw->tcnt.h.u << 8 | tw->tcnt.l.u);
+  state->done = 0;
+  h8_tw_schedule(tw, state);
+}
+
+h8_bool h8_tw_update(h8_tw_t *tw, h8_tw_state_t *state, h8_u64 now)
+{
+  h8_u64 counts, per, n;
+
+  if (h8_tw_rate(tw, &counts, &per) && now > state->base)
+  {
+    n = h8_tw_counts(now - state->base, counts, per);
+    if (n > state->done)
+    {
+      h8_u32 c = h8_tw_value(tw, state->start, state->done);
+      unsigned bit;
+
+      for (bit = 0; bit < 8; bit++)
+        if ((H8_TSRW_FLAGS & (1 << bit)) &&
+            h8_tw_until(tw, c, bit) <= n - state->done)
+          tw->tsrw.raw.u |= 1 << bit;
+      state->done = n;
+    }
+  }
+  h8_tw_schedule(tw, state);
+
+  return (tw->tsrw.raw.u & tw->tierw.raw.u & H8_TSRW_FLAGS) != 0;
+}
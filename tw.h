@@ -0,0 +1,49 @@
+#ifndef H8_TW_H
+#define H8_TW_H
+
+#include "registers.h"
+#include "types.h"
+
+/**
+ * Timer W's count of emulated time, kept outside of its registers. TCNT is
+ * not ticked per instruction; its value is computed from the instruction
+ * count when it is read, and only the next compare match or overflow that
+ * would change anything is scheduled, so an idle timer costs nothing.
+ */
+typedef struct
+{
+  /** The instruction count TCNT last started counting from */
+  h8_u64 base;
+
+  /** The value of TCNT at base */
+  h8_u16 start;
+
+  /** The number of counts since base whose matches have been flagged */
+  h8_u64 done;
+
+  /** The instruction count at which the next match or overflow is due */
+  h8_u64 deadline;
+} h8_tw_state_t;
+
+/** A deadline that is never reached */
+#define H8_TW_NEVER (~(h8_u64)0)
+
+/**
+ * Brings TCNT up to date with the instruction count.
+ */
+void h8_tw_sync(h8_tw_t *tw, const h8_tw_state_t *state, h8_u64 now);
+
+/**
+ * Starts TCNT counting again from its current value, after it or any of the
+ * registers controlling it has changed, and schedules the next event.
+ */
+void h8_tw_restart(const h8_tw_t *tw, h8_tw_state_t *state, h8_u64 now);
+
+/**
+ * Sets the TSRW flags of every compare match and overflow that has occurred
+ * by an instruction count, and schedules the next event.
+ * @return Whether an enabled interrupt is now flagged
+ */
+h8_bool h8_tw_update(h8_tw_t *tw, h8_tw_state_t *state, h8_u64 now);
+
+#endif
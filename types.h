@@ -9,6 +9,7 @@
 #define h8_s16 signed short
 #define h8_u32 unsigned int
 #define h8_s32 signed int
+#define h8_u64 unsigned long long
 #define h8_bool unsigned char
 
 #ifndef TRUE
@@ -270,6 +271,67 @@ typedef union
   h8_word_t bits;
 } h8_instruction_t;
 
+/* Storage for variables with one instance per host thread */
+#if defined(_MSC_VER)
+#define H8_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define H8_THREAD_LOCAL __thread
+#else
+#define H8_THREAD_LOCAL
+#endif
+
+/**
+ * Loads and stores for unsigned indices shared between one producer and one
+ * consumer thread. Writes made before a release store are visible to a thread
+ * that observes the stored value with an acquire load. Define both to port to
+ * a compiler not handled here.
+ */
+#if defined(H8_LOAD_ACQUIRE) && defined(H8_STORE_RELEASE)
+/* Provided by the build */
+#elif defined(__clang__) || (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define H8_LOAD_ACQUIRE(a) __atomic_load_n(&(a), __ATOMIC_ACQUIRE)
+#define H8_STORE_RELEASE(a, b) __atomic_store_n(&(a), b, __ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+/* Older GCC only has full barriers */
+#define H8_LOAD_ACQUIRE(a) __extension__ \
+  ({ unsigned h8_value = *(const volatile unsigned*)&(a); \
+     __sync_synchronize(); h8_value; })
+#define H8_STORE_RELEASE(a, b) \
+  (__sync_synchronize(), (void)(*(volatile unsigned*)&(a) = (b)))
+#else
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define H8_ACQUIRE_FENCE() atomic_thread_fence(memory_order_acquire)
+#define H8_RELEASE_FENCE() atomic_thread_fence(memory_order_release)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+/* x86 keeps loads before later accesses and stores after earlier ones */
+#include <intrin.h>
+#define H8_ACQUIRE_FENCE() _ReadWriteBarrier()
+#define H8_RELEASE_FENCE() _ReadWriteBarrier()
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+#include <intrin.h>
+#define H8_ACQUIRE_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#define H8_RELEASE_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#else
+#error "Define H8_LOAD_ACQUIRE and H8_STORE_RELEASE for this compiler"
+#endif
+
+static unsigned h8_load_acquire(const volatile unsigned *a)
+{
+  unsigned value = *a;
+
+  H8_ACQUIRE_FENCE();
+
+  return value;
+}
+
+#define H8_LOAD_ACQUIRE(a) h8_load_acquire(&(a))
+#define H8_STORE_RELEASE(a, b) \
+  (H8_RELEASE_FENCE(), (void)(*(volatile unsigned*)&(a) = (b)))
+#endif
+
 /* Used to silence warning for unused variables */
 #define H8_UNUSED(a) (void)a
 
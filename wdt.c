@@ -0,0 +1,85 @@
+#include "wdt.h"
+
+/**
+ * Gets the rate TCWD counts at, as the number of counts per `per`
+ * instructions, so that both can stay integers.
+ */
+static void h8_wdt_rate(const h8_wdt_t *wdt, h8_u64 *counts, h8_u64 *per)
+{
+  unsigned cks = wdt->tmwd.flags.cks;
+
+  if (cks & B1000)
+  {
+    /* phi/64 for 1000, doubling for each step up to phi/8192 */
+    *counts = H8_SYSTEM_CLOCK_HZ;
+    *per = (h8_u64)H8_INSTRUCTIONS_PER_SECOND * (64 << (cks & B0111));
+  }
+  else
+  {
+    *counts = H8_WDT_OSCILLATOR_HZ;
+    *per = H8_INSTRUCTIONS_PER_SECOND;
+  }
+}
+
+void h8_wdt_sync(h8_wdt_t *wdt, const h8_wdt_state_t *state, h8_u64 now)
+{
+  h8_u64 counts, per;
+
+  if (!wdt->tcsrwd1.flags.wdon || now < state->base)
+    return;
+  h8_wdt_rate(wdt, &counts, &per);
+  wdt->tcwd.u = (h8_u8)(state->start + (now - state->base) * counts / per);
+}
+
+void h8_wdt_restart(const h8_wdt_t *wdt, h8_wdt_state_t *state, h8_u64 now)
+{
+  h8_u64 counts, per;
+
+  state->base = now;
+  state->start = wdt->tcwd.u;
+  if (!wdt->tcsrwd1.flags.wdon)
+  {
+    state->deadline = H8_WDT_NEVER;
+    return;
+  }
+
+  /* The first instruction count by which all remaining counts have passed */
+  h8_wdt_rate(wdt, &counts, &per);
+  state->deadline = now + ((h8_u64)(0x100 - state->start) * per + counts - 1) /
+                    counts;
+}
+
+h8_tcsrwd1_t h8_wdt_write_tcsrwd1(h8_tcsrwd1_t old, h8_tcsrwd1_t value)
+{
+  h8_tcsrwd1_t result = old;
+
+  if (!value.flags.b6wi)
+    result.flags.tcwe = value.flags.tcwe;
+  if (!value.flags.b4wi)
+    result.flags.tcsrwe = value.flags.tcsrwe;
+  if (result.flags.tcsrwe && !value.flags.b2wi)
+    result.flags.wdon = value.flags.wdon;
+  if (result.flags.tcsrwe && !value.flags.b0wi)
+    result.flags.wrst = value.flags.wrst;
+  result.flags.b0wi = 1;
+  result.flags.b2wi = 1;
+  result.flags.b4wi = 1;
+  result.flags.b6wi = 1;
+
+  return result;
+}
+
+h8_tcsrwd2_t h8_wdt_write_tcsrwd2(h8_tcsrwd2_t old, h8_tcsrwd2_t value)
+{
+  h8_tcsrwd2_t result = old;
+
+  if (!value.flags.b5wi)
+    result.flags.ieovf = value.flags.ieovf;
+
+  /* The overflow flag can only be cleared */
+  result.flags.ovf &= value.flags.ovf;
+  result.flags.b5wi = 1;
+  result.flags.reserved = 0x1F;
+
+  return result;
+}
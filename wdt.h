@@ -0,0 +1,48 @@
+#ifndef H8_WDT_H
+#define H8_WDT_H
+
+#include "registers.h"
+#include "types.h"
+
+/**
+ * The watchdog timer's count of emulated time, kept outside of its
+ * registers. TCWD is not ticked per instruction; its value is computed from
+ * the instruction count when it is read, and its overflow is scheduled.
+ */
+typedef struct
+{
+  /** The instruction count TCWD last started counting from */
+  h8_u64 base;
+
+  /** The value of TCWD at base */
+  h8_u8 start;
+
+  /** The instruction count at which TCWD overflows, if it is counting */
+  h8_u64 deadline;
+
+  /** The number of times the watchdog has reset the system */
+  unsigned long resets;
+} h8_wdt_state_t;
+
+/** A deadline that is never reached */
+#define H8_WDT_NEVER (~(h8_u64)0)
+
+/**
+ * Brings TCWD up to date with the instruction count.
+ */
+void h8_wdt_sync(h8_wdt_t *wdt, const h8_wdt_state_t *state, h8_u64 now);
+
+/**
+ * Starts TCWD counting again from its current value, after it or the clock
+ * it counts has changed, and schedules its overflow.
+ */
+void h8_wdt_restart(const h8_wdt_t *wdt, h8_wdt_state_t *state, h8_u64 now);
+
+/**
+ * Handles the write-inhibit bits of TCSRWD1 and TCSRWD2, returning what the
+ * register holds after a write.
+ */
+h8_tcsrwd1_t h8_wdt_write_tcsrwd1(h8_tcsrwd1_t old, h8_tcsrwd1_t value);
+h8_tcsrwd2_t h8_wdt_write_tcsrwd2(h8_tcsrwd2_t old, h8_tcsrwd2_t value);
+
+#endif